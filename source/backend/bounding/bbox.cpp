@@ -98,6 +98,8 @@
  *
  *********************************************************************************/
 
+#include <algorithm>
+
 // frame.h must always be the first POV file included (pulls in platform config)
 #include "backend/frame.h"
 #include "backend/bounding/bbox.h"
@@ -116,15 +118,26 @@ namespace pov
 const int BUNCHING_FACTOR = 4;
 // Initial number of entries in a priority queue.
 const int INITIAL_PRIORITY_QUEUE_SIZE = 256;
+// Ranges smaller than this are not split up into separate build jobs.
+const ptrdiff_t MIN_BBOX_BUILD_JOB_SIZE = 1024;
 
 BBOX_TREE *create_bbox_node(int size);
 
 int find_axis(BBOX_TREE **Finite, ptrdiff_t first, ptrdiff_t last);
 void calc_bbox(BBOX *BBox, BBOX_TREE **Finite, ptrdiff_t first, ptrdiff_t last);
 void build_area_table(BBOX_TREE **Finite, ptrdiff_t a, ptrdiff_t b, DBL *areas);
-int sort_and_split(BBOX_TREE **Root, BBOX_TREE **&Finite, size_t *numOfFiniteObjects, ptrdiff_t first, ptrdiff_t last, size_t& maxfinitecount);
+ptrdiff_t find_split(BBOX_TREE **Finite, ptrdiff_t first, ptrdiff_t last);
+BBOX_TREE *create_composite_node(BBOX_TREE **Finite, ptrdiff_t first, ptrdiff_t last);
+void sort_and_split(BBOX_TREE **Finite, ptrdiff_t first, ptrdiff_t last, vector<BBOX_TREE *>& nodes);
+void split_into_jobs(BBOX_TREE **Finite, ptrdiff_t first, ptrdiff_t last, unsigned int levels, vector<BBoxBuildJob>& jobs);
 
 void priority_queue_insert(PriorityQueue& Queue, DBL Depth, BBOX_TREE *Node);
+void check_and_push_packet(BBoxPacketStack& stack, const BBOX_TREE *Node, const BBOX *BBox, const RayPacketInfo& rayinfo, TraceThreadData *Thread);
+
+struct BBoxPacketEntryFarther
+{
+	bool operator()(const BBoxPacketEntry& a, const BBoxPacketEntry& b) const { return a.mindepth > b.mindepth; }
+};
 
 PriorityQueue::PriorityQueue()
 {
@@ -251,7 +264,12 @@ void Recompute_Inverse_BBox(BBOX *bbox, const TRANSFORM *trans)
 // - an infinite flag
 // - a bounding box enclosing the element
 // - a pointer to the structure representing the element (e.g an object)
-void Build_BBox_Tree(BBOX_TREE **Root, size_t numOfFiniteObjects, BBOX_TREE **&Finite, size_t numOfInfiniteObjects, BBOX_TREE **Infinite, size_t& maxfinitecount)
+//
+// If a job runner is given, each level of the hierarchy is split up into
+// independent jobs which the runner may process in parallel. The jobs are
+// merged back in their original order, so the resulting tree is the same
+// as if it had been built serially.
+void Build_BBox_Tree(BBOX_TREE **Root, size_t numOfFiniteObjects, BBOX_TREE **&Finite, size_t numOfInfiniteObjects, BBOX_TREE **Infinite, size_t& maxfinitecount, BBoxBuildJobRunner *runner)
 {
 	ptrdiff_t low, high;
 	BBOX_TREE *cd, *root;
@@ -267,8 +285,44 @@ void Build_BBox_Tree(BBOX_TREE **Root, size_t numOfFiniteObjects, BBOX_TREE **&F
 		low = 0;
 		high = numOfFiniteObjects;
 
-		while(sort_and_split(Root, Finite, &numOfFiniteObjects, low, high, maxfinitecount) == 0)
+		while(true)
 		{
+			vector<BBoxBuildJob> jobs;
+
+			if(runner != NULL)
+			{
+				split_into_jobs(Finite, low, high, runner->GetJobLevels(), jobs);
+				(*runner)(Finite, jobs);
+			}
+			else
+			{
+				jobs.push_back(BBoxBuildJob(low, high));
+				Build_BBox_Job(Finite, jobs.back());
+			}
+
+			// Append the new composite nodes to the list in job order.
+			size_t newnodes = 0;
+			for(vector<BBoxBuildJob>::iterator i(jobs.begin()); i != jobs.end(); i++)
+				newnodes += i->nodes.size();
+
+			if(numOfFiniteObjects + newnodes > maxfinitecount)
+			{
+				// Prim array overrun, increase array by 50%.
+				maxfinitecount = max(size_t(1.5 * maxfinitecount), numOfFiniteObjects + newnodes);
+				Finite = (BBOX_TREE **)POV_REALLOC(Finite, maxfinitecount * sizeof(BBOX_TREE *), "bounding boxes");
+			}
+
+			for(vector<BBoxBuildJob>::iterator i(jobs.begin()); i != jobs.end(); i++)
+				for(vector<BBOX_TREE *>::iterator j(i->nodes.begin()); j != i->nodes.end(); j++)
+					Finite[numOfFiniteObjects++] = *j;
+
+			// A single composite node encloses everything and becomes the root.
+			if(newnodes == 1)
+			{
+				*Root = Finite[numOfFiniteObjects - 1];
+				break;
+			}
+
 			low = high;
 			high = numOfFiniteObjects;
 		}
@@ -310,7 +364,7 @@ void Build_BBox_Tree(BBOX_TREE **Root, size_t numOfFiniteObjects, BBOX_TREE **&F
 	}
 }
 
-void Build_Bounding_Slabs(BBOX_TREE **Root, vector<ObjectPtr>& objects, unsigned int& numberOfFiniteObjects, unsigned int& numberOfInfiniteObjects, unsigned int& numberOfLightSources)
+void Build_Bounding_Slabs(BBOX_TREE **Root, vector<ObjectPtr>& objects, unsigned int& numberOfFiniteObjects, unsigned int& numberOfInfiniteObjects, unsigned int& numberOfLightSources, BBoxBuildJobRunner *runner)
 {
 	ptrdiff_t iFinite, iInfinite;
 	BBOX_TREE **Finite, **Infinite;
@@ -407,7 +461,7 @@ void Build_Bounding_Slabs(BBOX_TREE **Root, vector<ObjectPtr>& objects, unsigned
 	}
 
 	// Now build the bounding box tree.
-	Build_BBox_Tree(Root, numberOfFiniteObjects, Finite, numberOfInfiniteObjects, Infinite, maxfinitecount);
+	Build_BBox_Tree(Root, numberOfFiniteObjects, Finite, numberOfInfiniteObjects, Infinite, maxfinitecount, runner);
 
 	// Get rid of the Finite and Infinite arrays and just use Root.
 	if(Finite != NULL)
@@ -526,6 +580,81 @@ bool Intersect_BBox_Tree(PriorityQueue& pqueue, const BBOX_TREE *Root, const Ray
 	return (found);
 }
 
+// Find the closest intersection of each ray of a packet in a single
+// traversal of the bounding box tree. Each ray only tests the objects
+// the single ray traversal would test as well, so the intersections found
+// are the same as those of Intersect_BBox_Tree(). Nodes are visited depth
+// first, nearest children first, instead of using a priority queue.
+void Intersect_BBox_Tree_Packet(BBoxPacketStack& stack, const BBOX_TREE *Root, const Ray * const *rays, Intersection * const *Best_Intersections, unsigned int count, const RayObjectCondition& precondition, const RayObjectCondition& postcondition, TraceThreadData *Thread)
+{
+	unsigned int i;
+	int j;
+	bool visit;
+	BBoxPacketEntry entry;
+	Intersection New_Intersection;
+
+	// Create the direction vectors for the rays.
+	RayPacketInfo rayinfo(rays, count);
+
+	// Start with an empty stack.
+	stack.clear();
+	New_Intersection.Object = NULL;
+
+	// Check top node.
+	check_and_push_packet(stack, Root, &Root->BBox, rayinfo, Thread);
+
+	// Check elements on the stack.
+	while(stack.empty() == false)
+	{
+		entry = stack.back();
+		stack.pop_back();
+
+		// Skip the node for rays that already found an intersection closer
+		// than the bounding box.
+		visit = false;
+		for(i = 0; i < count; i++)
+		{
+			if(entry.depth[i] <= Best_Intersections[i]->Depth)
+				visit = true;
+			else
+				entry.depth[i] = HUGE_VAL;
+		}
+
+		if(visit == false)
+			continue;
+
+		// Check current node.
+		if(entry.node->Entries)
+		{
+			size_t first = stack.size();
+
+			// This is a node containing leaves to be checked.
+			for(j = 0; j < entry.node->Entries; j++)
+				check_and_push_packet(stack, entry.node->Node[j], &entry.node->Node[j]->BBox, rayinfo, Thread);
+
+			// Make sure the nearest node is checked next.
+			sort(stack.begin() + first, stack.end(), BBoxPacketEntryFarther());
+		}
+		else
+		{
+			ObjectPtr object = (ObjectPtr )entry.node->Node;
+
+			// This is a leaf so test contained object.
+			for(i = 0; i < count; i++)
+			{
+				if((entry.depth[i] <= Best_Intersections[i]->Depth) && (precondition(*rays[i], object, 0.0) == true))
+				{
+					if(Find_Intersection(&New_Intersection, object, *rays[i], postcondition, Thread))
+					{
+						if(New_Intersection.Depth < Best_Intersections[i]->Depth)
+							*Best_Intersections[i] = New_Intersection;
+					}
+				}
+			}
+		}
+	}
+}
+
 void priority_queue_insert(PriorityQueue& Queue, DBL Depth, const BBOX_TREE *Node)
 {
 	unsigned size;
@@ -795,6 +924,79 @@ void Check_And_Enqueue(PriorityQueue& Queue, const BBOX_TREE *Node, const BBOX *
 	priority_queue_insert(Queue, dmin, Node);
 }
 
+// Test a bounding box against all rays of a packet and push it if it is
+// hit by any of them. This is the same test as in Check_And_Enqueue(),
+// but done for each ray of the packet without branches on the ray direction.
+void check_and_push_packet(BBoxPacketStack& stack, const BBOX_TREE *Node, const BBOX *BBox, const RayPacketInfo& rayinfo, TraceThreadData *Thread)
+{
+	BBoxPacketEntry entry;
+	DBL dmin[RAY_PACKET_SIZE];
+	DBL dmax[RAY_PACKET_SIZE];
+	DBL t0, t1;
+	unsigned int i;
+	int a;
+	bool hit = false;
+
+	entry.node = Node;
+	entry.mindepth = HUGE_VAL;
+
+	if(Node->Infinite == false)
+	{
+		Thread->Stats()[nChecked] += rayinfo.size;
+
+		for(i = 0; i < RAY_PACKET_SIZE; i++)
+		{
+			dmin[i] = -BOUND_HUGE;
+			dmax[i] = BOUND_HUGE;
+		}
+
+		for(a = X; a <= Z; a++)
+		{
+			for(i = 0; i < RAY_PACKET_SIZE; i++)
+			{
+				if(rayinfo.nonzero[a][i])
+				{
+					t0 = (BBox->Lower_Left[a] - rayinfo.slab_num[a][i]) * rayinfo.slab_den[a][i];
+					t1 = t0 + (BBox->Lengths[a] * rayinfo.slab_den[a][i]);
+
+					dmin[i] = max(dmin[i], min(t0, t1));
+					dmax[i] = min(dmax[i], max(t0, t1));
+				}
+				else if((rayinfo.slab_num[a][i] < BBox->Lower_Left[a]) ||
+				        (rayinfo.slab_num[a][i] > BBox->Lengths[a] + BBox->Lower_Left[a]))
+				{
+					dmin[i] = BOUND_HUGE;
+					dmax[i] = -BOUND_HUGE;
+				}
+			}
+		}
+
+		for(i = 0; i < RAY_PACKET_SIZE; i++)
+		{
+			if((i < rayinfo.size) && (dmax[i] >= EPSILON) && (dmin[i] <= dmax[i]))
+			{
+				Thread->Stats()[nEnqueued]++;
+				entry.depth[i] = dmin[i];
+				entry.mindepth = min(entry.mindepth, dmin[i]);
+				hit = true;
+			}
+			else
+				entry.depth[i] = HUGE_VAL;
+		}
+	}
+	else
+	{
+		// Set intersection depth to -Max_Distance.
+		for(i = 0; i < RAY_PACKET_SIZE; i++)
+			entry.depth[i] = (i < rayinfo.size) ? -MAX_DISTANCE : HUGE_VAL;
+		entry.mindepth = -MAX_DISTANCE;
+		hit = true;
+	}
+
+	if(hit == true)
+		stack.push_back(entry);
+}
+
 BBOX_TREE *create_bbox_node(int size)
 {
 	BBOX_TREE *New;
@@ -978,9 +1180,11 @@ void build_area_table(BBOX_TREE **Finite, ptrdiff_t a, ptrdiff_t b, DBL *areas)
 	}
 }
 
-int sort_and_split(BBOX_TREE **Root, BBOX_TREE **&Finite, size_t *numOfFiniteObjects, ptrdiff_t first, ptrdiff_t last, size_t& maxfinitecount)
+// Sort the given range along its largest axis and find the most effective
+// point to split it. Returns the first element of the right-hand group, or
+// -1 if the range should not be split any further.
+ptrdiff_t find_split(BBOX_TREE **Finite, ptrdiff_t first, ptrdiff_t last)
 {
-	BBOX_TREE *cd;
 	ptrdiff_t size, i, best_loc;
 	DBL *area_left, *area_right;
 	DBL best_index, new_index;
@@ -988,7 +1192,7 @@ int sort_and_split(BBOX_TREE **Root, BBOX_TREE **&Finite, size_t *numOfFiniteObj
 	int Axis = find_axis(Finite, first, last);
 	size = last - first;
 	if(size <= 0)
-		return (1);
+		return (-1);
 
 	// Actually, we could do this faster in several ways. We could use a
 	// logn algorithm to find the median along the given axis, and then a
@@ -1044,34 +1248,67 @@ int sort_and_split(BBOX_TREE **Root, BBOX_TREE **&Finite, size_t *numOfFiniteObj
 	// Stop splitting if the BUNCHING_FACTOR is reached or
 	// if splitting stops being effective.
 	if((size <= BUNCHING_FACTOR) || (best_loc < 0))
-	{
-		cd = create_bbox_node(size);
+		return (-1);
 
-		for(i = 0; i < size; i++)
-			cd->Node[i] = Finite[first+i];
+	return (best_loc + 1);
+}
 
-		calc_bbox(&(cd->BBox), Finite, first, last);
-		*Root = (BBOX_TREE *)cd;
-		if(*numOfFiniteObjects >= maxfinitecount)
-		{
-			// Prim array overrun, increase array by 50%.
-			maxfinitecount = 1.5 * maxfinitecount;
+BBOX_TREE *create_composite_node(BBOX_TREE **Finite, ptrdiff_t first, ptrdiff_t last)
+{
+	BBOX_TREE *cd = create_bbox_node(last - first);
 
-			// For debugging only.
-			// TODO MESSAGE      Debug_Info("Reallocing Finite to %d\n", maxfinitecount);
-			Finite = (BBOX_TREE **)POV_REALLOC(Finite, maxfinitecount * sizeof(BBOX_TREE *), "bounding boxes");
-		}
+	for(ptrdiff_t i = 0; i < last - first; i++)
+		cd->Node[i] = Finite[first+i];
+
+	calc_bbox(&(cd->BBox), Finite, first, last);
+
+	return cd;
+}
+
+void sort_and_split(BBOX_TREE **Finite, ptrdiff_t first, ptrdiff_t last, vector<BBOX_TREE *>& nodes)
+{
+	if(last - first <= 0)
+		return;
+
+	ptrdiff_t split = find_split(Finite, first, last);
+
+	if(split < 0)
+	{
+		nodes.push_back(create_composite_node(Finite, first, last));
+		return;
+	}
+
+	sort_and_split(Finite, first, split, nodes);
+	sort_and_split(Finite, split, last, nodes);
+}
+
+// Do the first few levels of sort_and_split, collecting all ranges that
+// remain to be split as jobs. Ranges that turn out not to be worth
+// splitting become jobs that are already done.
+void split_into_jobs(BBOX_TREE **Finite, ptrdiff_t first, ptrdiff_t last, unsigned int levels, vector<BBoxBuildJob>& jobs)
+{
+	if((levels == 0) || (last - first < MIN_BBOX_BUILD_JOB_SIZE))
+	{
+		jobs.push_back(BBoxBuildJob(first, last));
+		return;
+	}
 
-		Finite[*numOfFiniteObjects] = cd;
-		(*numOfFiniteObjects)++;
+	ptrdiff_t split = find_split(Finite, first, last);
 
-		return (1);
+	if(split < 0)
+	{
+		jobs.push_back(BBoxBuildJob(first, first));
+		jobs.back().nodes.push_back(create_composite_node(Finite, first, last));
+		return;
 	}
 
-	sort_and_split(Root, Finite, numOfFiniteObjects, first, best_loc + 1, maxfinitecount);
-	sort_and_split(Root, Finite, numOfFiniteObjects, best_loc + 1, last, maxfinitecount);
+	split_into_jobs(Finite, first, split, levels - 1, jobs);
+	split_into_jobs(Finite, split, last, levels - 1, jobs);
+}
 
-	return (0);
+void Build_BBox_Job(BBOX_TREE **Finite, BBoxBuildJob& job)
+{
+	sort_and_split(Finite, job.first, job.last, job.nodes);
 }
 
 }
@@ -108,6 +108,10 @@ namespace pov
 
 #define BBOX_EXTRA_STATS 1
 
+/* Number of rays traced together by Intersect_BBox_Tree_Packet(). */
+
+const unsigned int RAY_PACKET_SIZE = 4;
+
 
 /*****************************************************************************
 * Global typedefs
@@ -151,10 +155,83 @@ class Rayinfo
 		}
 };
 
+// Slab data of a packet of rays, stored per axis so that a bounding box can
+// be tested against all rays of the packet in one go.
+class RayPacketInfo
+{
+	public:
+		BBOX_VAL slab_num[3][RAY_PACKET_SIZE];
+		BBOX_VAL slab_den[3][RAY_PACKET_SIZE];
+		bool nonzero[3][RAY_PACKET_SIZE];
+		unsigned int size;
+
+		RayPacketInfo(const Ray * const *rays, unsigned int count)
+		{
+			size = count;
+
+			for(unsigned int i = 0; i < RAY_PACKET_SIZE; i++)
+			{
+				for(int a = X; a <= Z; a++)
+				{
+					slab_num[a][i] = 0.0;
+					slab_den[a][i] = 0.0;
+					nonzero[a][i] = false;
+				}
+
+				if(i < count)
+				{
+					Rayinfo rayinfo(*rays[i]);
+
+					for(int a = X; a <= Z; a++)
+					{
+						slab_num[a][i] = rayinfo.slab_num[a];
+						nonzero[a][i] = (rayinfo.nonzero[a] != 0);
+						if(nonzero[a][i])
+							slab_den[a][i] = rayinfo.slab_den[a];
+					}
+				}
+			}
+		}
+};
+
+// Bounding box tree node pending in a packet traversal.
+struct BBoxPacketEntry
+{
+	const BBOX_TREE *node;
+	// Distance at which each ray enters the node, HUGE_VAL if it doesn't.
+	DBL depth[RAY_PACKET_SIZE];
+	// Smallest of the above.
+	DBL mindepth;
+};
+
+typedef vector<BBoxPacketEntry> BBoxPacketStack;
+
 /*****************************************************************************
 * Global functions
 ******************************************************************************/
 
+struct BBoxBuildJob
+{
+	ptrdiff_t first;
+	ptrdiff_t last;
+	vector<BBOX_TREE *> nodes;
+
+	BBoxBuildJob(ptrdiff_t f, ptrdiff_t l) : first(f), last(l) { }
+};
+
+// Interface to process independent bounding box tree build jobs,
+// typically in parallel.
+class BBoxBuildJobRunner
+{
+	public:
+		virtual ~BBoxBuildJobRunner() { }
+
+		// Number of tree levels split off into separate jobs.
+		virtual unsigned int GetJobLevels() const = 0;
+		// Run Build_BBox_Job for each of the jobs and return when all are done.
+		virtual void operator()(BBOX_TREE **Finite, vector<BBoxBuildJob>& jobs) = 0;
+};
+
 struct PriorityQueue
 {
 	struct Qelem
@@ -171,13 +248,15 @@ struct PriorityQueue
 	~PriorityQueue();
 };
 
-void Build_BBox_Tree(BBOX_TREE **Root, size_t numOfFiniteObjects, BBOX_TREE **&Finite, size_t numOfInfiniteObjects, BBOX_TREE **Infinite, size_t& maxfinitecount);
-void Build_Bounding_Slabs(BBOX_TREE **Root, vector<ObjectPtr>& objects, unsigned int& numberOfFiniteObjects, unsigned int& numberOfInfiniteObjects, unsigned int& numberOfLightSources);
+void Build_BBox_Tree(BBOX_TREE **Root, size_t numOfFiniteObjects, BBOX_TREE **&Finite, size_t numOfInfiniteObjects, BBOX_TREE **Infinite, size_t& maxfinitecount, BBoxBuildJobRunner *runner = NULL);
+void Build_Bounding_Slabs(BBOX_TREE **Root, vector<ObjectPtr>& objects, unsigned int& numberOfFiniteObjects, unsigned int& numberOfInfiniteObjects, unsigned int& numberOfLightSources, BBoxBuildJobRunner *runner = NULL);
+void Build_BBox_Job(BBOX_TREE **Finite, BBoxBuildJob& job);
 
 void Recompute_BBox(BBOX *bbox, const TRANSFORM *trans);
 void Recompute_Inverse_BBox(BBOX *bbox, const TRANSFORM *trans);
 bool Intersect_BBox_Tree(PriorityQueue& pqueue, const BBOX_TREE *Root, const Ray& ray, Intersection *Best_Intersection, TraceThreadData *Thread);
 bool Intersect_BBox_Tree(PriorityQueue& pqueue, const BBOX_TREE *Root, const Ray& ray, Intersection *Best_Intersection, const RayObjectCondition& precondition, const RayObjectCondition& postcondition, TraceThreadData *Thread);
+void Intersect_BBox_Tree_Packet(BBoxPacketStack& stack, const BBOX_TREE *Root, const Ray * const *rays, Intersection * const *Best_Intersections, unsigned int count, const RayObjectCondition& precondition, const RayObjectCondition& postcondition, TraceThreadData *Thread);
 void Check_And_Enqueue(PriorityQueue& Queue, const BBOX_TREE *Node, const BBOX *BBox, Rayinfo *rayinfo, TraceThreadData *Thread);
 void Priority_Queue_Delete(PriorityQueue& Queue, DBL *key, const BBOX_TREE **Node);
 void Destroy_BBox_Tree(BBOX_TREE *Node);
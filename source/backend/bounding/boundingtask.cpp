@@ -99,6 +99,7 @@
 #include "backend/math/matrices.h"
 #include "backend/scene/objects.h"
 #include "backend/support/bsptree.h"
+#include "backend/support/bvhtree.h"
 #include "backend/bounding/boundingtask.h"
 #include "backend/shape/cones.h"
 #include "backend/texture/texture.h"
@@ -187,10 +188,120 @@ class BSPProgress : public BSPTree::Progress
 		BSPProgress();
 };
 
-BoundingTask::BoundingTask(shared_ptr<SceneData> sd, unsigned int bt) :
+BoundingJobQueue::BoundingJobQueue(unsigned int threads) :
+	finite(NULL),
+	jobs(NULL),
+	nextJob(0),
+	pendingJobs(0),
+	jobLevels(2),
+	failed(false),
+	finished(false)
+{
+	// aim for about four times as many jobs as there are threads
+	while((1u << jobLevels) < threads * 4)
+		jobLevels++;
+}
+
+BoundingJobQueue::~BoundingJobQueue()
+{
+}
+
+unsigned int BoundingJobQueue::GetJobLevels() const
+{
+	return jobLevels;
+}
+
+void BoundingJobQueue::operator()(BBOX_TREE **Finite, vector<BBoxBuildJob>& j)
+{
+	boost::mutex::scoped_lock lock(queueMutex);
+
+	finite = Finite;
+	jobs = &j;
+	nextJob = 0;
+	pendingJobs = j.size();
+
+	jobsCondition.notify_all();
+
+	while(ProcessJob(lock)) { }
+
+	// jobs taken by helper tasks have to be completed before returning
+	// as they reference the job list and the finite object list
+	while(pendingJobs > 0)
+		doneCondition.wait(lock);
+
+	finite = NULL;
+	jobs = NULL;
+
+	if(failed == true)
+		throw POV_EXCEPTION(kUncategorizedError, "Building bounding box tree failed.");
+}
+
+void BoundingJobQueue::Work()
+{
+	boost::mutex::scoped_lock lock(queueMutex);
+
+	while(finished == false)
+	{
+		if(ProcessJob(lock) == false)
+		{
+			boost::xtime t;
+			boost::xtime_get(&t, boost::TIME_UTC);
+			t.sec += 1;
+
+			jobsCondition.timed_wait(lock, t);
+
+			Task::CurrentTaskCooperate();
+		}
+	}
+}
+
+void BoundingJobQueue::Finish()
+{
+	boost::mutex::scoped_lock lock(queueMutex);
+
+	finished = true;
+
+	jobsCondition.notify_all();
+}
+
+bool BoundingJobQueue::ProcessJob(boost::mutex::scoped_lock& lock)
+{
+	if((jobs == NULL) || (nextJob >= jobs->size()))
+		return false;
+
+	BBoxBuildJob& job = (*jobs)[nextJob++];
+	BBOX_TREE **Finite = finite;
+
+	lock.unlock();
+
+	try
+	{
+		// jobs created already done have an empty range
+		if(job.first < job.last)
+			Build_BBox_Job(Finite, job);
+	}
+	catch(...)
+	{
+		lock.lock();
+		failed = true;
+		if(--pendingJobs == 0)
+			doneCondition.notify_all();
+		throw;
+	}
+
+	lock.lock();
+
+	if(--pendingJobs == 0)
+		doneCondition.notify_all();
+
+	return true;
+}
+
+BoundingTask::BoundingTask(shared_ptr<SceneData> sd, unsigned int bt, shared_ptr<BoundingJobQueue> jq) :
 	Task(new SceneThreadData(sd), boost::bind(&BoundingTask::SendFatalError, this, _1)),
 	sceneData(sd),
-	boundingThreshold(bt)
+	boundingThreshold(bt),
+	jobQueue(jq)
 {
 }
 
@@ -216,6 +327,22 @@ void BoundingTask::Run()
 
 	switch(sceneData->boundingMethod)
 	{
+		case 3:
+		{
+			// SAH bounding volume hierarchy code
+			SceneObjects objects(sceneData->objects);
+			BSPProgress progress(sceneData->sceneId, sceneData->frontendAddress);
+
+			sceneData->objects.clear();
+			sceneData->objects.insert(sceneData->objects.end(), objects.finite.begin(), objects.finite.end());
+			sceneData->objects.insert(sceneData->objects.end(), objects.infinite.begin(), objects.infinite.end());
+			sceneData->numberOfFiniteObjects = objects.finite.size();
+			sceneData->numberOfInfiniteObjects = objects.infinite.size() - objects.numLights;
+			sceneData->bvh = new BVHTree();
+			sceneData->bvh->build(progress, objects, sceneData->bvhNodes, sceneData->bvhLeafNodes,
+			                      sceneData->maxObjects, sceneData->averageObjects, sceneData->maxDepth, sceneData->averageDepth);
+			break;
+		}
 		case 2:
 		{
 			// new BSP tree code
@@ -240,7 +367,7 @@ void BoundingTask::Run()
 			unsigned int numberOfLightSources;
 
 			Build_Bounding_Slabs(&(sceneData->boundingSlabs), sceneData->objects, sceneData->numberOfFiniteObjects,
-			                     sceneData->numberOfInfiniteObjects, numberOfLightSources);
+			                     sceneData->numberOfInfiniteObjects, numberOfLightSources, jobQueue.get());
 			break;
 		}
 	}
@@ -252,6 +379,10 @@ void BoundingTask::Stopped()
 
 void BoundingTask::Finish()
 {
+	// release helper tasks even if building the tree failed
+	if(jobQueue != NULL)
+		jobQueue->Finish();
+
 	GetSceneDataPtr()->timeType = SceneThreadData::kBoundingTime;
 	GetSceneDataPtr()->realTime = ConsumedRealTime();
 	GetSceneDataPtr()->cpuTime = ConsumedCPUTime();
@@ -274,4 +405,48 @@ void BoundingTask::SendFatalError(Exception& e)
 	POVMS_SendMessage(msg);
 }
 
+BoundingHelperTask::BoundingHelperTask(shared_ptr<SceneData> sd, shared_ptr<BoundingJobQueue> jq) :
+	Task(new SceneThreadData(sd), boost::bind(&BoundingHelperTask::SendFatalError, this, _1)),
+	sceneData(sd),
+	jobQueue(jq)
+{
+}
+
+BoundingHelperTask::~BoundingHelperTask()
+{
+}
+
+void BoundingHelperTask::Run()
+{
+	jobQueue->Work();
+}
+
+void BoundingHelperTask::Stopped()
+{
+}
+
+void BoundingHelperTask::Finish()
+{
+	GetSceneDataPtr()->timeType = SceneThreadData::kBoundingTime;
+	GetSceneDataPtr()->realTime = ConsumedRealTime();
+	GetSceneDataPtr()->cpuTime = ConsumedCPUTime();
+}
+
+void BoundingHelperTask::SendFatalError(Exception& e)
+{
+	// if the front-end has been told about this exception already, we don't tell it again
+	if (e.frontendnotified(true))
+		return;
+
+	POVMS_Message msg(kPOVObjectClass_ControlData, kPOVMsgClass_SceneOutput, kPOVMsgIdent_Error);
+
+	msg.SetString(kPOVAttrib_EnglishText, e.what());
+	msg.SetInt(kPOVAttrib_Error, 0);
+	msg.SetInt(kPOVAttrib_SceneId, sceneData->sceneId);
+	msg.SetSourceAddress(sceneData->backendAddress);
+	msg.SetDestinationAddress(sceneData->frontendAddress);
+
+	POVMS_SendMessage(msg);
+}
+
 }
@@ -104,15 +104,60 @@
 #include "backend/render/rendertask.h"
 #include "backend/render/trace.h"
 #include "backend/support/bsptree.h"
+#include "backend/support/bvhtree.h"
 #include "backend/support/taskqueue.h"
+#include "backend/bounding/bbox.h"
 
 namespace pov
 {
 
+/**
+ *	Hands out bounding box tree build jobs to the bounding task and its
+ *	helper tasks, so the independent parts of each tree level are built
+ *	in parallel.
+ */
+class BoundingJobQueue : public BBoxBuildJobRunner
+{
+	public:
+		BoundingJobQueue(unsigned int threads);
+		virtual ~BoundingJobQueue();
+
+		virtual unsigned int GetJobLevels() const;
+		virtual void operator()(BBOX_TREE **Finite, vector<BBoxBuildJob>& jobs);
+
+		/// process jobs until Finish() is called, used by helper tasks
+		void Work();
+		/// tell helper tasks there will be no more jobs
+		void Finish();
+	private:
+		/// queue mutex
+		boost::mutex queueMutex;
+		/// signalled when new jobs are available
+		boost::condition jobsCondition;
+		/// signalled when all jobs are done
+		boost::condition doneCondition;
+		/// finite object list the current jobs refer to
+		BBOX_TREE **finite;
+		/// current jobs or NULL
+		vector<BBoxBuildJob> *jobs;
+		/// next job to hand out
+		size_t nextJob;
+		/// number of current jobs not yet done
+		size_t pendingJobs;
+		/// number of tree levels to split off into separate jobs
+		unsigned int jobLevels;
+		/// set if a job failed
+		bool failed;
+		/// set when no more jobs will be queued
+		bool finished;
+
+		bool ProcessJob(boost::mutex::scoped_lock& lock);
+};
+
 class BoundingTask : public Task
 {
 	public:
-		BoundingTask(shared_ptr<SceneData> sd, unsigned int bt);
+		BoundingTask(shared_ptr<SceneData> sd, unsigned int bt, shared_ptr<BoundingJobQueue> jq = shared_ptr<BoundingJobQueue>());
 		virtual ~BoundingTask();
 
 		virtual void Run();
@@ -125,6 +170,25 @@ class BoundingTask : public Task
 	private:
 		shared_ptr<SceneData> sceneData;
 		unsigned int boundingThreshold;
+		shared_ptr<BoundingJobQueue> jobQueue;
+
+		void SendFatalError(pov_base::Exception& e);
+};
+
+class BoundingHelperTask : public Task
+{
+	public:
+		BoundingHelperTask(shared_ptr<SceneData> sd, shared_ptr<BoundingJobQueue> jq);
+		virtual ~BoundingHelperTask();
+
+		virtual void Run();
+		virtual void Stopped();
+		virtual void Finish();
+
+		inline SceneThreadData *GetSceneDataPtr() { return (SceneThreadData *)(GetDataPtr()); }
+	private:
+		shared_ptr<SceneData> sceneData;
+		shared_ptr<BoundingJobQueue> jobQueue;
 
 		void SendFatalError(pov_base::Exception& e);
 };
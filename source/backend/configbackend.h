@@ -146,6 +146,19 @@
 	#define POV_MEMCPY(dst,src,len)     memcpy((dst),(src),(len))
 #endif
 
+/*
+ * Atomic compare-and-swap of a pointer: if *ptr equals oldval, replace it with
+ * newval and return true, otherwise return false. It must also act as a full
+ * memory barrier, so that the data a pointer refers to is visible to other
+ * threads once they see the pointer. If a platform does not provide it, code
+ * using it falls back to mutexes.
+ */
+#ifndef POV_ATOMIC_CAS_PTR
+	#if defined(__GNUC__) && ((__GNUC__ > 4) || ((__GNUC__ == 4) && (__GNUC_MINOR__ >= 1)))
+		#define POV_ATOMIC_CAS_PTR(ptr,oldval,newval) __sync_bool_compare_and_swap((ptr),(oldval),(newval))
+	#endif
+#endif
+
 #ifndef POV_MEM_STATS
 	#define POV_MEM_STATS                       0
 	#define POV_GLOBAL_MEM_STATS(a,f,c,p,s,l)   (false)
@@ -252,6 +265,12 @@
 	#define POVFPU_Run(ctx, fn) POVFPU_RunDefault(ctx, fn)
 #endif
 
+// Function that executes a function at several points, the parameters are
+// the function index, an array of points, an array of results and the count
+#ifndef POVFPU_RunBatch
+	#define POVFPU_RunBatch(ctx, fn, points, results, count) POVFPU_RunBatchDefault(ctx, fn, points, results, count)
+#endif
+
 // Adjust to add system specific handling of functions like just-in-time compilation
 #if (SYS_FUNCTIONS == 0)
 
@@ -276,6 +295,66 @@
 
 #endif // SYS_FUNCTIONS
 
+// Enables the native code generator for user-defined functions (see vm/fnjit.cpp).
+// It emits x86-64 code for the System V calling convention and needs mmap/mprotect.
+#ifndef SYS_FUNCTION_JIT
+	#if defined(__x86_64__) && (defined(__unix__) || defined(__APPLE__))
+		#define SYS_FUNCTION_JIT 1
+	#else
+		#define SYS_FUNCTION_JIT 0
+	#endif
+#endif
+
+// Enables rendering the final trace in several worker processes (see render/renderprocess.cpp).
+// Needs fork, socketpair, poll and waitpid.
+#ifndef SYS_RENDER_PROCESSES
+	#if defined(__unix__) || defined(__APPLE__)
+		#define SYS_RENDER_PROCESSES 1
+	#else
+		#define SYS_RENDER_PROCESSES 0
+	#endif
+#endif
+
+// Enables code paths using SSE2 intrinsics, such as the mesh triangle packet test (see shape/mesh.cpp).
+#ifndef SYS_SIMD_SSE2
+	#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+		#define SYS_SIMD_SSE2 1
+	#else
+		#define SYS_SIMD_SSE2 0
+	#endif
+#endif
+
+// Enables the AVX2/FMA3 and AVX-512 noise kernels, chosen at startup by CPUID (see texture/texture.cpp).
+// Needs per-function target attributes and __builtin_cpu_supports as provided by GCC 6 and later;
+// has no effect if USE_FASTER_NOISE is set.
+#ifndef SYS_SIMD_NOISE_DISPATCH
+	#if defined(__x86_64__) && defined(__GNUC__) && (__GNUC__ >= 6) && !defined(__clang__)
+		#define SYS_SIMD_NOISE_DISPATCH 1
+	#else
+		#define SYS_SIMD_NOISE_DISPATCH 0
+	#endif
+#endif
+
+// Enables mapping binary mesh cache files into memory (see shape/meshcache.cpp).
+// Needs open, fstat and mmap; otherwise cache files are read into allocated memory.
+#ifndef SYS_MESH_CACHE_MMAP
+	#if defined(__unix__) || defined(__APPLE__)
+		#define SYS_MESH_CACHE_MMAP 1
+	#else
+		#define SYS_MESH_CACHE_MMAP 0
+	#endif
+#endif
+
+// Enables caching the tokens of include files on disk (see parser/includecache.cpp).
+// Needs stat to tell the size and modification time of an include file.
+#ifndef SYS_INCLUDE_CACHE
+	#if defined(__unix__) || defined(__APPLE__) || defined(_WIN32)
+		#define SYS_INCLUDE_CACHE 1
+	#else
+		#define SYS_INCLUDE_CACHE 0
+	#endif
+#endif
+
 #ifndef POV_SYS_THREAD_STARTUP
 	#define POV_SYS_THREAD_STARTUP
 #endif
@@ -96,12 +96,27 @@
 namespace pov
 {
 
+/*****************************************************************************
+* Global typedefs
+******************************************************************************/
+
+// Result of the noise micro-benchmark for one variant of Noise and DNoise.
+struct Noise_Benchmark_Result
+{
+	const char *Name ;
+	bool Selected ;          // variant picked at startup
+	double Noise_Rate ;      // million Noise calls per second
+	double DNoise_Rate ;     // million DNoise calls per second
+	double Max_Deviation ;   // largest difference from the scalar variant
+} ;
+
 /*****************************************************************************
 * Global functions
 ******************************************************************************/
 
 bool Write_Benchmark_File (const char *Scene_File_Name, const char *INI_File_Name) ;
 unsigned int Get_Benchmark_Version (void) ;
+unsigned int Run_Noise_Benchmark (Noise_Benchmark_Result *Results, unsigned int Max_Results) ;
 
 }
 
@@ -162,6 +162,8 @@ const int PHOTON_BLOCK_POWER = 14;
 // PHOTON_BLOCK_SIZE must be equal to 2 raised to the power PHOTON_BLOCK_POWER
 const int PHOTON_BLOCK_SIZE = (16384);
 const int PHOTON_BLOCK_MASK = (PHOTON_BLOCK_SIZE-1);
+// photon maps smaller than this are not worth building the kd-tree in parallel
+const int MIN_PARALLEL_SORT_PHOTONS = 65536;
 const int INITIAL_BASE_ARRAY_SIZE = 100;
 
 
@@ -1332,6 +1334,11 @@ PhotonMap::PhotonMap()
 	// zero the array
 	for(k=0; k<numBlocks; k++)
 		head[k] = NULL;
+
+	// the kd-tree is allocated by buildTree()
+	treePhotons = NULL;
+	treeLoc[X] = treeLoc[Y] = treeLoc[Z] = NULL;
+	treeAxis = NULL;
 }
 
 SinCosOptimizations::SinCosOptimizations()
@@ -1539,6 +1546,24 @@ void PhotonMap::mergeMap(PhotonMap* map)
 ******************************************************************************/
 
 PhotonMap::~PhotonMap()
+{
+	freeBlocks();
+
+	if (treePhotons != NULL)
+	{
+		POV_FREE(treePhotons);
+		POV_FREE(treeLoc[X]);
+		POV_FREE(treeLoc[Y]);
+		POV_FREE(treeLoc[Z]);
+		POV_FREE(treeAxis);
+		treePhotons = NULL;
+	}
+}
+
+/*
+Free the photon blocks and the base array.
+*/
+void PhotonMap::freeBlocks()
 {
 	int j;
 
@@ -1891,7 +1916,13 @@ void PhotonMap::quickSortRec(int left, int right, int d)
 void PhotonMap::halfSortRec(int left, int right, int d, int mid)
 {
 	int j,k;
-	if(left<right)
+	if(right-left == 1)
+	{
+		// the median-of-three pivot selection below needs at least three photons
+		if(PHOTON_AMF(this->head,left).Loc[d] > PHOTON_AMF(this->head,right).Loc[d])
+			swapPhotons(left,right);
+	}
+	else if(left<right)
 	{
 		swapPhotons(((left+right)>>1), left+1);
 		if(PHOTON_AMF(this->head,left+1).Loc[d] > PHOTON_AMF(this->head,right).Loc[d])
@@ -1928,6 +1959,38 @@ void PhotonMap::halfSortRec(int left, int right, int d, int mid)
 	}
 }
 
+/*****************************************************************************
+
+  FUNCTION
+
+  leftBalancedMedian
+
+  Finds the index at which the median of a range has to be placed so that
+  the kd-tree built from the range is left-balanced, i.e. every level but
+  the last is full and the last level is filled from the left.  This lets
+  the tree be stored in heap order without any holes.
+
+  Preconditions:
+    'start' is the index of the first photon
+    'end' is the index of the last photon
+    end > start
+
+  Postconditions:
+    returns the index of the median
+******************************************************************************/
+static int leftBalancedMedian(int start, int end)
+{
+	int n = end - start + 1;
+	int m = 1;             // number of nodes of the largest full tree that fits, plus one
+
+	while(m <= n / 2)
+		m *= 2;
+
+	// nodes in the full levels of the left subtree plus the
+	// nodes of the last level that end up on the left side
+	return start + (m / 2 - 1) + min(n - (m - 1), m / 2);
+}
+
 /*****************************************************************************
 
   FUNCTION
@@ -1936,82 +1999,93 @@ void PhotonMap::halfSortRec(int left, int right, int d, int mid)
 
   Finds the dimension with the greates range, sorts the photons on that
   dimension.  Then it recurses on the left and right halves (keeping
-  the median photon as a pivot).  This produces a balanced kd-tree.
+  the median photon as a pivot).  This produces a left-balanced kd-tree.
+  The median photon of each range is copied to the tree arrays as soon as
+  it is known, as it is not moved by the recursion.
 
   Preconditions:
     photon memory initialized
+    tree arrays allocated
     'start' is the index of the first photon
     'end' is the index of the last photon
-    'sorted' is the dimension that was last sorted (so we don't sort again)
+    'node' is the tree node of the range
+    'splitLevels' is the number of levels to recurse before the
+         remaining ranges are added to 'jobs' instead, or -1
 
   Postconditions:
-    photons from 'start' to 'end' in the map are in a valid kd-tree format
+    photons from 'start' to 'end' in the map are sorted into the tree
+    (or added to 'jobs' to be done by the caller)
 ******************************************************************************/
-void PhotonMap::sortAndSubdivide(int start, int end, int /*sorted*/)
+void PhotonMap::sortAndSubdivide(int start, int end, int node, int splitLevels, vector<PhotonSortJob> *jobs)
 {
 	int i,j;             // counters
 	SNGL_VECT min,max;   // min/max vectors for finding range
 	int DimToUse;        // which dimesion has the greatest range
 	int mid;             // index of median (middle)
-	int len;             // length of the array we're sorting
 
-	if (end==start)
+	if(end<start) return;
+
+	if (splitLevels == 0)
 	{
-		PHOTON_AMF(this->head, start).info = 0;
+		// leave the rest of this range to the job runner
+		jobs->push_back(PhotonSortJob(start, end, node));
 		return;
 	}
 
-	if(end<start) return;
-
-	// loop and find greatest range
+	if (end==start)
+	{
+		DimToUse = X;
+		mid = start;
+	}
+	else
+	{
+		// loop and find greatest range
 
-	Make_Vector(min, 1/EPSILON, 1/EPSILON, 1/EPSILON);
-	Make_Vector(max, -1/EPSILON, -1/EPSILON, -1/EPSILON);
+		Make_Vector(min, 1/EPSILON, 1/EPSILON, 1/EPSILON);
+		Make_Vector(max, -1/EPSILON, -1/EPSILON, -1/EPSILON);
 
-	for(i=start; i<=end; i++)
-	{
-		for(j=X; j<=Z; j++)
+		for(i=start; i<=end; i++)
 		{
-			Photon *ph = &(PHOTON_AMF(this->head,i));
+			for(j=X; j<=Z; j++)
+			{
+				Photon *ph = &(PHOTON_AMF(this->head,i));
 
-			if (ph->Loc[j] < min[j])
-				min[j]=ph->Loc[j];
-			if (ph->Loc[j] > max[j])
-				max[j]=ph->Loc[j];
+				if (ph->Loc[j] < min[j])
+					min[j]=ph->Loc[j];
+				if (ph->Loc[j] > max[j])
+					max[j]=ph->Loc[j];
+			}
 		}
-	}
-
-	// choose which dimension to use
-	DimToUse = X;
-	if((max[Y]-min[Y])>(max[DimToUse]-min[DimToUse]))
-		DimToUse=Y;
-	if((max[Z]-min[Z])>(max[DimToUse]-min[DimToUse]))
-		DimToUse=Z;
 
-	// find midpoint
-	mid = (end+start)>>1;
+		// choose which dimension to use
+		DimToUse = X;
+		if((max[Y]-min[Y])>(max[DimToUse]-min[DimToUse]))
+			DimToUse=Y;
+		if((max[Z]-min[Z])>(max[DimToUse]-min[DimToUse]))
+			DimToUse=Z;
 
-	// use half of a quicksort to find the median
-	len = end-start;
-	if (len>=2)
-	{
-		// only display status every so often
-		if(len > 1000)
-		{
-			//gPhotonStat_end = end;
-//			Send_ProgressUpdate(PROGRESS_SORTING_PHOTONS);
-		}
+		// find median position
+		mid = leftBalancedMedian(start, end);
 
+		// use half of a quicksort to find the median
 		halfSortRec(start, end, DimToUse, mid);
-		//don't do this - but why? quickSortRec(start, end, DimToUse);
 	}
 
-	// set DimToUse for the midpoint
-	PHOTON_AMF(this->head, mid).info = DimToUse;
+	// set DimToUse for the midpoint and move it to the tree
+	Photon *ph = &(PHOTON_AMF(this->head, mid));
+	ph->info = DimToUse;
+	treePhotons[node] = *ph;
+	treeLoc[X][node] = ph->Loc[X];
+	treeLoc[Y][node] = ph->Loc[Y];
+	treeLoc[Z][node] = ph->Loc[Z];
+	treeAxis[node] = DimToUse;
+
+	if (splitLevels > 0)
+		splitLevels--;
 
 	// now recurse to continue building the kd-tree
-	sortAndSubdivide(start, mid - 1, DimToUse);
-	sortAndSubdivide(mid + 1, end, DimToUse);
+	sortAndSubdivide(start, mid - 1, 2 * node + 1, splitLevels, jobs);
+	sortAndSubdivide(mid + 1, end, 2 * node + 2, splitLevels, jobs);
 }
 
 /*****************************************************************************
@@ -2020,7 +2094,12 @@ void PhotonMap::sortAndSubdivide(int start, int end, int /*sorted*/)
 
   buildTree
 
-  Builds the kd-tree by calling sortAndSubdivide().
+  Builds the kd-tree by calling sortAndSubdivide(), then frees the
+  photon blocks.
+
+  If a job runner is given, the top levels of the tree are built here and
+  the ranges below them are handed to the runner, which may build them in
+  parallel as they do not overlap.
 
   Preconditions:
     photon memory initialized
@@ -2030,10 +2109,26 @@ void PhotonMap::sortAndSubdivide(int start, int end, int /*sorted*/)
   Postconditions:
     photons are in a valid kd-tree format
 ******************************************************************************/
-void PhotonMap::buildTree()
+void PhotonMap::buildTree(PhotonSortJobRunner *runner)
 {
 // 	Send_Progress("Sorting photons", PROGRESS_SORTING_PHOTONS);
-	sortAndSubdivide(0,this->numPhotons-1,X+Y+Z/*this is not X, Y, or Z*/);
+	treePhotons = (Photon *)POV_MALLOC(sizeof(Photon)*this->numPhotons, "photons");
+	treeLoc[X] = (float *)POV_MALLOC(sizeof(float)*this->numPhotons, "photons");
+	treeLoc[Y] = (float *)POV_MALLOC(sizeof(float)*this->numPhotons, "photons");
+	treeLoc[Z] = (float *)POV_MALLOC(sizeof(float)*this->numPhotons, "photons");
+	treeAxis = (unsigned char *)POV_MALLOC(sizeof(unsigned char)*this->numPhotons, "photons");
+
+	if ((runner != NULL) && (this->numPhotons >= MIN_PARALLEL_SORT_PHOTONS))
+	{
+		vector<PhotonSortJob> jobs;
+
+		sortAndSubdivide(0, this->numPhotons-1, 0, runner->GetJobLevels(), &jobs);
+		(*runner)(this, jobs);
+	}
+	else
+		sortAndSubdivide(0, this->numPhotons-1, 0);
+
+	freeBlocks();
 }
 
 /*****************************************************************************
@@ -2084,7 +2179,7 @@ void PhotonMap::setGatherOptions(ScenePhotonSettings &photonSettings, int mediaM
 		{
 			j = rand() % this->numPhotons;
 
-			Assign_Vector(Point,(PHOTON_AMF(this->head, j)).Loc);
+			Assign_Vector(Point,this->treePhotons[j].Loc);
 
 			// TODO FIXME (this allocates then frees memory each time around the loop)
 			PhotonGatherer gatherer(this, photonSettings);
@@ -2164,7 +2259,7 @@ void PhotonMap::setGatherOptions(ScenePhotonSettings &photonSettings, int mediaM
 		{
 			j = rand() % this->numPhotons;
 
-			Assign_Vector(Point,(PHOTON_AMF(this->head, j)).Loc);
+			Assign_Vector(Point,this->treePhotons[j].Loc);
 
 			PhotonGatherer gatherer(this, photonSettings);
 			n=gatherer.gatherPhotons(Point, this->minGatherRad, &r, NULL, false);
@@ -2414,45 +2509,43 @@ void PhotonGatherer::FullPQInsert(Photon *photon, DBL d)
   gatherPhotonsRec()
 
   Recursive part of gatherPhotons
-  Searches the kd-tree with range start..end (midpoint is pivot)
+  Searches the kd-tree below 'node'
   
   Preconditions:
     same preconditions as priority queue functions
     static variable map_s points to the map to use
-    'start' is the first photon in this range
-    'end' is the last photon in this range
-
-    the range 'start..end' must have been used in building photon map!!!
+    'node' is a node of the kd-tree
 
   Postconditions:
-    photons within the range of start..end are added to the priority
+    photons within the subtree of 'node' are added to the priority
     queue (photons may be delted from the queue to make room for photons
     of lower priority)
  
 ******************************************************************************/
 
-void PhotonGatherer::gatherPhotonsRec(int start, int end)
+void PhotonGatherer::gatherPhotonsRec(int node)
 {
 	DBL delta;
 	int DimToUse;
 	DBL d,dx,dy,dz;
-	int mid;
-	Photon *photon;
+	int left,right;
+	DBL split;
 	VECTOR ptToPhoton;
 	DBL discFix;   // use disc(ellipsoid) for gathering instead of sphere
 
-	// find midpoint
-	mid = (end+start)>>1;
-	photon = &(PHOTON_AMF(map->head, mid));
+	// children of this node
+	left = 2 * node + 1;
+	right = left + 1;
 
-	DimToUse = photon->info;// & PH_MASK_XYZ;
+	DimToUse = map->treeAxis[node];
+	split = map->treeLoc[DimToUse][node];
 
 	// check this photon
 
 	// find distance from pt
-	ptToPhoton[X] = - pt_s[X] + photon->Loc[X];
-	ptToPhoton[Y] = - pt_s[Y] + photon->Loc[Y];
-	ptToPhoton[Z] = - pt_s[Z] + photon->Loc[Z];
+	ptToPhoton[X] = - pt_s[X] + map->treeLoc[X][node];
+	ptToPhoton[Y] = - pt_s[Y] + map->treeLoc[Y][node];
+	ptToPhoton[Z] = - pt_s[Z] + map->treeLoc[Z][node];
 	// all distances are squared
 	dx = ptToPhoton[X]*ptToPhoton[X];
 	dy = ptToPhoton[Y]*ptToPhoton[Y];
@@ -2491,11 +2584,11 @@ void PhotonGatherer::gatherPhotonsRec(int start, int end)
 		{
 			if (gatheredPhotons.numFound+1>TargetNum_s)
 			{
-				FullPQInsert(photon, d);
+				FullPQInsert(&map->treePhotons[node], d);
 				sqrt_dmax_s = sqrt(dmax_s);
 			}
 			else
-				PQInsert(photon, d);
+				PQInsert(&map->treePhotons[node], d);
 		}
 	}
 
@@ -2516,33 +2609,33 @@ void PhotonGatherer::gatherPhotonsRec(int start, int end)
 			if (end>=mid+1) gatherPhotonsRec(start, mid - 1);
 	}
 	*/
-	delta=pt_s[DimToUse]-photon->Loc[DimToUse];
+	delta=pt_s[DimToUse]-split;
 	if(delta<0)
 	{
 		// on left - go left first
-		if (pt_s[DimToUse]-sqrt_dmax_s < photon->Loc[DimToUse])
+		if (pt_s[DimToUse]-sqrt_dmax_s < split)
 		{
-			if (mid-1>=start)
-				gatherPhotonsRec(start, mid - 1);
+			if (left<map->numPhotons)
+				gatherPhotonsRec(left);
 		}
-		if (pt_s[DimToUse]+sqrt_dmax_s > photon->Loc[DimToUse])
+		if (pt_s[DimToUse]+sqrt_dmax_s > split)
 		{
-			if(end>=mid+1)
-				gatherPhotonsRec(mid + 1, end);
+			if (right<map->numPhotons)
+				gatherPhotonsRec(right);
 		}
 	}
 	else
 	{
 		// on right - go right first
-		if (pt_s[DimToUse]+sqrt_dmax_s > photon->Loc[DimToUse])
+		if (pt_s[DimToUse]+sqrt_dmax_s > split)
 		{
-			if(end>=mid+1)
-				gatherPhotonsRec(mid + 1, end);
+			if (right<map->numPhotons)
+				gatherPhotonsRec(right);
 		}
-		if (pt_s[DimToUse]-sqrt_dmax_s < photon->Loc[DimToUse])
+		if (pt_s[DimToUse]-sqrt_dmax_s < split)
 		{
-			if (mid-1>=start)
-				gatherPhotonsRec(start, mid - 1);
+			if (left<map->numPhotons)
+				gatherPhotonsRec(left);
 		}
 	}
 }
@@ -2599,7 +2692,7 @@ int PhotonGatherer::gatherPhotons(const VECTOR pt, DBL Size, DBL *r, const VECTO
 	pt_s = pt;
 
 	// now search the kd-tree recursively
-	gatherPhotonsRec(0, map->numPhotons-1);
+	gatherPhotonsRec(0);
 
 	// set the radius variable
 	*r = sqrt_dmax_s;
@@ -2614,7 +2707,7 @@ int PhotonGatherer::gatherPhotons(const VECTOR pt, DBL Size, DBL *r, const VECTO
 	return(gatheredPhotons.numFound);
 }
 
-PhotonGatherer::PhotonGatherer(PhotonMap *map, ScenePhotonSettings& photonSettings): map(map),photonSettings(photonSettings),gatheredPhotons(photonSettings.maxGatherCount)
+PhotonGatherer::PhotonGatherer(PhotonMap *map, ScenePhotonSettings& photonSettings, MemoryArena *arena): map(map),photonSettings(photonSettings),gatheredPhotons(photonSettings.maxGatherCount, arena),arena(arena)
 {
 	gathered = false;
 }
@@ -2637,64 +2730,69 @@ DBL PhotonGatherer::gatherPhotonsAdaptive(const VECTOR pt, const VECTOR norm, bo
 
 	// start looping if necessary
 	int step=1;
-	while(num<photonSettings.minGatherCount && step<map->gatherNumSteps)
+	if(num<photonSettings.minGatherCount && step<map->gatherNumSteps)
 	{
-		step++;
-		DBL tempr = 0;
-		int tempn;
-
-		// save out the current set in case we want to revert
-		GatheredPhotons savedGatheredPhotons(photonSettings.maxGatherCount);
-		savedGatheredPhotons.swapWith(this->gatheredPhotons);
-
-		// increase the size
-		Size+=map->gatherRadStep;
-
-		// gather again, with the new size
-		tempn=gatherPhotons(pt, Size, &tempr, norm, flatten);
-
-		// compute the density of this search
-		thisDensity = tempn / (tempr*tempr);
+		// one spare set serves all steps, as only the most recent set is ever reverted to
+		GatheredPhotons savedGatheredPhotons(photonSettings.maxGatherCount, arena);
 
-		/*
-		this next line handles the adaptive search
-		if
-		the density change ((thisDensity-prevDensity)/prevDensity) is small enough
-		    or
-		this is the first time through (step==0)
-		    or
-		the number gathered is less than photonSettings.minExpandCount and greater than zero
-
-		then
-		use the color from this new gathering step and discard any previous
-		color
-
-		This adaptive search is explained my paper "Simulating Reflective and Refractive
-		Caustics in POV-Ray Using a Photon Map" - May, 1999
-		*/
-		if(((thisDensity-prevDensity)/prevDensity < photonSettings.expandTolerance)
-			|| (step==0)
-			|| (tempn<photonSettings.minExpandCount && tempn>0))
-		{
-			// it passes the tests, so use the new color
-			expanded = true;
-
-			// save variables in case we loop again
-			prevDensity = thisDensity;
-			if (prevDensity==0)
-				// TODO FIXME - Magic Value
-				prevDensity = 0.0000000000000001;  // avoid div-by-zero error
-
-			// keep
-			radius = tempr;
-			num = tempn;
-		}
-		else
+		while(num<photonSettings.minGatherCount && step<map->gatherNumSteps)
 		{
-			// put the old gathered photons back
+			step++;
+			DBL tempr = 0;
+			int tempn;
+
+			// save out the current set in case we want to revert
 			savedGatheredPhotons.swapWith(this->gatheredPhotons);
-			// we're done - break out of the loop
-			break;
+
+			// increase the size
+			Size+=map->gatherRadStep;
+
+			// gather again, with the new size
+			tempn=gatherPhotons(pt, Size, &tempr, norm, flatten);
+
+			// compute the density of this search
+			thisDensity = tempn / (tempr*tempr);
+
+			/*
+			this next line handles the adaptive search
+			if
+			the density change ((thisDensity-prevDensity)/prevDensity) is small enough
+			    or
+			this is the first time through (step==0)
+			    or
+			the number gathered is less than photonSettings.minExpandCount and greater than zero
+
+			then
+			use the color from this new gathering step and discard any previous
+			color
+
+			This adaptive search is explained my paper "Simulating Reflective and Refractive
+			Caustics in POV-Ray Using a Photon Map" - May, 1999
+			*/
+			if(((thisDensity-prevDensity)/prevDensity < photonSettings.expandTolerance)
+				|| (step==0)
+				|| (tempn<photonSettings.minExpandCount && tempn>0))
+			{
+				// it passes the tests, so use the new color
+				expanded = true;
+
+				// save variables in case we loop again
+				prevDensity = thisDensity;
+				if (prevDensity==0)
+					// TODO FIXME - Magic Value
+					prevDensity = 0.0000000000000001;  // avoid div-by-zero error
+
+				// keep
+				radius = tempr;
+				num = tempn;
+			}
+			else
+			{
+				// put the old gathered photons back
+				savedGatheredPhotons.swapWith(this->gatheredPhotons);
+				// we're done - break out of the loop
+				break;
+			}
 		}
 	}
 	// TODO FIXME STATS
@@ -2828,15 +2926,27 @@ void GatheredPhotons::swapWith(GatheredPhotons& toCopy)
 	toCopy.numFound = tmpNumFound;
 }
 
-GatheredPhotons::GatheredPhotons(int maxGatherCount)
+GatheredPhotons::GatheredPhotons(int maxGatherCount, MemoryArena *arena) : arena(arena)
 {
 	numFound = 0;
-	photonGatherList = (Photon**)POV_MALLOC(sizeof(Photon *)*maxGatherCount, "Photon Map Info");
-	photonDistances = (DBL *)POV_MALLOC(sizeof(DBL)*maxGatherCount, "Photon Map Info");
+	if(arena != NULL)
+	{
+		photonGatherList = arena->Alloc<Photon *>(maxGatherCount);
+		photonDistances = arena->Alloc<DBL>(maxGatherCount);
+	}
+	else
+	{
+		photonGatherList = (Photon**)POV_MALLOC(sizeof(Photon *)*maxGatherCount, "Photon Map Info");
+		photonDistances = (DBL *)POV_MALLOC(sizeof(DBL)*maxGatherCount, "Photon Map Info");
+	}
 }
 
 GatheredPhotons::~GatheredPhotons()
 {
+	// arrays taken from an arena are given back when the arena is released
+	if(arena != NULL)
+		return;
+
 	if(photonGatherList)
 		POV_FREE(photonGatherList);
 	photonGatherList = NULL;
@@ -101,6 +101,7 @@
 #include "backend/control/messagefactory.h"
 #include "backend/colour/colutils.h"
 #include "backend/interior/media.h"
+#include "backend/support/arena.h"
 
 namespace pov
 {
@@ -237,6 +238,31 @@ extern const int PHOTON_BLOCK_SIZE;
 extern const int PHOTON_BLOCK_MASK;
 extern const int INITIAL_BASE_ARRAY_SIZE;
 
+class PhotonMap;
+
+/* a range of photons whose kd-tree can be built independently */
+struct PhotonSortJob
+{
+	int start;            /* first photon of the range */
+	int end;              /* last photon of the range */
+	int node;             /* kd-tree node the median of the range goes to */
+
+	PhotonSortJob(int s, int e, int n) : start(s), end(e), node(n) { }
+};
+
+// Interface to process independent photon kd-tree build jobs,
+// typically in parallel.
+class PhotonSortJobRunner
+{
+	public:
+		virtual ~PhotonSortJobRunner() { }
+
+		// Number of tree levels split off into separate jobs.
+		virtual unsigned int GetJobLevels() const = 0;
+		// Run PhotonMap::sortAndSubdivide for each of the jobs and return when all are done.
+		virtual void operator()(PhotonMap *map, vector<PhotonSortJob>& jobs) = 0;
+};
+
 class PhotonMap
 {
 	public:
@@ -244,6 +270,14 @@ class PhotonMap
 		int numBlocks;        /* number of blocks in base array */
 		int numPhotons;       /* total number of photons used */
 
+		/* The kd-tree built by buildTree().  It is stored as a left-balanced
+		   tree in heap order (the children of node i are nodes 2i+1 and 2i+2),
+		   with the locations and split axes needed to walk the tree kept in
+		   separate arrays.  The photon blocks above are freed once it is built. */
+		Photon *treePhotons;     /* photons in tree order */
+		float *treeLoc[3];       /* photon locations in tree order, one array per axis */
+		unsigned char *treeAxis; /* split axis of each tree node */
+
 		DBL minGatherRad;       /* minimum gather radius */
 		DBL minGatherRadMult;   /* minimum gather radius multiplier (for speed adjustments) */
 		DBL gatherRadStep;      /* step size for gather expansion */
@@ -256,8 +290,9 @@ class PhotonMap
 		void insertSort(int start, int end, int d);
 		void quickSortRec(int left, int right, int d);
 		void halfSortRec(int left, int right, int d, int mid);
-		void sortAndSubdivide(int start, int end, int /*sorted*/);
-		void buildTree();
+		void sortAndSubdivide(int start, int end, int node, int splitLevels = -1, vector<PhotonSortJob> *jobs = NULL);
+		void buildTree(PhotonSortJobRunner *runner = NULL);
+		void freeBlocks();
 
 		void setGatherOptions(ScenePhotonSettings& photonSettings, int mediaMap);
 
@@ -317,8 +352,12 @@ class GatheredPhotons
 
 		void swapWith(GatheredPhotons& theOther);
 	
-		GatheredPhotons(int maxGatherCount);
+		/// if arena is not NULL, the arrays are taken from it and left to it on destruction
+		GatheredPhotons(int maxGatherCount, MemoryArena *arena = NULL);
 		~GatheredPhotons();
+	private:
+		/// arena the arrays were taken from, or NULL if they are owned
+		MemoryArena *arena;
 };
 
 class PhotonGatherer
@@ -341,9 +380,12 @@ class PhotonGatherer
 
 		GatheredPhotons gatheredPhotons;
 
-		PhotonGatherer(PhotonMap *map, ScenePhotonSettings& photonSettings);
+		/// arena for temporary gathering results, or NULL to use the heap
+		MemoryArena *arena;
+
+		PhotonGatherer(PhotonMap *map, ScenePhotonSettings& photonSettings, MemoryArena *arena = NULL);
 
-		void gatherPhotonsRec(int start, int end);
+		void gatherPhotonsRec(int node);
 		int gatherPhotons(const VECTOR pt, DBL Size, DBL *r, const VECTOR norm, bool flatten);
 		DBL gatherPhotonsAdaptive(const VECTOR pt, const VECTOR norm, bool flatten);
 
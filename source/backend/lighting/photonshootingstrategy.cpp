@@ -123,18 +123,28 @@
 namespace pov
 {
 
+PhotonShootingStrategy::PhotonShootingStrategy(unsigned int threads) :
+	threads(threads)
+{
+}
+
 void PhotonShootingStrategy::start()
 {
-	iter = units.begin();
+	unitQueue.Reset(threads);
+	for(unsigned int i = 0; i < units.size(); i++)
+		unitQueue.Append(i);
+}
+
+unsigned int PhotonShootingStrategy::attachThread()
+{
+	return unitQueue.AttachWorker();
 }
 
-PhotonShootingUnit* PhotonShootingStrategy::getNextUnit()
+PhotonShootingUnit* PhotonShootingStrategy::getNextUnit(unsigned int thread)
 {
-	boost::mutex::scoped_lock lock(nextUnitMutex);
-	if(iter == units.end()) return 0;
-	PhotonShootingUnit* unit = *iter;
-	iter++;
-	return unit;
+	unsigned int i;
+	if(!unitQueue.Take(thread, i)) return 0;
+	return units[i];
 }
 
 void PhotonShootingStrategy::createUnitsForCombo(ObjectPtr obj, LightSource* light, ViewThreadData* renderDataPtr, shared_ptr<SceneData> sceneData)
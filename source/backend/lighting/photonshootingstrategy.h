@@ -99,6 +99,7 @@
 #include "backend/render/rendertask.h"
 #include "backend/parser/parse.h"
 #include "backend/interior/media.h"
+#include "backend/support/workstealingqueue.h"
 
 namespace pov
 {
@@ -113,15 +114,18 @@ class PhotonShootingStrategy
 
 		vector<PhotonShootingUnit*> units;
 
+		PhotonShootingStrategy(unsigned int threads);
+
 		void createUnitsForCombo(ObjectPtr obj, LightSource* light, ViewThreadData* renderDataPtr, shared_ptr<SceneData> sceneData);
 		void start();
-		PhotonShootingUnit* getNextUnit();
+		unsigned int attachThread();
+		PhotonShootingUnit* getNextUnit(unsigned int thread);
 
 		virtual ~PhotonShootingStrategy();
 
 	private:
-		vector<PhotonShootingUnit*>::iterator iter;
-		boost::mutex nextUnitMutex;
+		unsigned int threads;
+		WorkStealingQueue unitQueue;
 
 };
 
@@ -172,12 +172,13 @@ void PhotonShootingTask::Run()
 
 	Cooperate();
 
-	PhotonShootingUnit* unit = strategy->getNextUnit();
+	unsigned int thread = strategy->attachThread();
+	PhotonShootingUnit* unit = strategy->getNextUnit(thread);
 	while(unit)
 	{
 		//ShootPhotonsAtObject(unit->lightAndObject.target, unit->lightAndObject.light);
 		ShootPhotonsAtObject(unit->lightAndObject);
-		unit = strategy->getNextUnit();
+		unit = strategy->getNextUnit(thread);
 	}
 
 
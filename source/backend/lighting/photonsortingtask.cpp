@@ -129,13 +129,14 @@ namespace pov
       3) compute gather options
       4) clean up memory (delete the non-merged maps and delete the strategy)
 */
-PhotonSortingTask::PhotonSortingTask(ViewData *vd, vector<PhotonMap*> surfaceMaps, vector<PhotonMap*> mediaMaps, PhotonShootingStrategy* strategy) :
+PhotonSortingTask::PhotonSortingTask(ViewData *vd, vector<PhotonMap*> surfaceMaps, vector<PhotonMap*> mediaMaps, PhotonShootingStrategy* strategy, shared_ptr<PhotonSortJobQueue> jq) :
 	RenderTask(vd),
 	surfaceMaps(surfaceMaps),
 	mediaMaps(mediaMaps),
 	strategy(strategy),
 	messageFactory(10, 370, "Photon", vd->GetSceneData()->backendAddress, vd->GetSceneData()->frontendAddress, vd->GetSceneData()->sceneId, 0), // TODO FIXME - Values need to come from the correct place!
-	cooperate(*this)
+	cooperate(*this),
+	jobQueue(jq)
 {
 }
 
@@ -176,11 +177,18 @@ void PhotonSortingTask::Run()
 		if (!this->load())
 			messageFactory.Error(POV_EXCEPTION_STRING("Failed to load photon map from disk"), "Could not load photon map (%s)",GetSceneData()->photonSettings.fileName);
 
-		// set photon options automatically
+		// the file does not tell how the photons were sorted, so the tree is always rebuilt;
+		// also set photon options automatically
 		if (GetSceneData()->surfacePhotonMap.numPhotons>0)
+		{
+			GetSceneData()->surfacePhotonMap.buildTree(jobQueue.get());
 			GetSceneData()->surfacePhotonMap.setGatherOptions(GetSceneData()->photonSettings,false);
+		}
 		if (GetSceneData()->mediaPhotonMap.numPhotons>0)
+		{
+			GetSceneData()->mediaPhotonMap.buildTree(jobQueue.get());
 			GetSceneData()->mediaPhotonMap.setGatherOptions(GetSceneData()->photonSettings,true);
+		}
 	}
 
 	// good idea to make sure all warnings and errors arrive frontend now [trf]
@@ -195,6 +203,10 @@ void PhotonSortingTask::Stopped()
 
 void PhotonSortingTask::Finish()
 {
+	// release helper tasks even if building the tree failed
+	if(jobQueue != NULL)
+		jobQueue->Finish();
+
 	GetViewDataPtr()->timeType = SceneThreadData::kPhotonTime;
 	GetViewDataPtr()->realTime = ConsumedRealTime();
 	GetViewDataPtr()->cpuTime = ConsumedCPUTime();
@@ -220,7 +232,7 @@ void PhotonSortingTask::sortPhotonMap()
 	{
 	//povwin::WIN32_DEBUG_FILE_OUTPUT("\n\nsurfacePhotonMap.buildTree about to be called\n");
 
-		GetSceneData()->surfacePhotonMap.buildTree();
+		GetSceneData()->surfacePhotonMap.buildTree(jobQueue.get());
 		GetSceneData()->surfacePhotonMap.setGatherOptions(GetSceneData()->photonSettings,false);
 //		povwin::WIN32_DEBUG_FILE_OUTPUT("gatherNumSteps: %d\n",GetSceneData()->surfacePhotonMap.gatherNumSteps);
 //		povwin::WIN32_DEBUG_FILE_OUTPUT("gatherRadStep: %lf\n",GetSceneData()->surfacePhotonMap.gatherRadStep);
@@ -234,7 +246,7 @@ void PhotonSortingTask::sortPhotonMap()
 	/* ----------- global photons ------------- */
 	if (globalPhotonMap.numPhotons>0)
 	{
-		globalPhotonMap.buildTree();
+		globalPhotonMap.buildTree(jobQueue.get());
 		globalPhotonMap.setGatherOptions(false);
 	}
 #endif
@@ -242,7 +254,7 @@ void PhotonSortingTask::sortPhotonMap()
 	/* ----------- media photons ------------- */
 	if (GetSceneData()->mediaPhotonMap.numPhotons>0)
 	{
-		GetSceneData()->mediaPhotonMap.buildTree();
+		GetSceneData()->mediaPhotonMap.buildTree(jobQueue.get());
 		GetSceneData()->mediaPhotonMap.setGatherOptions(GetSceneData()->photonSettings,true);
 	}
 
@@ -294,11 +306,11 @@ int PhotonSortingTask::save()
 
 	/* caustic photons */
 	fwrite(&GetSceneData()->surfacePhotonMap.numPhotons, sizeof(GetSceneData()->surfacePhotonMap.numPhotons),1,f);
-	if (GetSceneData()->surfacePhotonMap.numPhotons>0 && GetSceneData()->surfacePhotonMap.head)
+	if (GetSceneData()->surfacePhotonMap.numPhotons>0 && GetSceneData()->surfacePhotonMap.treePhotons)
 	{
 		for(i=0; i<GetSceneData()->surfacePhotonMap.numPhotons; i++)
 		{
-			ph = &(PHOTON_AMF(GetSceneData()->surfacePhotonMap.head, i));
+			ph = &(GetSceneData()->surfacePhotonMap.treePhotons[i]);
 			err = fwrite(ph, sizeof(Photon), 1, f);
 
 			if (err<=0)
@@ -317,11 +329,11 @@ int PhotonSortingTask::save()
 #ifdef GLOBAL_PHOTONS
 	/* global photons */
 	fwrite(&globalPhotonMap.numPhotons, sizeof(globalPhotonMap.numPhotons),1,f);
-	if (globalPhotonMap.numPhotons>0 && globalPhotonMap.head)
+	if (globalPhotonMap.numPhotons>0 && globalPhotonMap.treePhotons)
 	{
 		for(i=0; i<globalPhotonMap.numPhotons; i++)
 		{
-			ph = &(PHOTON_AMF(globalPhotonMap.head, i));
+			ph = &(globalPhotonMap.treePhotons[i]);
 			err = fwrite(ph, sizeof(Photon), 1, f);
 
 			if (err<=0)
@@ -340,11 +352,11 @@ int PhotonSortingTask::save()
 
 	/* media photons */
 	fwrite(&GetSceneData()->mediaPhotonMap.numPhotons, sizeof(GetSceneData()->mediaPhotonMap.numPhotons),1,f);
-	if (GetSceneData()->mediaPhotonMap.numPhotons>0 && GetSceneData()->mediaPhotonMap.head)
+	if (GetSceneData()->mediaPhotonMap.numPhotons>0 && GetSceneData()->mediaPhotonMap.treePhotons)
 	{
 		for(i=0; i<GetSceneData()->mediaPhotonMap.numPhotons; i++)
 		{
-			ph = &(PHOTON_AMF(GetSceneData()->mediaPhotonMap.head, i));
+			ph = &(GetSceneData()->mediaPhotonMap.treePhotons[i]);
 			err = fwrite(ph, sizeof(Photon), 1, f);
 
 			if (err<=0)
@@ -449,5 +461,137 @@ int PhotonSortingTask::load()
 	return true;
 }
 
+PhotonSortingHelperTask::PhotonSortingHelperTask(ViewData *vd, shared_ptr<PhotonSortJobQueue> jq) :
+	RenderTask(vd),
+	jobQueue(jq)
+{
+}
+
+PhotonSortingHelperTask::~PhotonSortingHelperTask()
+{
+}
+
+void PhotonSortingHelperTask::Run()
+{
+	jobQueue->Work();
+}
+
+void PhotonSortingHelperTask::Stopped()
+{
+}
+
+void PhotonSortingHelperTask::Finish()
+{
+	GetViewDataPtr()->timeType = SceneThreadData::kPhotonTime;
+	GetViewDataPtr()->realTime = ConsumedRealTime();
+	GetViewDataPtr()->cpuTime = ConsumedCPUTime();
+}
+
+PhotonSortJobQueue::PhotonSortJobQueue(unsigned int threads) :
+	map(NULL),
+	jobs(NULL),
+	nextJob(0),
+	pendingJobs(0),
+	jobLevels(2),
+	failed(false),
+	finished(false)
+{
+	// aim for about four times as many jobs as there are threads
+	while((1u << jobLevels) < threads * 4)
+		jobLevels++;
+}
+
+PhotonSortJobQueue::~PhotonSortJobQueue()
+{
+}
+
+unsigned int PhotonSortJobQueue::GetJobLevels() const
+{
+	return jobLevels;
+}
+
+void PhotonSortJobQueue::operator()(PhotonMap *m, vector<PhotonSortJob>& j)
+{
+	boost::mutex::scoped_lock lock(queueMutex);
+
+	map = m;
+	jobs = &j;
+	nextJob = 0;
+	pendingJobs = j.size();
+
+	jobsCondition.notify_all();
+
+	while(ProcessJob(lock)) { }
+
+	// jobs taken by helper tasks have to be completed before returning
+	// as they reference the job list and the photon map
+	while(pendingJobs > 0)
+		doneCondition.wait(lock);
+
+	map = NULL;
+	jobs = NULL;
+
+	if(failed == true)
+		throw POV_EXCEPTION(kUncategorizedError, "Building photon map kd-tree failed.");
+}
+
+void PhotonSortJobQueue::Work()
+{
+	boost::mutex::scoped_lock lock(queueMutex);
+
+	while(finished == false)
+	{
+		if(ProcessJob(lock) == false)
+		{
+			boost::xtime t;
+			boost::xtime_get(&t, boost::TIME_UTC);
+			t.sec += 1;
+
+			jobsCondition.timed_wait(lock, t);
+
+			Task::CurrentTaskCooperate();
+		}
+	}
+}
+
+void PhotonSortJobQueue::Finish()
+{
+	boost::mutex::scoped_lock lock(queueMutex);
+
+	finished = true;
+
+	jobsCondition.notify_all();
+}
+
+bool PhotonSortJobQueue::ProcessJob(boost::mutex::scoped_lock& lock)
+{
+	if((jobs == NULL) || (nextJob >= jobs->size()))
+		return false;
+
+	PhotonSortJob& job = (*jobs)[nextJob++];
+	PhotonMap *m = map;
+
+	lock.unlock();
+
+	try
+	{
+		m->sortAndSubdivide(job.start, job.end, job.node);
+	}
+	catch(...)
+	{
+		lock.lock();
+		failed = true;
+		if(--pendingJobs == 0)
+			doneCondition.notify_all();
+		throw;
+	}
+
+	lock.lock();
+
+	if(--pendingJobs == 0)
+		doneCondition.notify_all();
+
+	return true;
+}
 
 }
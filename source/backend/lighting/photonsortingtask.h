@@ -91,6 +91,10 @@
 #ifndef PHOTONSORTINGTASK_H
 #define PHOTONSORTINGTASK_H
 
+#include <vector>
+
+#include <boost/thread.hpp>
+
 #include "base/povms.h"
 #include "backend/frame.h"
 #include "backend/render/trace.h"
@@ -105,6 +109,48 @@ namespace pov
 
 using namespace pov_base;
 
+/**
+ *	Hands out photon kd-tree build jobs to the photon sorting task and its
+ *	helper tasks, so the independent subtrees are built in parallel.
+ */
+class PhotonSortJobQueue : public PhotonSortJobRunner
+{
+	public:
+		PhotonSortJobQueue(unsigned int threads);
+		virtual ~PhotonSortJobQueue();
+
+		virtual unsigned int GetJobLevels() const;
+		virtual void operator()(PhotonMap *map, vector<PhotonSortJob>& jobs);
+
+		/// process jobs until Finish() is called, used by helper tasks
+		void Work();
+		/// tell helper tasks there will be no more jobs
+		void Finish();
+	private:
+		/// queue mutex
+		boost::mutex queueMutex;
+		/// signalled when new jobs are available
+		boost::condition jobsCondition;
+		/// signalled when all jobs are done
+		boost::condition doneCondition;
+		/// photon map the current jobs refer to
+		PhotonMap *map;
+		/// current jobs or NULL
+		vector<PhotonSortJob> *jobs;
+		/// next job to hand out
+		size_t nextJob;
+		/// number of current jobs not yet done
+		size_t pendingJobs;
+		/// number of tree levels to split off into separate jobs
+		unsigned int jobLevels;
+		/// set if a job failed
+		bool failed;
+		/// set when no more jobs will be queued
+		bool finished;
+
+		bool ProcessJob(boost::mutex::scoped_lock& lock);
+};
+
 class PhotonSortingTask : public RenderTask
 {
 	public:
@@ -115,7 +161,7 @@ class PhotonSortingTask : public RenderTask
 		vector<PhotonMap*> mediaMaps;
 		PhotonShootingStrategy* strategy;
 
-		PhotonSortingTask(ViewData *vd, vector<PhotonMap*> surfaceMaps, vector<PhotonMap*> mediaMaps, PhotonShootingStrategy* strategy);
+		PhotonSortingTask(ViewData *vd, vector<PhotonMap*> surfaceMaps, vector<PhotonMap*> mediaMaps, PhotonShootingStrategy* strategy, shared_ptr<PhotonSortJobQueue> jq = shared_ptr<PhotonSortJobQueue>());
 		~PhotonSortingTask();
 
 		void Run();
@@ -138,6 +184,20 @@ class PhotonSortingTask : public RenderTask
 		};
 
 		CooperateFunction cooperate;
+		shared_ptr<PhotonSortJobQueue> jobQueue;
+};
+
+class PhotonSortingHelperTask : public RenderTask
+{
+	public:
+		PhotonSortingHelperTask(ViewData *vd, shared_ptr<PhotonSortJobQueue> jq);
+		~PhotonSortingHelperTask();
+
+		void Run();
+		void Stopped();
+		void Finish();
+	private:
+		shared_ptr<PhotonSortJobQueue> jobQueue;
 };
 
 }
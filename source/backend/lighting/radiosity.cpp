@@ -904,6 +904,9 @@ RadiosityCache::RadiosityCache(const SceneRadiositySettings& radset) :
 	ra_reuse_count(0),
 	ra_gather_count(0),
 	ot_fd(NULL),
+	ot_binary(true),
+	baseBlocks(NULL),
+	baseBlockCount(0),
 	Gather_Total_Count(0),
 	recursionSettings(radset.GetRecursionSettings(true)) // be prepared for the main render
 {
@@ -917,11 +920,86 @@ RadiosityCache::RadiosityCache(const SceneRadiositySettings& radset) :
 	#endif
 }
 
-bool RadiosityCache::Load(const Path& inputFile)
+bool RadiosityCache::Load(const Path& inputFile, unsigned int sceneHash)
 {
 	bool ok = false;
 	IStream* fd = NewIStream(inputFile, POV_File_Data_RCA);
 	if(fd != NULL)
+	{
+		OT_FILE_HEADER header;
+
+		if(fd->read(&header, sizeof(header)) && (memcmp(header.Magic, OT_FILE_MAGIC, sizeof(header.Magic)) == 0))
+		{
+			ok = LoadBinary(fd, header, sceneHash);
+			ot_binary = true;
+		}
+		else
+		{
+			// no binary cache file, so assume the traditional text format
+			fd->clearstate();
+			fd->seekg(0);
+			ok = LoadText(fd);
+			ot_binary = false;
+		}
+
+		delete fd;
+	}
+	return ok;
+}
+
+bool RadiosityCache::LoadBinary(IStream *fd, const OT_FILE_HEADER& header, unsigned int sceneHash)
+{
+	// reject files written by a different version, on a different platform or for a different scene
+	if((header.Version != OT_FILE_VERSION) || (header.BlockSize != sizeof(OT_FILE_BLOCK)) || (header.SceneHash != sceneHash))
+		return false;
+
+	POV_LONG start = fd->tellg();
+	fd->seekg(0, POV_SEEK_END);
+	POV_LONG end = fd->tellg();
+	fd->seekg(start);
+
+	if((start < 0) || (end < start))
+		return false;
+
+	size_t count = size_t(end - start) / sizeof(OT_FILE_BLOCK);
+	if(count == 0)
+		return true;
+
+	// All blocks go into a single array, which is read in large chunks and never
+	// modified afterwards; blocks added during the render go to the block pools.
+	assert(baseBlocks == NULL);
+	baseBlocks = new OT_BLOCK[count];
+	baseBlockCount = count;
+
+	vector<OT_FILE_BLOCK> buffer(min(count, size_t(4096)));
+
+	for(size_t done = 0; done < count; )
+	{
+		size_t n = min(count - done, buffer.size());
+
+		if(!fd->read(&buffer[0], n * sizeof(OT_FILE_BLOCK)))
+			return false;
+
+		for(size_t i = 0; i < n; i++)
+		{
+			OT_BLOCK *block = &baseBlocks[done + i];
+
+			ot_read_block_binary(&buffer[i], block);
+			block->Pass = OT_PASS(PRETRACE_STEP_LOADED);
+			block->TileId = 0;
+
+			LinkBlock(NULL, block, block->Harmonic_Mean_Distance);
+		}
+
+		done += n;
+	}
+
+	return true;
+}
+
+bool RadiosityCache::LoadText(IStream *fd)
+{
+	bool ok = false;
 	{
 		BlockPool* pool = AcquireBlockPool();
 
@@ -1020,15 +1098,63 @@ bool RadiosityCache::Load(const Path& inputFile)
 		}
 
 		ReleaseBlockPool(pool);
-
-		delete fd;
 	}
 	return ok;
 }
 
-void RadiosityCache::InitAutosave(const Path& outputFile, bool append)
+void RadiosityCache::InitAutosave(const Path& outputFile, bool append, unsigned int sceneHash)
 {
 	ot_fd = NewOStream(outputFile, POV_File_Data_RCA, append);
+
+	if(append == false)
+	{
+		// new files are always written in binary format;
+		// when appending, stick to the format of the file loaded
+		ot_binary = true;
+		if((ot_fd != NULL) && (ot_write_file_header(ot_fd, sceneHash) == false))
+		{
+			delete ot_fd;
+			ot_fd = NULL;
+		}
+	}
+}
+
+// Hash the parts of the scene that determine whether radiosity samples taken
+// in it are still valid: the radiosity settings that affect sample values,
+// and the number and extent of all objects. Moving only the camera, as in a
+// walkthrough animation, keeps the hash unchanged.
+unsigned int RadiosityCache::ComputeSceneHash(const SceneData& sceneData)
+{
+	const SceneRadiositySettings& settings = sceneData.radiositySettings;
+	unsigned int hash = 2166136261u; // FNV-1a
+
+	#define HASH_VALUE(v) \
+		for(size_t i = 0; i < sizeof(v); i++) \
+			hash = (hash ^ ((const unsigned char *)&(v))[i]) * 16777619u;
+
+	HASH_VALUE(settings.brightness);
+	HASH_VALUE(settings.grayThreshold);
+	HASH_VALUE(settings.recursionLimit);
+	HASH_VALUE(settings.maxSample);
+	HASH_VALUE(settings.adcBailout);
+	HASH_VALUE(settings.normal);
+	HASH_VALUE(settings.media);
+	HASH_VALUE(settings.subsurface);
+
+	size_t objects = sceneData.objects.size();
+	size_t lights = sceneData.lightSources.size();
+	HASH_VALUE(objects);
+	HASH_VALUE(lights);
+
+	for(vector<ObjectPtr>::const_iterator it = sceneData.objects.begin(); it != sceneData.objects.end(); it++)
+	{
+		HASH_VALUE((*it)->BBox.Lower_Left);
+		HASH_VALUE((*it)->BBox.Lengths);
+	}
+
+	#undef HASH_VALUE
+
+	return hash;
 }
 
 /*****************************************************************************
@@ -1072,9 +1198,13 @@ RadiosityCache::~RadiosityCache()
 
 	{ // mutex scope
 		boost::mutex::scoped_lock lockTree(octree.treeMutex);
+#ifndef POV_ATOMIC_CAS_PTR
 		boost::mutex::scoped_lock lockBlock(octree.blockMutex);
+#endif
 		if (octree.root != NULL)
 			ot_free_tree(&octree.root);
+		delete[] baseBlocks;
+		baseBlocks = NULL;
 	}
 
 	{ // mutex scope
@@ -1107,7 +1237,7 @@ void RadiosityCache::ReleaseBlockPool(RadiosityCache::BlockPool* pool)
 {
 	{ // mutex scope
 		boost::mutex::scoped_lock lock(fileMutex);
-		pool->Save(ot_fd);
+		pool->Save(ot_fd, ot_binary);
 	}
 
 	{ // mutex scope
@@ -1142,7 +1272,7 @@ RadiosityCache::BlockPool::BlockPool() :
 	// nothing else to do
 }
 
-void RadiosityCache::BlockPool::Save(OStream* fd)
+void RadiosityCache::BlockPool::Save(OStream* fd, bool binary)
 {
 	if (fd != NULL)
 	{
@@ -1160,7 +1290,12 @@ void RadiosityCache::BlockPool::Save(OStream* fd)
 
 			// save current pool unit
 			for (int i = from; i < to; i ++)
-				ot_write_block(&(unit->blocks[i]), fd);
+			{
+				if (binary)
+					ot_write_block_binary(&(unit->blocks[i]), fd);
+				else
+					ot_write_block(&(unit->blocks[i]), fd);
+			}
 
 			unit = unit->next;
 		}
@@ -1199,9 +1334,6 @@ void RadiosityCache::AddBlock(BlockPool* pool, RenderStatistics* stats, const Ve
                               DBL harmonicMeanDistance, DBL nearestDistance, DBL quality, int bounceDepth, int pretraceStep, int tileId)
 {
 	OT_BLOCK*   block = pool->NewBlock();
-	OT_ID       id;
-	OT_NODE*    node;
-	const RadiosityRecursionSettings& recSettings = recursionSettings[bounceDepth];
 
 	assert((bounceDepth >= 0) && (bounceDepth  <= OT_DEPTH_MAX));
 	assert(((pretraceStep >= OT_PASS_FIRST) && (pretraceStep <= OT_PASS_MAX)) || (pretraceStep == OT_PASS_FINAL));
@@ -1224,14 +1356,33 @@ void RadiosityCache::AddBlock(BlockPool* pool, RenderStatistics* stats, const Ve
 	block->S_Normal = normal;
 	block->next = NULL;
 
+	LinkBlock(stats, block, harmonicMeanDistance);
+}
+
+void RadiosityCache::LinkBlock(RenderStatistics* stats, OT_BLOCK *block, DBL harmonicMeanDistance)
+{
+	OT_ID       id;
+	OT_NODE*    node;
+	const RadiosityRecursionSettings& recSettings = recursionSettings[block->Bounce_Depth];
+
 	// figure out the block id
-	ot_index_sphere(point, harmonicMeanDistance * recSettings.octreeAddressFactor, &id);
+	ot_index_sphere(block->Point, harmonicMeanDistance * recSettings.octreeAddressFactor, &id);
 
 	// get the corresponding node
 	node = RadiosityCache::GetNode(stats, id);
 
 	// add the info block
-	InsertBlock(node, block);
+	InsertBlock(stats, node, block);
+}
+
+// Acquire a lock, counting it as contention if another task is holding it.
+static void LockOctree(boost::mutex::scoped_lock& lock, RenderStatistics* stats)
+{
+	if (!lock.try_lock())
+	{
+		if (stats != NULL) (*stats)[Radiosity_OctreeContention]++;
+		lock.lock();
+	}
 }
 
 OT_NODE *RadiosityCache::GetNode(RenderStatistics* stats, const OT_ID& id)
@@ -1263,7 +1414,7 @@ OT_NODE *RadiosityCache::GetNode(RenderStatistics* stats, const OT_ID& id)
 #endif
 
 		// now is the time to lock the tree for modification
-		treeLock.lock();
+		LockOctree(treeLock, stats);
 
 		// Now that we have exclusive write access, make sure we REALLY don't have a root
 		// (some other thread might have created it just as we were waiting to get the lock)
@@ -1302,7 +1453,7 @@ OT_NODE *RadiosityCache::GetNode(RenderStatistics* stats, const OT_ID& id)
 	{
 		// now is the time to lock the tree for modification, in case we haven't yet
 		if (!treeLock.owns_lock())
-			treeLock.lock();
+			LockOctree(treeLock, stats);
 
 		// (Note that the following can't be a do...while() loop because we may not have had a lock when we first tested,
 		// and some other task may have modified the root while we were not looking)
@@ -1336,7 +1487,7 @@ OT_NODE *RadiosityCache::GetNode(RenderStatistics* stats, const OT_ID& id)
 		// now is the time to lock the tree for modification, in case we haven't yet
 		if (!treeLock.owns_lock())
 		{
-			treeLock.lock();
+			LockOctree(treeLock, stats);
 
 			// Acquired the lock just now, so some other task may have changed the root since last time we looked
 			while (temp_id.Size < octree.root->Id.Size)
@@ -1388,9 +1539,33 @@ OT_NODE *RadiosityCache::GetNode(RenderStatistics* stats, const OT_ID& id)
 		{
 			// Next level down doesn't exist yet, so create it
 
+#ifdef POV_ATOMIC_CAS_PTR
+			temp_node = (OT_NODE *)POV_CALLOC(1, sizeof(OT_NODE), "octree node");
+
+			// Fill in the data
+			temp_node->Id = temp_id;
+			// (all other data fields are automatically zeroed by the allocation function)
+
+			// Add it onto the tree, unless some other task has just done so
+			if (POV_ATOMIC_CAS_PTR(&this_node->Kids[index], (OT_NODE *)NULL, temp_node))
+			{
+#ifdef OCTREE_PERFORMANCE_DEBUG
+				if (stats!= NULL) (*stats)[Radiosity_OctreeNodes]++;
+#endif
+
+#ifdef RADSTATS
+				ot_nodecount++;
+#endif
+			}
+			else
+			{
+				POV_FREE(temp_node);
+				if (stats != NULL) (*stats)[Radiosity_OctreeContention]++;
+			}
+#else
 			// now is the time to lock the tree for modification, in case we haven't yet
 			if (!treeLock.owns_lock())
-				treeLock.lock();
+				LockOctree(treeLock, stats);
 
 			// We may have acquired the lock just now, so some other task may have changed the root since last time we looked
 			if (this_node->Kids[index] == NULL)
@@ -1411,6 +1586,7 @@ OT_NODE *RadiosityCache::GetNode(RenderStatistics* stats, const OT_ID& id)
 				// Add it onto the tree
 				this_node->Kids[index] = temp_node;
 			}
+#endif
 		}
 
 		// Now follow it down and repeat
@@ -1421,12 +1597,23 @@ OT_NODE *RadiosityCache::GetNode(RenderStatistics* stats, const OT_ID& id)
 	return this_node;
 }
 
-void RadiosityCache::InsertBlock(OT_NODE *node, OT_BLOCK *block)
+void RadiosityCache::InsertBlock(RenderStatistics* stats, OT_NODE *node, OT_BLOCK *block)
 {
-	boost::mutex::scoped_lock lock(octree.blockMutex);
+#ifdef POV_ATOMIC_CAS_PTR
+	// Push the block onto the node's list; readers see either the old or the new list head
+	block->next = node->Values;
+	while (!POV_ATOMIC_CAS_PTR(&node->Values, block->next, block))
+	{
+		if (stats != NULL) (*stats)[Radiosity_OctreeContention]++;
+		block->next = node->Values;
+	}
+#else
+	boost::mutex::scoped_lock lock(octree.blockMutex, boost::defer_lock_t());
+	LockOctree(lock, stats);
 
 	block->next = node->Values;
 	node->Values = block;
+#endif
 }
 
 /*****************************************************************************
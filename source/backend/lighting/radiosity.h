@@ -222,7 +222,7 @@ class RadiosityCache
 				~BlockPool();
 			protected:
 				OT_BLOCK* NewBlock();
-				void Save(OStream *fd);
+				void Save(OStream *fd, bool binary);
 			private:
 				struct PoolUnit
 				{
@@ -257,8 +257,10 @@ class RadiosityCache
 		RadiosityCache(const SceneRadiositySettings& radset);
 		~RadiosityCache();
 
-		bool Load(const Path& inputFile);
-		void InitAutosave(const Path& outputFile, bool append);
+		bool Load(const Path& inputFile, unsigned int sceneHash);
+		void InitAutosave(const Path& outputFile, bool append, unsigned int sceneHash);
+
+		static unsigned int ComputeSceneHash(const SceneData& sceneData);
 
 		DBL FindReusableBlock(RenderStatistics& stats, DBL errorbound, const Vector3d& ipoint, const Vector3d& snormal, RGBColour& illuminance, int recursionDepth, int pretraceStep, int tileId);
 		BlockPool* AcquireBlockPool();
@@ -269,11 +271,15 @@ class RadiosityCache
 
 	private:
 
+		// Readers traverse the tree without locking. Where POV_ATOMIC_CAS_PTR is available,
+		// child nodes and blocks are published with it, and only changing the root is locked.
 		struct Octree
 		{
 			OT_NODE *root;
 			boost::mutex treeMutex;   // lock this when adding nodes to the tree
+#ifndef POV_ATOMIC_CAS_PTR
 			boost::mutex blockMutex;  // lock this when adding blocks to any node of the tree
+#endif
 
 			Octree() : root(NULL) {}
 		};
@@ -284,11 +290,19 @@ class RadiosityCache
 		Octree octree;
 
 		OStream *ot_fd;
+		bool ot_binary;                 // whether ot_fd is a binary cache file
 		boost::mutex fileMutex;         // lock this when accessing ot_fd
 
+		OT_BLOCK *baseBlocks;           // blocks loaded from a binary cache file, in one array
+		size_t baseBlockCount;
+
 		RadiosityRecursionSettings* recursionSettings; // dynamically allocated array; use recursion depth as index
 
-		void InsertBlock(OT_NODE* node, OT_BLOCK *block);
+		bool LoadText(IStream *fd);
+		bool LoadBinary(IStream *fd, const OT_FILE_HEADER& header, unsigned int sceneHash);
+
+		void LinkBlock(RenderStatistics* stats, OT_BLOCK *block, DBL harmonicMeanDistance);
+		void InsertBlock(RenderStatistics* stats, OT_NODE* node, OT_BLOCK *block);
 		OT_NODE *GetNode(RenderStatistics* stats, const OT_ID& id);
 
 		static bool AverageNearBlock(OT_BLOCK *block, void *void_info);
@@ -0,0 +1,621 @@
+/*******************************************************************************
+ * includecache.cpp
+ *
+ * This module keeps the tokens of include files in cache files on disk.
+ *
+ * from Persistence of Vision Ray Tracer ('POV-Ray') version 3.7.
+ * Copyright 1991-2003 Persistence of Vision Team
+ * Copyright 2003-2009 Persistence of Vision Raytracer Pty. Ltd.
+ * ---------------------------------------------------------------------------
+ * NOTICE: This source code file is provided so that users may experiment
+ * with enhancements to POV-Ray and to port the software to platforms other
+ * than those supported by the POV-Ray developers. There are strict rules
+ * regarding how you are permitted to use this file. These rules are contained
+ * in the distribution and derivative versions licenses which should have been
+ * provided with this file.
+ *
+ * These licences may be found online, linked from the end-user license
+ * agreement that is located at http://www.povray.org/povlegal.html
+ * ---------------------------------------------------------------------------
+ * POV-Ray is based on the popular DKB raytracer version 2.12.
+ * DKBTrace was originally written by David K. Buck.
+ * DKBTrace Ver 2.0-2.12 were written by David K. Buck & Aaron A. Collins.
+ * ---------------------------------------------------------------------------
+ * $File: //depot/povray/smp/source/backend/parser/includecache.cpp $
+ * $Revision: #1 $
+ * $Change: 5401 $
+ * $DateTime: 2011/02/08 21:06:55 $
+ * $Author: clipka $
+ *******************************************************************************/
+
+/*********************************************************************************
+ * NOTICE
+ *
+ * This file is part of a BETA-TEST version of POV-Ray version 3.7. It is not
+ * final code. Use of this source file is governed by both the standard POV-Ray
+ * licences referred to in the copyright header block above this notice, and the
+ * following additional restrictions numbered 1 through 4 below:
+ *
+ *   1. This source file may not be re-distributed without the written permission
+ *      of Persistence of Vision Raytracer Pty. Ltd.
+ *
+ *   2. This notice may not be altered or removed.
+ *   
+ *   3. Binaries generated from this source file by individuals for their own
+ *      personal use may not be re-distributed without the written permission
+ *      of Persistence of Vision Raytracer Pty. Ltd. Such personal-use binaries
+ *      are not required to have a timeout, and thus permission is granted in
+ *      these circumstances only to disable the timeout code contained within
+ *      the beta software.
+ *   
+ *   4. Binaries generated from this source file for use within an organizational
+ *      unit (such as, but not limited to, a company or university) may not be
+ *      distributed beyond the local organizational unit in which they were made,
+ *      unless written permission is obtained from Persistence of Vision Raytracer
+ *      Pty. Ltd. Additionally, the timeout code implemented within the beta may
+ *      not be disabled or otherwise bypassed in any manner.
+ *
+ * The following text is not part of the above conditions and is provided for
+ * informational purposes only.
+ *
+ * The purpose of the no-redistribution clause is to attempt to keep the
+ * circulating copies of the beta source fresh. The only authorized distribution
+ * point for the source code is the POV-Ray website and Perforce server, where
+ * the code will be kept up to date with recent fixes. Additionally the beta
+ * timeout code mentioned above has been a standard part of POV-Ray betas since
+ * version 1.0, and is intended to reduce bug reports from old betas as well as
+ * keep any circulating beta binaries relatively fresh.
+ *
+ * All said, however, the POV-Ray developers are open to any reasonable request
+ * for variations to the above conditions and will consider them on a case-by-case
+ * basis.
+ *
+ * Additionally, the developers request your co-operation in fixing bugs and
+ * generally improving the program. If submitting a bug-fix, please ensure that
+ * you quote the revision number of the file shown above in the copyright header
+ * (see the '$Revision:' field). This ensures that it is possible to determine
+ * what specific copy of the file you are working with. The developers also would
+ * like to make it known that until POV-Ray 3.7 is out of beta, they would prefer
+ * to emphasize the provision of bug fixes over the addition of new features.
+ *
+ * Persons wishing to enhance this source are requested to take the above into
+ * account. It is also strongly suggested that such enhancements are started with
+ * a recent copy of the source.
+ *
+ * The source code page (see http://www.povray.org/beta/source/) sets out the
+ * conditions under which the developers are willing to accept contributions back
+ * into the primary source tree. Please refer to those conditions prior to making
+ * any changes to this source, if you wish to submit those changes for inclusion
+ * with POV-Ray.
+ *
+ *********************************************************************************/
+
+/****************************************************************************
+*
+*  Explanation:
+*
+*    An include cache file holds the token cache of an include file as it
+*    is recorded while the file is read, so that later renders can replay
+*    the tokens instead of scanning the file character by character. The
+*    cache files are kept in the directory given by Include_Cache_Path and
+*    are named after the include file and a hash of its full path.
+*
+*    A cache file is only used if the size and modification time of the
+*    include file match those stored in the cache file; otherwise the
+*    include file is read as usual and its cache file is written anew once
+*    all of it has been read.
+*
+*    The file is only meant to be read by the same build of POV-Ray on the
+*    same kind of machine; the header records the byte order, the size of
+*    a cached token and a checksum of the reserved word table, and any
+*    difference is rejected.
+*
+*****************************************************************************/
+
+// frame.h must always be the first POV file included (pulls in platform config)
+#include "backend/frame.h"
+#include "base/fileinputoutput.h"
+#include "base/path.h"
+#include "base/pov_err.h"
+#include "backend/parser/parse.h"
+#include "backend/scene/scene.h"
+
+#if (SYS_INCLUDE_CACHE == 1)
+#include <sys/types.h>
+#include <sys/stat.h>
+#endif
+
+// this must be the last file included
+#include "base/povdebug.h"
+
+namespace pov
+{
+
+using namespace pov_base;
+
+/*****************************************************************************
+* Local preprocessor defines
+******************************************************************************/
+
+const unsigned int INCLUDE_CACHE_VERSION = 1;
+
+const unsigned int INCLUDE_CACHE_BYTE_ORDER = 0x01020304;
+
+const char INCLUDE_CACHE_MAGIC[8] = "POVTOKS";
+
+
+
+/*****************************************************************************
+* Local typedefs
+******************************************************************************/
+
+typedef struct Include_Cache_Header_Struct INCLUDE_CACHE_HEADER;
+
+struct Include_Cache_Header_Struct
+{
+	char Magic[8];                 /* INCLUDE_CACHE_MAGIC.              */
+	unsigned int Version;          /* INCLUDE_CACHE_VERSION.            */
+	unsigned int Byte_Order;       /* INCLUDE_CACHE_BYTE_ORDER.         */
+	unsigned int Token_Size;       /* Size of a cached token.           */
+	unsigned int Last_Token;       /* LAST_TOKEN.                       */
+	unsigned int Reserved_Words;   /* Checksum of the reserved words.   */
+	unsigned int Name_Length;      /* Characters in the include name.   */
+	POV_LONG Source_Size;          /* Size of the include file.         */
+	POV_LONG Source_Time;          /* Modification time of the same.    */
+	POV_LONG Number_Of_Tokens;
+	POV_LONG Strings_Size;         /* Size of the string pool.          */
+};
+
+
+
+/*****************************************************************************
+* Static functions
+******************************************************************************/
+
+static unsigned int hash_bytes(unsigned int Hash, const void *Data, size_t Size);
+static unsigned int reserved_words_checksum();
+static UCS2String include_cache_name(const UCS2String& Directory, const UCS2String& filename);
+static void init_cache_header(INCLUDE_CACHE_HEADER *Header);
+
+
+
+/*****************************************************************************
+*
+* FUNCTION
+*
+*   Open_Include_Cache
+*
+* INPUT
+*
+*   filename - Full name of the include file just opened
+*
+* OUTPUT
+*
+* RETURNS
+*
+* AUTHOR
+*
+* DESCRIPTION
+*
+*   Fill the (still empty) token cache of the current input file from its
+*   include cache file and start replaying it. The input file is positioned
+*   at its end, so that reading continues with the end of the file once all
+*   tokens have been replayed.
+*
+*   If there is no valid cache file, the whole input file is recorded
+*   instead, and the cache file is written when the end of the file is
+*   reached.
+*
+* CHANGES
+*
+******************************************************************************/
+
+void Parser::Open_Include_Cache(const UCS2String& filename)
+{
+#if (SYS_INCLUDE_CACHE == 1)
+	TOKEN_CACHE *Tokens = Input_File->Tokens;
+	UCS2String Cache_Name;
+	IStream *file = NULL;
+	struct stat info;
+
+	if (stat(UCS2toASCIIString(filename).c_str(), &info) != 0)
+		return;
+
+	Tokens->Source_Size = (POV_LONG)info.st_size;
+	Tokens->Source_Time = (POV_LONG)info.st_mtime;
+
+	Cache_Name = include_cache_name(sceneData->includeCachePath, filename);
+
+	try
+	{
+		file = NewIStream(Cache_Name.c_str(), POV_File_Unknown);
+	}
+	catch (pov_base::Exception&)
+	{
+		file = NULL;
+	}
+
+	if (file != NULL)
+	{
+		bool Valid = Read_Include_Cache(file, filename);
+
+		delete file;
+
+		if (Valid)
+		{
+			ITextStream::FilePos End;
+
+			End.offset = Tokens->Source_Size;
+			End.lineno = (Tokens->Number_Of_Tokens > 0) ? Tokens->Tokens[Tokens->Number_Of_Tokens - 1].File_Pos.lineno : 1;
+
+			if (Input_File->In_File->seekg(End))
+			{
+				Input_File->Replay       = Tokens;
+				Input_File->Replay_Index = 0;
+
+				return;
+			}
+
+			Tokens->Number_Of_Tokens = 0;
+			Tokens->Strings_Size     = 0;
+		}
+	}
+
+	Tokens->Cache_File = UCS2_strdup(Cache_Name.c_str());
+	Tokens->Recording++;
+#endif
+}
+
+
+
+/*****************************************************************************
+*
+* FUNCTION
+*
+*   Read_Include_Cache
+*
+* INPUT
+*
+*   file     - Include cache file
+*   filename - Full name of the include file
+*
+* OUTPUT
+*
+* RETURNS
+*
+*   True if the cache file is valid and has been read into the token cache
+*   of the current input file.
+*
+* AUTHOR
+*
+* DESCRIPTION
+*
+*   Any error in the cache file is silently ignored, leaving the token cache
+*   empty; the include file is then read as usual.
+*
+* CHANGES
+*
+******************************************************************************/
+
+bool Parser::Read_Include_Cache(IStream *file, const UCS2String& filename)
+{
+	TOKEN_CACHE *Tokens = Input_File->Tokens;
+	INCLUDE_CACHE_HEADER Header, Expected;
+	vector<UCS2> Name;
+	POV_LONG Size;
+
+	file->seekg(0, IOBase::seek_end);
+	Size = file->tellg();
+	file->seekg(0, IOBase::seek_set);
+
+	if ((Size < (POV_LONG)sizeof(INCLUDE_CACHE_HEADER)) || !file->read(&Header, sizeof(INCLUDE_CACHE_HEADER)))
+		return false;
+
+	init_cache_header(&Expected);
+
+	if ((memcmp(Header.Magic, Expected.Magic, sizeof(Header.Magic)) != 0) ||
+	    (Header.Version        != Expected.Version) ||
+	    (Header.Byte_Order     != Expected.Byte_Order) ||
+	    (Header.Token_Size     != Expected.Token_Size) ||
+	    (Header.Last_Token     != Expected.Last_Token) ||
+	    (Header.Reserved_Words != Expected.Reserved_Words))
+		return false;
+
+	if ((Header.Source_Size != Tokens->Source_Size) || (Header.Source_Time != Tokens->Source_Time) ||
+	    (Header.Name_Length != filename.length()))
+		return false;
+
+	if ((Header.Number_Of_Tokens < 0) || (Header.Number_Of_Tokens > INT_MAX) || (Header.Strings_Size < 0) ||
+	    (Size != (POV_LONG)sizeof(INCLUDE_CACHE_HEADER) + (POV_LONG)(Header.Name_Length * sizeof(UCS2)) +
+	             Header.Number_Of_Tokens * (POV_LONG)sizeof(CACHED_TOKEN) + Header.Strings_Size))
+		return false;
+
+	if (Header.Name_Length > 0)
+	{
+		Name.resize(Header.Name_Length);
+
+		if (!file->read(&Name[0], Header.Name_Length * sizeof(UCS2)) || (filename.compare(0, UCS2String::npos, &Name[0], Name.size()) != 0))
+			return false;
+	}
+
+	Tokens->Max_Tokens  = (int)Header.Number_Of_Tokens;
+	Tokens->Max_Strings = (size_t)Header.Strings_Size;
+
+	if (Tokens->Max_Tokens > 0)
+		Tokens->Tokens = (CACHED_TOKEN *)POV_MALLOC(Tokens->Max_Tokens * sizeof(CACHED_TOKEN), "token cache");
+	if (Tokens->Max_Strings > 0)
+		Tokens->Strings = (char *)POV_MALLOC(Tokens->Max_Strings, "token cache strings");
+
+	if (((Tokens->Max_Tokens > 0) && !file->read(Tokens->Tokens, Tokens->Max_Tokens * sizeof(CACHED_TOKEN))) ||
+	    ((Tokens->Max_Strings > 0) && !file->read(Tokens->Strings, Tokens->Max_Strings)) ||
+	    ((Tokens->Max_Strings > 0) && (Tokens->Strings[Tokens->Max_Strings - 1] != '\0')))
+		return false;
+
+	for (int i = 0; i < Tokens->Max_Tokens; i++)
+	{
+		const CACHED_TOKEN *Cached = &Tokens->Tokens[i];
+
+		if ((Cached->Token_Id < 0) || (Cached->Token_Id >= LAST_TOKEN) ||
+		    (Cached->Reserved_Id < 0) || (Cached->Reserved_Id >= LAST_TOKEN) ||
+		    (Cached->String_Offset >= Tokens->Max_Strings))
+			return false;
+	}
+
+	Tokens->Number_Of_Tokens = Tokens->Max_Tokens;
+	Tokens->Strings_Size     = Tokens->Max_Strings;
+
+	return true;
+}
+
+
+
+/*****************************************************************************
+*
+* FUNCTION
+*
+*   Write_Include_Cache
+*
+* INPUT
+*
+*   Tokens - Token cache holding all tokens of an include file
+*
+* OUTPUT
+*
+* RETURNS
+*
+* AUTHOR
+*
+* DESCRIPTION
+*
+*   Write the include cache file of a token cache once the end of its
+*   include file has been reached. Failing to write the file only causes
+*   a warning.
+*
+* CHANGES
+*
+******************************************************************************/
+
+void Parser::Write_Include_Cache(TOKEN_CACHE *Tokens)
+{
+	INCLUDE_CACHE_HEADER Header;
+	OStream *file = NULL;
+	UCS2String Cache_Name(Tokens->Cache_File);
+
+	POV_FREE(Tokens->Cache_File);
+	Tokens->Cache_File = NULL;
+
+	init_cache_header(&Header);
+
+	Header.Name_Length      = UCS2_strlen(Tokens->Name);
+	Header.Source_Size      = Tokens->Source_Size;
+	Header.Source_Time      = Tokens->Source_Time;
+	Header.Number_Of_Tokens = Tokens->Number_Of_Tokens;
+	Header.Strings_Size     = Tokens->Strings_Size;
+
+	try
+	{
+		file = sceneData->CreateFile(GetPOVMSContext(), Cache_Name, POV_File_Unknown, false);
+	}
+	catch (pov_base::Exception&)
+	{
+		file = NULL;
+	}
+
+	if (file != NULL)
+	{
+		file->write(&Header, sizeof(INCLUDE_CACHE_HEADER));
+		file->write(Tokens->Name, Header.Name_Length * sizeof(UCS2));
+		if (Tokens->Number_Of_Tokens > 0)
+			file->write(Tokens->Tokens, Tokens->Number_Of_Tokens * sizeof(CACHED_TOKEN));
+		if (Tokens->Strings_Size > 0)
+			file->write(Tokens->Strings, Tokens->Strings_Size);
+
+		if (*file)
+		{
+			delete file;
+			return;
+		}
+
+		delete file;
+	}
+
+	Warning(0, "Cannot write include cache file '%s'.", UCS2toASCIIString(Cache_Name).c_str());
+}
+
+
+
+/*****************************************************************************
+*
+* FUNCTION
+*
+*   hash_bytes
+*
+* INPUT
+*
+*   Hash - Hash of the preceding data
+*   Data - Data to hash
+*   Size - Size of the data
+*
+* OUTPUT
+*
+* RETURNS
+*
+*   unsigned int - Hash of the preceding data followed by the given data
+*
+* AUTHOR
+*
+* DESCRIPTION
+*
+*   32 bit FNV-1a hash; start with 2166136261.
+*
+* CHANGES
+*
+******************************************************************************/
+
+static unsigned int hash_bytes(unsigned int Hash, const void *Data, size_t Size)
+{
+	const unsigned char *p = (const unsigned char *)Data;
+
+	while (Size-- > 0)
+		Hash = (Hash ^ *p++) * 16777619u;
+
+	return Hash;
+}
+
+
+
+/*****************************************************************************
+*
+* FUNCTION
+*
+*   reserved_words_checksum
+*
+* INPUT
+*
+* OUTPUT
+*
+* RETURNS
+*
+*   unsigned int - Hash of all reserved words and their token numbers
+*
+* AUTHOR
+*
+* DESCRIPTION
+*
+*   Cached tokens store the token numbers of punctuation and reserved words,
+*   which change whenever a reserved word is added; the checksum rejects
+*   cache files written by a build with a different reserved word table.
+*
+* CHANGES
+*
+******************************************************************************/
+
+static unsigned int reserved_words_checksum()
+{
+	static unsigned int Checksum = 0;
+
+	if (Checksum == 0)
+	{
+		unsigned int Hash = 2166136261u;
+
+		for (int i = 0; (i < LAST_TOKEN) && (Reserved_Words[i].Token_Name != NULL); i++)
+		{
+			Hash = hash_bytes(Hash, &Reserved_Words[i].Token_Number, sizeof(TOKEN));
+			Hash = hash_bytes(Hash, Reserved_Words[i].Token_Name, strlen(Reserved_Words[i].Token_Name) + 1);
+		}
+
+		Checksum = Hash;
+	}
+
+	return Checksum;
+}
+
+
+
+/*****************************************************************************
+*
+* FUNCTION
+*
+*   include_cache_name
+*
+* INPUT
+*
+*   Directory - Directory holding the include cache files
+*   filename  - Full name of the include file
+*
+* OUTPUT
+*
+* RETURNS
+*
+*   UCS2String - Name of the include cache file
+*
+* AUTHOR
+*
+* DESCRIPTION
+*
+*   The cache file is named "file.inc.xxxxxxxx.tok", where xxxxxxxx is a hash
+*   of the full name of the include file, so that include files of the same
+*   name in different directories get different cache files.
+*
+* CHANGES
+*
+******************************************************************************/
+
+static UCS2String include_cache_name(const UCS2String& Directory, const UCS2String& filename)
+{
+	UCS2String Name(Directory);
+	char Suffix[16];
+
+	sprintf(Suffix, ".%08x.tok", hash_bytes(2166136261u, filename.data(), filename.length() * sizeof(UCS2)));
+
+	if ((Name[Name.length() - 1] != POV_FILE_SEPARATOR) && (Name[Name.length() - 1] != '/'))
+		Name += POV_FILE_SEPARATOR;
+
+	Name += Path(filename).GetFile();
+	Name += ASCIItoUCS2String(Suffix);
+
+	return Name;
+}
+
+
+
+/*****************************************************************************
+*
+* FUNCTION
+*
+*   init_cache_header
+*
+* INPUT
+*
+*   Header - Header to initialise
+*
+* OUTPUT
+*
+*   Header
+*
+* RETURNS
+*
+* AUTHOR
+*
+* DESCRIPTION
+*
+*   Clear a header and fill in the fields identifying the build.
+*
+* CHANGES
+*
+******************************************************************************/
+
+static void init_cache_header(INCLUDE_CACHE_HEADER *Header)
+{
+	memset(Header, 0, sizeof(INCLUDE_CACHE_HEADER));
+
+	memcpy(Header->Magic, INCLUDE_CACHE_MAGIC, sizeof(Header->Magic));
+
+	Header->Version        = INCLUDE_CACHE_VERSION;
+	Header->Byte_Order     = INCLUDE_CACHE_BYTE_ORDER;
+	Header->Token_Size     = sizeof(Parser::CACHED_TOKEN);
+	Header->Last_Token     = LAST_TOKEN;
+	Header->Reserved_Words = reserved_words_checksum();
+}
+
+}
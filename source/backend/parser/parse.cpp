@@ -115,6 +115,7 @@
 #include "backend/texture/pigment.h"
 #include "backend/support/octree.h"
 #include "backend/support/imageutil.h"
+#include "backend/support/fileutil.h"
 #include "backend/vm/fnpovfpu.h"
 #include "backend/shape/blob.h"
 #include "backend/shape/boxes.h"
@@ -128,6 +129,7 @@
 #include "backend/shape/lathe.h"
 #include "backend/shape/ovus.h"
 #include "backend/shape/mesh.h"
+#include "backend/shape/meshcache.h"
 #include "backend/shape/planes.h"
 #include "backend/shape/polygon.h"
 #include "backend/shape/poly.h"
@@ -259,6 +261,9 @@ void Parser::Run()
 
 		Parse_Frame();
 
+		if (sceneData->parserProfile != NULL)
+			Finish_Profile();
+
 #if 0 // [CLi] Dist_Max is completely obsolete
 		// init misc radiosity stuff
 		if(sceneData->parsedRadiositySettings.Dist_Max == 0.0)
@@ -294,10 +299,10 @@ void Parser::Run()
 			{
 				// take a (local) copy of error location prior to freeing token data
 				// NB error_filename has been pre-allocated for strings up to _MAX_PATH
-				error_filename = Token.FileHandle->name();
+				error_filename = Token.FileHandle->Name;
 				error_line = Token.Token_File_Pos.lineno;
 				error_col = Token.Token_Col_No;
-				error_pos = Token.FileHandle->tellg().offset;
+				error_pos = Token.Token_File_Pos.offset;
 			}
 
 			// free up some memory before proceeding with error notification.
@@ -502,6 +507,75 @@ void Parser::Run()
 	}
 }
 
+/*****************************************************************************
+*
+* FUNCTION
+*
+*   Finish_Profile
+*
+* INPUT
+*
+* OUTPUT
+*
+* RETURNS
+*
+* AUTHOR
+*
+* DESCRIPTION
+*
+*   Close the parser profile once the scene has been parsed, and write it to
+*   the parser profile file, if any, as comma separated values. The profile
+*   itself is sent to the frontend along with the parser statistics.
+*
+* CHANGES
+*
+******************************************************************************/
+
+static string csv_string(const string& s)
+{
+	string result("\"");
+
+	for (string::const_iterator i(s.begin()); i != s.end(); i++)
+	{
+		if (*i == '"')
+			result += '"';
+		result += *i;
+	}
+
+	return result + "\"";
+}
+
+void Parser::Finish_Profile()
+{
+	static const char *Kind_Names[] = { "file", "macro", "loop" };
+	ParserProfile *Profile = sceneData->parserProfile;
+
+	Profile->Leave(0, Profile_Counters());
+	Include_Files[0].Profile_Frame = -1;
+
+	Profile->Sort();
+
+	if (sceneData->parserProfileFile.empty())
+		return;
+
+	OStream *file = sceneData->CreateFile(GetPOVMSContext(), sceneData->parserProfileFile, POV_File_Text_CSV, false);
+	if (file == NULL)
+	{
+		Warning(0, "Cannot open parser profile file %s.", UCS2toASCIIString(sceneData->parserProfileFile).c_str());
+		return;
+	}
+
+	OTextStream out(sceneData->parserProfileFile.c_str(), file);
+
+	out.printf("kind,name,file,line,calls,iterations,total_usec,self_usec,tokens,lookups,allocations\n");
+
+	for (vector<ParserProfile::Site>::const_iterator i(Profile->GetSites().begin()); i != Profile->GetSites().end(); i++)
+		out.printf("%s,%s,%s,%ld,%ld,%ld,%ld,%ld,%ld,%ld,%ld\n", Kind_Names[i->kind],
+		           csv_string(i->name).c_str(), csv_string(i->file).c_str(), long(i->line),
+		           long(i->calls), long(i->iterations), long(i->totalTime), long(i->selfTime),
+		           long(i->self.tokens), long(i->self.lookups), long(i->self.allocations));
+}
+
 void Parser::Cleanup()
 {
 	sceneData->functionVM->DeleteContext(fnVMContext);
@@ -1293,12 +1367,15 @@ void Parser::Parse_Mesh_Camera (Camera& Cam)
 		Mesh_Triangle_Struct *tr(mesh->Data->Triangles);
 		for (int i = 0, idx = 0, bit = 1; i < mesh->Data->Number_Of_Triangles; i++, tr++)
 		{
-			int P1u(mesh->Data->UVCoords[tr->UV1][U] * 10);
-			int P2u(mesh->Data->UVCoords[tr->UV2][U] * 10);
-			int P3u(mesh->Data->UVCoords[tr->UV3][U] * 10);
-			int P1v(mesh->Data->UVCoords[tr->UV1][V] * 10);
-			int P2v(mesh->Data->UVCoords[tr->UV2][V] * 10);
-			int P3v(mesh->Data->UVCoords[tr->UV3][V] * 10);
+			UV_VECT UV1, UV2, UV3;
+			mesh->get_triangle_uvcoords(tr, UV1, UV2, UV3);
+
+			int P1u(UV1[U] * 10);
+			int P2u(UV2[U] * 10);
+			int P3u(UV3[U] * 10);
+			int P1v(UV1[V] * 10);
+			int P2v(UV2[V] * 10);
+			int P3v(UV3[V] * 10);
 
 			int minU = min(min(P1u, min(P2u, P3u)), 9);
 			int minV = min(min(P1v, min(P2v, P3v)), 9);
@@ -3594,6 +3671,7 @@ ObjectPtr Parser::Parse_Mesh()
 	UV_VECT *UVCoords;
 	Mesh *Object;
 	MESH_TRIANGLE *Triangles;
+	int *UVIndices, *TextureIndices;
 	int fully_textured=true;
 	/* NK 1998 */
 	VECTOR Inside_Vect;
@@ -3627,6 +3705,10 @@ ObjectPtr Parser::Parse_Mesh()
 
 	Triangles = (MESH_TRIANGLE *)POV_MALLOC(max_triangles*sizeof(MESH_TRIANGLE), "temporary triangle mesh data");
 
+	UVIndices = (int *)POV_MALLOC(3*max_triangles*sizeof(int), "temporary triangle mesh data");
+
+	TextureIndices = (int *)POV_MALLOC(3*max_triangles*sizeof(int), "temporary triangle mesh data");
+
 	Vertices = (SNGL_VECT *)POV_MALLOC(max_vertices*sizeof(SNGL_VECT), "temporary triangle mesh data");
 
 	/* Read raw triangle file. */
@@ -3667,6 +3749,8 @@ ObjectPtr Parser::Parse_Mesh()
 					max_triangles *= 2;
 
 					Triangles = (MESH_TRIANGLE *)POV_REALLOC(Triangles, max_triangles*sizeof(MESH_TRIANGLE), "triangle triangle mesh data");
+					UVIndices = (int *)POV_REALLOC(UVIndices, 3*max_triangles*sizeof(int), "triangle triangle mesh data");
+					TextureIndices = (int *)POV_REALLOC(TextureIndices, 3*max_triangles*sizeof(int), "triangle triangle mesh data");
 				}
 
 				/* Init triangle. */
@@ -3679,25 +3763,25 @@ ObjectPtr Parser::Parse_Mesh()
 
 				/* NK 1998 */
 				Parse_Three_UVCoords(UV1,UV2,UV3);
-				Triangles[number_of_triangles].UV1 = Object->Mesh_Hash_UV(&number_of_uvcoords, &max_uvcoords, &UVCoords,UV1);
-				Triangles[number_of_triangles].UV2 = Object->Mesh_Hash_UV(&number_of_uvcoords, &max_uvcoords, &UVCoords,UV2);
-				Triangles[number_of_triangles].UV3 = Object->Mesh_Hash_UV(&number_of_uvcoords, &max_uvcoords, &UVCoords,UV3);
+				UVIndices[3*number_of_triangles]   = Object->Mesh_Hash_UV(&number_of_uvcoords, &max_uvcoords, &UVCoords,UV1);
+				UVIndices[3*number_of_triangles+1] = Object->Mesh_Hash_UV(&number_of_uvcoords, &max_uvcoords, &UVCoords,UV2);
+				UVIndices[3*number_of_triangles+2] = Object->Mesh_Hash_UV(&number_of_uvcoords, &max_uvcoords, &UVCoords,UV3);
 				/* NK ---- */
 
 				/* NK */
 				/* read possibly three instead of only one texture */
 				/* read these before compute!!! */
 				t2 = t3 = NULL;
-				Triangles[number_of_triangles].Texture = Object->Mesh_Hash_Texture(&number_of_textures, &max_textures, &Textures, Parse_Mesh_Texture(&t2,&t3));
-				if (t2) Triangles[number_of_triangles].Texture2 = Object->Mesh_Hash_Texture(&number_of_textures, &max_textures, &Textures, t2);
-				if (t3) Triangles[number_of_triangles].Texture3 = Object->Mesh_Hash_Texture(&number_of_textures, &max_textures, &Textures, t3);
+				TextureIndices[3*number_of_triangles] = Object->Mesh_Hash_Texture(&number_of_textures, &max_textures, &Textures, Parse_Mesh_Texture(&t2,&t3));
+				TextureIndices[3*number_of_triangles+1] = t2 ? Object->Mesh_Hash_Texture(&number_of_textures, &max_textures, &Textures, t2) : -1;
+				TextureIndices[3*number_of_triangles+2] = t3 ? Object->Mesh_Hash_Texture(&number_of_textures, &max_textures, &Textures, t3) : -1;
 				if (t2 || t3) Triangles[number_of_triangles].ThreeTex = true;
 
-				Object->Compute_Mesh_Triangle(&Triangles[number_of_triangles], false, P1, P2, P3, N);
+				Object->Compute_Mesh_Triangle(&Triangles[number_of_triangles], &UVIndices[3*number_of_triangles], &TextureIndices[3*number_of_triangles], false, P1, P2, P3, N);
 
 				Triangles[number_of_triangles].Normal_Ind = Object->Mesh_Hash_Normal(&number_of_normals, &max_normals, &Normals, N);
 
-				if(Triangles[number_of_triangles].Texture < 0)
+				if(TextureIndices[3*number_of_triangles] < 0)
 					fully_textured = false;
 
 				number_of_triangles++;
@@ -3763,6 +3847,8 @@ ObjectPtr Parser::Parse_Mesh()
 					max_triangles *= 2;
 
 					Triangles = (MESH_TRIANGLE *)POV_REALLOC(Triangles, max_triangles*sizeof(MESH_TRIANGLE), "triangle triangle mesh data");
+					UVIndices = (int *)POV_REALLOC(UVIndices, 3*max_triangles*sizeof(int), "triangle triangle mesh data");
+					TextureIndices = (int *)POV_REALLOC(TextureIndices, 3*max_triangles*sizeof(int), "triangle triangle mesh data");
 				}
 
 				VInverseScaleEq(N1, l1);
@@ -3787,38 +3873,38 @@ ObjectPtr Parser::Parse_Mesh()
 
 				/* NK 1998 */
 				Parse_Three_UVCoords(UV1,UV2,UV3);
-				Triangles[number_of_triangles].UV1 = Object->Mesh_Hash_UV(&number_of_uvcoords, &max_uvcoords, &UVCoords,UV1);
-				Triangles[number_of_triangles].UV2 = Object->Mesh_Hash_UV(&number_of_uvcoords, &max_uvcoords, &UVCoords,UV2);
-				Triangles[number_of_triangles].UV3 = Object->Mesh_Hash_UV(&number_of_uvcoords, &max_uvcoords, &UVCoords,UV3);
+				UVIndices[3*number_of_triangles]   = Object->Mesh_Hash_UV(&number_of_uvcoords, &max_uvcoords, &UVCoords,UV1);
+				UVIndices[3*number_of_triangles+1] = Object->Mesh_Hash_UV(&number_of_uvcoords, &max_uvcoords, &UVCoords,UV2);
+				UVIndices[3*number_of_triangles+2] = Object->Mesh_Hash_UV(&number_of_uvcoords, &max_uvcoords, &UVCoords,UV3);
 
 				/* read possibly three instead of only one texture */
 				/* read these before compute!!! */
 				t2 = t3 = NULL;
-				Triangles[number_of_triangles].Texture = Object->Mesh_Hash_Texture(&number_of_textures, &max_textures, &Textures, Parse_Mesh_Texture(&t2,&t3));
-				if (t2) Triangles[number_of_triangles].Texture2 = Object->Mesh_Hash_Texture(&number_of_textures, &max_textures, &Textures, t2);
-				if (t3) Triangles[number_of_triangles].Texture3 = Object->Mesh_Hash_Texture(&number_of_textures, &max_textures, &Textures, t3);
+				TextureIndices[3*number_of_triangles] = Object->Mesh_Hash_Texture(&number_of_textures, &max_textures, &Textures, Parse_Mesh_Texture(&t2,&t3));
+				TextureIndices[3*number_of_triangles+1] = t2 ? Object->Mesh_Hash_Texture(&number_of_textures, &max_textures, &Textures, t2) : -1;
+				TextureIndices[3*number_of_triangles+2] = t3 ? Object->Mesh_Hash_Texture(&number_of_textures, &max_textures, &Textures, t3) : -1;
 				if (t2 || t3) Triangles[number_of_triangles].ThreeTex = true;
 
 				if ((fabs(l1) > EPSILON) || (fabs(l2) > EPSILON))
 				{
 					/* Smooth triangle. */
 
-					Triangles[number_of_triangles].N1 = Object->Mesh_Hash_Normal(&number_of_normals, &max_normals, &Normals, N1);
-					Triangles[number_of_triangles].N2 = Object->Mesh_Hash_Normal(&number_of_normals, &max_normals, &Normals, N2);
-					Triangles[number_of_triangles].N3 = Object->Mesh_Hash_Normal(&number_of_normals, &max_normals, &Normals, N3);
+					Triangles[number_of_triangles].N1 = Mesh::Encode_Mesh_Normal(N1);
+					Triangles[number_of_triangles].N2 = Mesh::Encode_Mesh_Normal(N2);
+					Triangles[number_of_triangles].N3 = Mesh::Encode_Mesh_Normal(N3);
 
-					Object->Compute_Mesh_Triangle(&Triangles[number_of_triangles], true, P1, P2, P3, N);
+					Object->Compute_Mesh_Triangle(&Triangles[number_of_triangles], &UVIndices[3*number_of_triangles], &TextureIndices[3*number_of_triangles], true, P1, P2, P3, N);
 				}
 				else
 				{
 					/* Flat triangle. */
 
-					Object->Compute_Mesh_Triangle(&Triangles[number_of_triangles], false, P1, P2, P3, N);
+					Object->Compute_Mesh_Triangle(&Triangles[number_of_triangles], &UVIndices[3*number_of_triangles], &TextureIndices[3*number_of_triangles], false, P1, P2, P3, N);
 				}
 
 				Triangles[number_of_triangles].Normal_Ind = Object->Mesh_Hash_Normal(&number_of_normals, &max_normals, &Normals, N);
 
-				if (Triangles[number_of_triangles].Texture < 0)
+				if (TextureIndices[3*number_of_triangles] < 0)
 				{
 					fully_textured = false;
 				}
@@ -3871,6 +3957,7 @@ ObjectPtr Parser::Parse_Mesh()
 	Object->Data->References = 1;
 
 	Object->Data->Tree = NULL;
+	Object->Data->Cache = NULL;
 	/* NK 1998 */
 
 	if( (fabs(Inside_Vect[X]) < EPSILON) &&  (fabs(Inside_Vect[Y]) < EPSILON) &&  (fabs(Inside_Vect[Z]) < EPSILON))
@@ -3944,6 +4031,10 @@ ObjectPtr Parser::Parse_Mesh()
 		Object->Data->Triangles[i] = Triangles[i];
 	}
 
+	/* The index arrays are taken over or freed here. */
+
+	Object->Pack_Mesh_Indices(UVIndices, false, TextureIndices);
+
 	for (i = 0; i < number_of_vertices; i++)
 	{
 		Assign_Vector(Object->Data->Vertices[i], Vertices[i]);
@@ -3968,17 +4059,8 @@ ObjectPtr Parser::Parse_Mesh()
 	POV_FREE(Triangles);
 	POV_FREE(Vertices);
 
-/*
-	Render_Info("Mesh: %ld bytes: %ld vertices, %ld normals, %ld textures, %ld triangles\n",
-		Object->Data->Number_Of_Normals*sizeof(SNGL_VECT)+
-		Object->Number_Of_Textures*sizeof(TEXTURE *)+
-		Object->Data->Number_Of_Triangles*sizeof(MESH_TRIANGLE)+
-		Object->Data->Number_Of_Vertices*sizeof(SNGL_VECT),
-		Object->Data->Number_Of_Vertices,
-		Object->Data->Number_Of_Normals,
-		Object->Number_Of_Textures,
-		Object->Data->Number_Of_Triangles);
-*/
+	sceneData->meshTriangles += Object->Data->Number_Of_Triangles;
+	sceneData->meshMemory += Object->Mesh_Data_Size();
 
 	/* Create bounding box. */
 
@@ -4040,11 +4122,16 @@ ObjectPtr Parser::Parse_Mesh2()
 
 	UV_VECT UV1;
 	SNGL_VECT *Normals = NULL;
+	SNGL_VECT *FaceNormals;
 	SNGL_VECT *Vertices = NULL;
 	TEXTURE **Textures = NULL;
 	UV_VECT *UVCoords = NULL;
 	Mesh *Object;
 	MESH_TRIANGLE *Triangles;
+	int *UVIndices = NULL;
+	int *NormalIndices = NULL;
+	int *TextureIndices;
+	char *Cache_File = NULL;
 
 	Make_Vector(Inside_Vect, 0, 0, 0);
 
@@ -4056,6 +4143,17 @@ ObjectPtr Parser::Parse_Mesh2()
 	/* Create object. */
 	Object = new Mesh();
 
+	/* A cache file replaces all of the data sections. */
+	EXPECT_ONE
+		CASE(CACHE_FILE_TOKEN)
+			return Parse_Mesh2_Cache(Object);
+		END_CASE
+
+		OTHERWISE
+			UNGET
+		END_CASE
+	END_EXPECT
+
 	/* normals, uvcoords, and textures are optional */
 	number_of_vertices = 0;
 	number_of_uvcoords = 0;
@@ -4139,30 +4237,7 @@ ObjectPtr Parser::Parse_Mesh2()
 
 	EXPECT*/
 		CASE(TEXTURE_LIST_TOKEN)
-			Parse_Begin();
-
-			number_of_textures = (int)Parse_Float();  Parse_Comma();
-
-			if (number_of_textures>0)
-			{
-				Textures = (TEXTURE **)POV_MALLOC(number_of_textures*sizeof(TEXTURE *), "triangle mesh data");
-
-				for(i=0; i<number_of_textures; i++)
-				{
-					/*
-					GET(TEXTURE_ID_TOKEN)
-					Textures[i] = Copy_Texture_Pointer((TEXTURE *)Token.Data);
-					*/
-					GET(TEXTURE_TOKEN);
-					Parse_Begin();
-					Textures[i] = Parse_Texture();
-					Post_Textures(Textures[i]);
-					Parse_End();
-					Parse_Comma();
-				}
-			}
-
-			Parse_End();
+			number_of_textures = Parse_Mesh_Texture_List(&Textures);
 			EXIT
 		END_CASE
 
@@ -4199,6 +4274,7 @@ ObjectPtr Parser::Parse_Mesh2()
 
 	/* allocate memory for triangles */
 	Triangles = (MESH_TRIANGLE *)POV_MALLOC(number_of_triangles*sizeof(MESH_TRIANGLE), "triangle mesh data");
+	TextureIndices = (int *)POV_MALLOC(3*number_of_triangles*sizeof(int), "temporary triangle mesh data");
 
 	/* start reading triangles */
 
@@ -4231,15 +4307,15 @@ ObjectPtr Parser::Parse_Mesh2()
 		/* look for a texture index */
 		EXPECT
 			CASE_FLOAT
-				Triangles[i].Texture = Parse_Float(); Parse_Comma();
-				if (Triangles[i].Texture >= number_of_textures ||
-				    Triangles[i].Texture < 0)
+				TextureIndices[3*i] = (int)Parse_Float(); Parse_Comma();
+				if (TextureIndices[3*i] >= number_of_textures ||
+				    TextureIndices[3*i] < 0)
 					Error("Texture index out of range in mesh2.");
 				EXIT
 			END_CASE
 
 			OTHERWISE
-				Triangles[i].Texture = -1;
+				TextureIndices[3*i] = -1;
 				fully_textured = false;
 				EXIT
 				UNGET
@@ -4248,15 +4324,15 @@ ObjectPtr Parser::Parse_Mesh2()
 		/* look for a texture index */
 		EXPECT
 			CASE_FLOAT
-				Triangles[i].Texture2 = Parse_Float(); Parse_Comma();
-				if (Triangles[i].Texture2 >= number_of_textures ||
-				    Triangles[i].Texture2 < 0)
+				TextureIndices[3*i+1] = (int)Parse_Float(); Parse_Comma();
+				if (TextureIndices[3*i+1] >= number_of_textures ||
+				    TextureIndices[3*i+1] < 0)
 					Error("Texture index out of range in mesh2.");
 				Triangles[i].ThreeTex = true;
 				EXIT
 			END_CASE
 			OTHERWISE
-				Triangles[i].Texture2 = -1;
+				TextureIndices[3*i+1] = -1;
 				EXIT
 				UNGET
 			END_CASE
@@ -4264,15 +4340,15 @@ ObjectPtr Parser::Parse_Mesh2()
 		/* look for a texture index */
 		EXPECT
 			CASE_FLOAT
-				Triangles[i].Texture3 = Parse_Float(); Parse_Comma();
-				if (Triangles[i].Texture3 >= number_of_textures ||
-				    Triangles[i].Texture3 < 0)
+				TextureIndices[3*i+2] = (int)Parse_Float(); Parse_Comma();
+				if (TextureIndices[3*i+2] >= number_of_textures ||
+				    TextureIndices[3*i+2] < 0)
 					Error("Texture index out of range in mesh2.");
 				Triangles[i].ThreeTex = true;
 				EXIT
 			END_CASE
 			OTHERWISE
-				Triangles[i].Texture3 = -1;
+				TextureIndices[3*i+2] = -1;
 				EXIT
 				UNGET
 			END_CASE
@@ -4297,6 +4373,8 @@ ObjectPtr Parser::Parse_Mesh2()
 				Error("Number of uv indices must equal number of faces.");
 			Parse_Comma();
 
+			UVIndices = (int *)POV_MALLOC(3*number_of_triangles*sizeof(int), "temporary triangle mesh data");
+
 			for (i=0; i<number_of_triangles; i++)
 			{
 				/* read in the indices vector */
@@ -4316,9 +4394,9 @@ ObjectPtr Parser::Parse_Mesh2()
 				}
 
 				/* assign the uv coordinate */
-				Triangles[i].UV1 = a;
-				Triangles[i].UV2 = b;
-				Triangles[i].UV3 = c;
+				UVIndices[3*i]   = a;
+				UVIndices[3*i+1] = b;
+				UVIndices[3*i+2] = c;
 			}
 			Parse_End();
 			/*EXIT*/
@@ -4354,6 +4432,8 @@ ObjectPtr Parser::Parse_Mesh2()
 
 			Parse_Comma();
 
+			NormalIndices = (int *)POV_MALLOC(3*number_of_triangles*sizeof(int), "temporary triangle mesh data");
+
 			for (i=0; i<number_of_normal_indices; i++)
 			{
 				/* read in the indices vector */
@@ -4373,10 +4453,10 @@ ObjectPtr Parser::Parse_Mesh2()
 					Error("Mesh normal index out of range.");
 				}
 
-				/* assign the uv coordinate */
-				Triangles[i].N1 = a;
-				Triangles[i].N2 = b;
-				Triangles[i].N3 = c;
+				/* assign the normal indices */
+				NormalIndices[3*i]   = a;
+				NormalIndices[3*i+1] = b;
+				NormalIndices[3*i+2] = c;
 			}
 			Parse_End();
 			/*EXIT*/
@@ -4396,6 +4476,14 @@ ObjectPtr Parser::Parse_Mesh2()
 			Parse_Vector(Inside_Vect);
 		END_CASE
 
+		CASE(CACHE_FILE_TOKEN)
+			if (Cache_File != NULL)
+			{
+				Error("Only one cache_file is allowed in mesh2");
+			}
+			Cache_File = Parse_C_String(true);
+		END_CASE
+
 		OTHERWISE
 			UNGET
 			EXIT
@@ -4405,27 +4493,11 @@ ObjectPtr Parser::Parse_Mesh2()
 	if (fully_textured)
 		Object->Type |= TEXTURED_OBJECT;
 
+	/* without uv_indices the uv coordinates either follow the vertices or
+	   there is only one; neither needs indices to be stored per triangle */
 	if (!found_uv_indices)
 	{
-		if (number_of_uvcoords==number_of_vertices)
-		{
-			for (i=0; i<number_of_triangles; i++)
-			{
-				Triangles[i].UV1 = Triangles[i].P1;
-				Triangles[i].UV2 = Triangles[i].P2;
-				Triangles[i].UV3 = Triangles[i].P3;
-			}
-		}
-		else if (number_of_uvcoords==1)
-		{
-			for (i=0; i<number_of_triangles; i++)
-			{
-				Triangles[i].UV1 = 0;
-				Triangles[i].UV2 = 0;
-				Triangles[i].UV3 = 0;
-			}
-		}
-		else
+		if ((number_of_uvcoords!=number_of_vertices) && (number_of_uvcoords!=1))
 		{
 			Error("Missing uv_indicies section in mesh2.");
 		}
@@ -4441,13 +4513,6 @@ ObjectPtr Parser::Parse_Mesh2()
 			   So, we pretend that we read in some normal_indices
 			*/
 			number_of_normal_indices = number_of_triangles;
-
-			for (i=0; i<number_of_triangles; i++)
-			{
-				Triangles[i].N1 = Triangles[i].P1;
-				Triangles[i].N2 = Triangles[i].P2;
-				Triangles[i].N3 = Triangles[i].P3;
-			}
 		}
 		else if (number_of_normals)
 		{
@@ -4457,20 +4522,28 @@ ObjectPtr Parser::Parse_Mesh2()
 
 	/* ---------------- Compute Triangle Normals ---------------- */
 
-	/* reallocate the normals stuff */
-	if (!number_of_normals)
-		Normals = (SNGL_VECT *)POV_MALLOC(number_of_triangles*sizeof(SNGL_VECT), "triangle mesh data");
-	else
-		Normals = (SNGL_VECT *)POV_REALLOC(Normals, (number_of_normals+number_of_triangles)*sizeof(SNGL_VECT), "triangle mesh data");
+	/* the mesh only keeps the face normals, the smooth normals are stored
+	   in encoded form with each triangle */
+	FaceNormals = (SNGL_VECT *)POV_MALLOC(number_of_triangles*sizeof(SNGL_VECT), "triangle mesh data");
 
 	for (i=0; i<number_of_triangles; i++)
 	{
-		a = (int) Triangles[i].P1;
-		b = (int) Triangles[i].P2;
-		c = (int) Triangles[i].P3;
-		n1 = (int) Triangles[i].N1;
-		n2 = (int) Triangles[i].N2;
-		n3 = (int) Triangles[i].N3;
+		a = Triangles[i].P1;
+		b = Triangles[i].P2;
+		c = Triangles[i].P3;
+
+		if (NormalIndices != NULL)
+		{
+			n1 = NormalIndices[3*i];
+			n2 = NormalIndices[3*i+1];
+			n3 = NormalIndices[3*i+2];
+		}
+		else
+		{
+			n1 = a;
+			n2 = b;
+			n3 = c;
+		}
 
 		Assign_Vector(P1, Vertices[a]);
 		Assign_Vector(P2, Vertices[b]);
@@ -4493,28 +4566,42 @@ ObjectPtr Parser::Parse_Mesh2()
 			if ((fabs(l1) > EPSILON) || (fabs(l2) > EPSILON))
 			{
 				/* Smooth triangle. */
-				Object->Compute_Mesh_Triangle(&Triangles[i], true, P1, P2, P3, N);
+				Assign_Vector(N1, Normals[n1]);
+				Triangles[i].N1 = Mesh::Encode_Mesh_Normal(N1);
+				Assign_Vector(N1, Normals[n2]);
+				Triangles[i].N2 = Mesh::Encode_Mesh_Normal(N1);
+				Assign_Vector(N1, Normals[n3]);
+				Triangles[i].N3 = Mesh::Encode_Mesh_Normal(N1);
+
+				Object->Compute_Mesh_Triangle(&Triangles[i], (UVIndices != NULL) ? &UVIndices[3*i] : NULL, &TextureIndices[3*i], true, P1, P2, P3, N);
 				Triangles[i].Smooth = true;
 			}
 			else
 			{
 				/* Flat triangle. */
-				Object->Compute_Mesh_Triangle(&Triangles[i], false, P1, P2, P3, N);
+				Object->Compute_Mesh_Triangle(&Triangles[i], (UVIndices != NULL) ? &UVIndices[3*i] : NULL, &TextureIndices[3*i], false, P1, P2, P3, N);
 			}
 		}
 		else
 		{
 			/* Flat triangle. */
-			Object->Compute_Mesh_Triangle(&Triangles[i], false, P1, P2, P3, N);
+			Object->Compute_Mesh_Triangle(&Triangles[i], (UVIndices != NULL) ? &UVIndices[3*i] : NULL, &TextureIndices[3*i], false, P1, P2, P3, N);
 		}
 
 		/* assign the triangle normal that we just computed */
-		Triangles[i].Normal_Ind = i+number_of_normals;
-		Assign_Vector(Normals[i+number_of_normals], N);
+		Triangles[i].Normal_Ind = i;
+		Assign_Vector(FaceNormals[i], N);
 	}
 
+	if (Normals != NULL)
+		POV_FREE(Normals);
+
+	if (NormalIndices != NULL)
+		POV_FREE(NormalIndices);
+
 	/* now remember how many normals we really have */
-	number_of_normals += number_of_triangles;
+	Normals = FaceNormals;
+	number_of_normals = number_of_triangles;
 
 	/* ----------------------------------------------------- */
 
@@ -4522,6 +4609,7 @@ ObjectPtr Parser::Parse_Mesh2()
 	Object->Data = (MESH_DATA *)POV_MALLOC(sizeof(MESH_DATA), "triangle mesh data");
 	Object->Data->References = 1;
 	Object->Data->Tree = NULL;
+	Object->Data->Cache = NULL;
 	/* NK 1998 */
 	/*YS* 31/12/1999 */
 
@@ -4553,6 +4641,9 @@ ObjectPtr Parser::Parse_Mesh2()
 	Object->Data->Number_Of_UVCoords  = number_of_uvcoords;
 	Object->Number_Of_Textures = number_of_textures;
 
+	/* The index arrays are taken over or freed here. */
+	Object->Pack_Mesh_Indices(UVIndices, (number_of_uvcoords == number_of_vertices), TextureIndices);
+
 	if (number_of_textures)
 	{
 		Set_Flag(Object, MULTITEXTURE_FLAG);
@@ -4567,22 +4658,201 @@ ObjectPtr Parser::Parse_Mesh2()
 	/* Create bounding box tree. */
 	Object->Build_Mesh_BBox_Tree();
 
-/*
-	Render_Info("Mesh2: %ld bytes: %ld vertices, %ld normals, %ld textures, %ld triangles\n",
-		Object->Data->Number_Of_Normals*sizeof(SNGL_VECT)+
-		Object->Number_Of_Textures*sizeof(TEXTURE *)+
-		Object->Data->Number_Of_Triangles*sizeof(MESH_TRIANGLE)+
-		Object->Data->Number_Of_Vertices*sizeof(SNGL_VECT),
-		Object->Data->Number_Of_Vertices,
-		Object->Data->Number_Of_Normals,
-		Object->Number_Of_Textures,
-		Object->Data->Number_Of_Triangles);
-*/
+	/* Store the parsed data for later renders. */
+	if (Cache_File != NULL)
+	{
+		OStream *file = sceneData->CreateFile(GetPOVMSContext(), ASCIItoUCS2String(Cache_File).c_str(), POV_File_Unknown, false);
+
+		if (file == NULL)
+			Error("Cannot open mesh cache file '%s' for writing.", Cache_File);
+
+		try
+		{
+			Write_Mesh_Cache(file, Object);
+		}
+		catch (pov_base::Exception& e)
+		{
+			delete file;
+			Error("%s (mesh cache file '%s')", e.what(), Cache_File);
+		}
+
+		delete file;
+
+		POV_FREE(Cache_File);
+	}
+
+	sceneData->meshTriangles += Object->Data->Number_Of_Triangles;
+	sceneData->meshMemory += Object->Mesh_Data_Size();
 
 	return((ObjectPtr )Object);
 }
 
 
+
+/*****************************************************************************
+*
+* FUNCTION
+*
+*   Parse_Mesh2_Cache
+*
+* INPUT
+*
+*   Object - Mesh without data
+*
+* OUTPUT
+*
+* RETURNS
+*
+*   OBJECT
+*
+* AUTHOR
+*
+* DESCRIPTION
+*
+*   Read the data of a mesh2 from a cache file written by an earlier render
+*   and parse the rest of the mesh2 statement:
+*
+*   mesh2 {
+*     cache_file "name"
+*     [ texture_list { ... } ]
+*     [ object modifiers ]
+*   }
+*
+*   The bounding box tree stored in the file is used unless the hierarchy
+*   is turned off; a file without a tree gets a new one.
+*
+* CHANGES
+*
+******************************************************************************/
+
+ObjectPtr Parser::Parse_Mesh2_Cache(Mesh *Object)
+{
+	char *Cache_File;
+	UCS2String Found_File;
+	IStream *file;
+
+	Cache_File = Parse_C_String(true);
+
+	file = Locate_File(this, sceneData, ASCIItoUCS2String(Cache_File), POV_File_Unknown, Found_File, true);
+
+	if (file == NULL)
+		Error("Cannot open mesh cache file '%s'.", Cache_File);
+
+	try
+	{
+		Read_Mesh_Cache(file, Found_File, Object);
+	}
+	catch (pov_base::Exception& e)
+	{
+		delete file;
+		Error("%s (mesh cache file '%s')", e.what(), Cache_File);
+	}
+
+	delete file;
+
+	EXPECT
+		CASE(TEXTURE_LIST_TOKEN)
+			Object->Number_Of_Textures = Parse_Mesh_Texture_List(&Object->Textures);
+			EXIT
+		END_CASE
+
+		OTHERWISE
+			UNGET
+			EXIT
+		END_CASE
+	END_EXPECT
+
+	if (Object->Number_Of_Textures < Object->Data->Cache->Number_Of_Textures)
+		Error("Mesh cache file '%s' needs a texture_list of %d textures.", Cache_File, Object->Data->Cache->Number_Of_Textures);
+
+	POV_FREE(Cache_File);
+
+	if (Object->Number_Of_Textures)
+	{
+		Set_Flag(Object, MULTITEXTURE_FLAG);
+	}
+
+	/* Create bounding box. */
+	Object->Compute_BBox();
+
+	/* Parse object modifiers. */
+	Parse_Object_Mods((ObjectPtr)Object);
+
+	/* Use the bounding box tree from the file. */
+	if (!Test_Flag(Object, HIERARCHY_FLAG))
+		Object->Data->Tree = NULL;
+	else if (Object->Data->Tree == NULL)
+		Object->Build_Mesh_BBox_Tree();
+
+	sceneData->meshTriangles += Object->Data->Number_Of_Triangles;
+	sceneData->meshMemory += Object->Mesh_Data_Size();
+
+	return((ObjectPtr )Object);
+}
+
+
+
+/*****************************************************************************
+*
+* FUNCTION
+*
+*   Parse_Mesh_Texture_List
+*
+* INPUT
+*
+* OUTPUT
+*
+*   Textures - Array of the textures, NULL if the list is empty
+*
+* RETURNS
+*
+*   int - Number of textures
+*
+* AUTHOR
+*
+* DESCRIPTION
+*
+*   Parse the body of a mesh2 texture_list.
+*
+* CHANGES
+*
+******************************************************************************/
+
+int Parser::Parse_Mesh_Texture_List(TEXTURE ***Textures)
+{
+	int i, number_of_textures;
+
+	Parse_Begin();
+
+	number_of_textures = (int)Parse_Float();  Parse_Comma();
+
+	*Textures = NULL;
+
+	if (number_of_textures>0)
+	{
+		*Textures = (TEXTURE **)POV_MALLOC(number_of_textures*sizeof(TEXTURE *), "triangle mesh data");
+
+		for(i=0; i<number_of_textures; i++)
+		{
+			/*
+			GET(TEXTURE_ID_TOKEN)
+			(*Textures)[i] = Copy_Texture_Pointer((TEXTURE *)Token.Data);
+			*/
+			GET(TEXTURE_TOKEN);
+			Parse_Begin();
+			(*Textures)[i] = Parse_Texture();
+			Post_Textures((*Textures)[i]);
+			Parse_End();
+			Parse_Comma();
+		}
+	}
+
+	Parse_End();
+
+	return number_of_textures;
+}
+
+
 /*****************************************************************************
 *
 * FUNCTION
@@ -10187,7 +10457,7 @@ void Parser::Warning(unsigned int level, const char *format,...)
 	va_end(marker);
 
 	if(Token.FileHandle != NULL)
-		messageFactory.WarningAt(level, Token.FileHandle->name(), Token.Token_File_Pos.lineno, Token.Token_Col_No, Token.FileHandle->tellg().offset, "%s", localvsbuffer);
+		messageFactory.WarningAt(level, Token.FileHandle->Name, Token.Token_File_Pos.lineno, Token.Token_Col_No, Token.Token_File_Pos.offset, "%s", localvsbuffer);
 	else
 		messageFactory.Warning(level, "%s", localvsbuffer);
 }
@@ -10202,7 +10472,7 @@ void Parser::PossibleError(const char *format,...)
 	va_end(marker);
 
 	if(Token.FileHandle != NULL)
-		messageFactory.PossibleErrorAt(Token.FileHandle->name(), Token.Token_File_Pos.lineno, Token.Token_Col_No, Token.FileHandle->tellg().offset, "%s", localvsbuffer);
+		messageFactory.PossibleErrorAt(Token.FileHandle->Name, Token.Token_File_Pos.lineno, Token.Token_Col_No, Token.Token_File_Pos.offset, "%s", localvsbuffer);
 	else
 		messageFactory.PossibleError("%s", localvsbuffer);
 }
@@ -10217,7 +10487,7 @@ void Parser::Error(const char *format,...)
 	va_end(marker);
 
 	if(Token.FileHandle != NULL)
-		messageFactory.ErrorAt(POV_EXCEPTION(kParseErr, localvsbuffer), Token.FileHandle->name(), Token.Token_File_Pos.lineno, Token.Token_Col_No, Token.FileHandle->tellg().offset, "%s", localvsbuffer);
+		messageFactory.ErrorAt(POV_EXCEPTION(kParseErr, localvsbuffer), Token.FileHandle->Name, Token.Token_File_Pos.lineno, Token.Token_Col_No, Token.Token_File_Pos.offset, "%s", localvsbuffer);
 	else
 		messageFactory.Error(POV_EXCEPTION(kParseErr, localvsbuffer), "%s", localvsbuffer);
 }
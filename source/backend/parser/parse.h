@@ -220,6 +220,8 @@ enum
 * Global typedefs
 ******************************************************************************/
 
+class Mesh;
+
 class Parser : public Task
 {
 	public:
@@ -243,6 +245,39 @@ class Parser : public Task
 
 		// tokenize.h/tokenize.cpp
 
+		/// Structure holding a token as read from a scene or include file, prior to any identifier lookup
+		struct CACHED_TOKEN
+		{
+			pov_base::ITextStream::FilePos File_Pos;        ///< location just past the token in the scene or include file (line number & file position)
+			int Col_No;                                     ///< location of the token in the scene or include file (column)
+			TOKEN Token_Id;                                 ///< punctuation token ID, or one of FLOAT_TOKEN, STRING_LITERAL_TOKEN, HASH_TOKEN or IDENTIFIER_TOKEN
+			TOKEN Reserved_Id;                              ///< reserved word ID if the token is a keyword, IDENTIFIER_TOKEN otherwise
+			DBL Token_Float;                                ///< token value (if it is a float literal)
+			size_t String_Offset;                           ///< character sequence comprising the token, as an offset into the string pool
+		};
+
+		/// Structure holding the tokens recorded from a scene or include file, for replaying loop and macro bodies
+		struct TOKEN_CACHE
+		{
+			UCS2 *Name;                                     ///< name of the scene or include file
+			CACHED_TOKEN *Tokens;
+			int Number_Of_Tokens, Max_Tokens;
+			char *Strings;                                  ///< string pool holding the character sequences of all tokens
+			size_t Strings_Size, Max_Strings;
+			int Recording;                                  ///< number of loops and macro declarations currently being recorded
+			int References;
+			UCS2 *Cache_File;                               ///< include cache file to write once the whole file has been recorded, or NULL
+			POV_LONG Source_Size, Source_Time;              ///< size and modification time of the include file, as stored in the include cache file
+			TOKEN_CACHE *Next, *Prev;
+		};
+
+		/// Structure holding a position in a token cache
+		struct TOKEN_POS
+		{
+			TOKEN_CACHE *Tokens;                            ///< token cache, or NULL to denote reading from the input file itself
+			int Index;
+		};
+
 		/// Structure holding information about the current token
 		struct Token_Struct
 		{
@@ -254,7 +289,7 @@ class Parser : public Task
 			char *Token_String;                             ///< reference to token value (if it is a string literal) or character sequence comprising the token
 			DBL Token_Float;                                ///< token value (if it is a float literal)
 			int Unget_Token, End_Of_File;
-			pov_base::ITextStream *FileHandle;              ///< location of this token in the scene or include file (file)
+			TOKEN_CACHE *FileHandle;                        ///< location of this token in the scene or include file (file)
 			void *Data;                                     ///< reference to token value (if it is a non-float identifier)
 			int *NumberPtr;
 			void **DataPtr;
@@ -266,8 +301,7 @@ class Parser : public Task
 		struct POV_MACRO
 		{
 			char *Macro_Name;
-			UCS2 *Macro_Filename;
-			pov_base::ITextStream::FilePos Macro_File_Pos;
+			TOKEN_POS Macro_Start;
 			POV_LONG Macro_End;
 			int Num_Of_Pars;
 			char *Par_Name[MAX_PARAMETER_LIST];
@@ -532,6 +566,8 @@ class Parser : public Task
 
 		POV_LONG Current_Token_Count; // This variable really counts tokens! [trf]
 
+		POV_LONG Symbol_Lookups; // symbol table searches, for the parser profile
+
 		int token_count; // WARNING: This variable has very little to do with counting tokens! [trf]
 
 		int line_count;
@@ -540,11 +576,16 @@ class Parser : public Task
 		{
 			pov_base::ITextStream *In_File;
 			bool R_Flag;
+			TOKEN_CACHE *Tokens;                            ///< tokens recorded from In_File
+			TOKEN_CACHE *Replay;                            ///< token cache currently being replayed, or NULL when reading In_File
+			int Replay_Index;
+			int Profile_Frame;                              ///< parser profile frame of the file, or -1
 		};
 
 		int Include_File_Index;
 		InputFileData *Input_File;
 		InputFileData Include_Files[MAX_INCLUDE_FILES];
+		TOKEN_CACHE *Token_Caches;
 
 		int Echo_Indx;
 
@@ -552,13 +593,12 @@ class Parser : public Task
 		{
 			COND_TYPE Cond_Type;
 			DBL Switch_Value;
-			pov_base::ITextStream *Loop_File;
-			pov_base::ITextStream *Macro_File;
-			const UCS2 *Macro_Return_Name;
-			bool Macro_Same_Flag;
 			bool Switch_Case_Ok_Flag;
 			POV_MACRO *PMac;
-			pov_base::ITextStream::FilePos File_Pos;
+			TOKEN_POS Token_Pos;                            ///< start of a loop body, or return position of a macro
+			TOKEN_CACHE *Macro_Tokens;                      ///< token cache holding the body of an invoked macro
+			TOKEN_CACHE *Recording;                         ///< token cache recording the body of a loop or macro declaration
+			int Profile_Frame;                              ///< parser profile frame of an invoked macro or loop, or -1
 			char* Loop_Identifier;
 			DBL For_Loop_End;
 			DBL For_Loop_Step;
@@ -613,6 +653,8 @@ class Parser : public Task
 		ObjectPtr Parse_Triangle();
 		ObjectPtr Parse_Mesh();
 		ObjectPtr Parse_Mesh2();
+		ObjectPtr Parse_Mesh2_Cache(Mesh *Object);
+		int Parse_Mesh_Texture_List(TEXTURE ***Textures);
 		TEXTURE *Parse_Mesh_Texture(TEXTURE **t2, TEXTURE **t3);
 		ObjectPtr Parse_TrueType(void);
 		void Parse_Blob_Element_Mods(Blob_Element *Element);
@@ -621,6 +663,7 @@ class Parser : public Task
 		void Parse_Camera(Camera& Cam);
 		bool Parse_Camera_Mods(Camera& Cam);
 		void Parse_Frame();
+		void Finish_Profile();
 
 		void Link(ObjectPtr New_Object, vector<ObjectPtr>& Object_List_Root);
 		void Link_To_Frame(ObjectPtr Object);
@@ -653,12 +696,34 @@ class Parser : public Task
 		inline void End_String_Fast (void);
 		bool Read_Float (void);
 		void Read_Symbol (void);
+		void Process_Symbol (TOKEN Reserved_Id);
+		bool Subscript_Follows (void);
 		SYM_ENTRY *Find_Symbol (int Index, char *s);
 		void Skip_Tokens (COND_TYPE cond);
 		void Break (void);
 
 		int get_hash_value (char *s);
 		inline void Write_Token (TOKEN Token_Id, int col);
+		inline void Set_Token (TOKEN Token_Id, int col);
+		inline pov_base::ITextStream::FilePos Input_File_Pos (void);
+		TOKEN_CACHE *Open_Token_Cache (const UCS2 *Name);
+		void Release_Token_Cache (TOKEN_CACHE *Tokens);
+		void Destroy_Token_Cache (TOKEN_CACHE *Tokens);
+		inline void Cache_Token (TOKEN Token_Id, TOKEN Reserved_Id, int col);
+		void Record_Token (TOKEN Token_Id, TOKEN Reserved_Id, int col);
+		inline bool Replaying (void);
+		void Replay_Token (void);
+		void Mark_Token_Pos (TOKEN_POS& Pos);
+		void Stop_Token_Recording (void);
+		int Enter_Profile_Site (ParserProfile::SiteKind kind, const char *name, const UCS2 *file, POV_LONG line);
+		void Leave_Profile_Site (int& Frame);
+		ParserProfile::Counters Profile_Counters (void);
+
+		// includecache.h/includecache.cpp
+
+		void Open_Include_Cache (const UCS2String& filename);
+		bool Read_Include_Cache (IStream *file, const UCS2String& filename);
+		void Write_Include_Cache (TOKEN_CACHE *Tokens);
 		void Destroy_Table (int index);
 		void init_sym_tables (void);
 		void Add_Sym_Table ();
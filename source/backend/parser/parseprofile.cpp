@@ -0,0 +1,219 @@
+/*******************************************************************************
+ * parseprofile.cpp
+ *
+ * This module collects the parser profile of a scene.
+ *
+ * from Persistence of Vision Ray Tracer ('POV-Ray') version 3.7.
+ * Copyright 1991-2003 Persistence of Vision Team
+ * Copyright 2003-2009 Persistence of Vision Raytracer Pty. Ltd.
+ * ---------------------------------------------------------------------------
+ * NOTICE: This source code file is provided so that users may experiment
+ * with enhancements to POV-Ray and to port the software to platforms other
+ * than those supported by the POV-Ray developers. There are strict rules
+ * regarding how you are permitted to use this file. These rules are contained
+ * in the distribution and derivative versions licenses which should have been
+ * provided with this file.
+ *
+ * These licences may be found online, linked from the end-user license
+ * agreement that is located at http://www.povray.org/povlegal.html
+ * ---------------------------------------------------------------------------
+ * POV-Ray is based on the popular DKB raytracer version 2.12.
+ * DKBTrace was originally written by David K. Buck.
+ * DKBTrace Ver 2.0-2.12 were written by David K. Buck & Aaron A. Collins.
+ * ---------------------------------------------------------------------------
+ * $File: //depot/povray/smp/source/backend/parser/parseprofile.cpp $
+ * $Revision: #1 $
+ * $Change: 5401 $
+ * $DateTime: 2011/02/08 21:06:55 $
+ * $Author: clipka $
+ *******************************************************************************/
+
+/*********************************************************************************
+ * NOTICE
+ *
+ * This file is part of a BETA-TEST version of POV-Ray version 3.7. It is not
+ * final code. Use of this source file is governed by both the standard POV-Ray
+ * licences referred to in the copyright header block above this notice, and the
+ * following additional restrictions numbered 1 through 4 below:
+ *
+ *   1. This source file may not be re-distributed without the written permission
+ *      of Persistence of Vision Raytracer Pty. Ltd.
+ *
+ *   2. This notice may not be altered or removed.
+ *   
+ *   3. Binaries generated from this source file by individuals for their own
+ *      personal use may not be re-distributed without the written permission
+ *      of Persistence of Vision Raytracer Pty. Ltd. Such personal-use binaries
+ *      are not required to have a timeout, and thus permission is granted in
+ *      these circumstances only to disable the timeout code contained within
+ *      the beta software.
+ *   
+ *   4. Binaries generated from this source file for use within an organizational
+ *      unit (such as, but not limited to, a company or university) may not be
+ *      distributed beyond the local organizational unit in which they were made,
+ *      unless written permission is obtained from Persistence of Vision Raytracer
+ *      Pty. Ltd. Additionally, the timeout code implemented within the beta may
+ *      not be disabled or otherwise bypassed in any manner.
+ *
+ * The following text is not part of the above conditions and is provided for
+ * informational purposes only.
+ *
+ * The purpose of the no-redistribution clause is to attempt to keep the
+ * circulating copies of the beta source fresh. The only authorized distribution
+ * point for the source code is the POV-Ray website and Perforce server, where
+ * the code will be kept up to date with recent fixes. Additionally the beta
+ * timeout code mentioned above has been a standard part of POV-Ray betas since
+ * version 1.0, and is intended to reduce bug reports from old betas as well as
+ * keep any circulating beta binaries relatively fresh.
+ *
+ * All said, however, the POV-Ray developers are open to any reasonable request
+ * for variations to the above conditions and will consider them on a case-by-case
+ * basis.
+ *
+ * Additionally, the developers request your co-operation in fixing bugs and
+ * generally improving the program. If submitting a bug-fix, please ensure that
+ * you quote the revision number of the file shown above in the copyright header
+ * (see the '$Revision:' field). This ensures that it is possible to determine
+ * what specific copy of the file you are working with. The developers also would
+ * like to make it known that until POV-Ray 3.7 is out of beta, they would prefer
+ * to emphasize the provision of bug fixes over the addition of new features.
+ *
+ * Persons wishing to enhance this source are requested to take the above into
+ * account. It is also strongly suggested that such enhancements are started with
+ * a recent copy of the source.
+ *
+ * The source code page (see http://www.povray.org/beta/source/) sets out the
+ * conditions under which the developers are willing to accept contributions back
+ * into the primary source tree. Please refer to those conditions prior to making
+ * any changes to this source, if you wish to submit those changes for inclusion
+ * with POV-Ray.
+ *
+ *********************************************************************************/
+
+#include <algorithm>
+
+// frame.h must always be the first POV file included (pulls in platform config)
+#include "backend/frame.h"
+#include "backend/parser/parseprofile.h"
+
+// this must be the last file included
+#include "base/povdebug.h"
+
+namespace pov
+{
+
+// sites are told apart by kind, name and location
+static string site_key(ParserProfile::SiteKind kind, const string& name, const string& file, POV_LONG line)
+{
+	char buffer[64];
+
+	sprintf(buffer, "%d:%ld:", int(kind), long(line));
+
+	return buffer + name + "\n" + file;
+}
+
+static bool compare_self_time(const ParserProfile::Site& a, const ParserProfile::Site& b)
+{
+	return (a.selfTime > b.selfTime);
+}
+
+ParserProfile::ParserProfile() :
+	origin(boost::posix_time::microsec_clock::universal_time())
+{
+}
+
+int ParserProfile::Enter(SiteKind kind, const string& name, const string& file, POV_LONG line, const Counters& now)
+{
+	string key(site_key(kind, name, file, line));
+	Frame frame;
+
+	map<string, int>::iterator i(siteIndex.find(key));
+
+	if(i == siteIndex.end())
+	{
+		Site site;
+
+		site.kind = kind;
+		site.name = name;
+		site.file = file;
+		site.line = line;
+		site.calls = 0;
+		site.iterations = 0;
+		site.totalTime = 0;
+		site.selfTime = 0;
+		site.self.tokens = 0;
+		site.self.lookups = 0;
+		site.self.allocations = 0;
+
+		i = siteIndex.insert(make_pair(key, int(sites.size()))).first;
+		sites.push_back(site);
+		active.push_back(0);
+	}
+
+	sites[i->second].calls++;
+	active[i->second]++;
+
+	frame.site = i->second;
+	frame.startTime = Now();
+	frame.start = now;
+	frame.childTime = 0;
+	frame.child.tokens = 0;
+	frame.child.lookups = 0;
+	frame.child.allocations = 0;
+
+	frames.push_back(frame);
+
+	return int(frames.size()) - 1;
+}
+
+void ParserProfile::Leave(int frame, const Counters& now)
+{
+	POV_LONG time = Now();
+
+	while(int(frames.size()) > frame)
+	{
+		const Frame& top(frames.back());
+		Site& site(sites[top.site]);
+		POV_LONG elapsed = time - top.startTime;
+		Counters used;
+
+		used.tokens = now.tokens - top.start.tokens;
+		used.lookups = now.lookups - top.start.lookups;
+		used.allocations = now.allocations - top.start.allocations;
+
+		if(--active[top.site] == 0)
+			site.totalTime += elapsed;
+		site.selfTime += elapsed - top.childTime;
+		site.self.tokens += used.tokens - top.child.tokens;
+		site.self.lookups += used.lookups - top.child.lookups;
+		site.self.allocations += used.allocations - top.child.allocations;
+
+		frames.pop_back();
+
+		if(frames.empty() == false)
+		{
+			Frame& parent(frames.back());
+
+			parent.childTime += elapsed;
+			parent.child.tokens += used.tokens;
+			parent.child.lookups += used.lookups;
+			parent.child.allocations += used.allocations;
+		}
+	}
+}
+
+void ParserProfile::Sort()
+{
+	stable_sort(sites.begin(), sites.end(), compare_self_time);
+
+	siteIndex.clear();
+	for(size_t i = 0; i < sites.size(); i++)
+		siteIndex[site_key(sites[i].kind, sites[i].name, sites[i].file, sites[i].line)] = int(i);
+}
+
+POV_LONG ParserProfile::Now() const
+{
+	return (boost::posix_time::microsec_clock::universal_time() - origin).total_microseconds();
+}
+
+}
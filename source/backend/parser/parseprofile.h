@@ -0,0 +1,190 @@
+/*******************************************************************************
+ * parseprofile.h
+ *
+ * Declarations for the parser profiler.
+ *
+ * from Persistence of Vision Ray Tracer ('POV-Ray') version 3.7.
+ * Copyright 1991-2003 Persistence of Vision Team
+ * Copyright 2003-2009 Persistence of Vision Raytracer Pty. Ltd.
+ * ---------------------------------------------------------------------------
+ * NOTICE: This source code file is provided so that users may experiment
+ * with enhancements to POV-Ray and to port the software to platforms other
+ * than those supported by the POV-Ray developers. There are strict rules
+ * regarding how you are permitted to use this file. These rules are contained
+ * in the distribution and derivative versions licenses which should have been
+ * provided with this file.
+ *
+ * These licences may be found online, linked from the end-user license
+ * agreement that is located at http://www.povray.org/povlegal.html
+ * ---------------------------------------------------------------------------
+ * POV-Ray is based on the popular DKB raytracer version 2.12.
+ * DKBTrace was originally written by David K. Buck.
+ * DKBTrace Ver 2.0-2.12 were written by David K. Buck & Aaron A. Collins.
+ * ---------------------------------------------------------------------------
+ * $File: //depot/povray/smp/source/backend/parser/parseprofile.h $
+ * $Revision: #1 $
+ * $Change: 5401 $
+ * $DateTime: 2011/02/08 21:06:55 $
+ * $Author: clipka $
+ *******************************************************************************/
+
+/*********************************************************************************
+ * NOTICE
+ *
+ * This file is part of a BETA-TEST version of POV-Ray version 3.7. It is not
+ * final code. Use of this source file is governed by both the standard POV-Ray
+ * licences referred to in the copyright header block above this notice, and the
+ * following additional restrictions numbered 1 through 4 below:
+ *
+ *   1. This source file may not be re-distributed without the written permission
+ *      of Persistence of Vision Raytracer Pty. Ltd.
+ *
+ *   2. This notice may not be altered or removed.
+ *   
+ *   3. Binaries generated from this source file by individuals for their own
+ *      personal use may not be re-distributed without the written permission
+ *      of Persistence of Vision Raytracer Pty. Ltd. Such personal-use binaries
+ *      are not required to have a timeout, and thus permission is granted in
+ *      these circumstances only to disable the timeout code contained within
+ *      the beta software.
+ *   
+ *   4. Binaries generated from this source file for use within an organizational
+ *      unit (such as, but not limited to, a company or university) may not be
+ *      distributed beyond the local organizational unit in which they were made,
+ *      unless written permission is obtained from Persistence of Vision Raytracer
+ *      Pty. Ltd. Additionally, the timeout code implemented within the beta may
+ *      not be disabled or otherwise bypassed in any manner.
+ *
+ * The following text is not part of the above conditions and is provided for
+ * informational purposes only.
+ *
+ * The purpose of the no-redistribution clause is to attempt to keep the
+ * circulating copies of the beta source fresh. The only authorized distribution
+ * point for the source code is the POV-Ray website and Perforce server, where
+ * the code will be kept up to date with recent fixes. Additionally the beta
+ * timeout code mentioned above has been a standard part of POV-Ray betas since
+ * version 1.0, and is intended to reduce bug reports from old betas as well as
+ * keep any circulating beta binaries relatively fresh.
+ *
+ * All said, however, the POV-Ray developers are open to any reasonable request
+ * for variations to the above conditions and will consider them on a case-by-case
+ * basis.
+ *
+ * Additionally, the developers request your co-operation in fixing bugs and
+ * generally improving the program. If submitting a bug-fix, please ensure that
+ * you quote the revision number of the file shown above in the copyright header
+ * (see the '$Revision:' field). This ensures that it is possible to determine
+ * what specific copy of the file you are working with. The developers also would
+ * like to make it known that until POV-Ray 3.7 is out of beta, they would prefer
+ * to emphasize the provision of bug fixes over the addition of new features.
+ *
+ * Persons wishing to enhance this source are requested to take the above into
+ * account. It is also strongly suggested that such enhancements are started with
+ * a recent copy of the source.
+ *
+ * The source code page (see http://www.povray.org/beta/source/) sets out the
+ * conditions under which the developers are willing to accept contributions back
+ * into the primary source tree. Please refer to those conditions prior to making
+ * any changes to this source, if you wish to submit those changes for inclusion
+ * with POV-Ray.
+ *
+ *********************************************************************************/
+
+
+#ifndef PARSEPROFILE_H
+#define PARSEPROFILE_H
+
+#include <vector>
+#include <string>
+#include <map>
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#include "backend/frame.h"
+
+namespace pov
+{
+
+/// Time, token counts, symbol lookups and allocations spent parsing each
+/// file, macro and loop of a scene.
+///
+/// The parser enters a site when it opens the scene file or an include
+/// file, invokes a macro or starts a loop, and leaves it again when it is done with it. All
+/// counts of a site exclude those of the sites entered from within it,
+/// except for the total time, which includes them.
+class ParserProfile
+{
+	public:
+		enum SiteKind
+		{
+			kFile = 0,
+			kMacro,
+			kLoop
+		};
+
+		/// Running totals the parser keeps, sampled when entering and leaving a site.
+		struct Counters
+		{
+			POV_LONG tokens;
+			POV_LONG lookups;
+			POV_LONG allocations;
+		};
+
+		/// Accumulated results for one include file, macro or loop.
+		struct Site
+		{
+			SiteKind kind;
+			/// Scene or include file name, macro name, or "#while"/"#for".
+			string name;
+			/// File and line of the macro body or loop directive; empty for files.
+			string file;
+			POV_LONG line;
+			/// Number of times the site was entered.
+			POV_LONG calls;
+			/// Number of times a loop body was run.
+			POV_LONG iterations;
+			/// Wall time in microseconds, including and excluding nested sites.
+			POV_LONG totalTime;
+			POV_LONG selfTime;
+			/// Counts excluding nested sites.
+			Counters self;
+		};
+
+		ParserProfile();
+
+		/// Enter a site, returning the frame to pass to Leave.
+		int Enter(SiteKind kind, const string& name, const string& file, POV_LONG line, const Counters& now);
+		/// Leave the given frame, along with any frames entered from within it that are still open.
+		void Leave(int frame, const Counters& now);
+		/// Count another pass through the loop body of the given frame.
+		void Iteration(int frame) { sites[frames[frame].site].iterations++; }
+
+		/// Sort the sites by decreasing time spent in them, excluding nested sites.
+		/// All frames must have been left.
+		void Sort();
+
+		const vector<Site>& GetSites() const { return sites; }
+	private:
+		struct Frame
+		{
+			int site;
+			POV_LONG startTime;
+			Counters start;
+			/// Totals of the frames entered from within this one.
+			POV_LONG childTime;
+			Counters child;
+		};
+
+		vector<Site> sites;
+		map<string, int> siteIndex;
+		vector<Frame> frames;
+		/// Number of open frames of each site, so that the total time of recursive macros is counted once.
+		vector<int> active;
+		boost::posix_time::ptime origin;
+
+		POV_LONG Now() const;
+};
+
+}
+
+#endif
@@ -158,6 +158,8 @@ void Parser::Make_Pattern_Image(ImageData *image, FUNCTION_PTR fn, int *token)
 	DBL val = 0;
 	FunctionCode *f = sceneData->functionVM->GetFunction(*fn);
 	VECTOR point;
+	VECTOR points[POVFPU_BATCH_SIZE];
+	DBL values[POVFPU_BATCH_SIZE];
 
 	image->iwidth  = image->width;
 	image->iheight = image->height;
@@ -165,21 +167,24 @@ void Parser::Make_Pattern_Image(ImageData *image, FUNCTION_PTR fn, int *token)
 	{
 		image->data =Image::Create(image->iwidth, image->iheight, Image::Gray_Int16);
 
-		point[Z] = 0;
-
 		for(i = 0; i < image->iheight; i++)
 		{
-			point[Y] = ((DBL)i / (image->height - 1));
-
-			for( j = 0; j < image->iwidth; j++ )
+			// evaluate the function for several pixels of the row at once
+			for(j = 0; j < image->iwidth; j += POVFPU_BATCH_SIZE)
 			{
-				point[X] = ((DBL)j / (image->width - 1));
+				int n = min(image->iwidth - j, POVFPU_BATCH_SIZE);
+
+				for(int k = 0; k < n; k++)
+				{
+					points[k][X] = ((DBL)(j + k) / (image->width - 1));
+					points[k][Y] = ((DBL)i / (image->height - 1));
+					points[k][Z] = 0;
+				}
 
-				fnVMContext->SetLocal(X, point[X]);
-				fnVMContext->SetLocal(Y, point[Y]);
-				fnVMContext->SetLocal(Z, point[Z]);
+				POVFPU_RunBatch(fnVMContext, *fn, points, values, n);
 
-				image->data->SetGrayValue(j, i, float(POVFPU_Run(fnVMContext, *fn)));
+				for(int k = 0; k < n; k++)
+					image->data->SetGrayValue(j + k, i, float(values[k]));
 			}
 		}
 	}
@@ -177,6 +177,7 @@ const RESERVED_WORD Reserved_Words[LAST_TOKEN] = {
 	{BUMP_MAP_TOKEN, "bump_map"},
 	{BUMP_SIZE_TOKEN, "bump_size"},
 	{B_SPLINE_TOKEN, "b_spline"},
+	{CACHE_FILE_TOKEN, "cache_file"},
 	{CAMERA_ID_TOKEN, "camera identifier"},
 	{CAMERA_TOKEN, "camera"},
 	{CASE_TOKEN, "case"},
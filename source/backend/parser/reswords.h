@@ -711,6 +711,7 @@ enum TOKEN_IDS
 	PAVEMENT_TOKEN,
 	TILING_TOKEN,
 	XYZ_TOKEN,
+	CACHE_FILE_TOKEN,
 	LAST_TOKEN
 };
 
@@ -162,6 +162,10 @@ void Parser::Initialize_Tokenizer()
 	}
 
 	Input_File->R_Flag = false;
+	Input_File->Tokens = Open_Token_Cache(Input_File->In_File->name());
+	Input_File->Replay = NULL;
+	Input_File->Replay_Index = 0;
+	Input_File->Profile_Frame = Enter_Profile_Site(ParserProfile::kFile, UCS2toASCIIString(Input_File->In_File->name()).c_str(), NULL, 0);
 
 	Got_EOF  = false;
 
@@ -171,6 +175,9 @@ void Parser::Initialize_Tokenizer()
 
 	Cond_Stack[0].Cond_Type    = ROOT_COND;
 	Cond_Stack[0].Switch_Value = 0.0;
+	Cond_Stack[0].Macro_Tokens = NULL;
+	Cond_Stack[0].Recording    = NULL;
+	Cond_Stack[0].Profile_Frame = -1;
 
 	init_sym_tables();
 	Max_Trace_Level = MAX_TRACE_LEVEL_DEFAULT;
@@ -219,6 +226,7 @@ void Parser::pre_init_tokenizer ()
 	line_count = 10;
 	token_count = 0;
 	Current_Token_Count = 0;
+	Symbol_Lookups = 0;
 	Include_File_Index = 0;
 	Echo_Indx=0;
 
@@ -235,6 +243,10 @@ void Parser::pre_init_tokenizer ()
 
 	Input_File = &Include_Files[0];
 	Include_Files[0].In_File = NULL ;
+	Include_Files[0].Tokens = NULL;
+	Include_Files[0].Replay = NULL;
+	Include_Files[0].Profile_Frame = -1;
+	Token_Caches = NULL;
 
 	for(i = 0; i < LAST_TOKEN; i++)
 	{
@@ -299,15 +311,16 @@ void Parser::Terminate_Tokenizer()
 			Input_File->In_File = NULL;
 			Got_EOF = false;
 		}
+		Input_File->Tokens = NULL;
+		Input_File->Replay = NULL;
 	}
 
+	// token caches still referenced by macros, macro invocations or open files
+	while(Token_Caches != NULL)
+		Destroy_Token_Cache(Token_Caches);
+
 	if(Cond_Stack != NULL)
 	{
-		for(int i = 0; i <= CS_Index; i++)
-		{
-			if((Cond_Stack[i].Cond_Type == INVOKING_MACRO_COND) && (Cond_Stack[i].Macro_Same_Flag == false))
-				delete Cond_Stack[i].Macro_File;
-		}
 		POV_FREE(Cond_Stack);
 
 		Cond_Stack = NULL;
@@ -376,6 +389,12 @@ void Parser::Get_Token ()
 
 	while (Token.Token_Id == END_OF_FILE_TOKEN)
 	{
+		if (Replaying())
+		{
+			Replay_Token();
+			continue;
+		}
+
 		Skip_Spaces();
 
 		Token.Token_Col_No = col = Echo_Indx;
@@ -404,18 +423,26 @@ void Parser::Get_Token ()
 				return;
 			}
 
-			if (Input_File->In_File == Token.FileHandle)
+			if (Input_File->Tokens == Token.FileHandle)
 				Token.FileHandle = NULL;
 
 			delete Input_File->In_File; /* added to fix open file buildup JLN 12/91 */
 			Input_File->In_File = NULL ;
 			Got_EOF=false;
 
+			if (Input_File->Tokens->Cache_File != NULL)
+				Write_Include_Cache(Input_File->Tokens);
+
+			Release_Token_Cache(Input_File->Tokens);
+			Input_File->Tokens = NULL;
+
 			Destroy_Table(Table_Index--);
 
+			Leave_Profile_Site(Input_File->Profile_Frame);
+
 			Input_File = &Include_Files[--Include_File_Index];
 			if (Token.FileHandle == NULL)
-				Token.FileHandle = Input_File->In_File;
+				Token.FileHandle = Input_File->Tokens;
 
 			continue;
 		}
@@ -495,6 +522,7 @@ void Parser::Get_Token ()
 				break;
 
 			case '#' :
+				Cache_Token(HASH_TOKEN, IDENTIFIER_TOKEN, col);
 				Parse_Directive(true);
 				/* Write_Token (HASH_TOKEN, col);*/
 				break;
@@ -763,6 +791,9 @@ bool Parser::Skip_Spaces()
 {
 	register int c;
 
+	if (Replaying())
+		return true;
+
 	while(true)
 	{
 		c = Echo_getc();
@@ -1273,14 +1304,12 @@ bool Parser::Read_Float()
 
 	End_String_Fast();
 
-	Write_Token (FLOAT_TOKEN, col);
+	// convert before writing the token, so that the value is recorded along with it
+	bool valid = (sscanf (String, DBL_FORMAT_STRING, &Token.Token_Float) != 0);
 
-	if (sscanf (String, DBL_FORMAT_STRING, &Token.Token_Float) == 0)
-	{
-		return (false);
-	}
+	Write_Token (FLOAT_TOKEN, col);
 
-	return (true);
+	return (valid);
 }
 
 
@@ -1312,11 +1341,8 @@ bool Parser::Read_Float()
 void Parser::Read_Symbol()
 {
 	register int c;
-	int Local_Index,i,j,k;
-	POV_ARRAY *a;
 	SYM_ENTRY *Temp_Entry;
-	POV_PARAM *Par;
-	DBL val;
+	TOKEN Reserved_Id;
 
 	Begin_String_Fast();
 
@@ -1343,6 +1369,51 @@ void Parser::Read_Symbol()
 
 	End_String_Fast();
 
+	/* Reserved keywords never change, so the lookup is recorded along with the symbol */
+	Temp_Entry = Find_Symbol(0,String);
+	Reserved_Id = (Temp_Entry != NULL) ? Temp_Entry->Token_Number : IDENTIFIER_TOKEN;
+
+	Cache_Token(IDENTIFIER_TOKEN, Reserved_Id, Token.Token_Col_No);
+
+	Process_Symbol(Reserved_Id);
+}
+
+
+
+/*****************************************************************************
+*
+* FUNCTION
+*
+*   Process_Symbol
+*
+* INPUT
+*
+*   Reserved_Id - reserved word ID of the symbol in String, or
+*                 IDENTIFIER_TOKEN if it is not a reserved word
+*
+* OUTPUT
+*
+* RETURNS
+*
+* AUTHOR
+*
+* DESCRIPTION
+*
+*   Write out the token for a symbol read from the input file or replayed
+*   from a token cache, looking up identifiers in the symbol tables.
+*
+* CHANGES
+*
+******************************************************************************/
+
+void Parser::Process_Symbol(TOKEN Reserved_Id)
+{
+	int Local_Index,i,j,k;
+	POV_ARRAY *a;
+	SYM_ENTRY *Temp_Entry;
+	POV_PARAM *Par;
+	DBL val;
+
 	if (Inside_Ifdef)
 	{
 		Token.Token_Id = IDENTIFIER_TOKEN;
@@ -1352,9 +1423,9 @@ void Parser::Read_Symbol()
 	}
 
 	/* If its a reserved keyword, write it and return */
-	if ( (Temp_Entry = Find_Symbol(0,String)) != NULL)
+	if (Reserved_Id != IDENTIFIER_TOKEN)
 	{
-		Write_Token (Temp_Entry->Token_Number, Token.Token_Col_No);
+		Set_Token (Reserved_Id, Token.Token_Col_No);
 		return;
 	}
 
@@ -1386,7 +1457,7 @@ void Parser::Read_Symbol()
 						Token.is_array_elem = false;
 						Token.NumberPtr = &(Temp_Entry->Token_Number);
 						Token.DataPtr   = &(Temp_Entry->Data);
-						Write_Token (Token.Token_Id, Token.Token_Col_No);
+						Set_Token (Token.Token_Id, Token.Token_Col_No);
 
 						Token.Table_Index = Local_Index;
 					}
@@ -1403,11 +1474,7 @@ void Parser::Read_Symbol()
 				{
 					if (Token.Token_Id==ARRAY_ID_TOKEN)
 					{
-						Skip_Spaces();
-						c = Echo_getc();
-						Echo_ungetc(c);
-
-						if (c!='[')
+						if (!Subscript_Follows())
 						{
 							break;
 						}
@@ -1454,7 +1521,7 @@ void Parser::Read_Symbol()
 					}
 				}
 
-				Write_Token (Token.Token_Id, Token.Token_Col_No);
+				Set_Token (Token.Token_Id, Token.Token_Col_No);
 
 				Token.Data        = *(Token.DataPtr);
 				Token.Table_Index = Local_Index;
@@ -1463,20 +1530,471 @@ void Parser::Read_Symbol()
 		}
 	}
 
-	Write_Token(IDENTIFIER_TOKEN, Token.Token_Col_No);
+	Set_Token(IDENTIFIER_TOKEN, Token.Token_Col_No);
 }
 
 inline void Parser::Write_Token (TOKEN Token_Id, int col)
 {
-	Token.Token_File_Pos = Input_File->In_File->tellg();
+	Cache_Token(Token_Id, IDENTIFIER_TOKEN, col);
+	Set_Token(Token_Id, col);
+}
+
+inline void Parser::Set_Token (TOKEN Token_Id, int col)
+{
+	Token.Token_File_Pos = Input_File_Pos();
 	Token.Token_Col_No   = col;
-	Token.FileHandle     = Input_File->In_File;
+	Token.FileHandle     = (Input_File->Replay != NULL) ? Input_File->Replay : Input_File->Tokens;
 	Token.Token_String   = String;
 	Token.Data           = NULL;
 	Token.Token_Id       = Conversion_Util_Table[Token_Id];
 	Token.Function_Id    = Token_Id;
 }
 
+/* Location just past the most recently read token */
+inline ITextStream::FilePos Parser::Input_File_Pos()
+{
+	if ((Input_File->Replay != NULL) && (Input_File->Replay_Index > 0))
+		return Input_File->Replay->Tokens[Input_File->Replay_Index - 1].File_Pos;
+
+	return Input_File->In_File->tellg();
+}
+
+
+
+/*****************************************************************************
+*
+* FUNCTION
+*
+*   Open_Token_Cache
+*
+* INPUT
+*
+*   Name - name of the scene or include file
+*
+* OUTPUT
+*
+* RETURNS
+*
+*   A new, empty token cache with a single reference.
+*
+* AUTHOR
+*
+* DESCRIPTION
+*
+*   Token caches record the tokens read from a scene or include file while
+*   a loop body or macro declaration is being read, so that later passes
+*   through the loop and later invocations of the macro can replay the
+*   tokens instead of seeking in and re-reading the file.  Only the raw
+*   tokens are recorded; identifiers are looked up again on every replay.
+*
+* CHANGES
+*
+******************************************************************************/
+
+Parser::TOKEN_CACHE *Parser::Open_Token_Cache(const UCS2 *Name)
+{
+	TOKEN_CACHE *New;
+
+	New = (TOKEN_CACHE *)POV_MALLOC(sizeof(TOKEN_CACHE), "token cache");
+
+	New->Name = UCS2_strdup(Name);
+	New->Tokens = NULL;
+	New->Number_Of_Tokens = 0;
+	New->Max_Tokens = 0;
+	New->Strings = NULL;
+	New->Strings_Size = 0;
+	New->Max_Strings = 0;
+	New->Recording = 0;
+	New->References = 1;
+	New->Cache_File = NULL;
+	New->Source_Size = 0;
+	New->Source_Time = 0;
+
+	New->Prev = NULL;
+	New->Next = Token_Caches;
+	if (Token_Caches != NULL)
+		Token_Caches->Prev = New;
+	Token_Caches = New;
+
+	return New;
+}
+
+void Parser::Release_Token_Cache(TOKEN_CACHE *Tokens)
+{
+	if ((Tokens != NULL) && (--Tokens->References <= 0))
+		Destroy_Token_Cache(Tokens);
+}
+
+void Parser::Destroy_Token_Cache(TOKEN_CACHE *Tokens)
+{
+	if (Token.FileHandle == Tokens)
+		Token.FileHandle = NULL;
+
+	if (Tokens->Prev != NULL)
+		Tokens->Prev->Next = Tokens->Next;
+	else
+		Token_Caches = Tokens->Next;
+	if (Tokens->Next != NULL)
+		Tokens->Next->Prev = Tokens->Prev;
+
+	POV_FREE(Tokens->Name);
+	if (Tokens->Cache_File != NULL)
+		POV_FREE(Tokens->Cache_File);
+	if (Tokens->Tokens != NULL)
+		POV_FREE(Tokens->Tokens);
+	if (Tokens->Strings != NULL)
+		POV_FREE(Tokens->Strings);
+	POV_FREE(Tokens);
+}
+
+
+
+/*****************************************************************************
+*
+* FUNCTION
+*
+*   Record_Token
+*
+* INPUT
+*
+*   Token_Id    - raw token ID
+*   Reserved_Id - reserved word ID for symbols, IDENTIFIER_TOKEN otherwise
+*   col         - column of the token
+*
+* OUTPUT
+*
+* RETURNS
+*
+* AUTHOR
+*
+* DESCRIPTION
+*
+*   Append the token just read from the input file, with its character
+*   sequence in String, to the token cache of the input file.
+*
+* CHANGES
+*
+******************************************************************************/
+
+inline void Parser::Cache_Token(TOKEN Token_Id, TOKEN Reserved_Id, int col)
+{
+	if ((Input_File->Replay == NULL) && (Input_File->Tokens != NULL) && (Input_File->Tokens->Recording > 0))
+		Record_Token(Token_Id, Reserved_Id, col);
+}
+
+void Parser::Record_Token(TOKEN Token_Id, TOKEN Reserved_Id, int col)
+{
+	TOKEN_CACHE *Tokens = Input_File->Tokens;
+	CACHED_TOKEN *New;
+	size_t Length = strlen(String) + 1;
+
+	if (Tokens->Number_Of_Tokens >= Tokens->Max_Tokens)
+	{
+		Tokens->Max_Tokens = (Tokens->Max_Tokens > 0) ? Tokens->Max_Tokens * 2 : 256;
+		Tokens->Tokens = (CACHED_TOKEN *)POV_REALLOC(Tokens->Tokens, Tokens->Max_Tokens * sizeof(CACHED_TOKEN), "token cache");
+	}
+
+	if (Tokens->Strings_Size + Length > Tokens->Max_Strings)
+	{
+		Tokens->Max_Strings = max(Tokens->Max_Strings * 2, max(Tokens->Strings_Size + Length, (size_t)4096));
+		Tokens->Strings = (char *)POV_REALLOC(Tokens->Strings, Tokens->Max_Strings, "token cache strings");
+	}
+
+	New = &Tokens->Tokens[Tokens->Number_Of_Tokens++];
+
+	New->File_Pos      = Input_File->In_File->tellg();
+	New->Col_No        = col;
+	New->Token_Id      = Token_Id;
+	New->Reserved_Id   = Reserved_Id;
+	New->Token_Float   = Token.Token_Float;
+	New->String_Offset = Tokens->Strings_Size;
+
+	memcpy(Tokens->Strings + Tokens->Strings_Size, String, Length);
+	Tokens->Strings_Size += Length;
+}
+
+
+
+/*****************************************************************************
+*
+* FUNCTION
+*
+*   Replaying
+*
+* INPUT
+*
+* OUTPUT
+*
+* RETURNS
+*
+*   True if the next token is to be taken from a token cache rather than
+*   read from the input file.
+*
+* AUTHOR
+*
+* DESCRIPTION
+*
+*   Replaying the token cache of the input file itself may run past the
+*   last recorded token, in which case reading continues from the input
+*   file, which is still positioned just past that token.
+*
+* CHANGES
+*
+******************************************************************************/
+
+inline bool Parser::Replaying()
+{
+	if (Input_File->Replay == NULL)
+		return false;
+
+	if ((Input_File->Replay_Index >= Input_File->Replay->Number_Of_Tokens) &&
+	    (Input_File->Replay == Input_File->Tokens))
+	{
+		Input_File->Replay = NULL;
+		return false;
+	}
+
+	return true;
+}
+
+
+
+/*****************************************************************************
+*
+* FUNCTION
+*
+*   Replay_Token
+*
+* INPUT
+*
+* OUTPUT
+*
+* RETURNS
+*
+* AUTHOR
+*
+* DESCRIPTION
+*
+*   Take the next token from the token cache being replayed, and process it
+*   just as Get_Token does for a token read from the input file.
+*
+* CHANGES
+*
+******************************************************************************/
+
+void Parser::Replay_Token()
+{
+	TOKEN_CACHE *Tokens = Input_File->Replay;
+	CACHED_TOKEN *Cached;
+	const char *Text;
+	TOKEN Token_Id, Reserved_Id;
+	int col;
+
+	if (Input_File->Replay_Index >= Tokens->Number_Of_Tokens)
+		Error("Unexpected end of macro.");
+
+	Cached = &Tokens->Tokens[Input_File->Replay_Index++];
+
+	// copy everything needed, as processing the token may read (and record) further tokens
+	Token_Id    = Cached->Token_Id;
+	Reserved_Id = Cached->Reserved_Id;
+	col         = Cached->Col_No;
+	Text        = Tokens->Strings + Cached->String_Offset;
+
+	Token.Token_Col_No = col;
+	if (Token_Id == FLOAT_TOKEN)
+		Token.Token_Float = Cached->Token_Float;
+
+	if (Token_Id == STRING_LITERAL_TOKEN)
+	{
+		Begin_String();
+		while (*Text != '\0')
+			Stuff_Character(*Text++);
+		End_String();
+	}
+	else
+	{
+		Begin_String_Fast();
+		while (*Text != '\0')
+			Stuff_Character_Fast(*Text++);
+		End_String_Fast();
+	}
+
+	switch (Token_Id)
+	{
+		case HASH_TOKEN:
+			Parse_Directive(true);
+			break;
+
+		case IDENTIFIER_TOKEN:
+			Process_Symbol(Reserved_Id);
+			break;
+
+		default:
+			Set_Token(Token_Id, col);
+			break;
+	}
+}
+
+
+
+/*****************************************************************************
+*
+* FUNCTION
+*
+*   Mark_Token_Pos
+*
+* INPUT
+*
+* OUTPUT
+*
+*   Pos - position of the next token
+*
+* RETURNS
+*
+* AUTHOR
+*
+* DESCRIPTION
+*
+*   Mark the start of a loop body or macro declaration.  If the tokens are
+*   being read from the input file, recording starts until the matching
+*   #end is reached; the recording is attributed to the current entry of
+*   the conditional stack.
+*
+* CHANGES
+*
+******************************************************************************/
+
+void Parser::Mark_Token_Pos(TOKEN_POS& Pos)
+{
+	if (Replaying())
+	{
+		Pos.Tokens = Input_File->Replay;
+		Pos.Index  = Input_File->Replay_Index;
+	}
+	else
+	{
+		Pos.Tokens = Input_File->Tokens;
+		Pos.Index  = Input_File->Tokens->Number_Of_Tokens;
+
+		if (Cond_Stack[CS_Index].Recording == NULL)
+		{
+			Input_File->Tokens->Recording++;
+			Cond_Stack[CS_Index].Recording = Input_File->Tokens;
+		}
+	}
+}
+
+void Parser::Stop_Token_Recording()
+{
+	if (Cond_Stack[CS_Index].Recording != NULL)
+	{
+		Cond_Stack[CS_Index].Recording->Recording--;
+		Cond_Stack[CS_Index].Recording = NULL;
+	}
+}
+
+
+
+/*****************************************************************************
+*
+* FUNCTION
+*
+*   Enter_Profile_Site
+*
+* INPUT
+*
+*   kind - kind of site
+*   name - name of the file or macro, or the loop directive
+*   file - file holding the macro body or loop, NULL for files
+*   line - line of the macro body or loop
+*
+* OUTPUT
+*
+* RETURNS
+*
+*   The profile frame to leave once done with the site, or -1 if no parser
+*   profile was requested.
+*
+* AUTHOR
+*
+* DESCRIPTION
+*
+*   Start charging time, tokens, symbol lookups and allocations to a file,
+*   macro or loop of the parser profile.
+*
+* CHANGES
+*
+******************************************************************************/
+
+int Parser::Enter_Profile_Site(ParserProfile::SiteKind kind, const char *name, const UCS2 *file, POV_LONG line)
+{
+	if (sceneData->parserProfile == NULL)
+		return -1;
+
+	return sceneData->parserProfile->Enter(kind, name, (file != NULL) ? UCS2toASCIIString(file) : string(), line, Profile_Counters());
+}
+
+void Parser::Leave_Profile_Site(int& Frame)
+{
+	if (Frame >= 0)
+		sceneData->parserProfile->Leave(Frame, Profile_Counters());
+
+	Frame = -1;
+}
+
+ParserProfile::Counters Parser::Profile_Counters()
+{
+	ParserProfile::Counters Now;
+
+	Now.tokens      = Current_Token_Count;
+	Now.lookups     = Symbol_Lookups;
+	Now.allocations = (POV_LONG)mem_allocations();
+
+	return Now;
+}
+
+
+
+/*****************************************************************************
+*
+* FUNCTION
+*
+*   Subscript_Follows
+*
+* INPUT
+*
+* OUTPUT
+*
+* RETURNS
+*
+*   True if the next token is a '['.
+*
+* AUTHOR
+*
+* DESCRIPTION
+*
+*   Peek ahead after an array identifier without reading the next token.
+*
+* CHANGES
+*
+******************************************************************************/
+
+bool Parser::Subscript_Follows()
+{
+	register int c;
+
+	if (Replaying())
+		return (Input_File->Replay_Index < Input_File->Replay->Number_Of_Tokens) &&
+		       (Input_File->Replay->Tokens[Input_File->Replay_Index].Token_Id == LEFT_SQUARE_TOKEN);
+
+	Skip_Spaces();
+	c = Echo_getc();
+	Echo_ungetc(c);
+
+	return (c == '[');
+}
+
 
 /*****************************************************************************
 *
@@ -1657,12 +2175,12 @@ void Parser::Where_Error(POVMSObjectPtr msg)
 	if(Token.FileHandle == NULL)
 		return;
 
-	(void)POVMSUtil_SetUCS2String(msg, kPOVAttrib_FileName, Token.FileHandle->name());
+	(void)POVMSUtil_SetUCS2String(msg, kPOVAttrib_FileName, Token.FileHandle->Name);
 	(void)POVMSUtil_SetString(msg, kPOVAttrib_TokenName, Token.Token_String);
 	(void)POVMSUtil_SetLong(msg, kPOVAttrib_Line, Token.Token_File_Pos.lineno);
 	(void)POVMSUtil_SetInt(msg, kPOVAttrib_Column, Token.Token_Col_No);
 	if(Token.FileHandle != NULL)
-		(void)POVMSUtil_SetLong(msg, kPOVAttrib_FilePosition, Token.FileHandle->tellg().offset);
+		(void)POVMSUtil_SetLong(msg, kPOVAttrib_FilePosition, Token.Token_File_Pos.offset);
 }
 
 
@@ -1690,12 +2208,12 @@ void Parser::Where_Warning(POVMSObjectPtr msg)
 	if(Token.FileHandle == NULL)
 		return;
 
-	(void)POVMSUtil_SetUCS2String(msg, kPOVAttrib_FileName, Token.FileHandle->name());
+	(void)POVMSUtil_SetUCS2String(msg, kPOVAttrib_FileName, Token.FileHandle->Name);
 	(void)POVMSUtil_SetString(msg, kPOVAttrib_TokenName, Token.Token_String);
 	(void)POVMSUtil_SetLong(msg, kPOVAttrib_Line, Token.Token_File_Pos.lineno);
 	(void)POVMSUtil_SetInt(msg, kPOVAttrib_Column, Token.Token_Col_No);
 	if(Token.FileHandle != NULL)
-		(void)POVMSUtil_SetLong(msg, kPOVAttrib_FilePosition, Token.FileHandle->tellg().offset);
+		(void)POVMSUtil_SetLong(msg, kPOVAttrib_FilePosition, Token.Token_File_Pos.offset);
 }
 
 
@@ -1725,7 +2243,7 @@ void Parser::Parse_Directive(int After_Hash)
 	char *ts;
 	POV_MACRO *PMac=NULL;
 	COND_TYPE Curr_Type = Cond_Stack[CS_Index].Cond_Type;
-	POV_LONG Hash_Loc = Input_File->In_File->tellg().offset;
+	POV_LONG Hash_Loc = Input_File_Pos().offset;
 
 	if (Curr_Type == INVOKING_MACRO_COND)
 	{
@@ -1837,8 +2355,10 @@ void Parser::Parse_Directive(int After_Hash)
 			}
 			else
 			{
-				Cond_Stack[CS_Index].Loop_File = Input_File->In_File;
-				Cond_Stack[CS_Index].File_Pos  = Input_File->In_File->tellg();
+				if (sceneData->parserProfile != NULL)
+					Cond_Stack[CS_Index].Profile_Frame = Enter_Profile_Site(ParserProfile::kLoop, "#while", Token.FileHandle->Name, Input_File_Pos().lineno);
+
+				Mark_Token_Pos(Cond_Stack[CS_Index].Token_Pos);
 
 				Value=Parse_Cond_Param();
 
@@ -1867,12 +2387,15 @@ void Parser::Parse_Directive(int After_Hash)
 			{
 				char* Identifier = NULL;
 				DBL End, Step;
+
+				if (sceneData->parserProfile != NULL)
+					Cond_Stack[CS_Index].Profile_Frame = Enter_Profile_Site(ParserProfile::kLoop, "#for", Token.FileHandle->Name, Input_File_Pos().lineno);
+
 				if (Parse_For_Param (&Identifier, &End, &Step))
 				{
 					// execute loop
 					Cond_Stack[CS_Index].Cond_Type = FOR_COND;
-					Cond_Stack[CS_Index].Loop_File = Input_File->In_File;
-					Cond_Stack[CS_Index].File_Pos  = Input_File->In_File->tellg();
+					Mark_Token_Pos(Cond_Stack[CS_Index].Token_Pos);
 					Cond_Stack[CS_Index].Loop_Identifier = Identifier;
 					Cond_Stack[CS_Index].For_Loop_End = End;
 					Cond_Stack[CS_Index].For_Loop_Step = Step;
@@ -2085,6 +2608,8 @@ void Parser::Parse_Directive(int After_Hash)
 							PMac->Macro_End=Hash_Loc;
 						}
 					}
+					Stop_Token_Recording();
+					Leave_Profile_Site(Cond_Stack[CS_Index].Profile_Frame);
 					if (--CS_Index < 0)
 					{
 						Error("Mis-matched '#end'.");
@@ -2098,16 +2623,18 @@ void Parser::Parse_Directive(int After_Hash)
 					break;
 
 				case WHILE_COND:
-					if (Cond_Stack[CS_Index].Loop_File != Input_File->In_File)
+					if (Cond_Stack[CS_Index].Token_Pos.Tokens != ((Input_File->Replay != NULL) ? Input_File->Replay : Input_File->Tokens))
 					{
 						Error("#while loop did not end in file where it started.");
 					}
 
-					Got_EOF=false;
-					if (!Input_File->In_File->seekg(Cond_Stack[CS_Index].File_Pos))
-					{
-						Error("Unable to seek in input file for #while directive.");
-					}
+					// the loop body has been read once, so replay it from here on
+					Stop_Token_Recording();
+					Input_File->Replay       = Cond_Stack[CS_Index].Token_Pos.Tokens;
+					Input_File->Replay_Index = Cond_Stack[CS_Index].Token_Pos.Index;
+
+					if (Cond_Stack[CS_Index].Profile_Frame >= 0)
+						sceneData->parserProfile->Iteration(Cond_Stack[CS_Index].Profile_Frame);
 
 					Value=Parse_Cond_Param();
 
@@ -2119,16 +2646,18 @@ void Parser::Parse_Directive(int After_Hash)
 					break;
 
 				case FOR_COND:
-					if (Cond_Stack[CS_Index].Loop_File != Input_File->In_File)
+					if (Cond_Stack[CS_Index].Token_Pos.Tokens != ((Input_File->Replay != NULL) ? Input_File->Replay : Input_File->Tokens))
 					{
 						Error("#for loop did not end in file where it started.");
 					}
 
-					Got_EOF=false;
-					if (!Input_File->In_File->seekg(Cond_Stack[CS_Index].File_Pos))
-					{
-						Error("Unable to seek in input file for #for directive.");
-					}
+					// the loop body has been read once, so replay it from here on
+					Stop_Token_Recording();
+					Input_File->Replay       = Cond_Stack[CS_Index].Token_Pos.Tokens;
+					Input_File->Replay_Index = Cond_Stack[CS_Index].Token_Pos.Index;
+
+					if (Cond_Stack[CS_Index].Profile_Frame >= 0)
+						sceneData->parserProfile->Iteration(Cond_Stack[CS_Index].Profile_Frame);
 
 					{
 						SYM_ENTRY* Entry = Find_Symbol(Table_Index, Cond_Stack[CS_Index].Loop_Identifier);
@@ -2481,6 +3010,11 @@ void Parser::Parse_Directive(int After_Hash)
 			Inc_CS_Index();
 			Cond_Stack[CS_Index].Cond_Type = DECLARING_MACRO_COND;
 			Cond_Stack[CS_Index].PMac      = PMac;
+			if (PMac != NULL)
+			{
+				Mark_Token_Pos(PMac->Macro_Start);
+				PMac->Macro_Start.Tokens->References++;
+			}
 			Skip_Tokens(DECLARING_MACRO_COND);
 			EXIT
 		END_CASE
@@ -2550,6 +3084,10 @@ void Parser::Open_Include()
 	// exception (e.g. I/O restriction error), the parser shut-down code will attempt
 	// to free In_File if it's not NULL.
 	Input_File->In_File = NULL;
+	Input_File->Tokens = NULL;
+	Input_File->Replay = NULL;
+	Input_File->Replay_Index = 0;
+	Input_File->Profile_Frame = -1;
 
 	IStream *is = Locate_File(this, sceneData, temp, POV_File_Text_INC, b, true);
 	if(is == NULL)
@@ -2561,6 +3099,12 @@ void Parser::Open_Include()
 		Input_File->In_File = new ITextStream(b.c_str(), is);
 
 	Input_File->R_Flag=false;
+	Input_File->Tokens = Open_Token_Cache(Input_File->In_File->name());
+
+	if (!sceneData->includeCachePath.empty())
+		Open_Include_Cache(b);
+
+	Input_File->Profile_Frame = Enter_Profile_Site(ParserProfile::kFile, UCS2toASCIIString(b).c_str(), NULL, 0);
 
 	Add_Sym_Table();
 
@@ -2907,6 +3451,8 @@ SYM_ENTRY *Parser::Find_Symbol(int Index,char *Name)
 
 	Entry = Tables[Index]->Table[i];
 
+	Symbol_Lookups++;
+
 	while (Entry)
 	{
 		if (strcmp(Name, Entry->Token_Name) == 0)
@@ -3005,7 +3551,8 @@ Parser::POV_MACRO *Parser::Parse_Macro()
 
 	Table_Entry->Data=(void *)New;
 
-	New->Macro_Filename = NULL;
+	New->Macro_Start.Tokens = NULL;
+	New->Macro_Start.Index = 0;
 	New->Num_Of_Pars=0;
 	New->Macro_Name=POV_STRDUP(Token.Token_String);
 
@@ -3078,9 +3625,6 @@ Parser::POV_MACRO *Parser::Parse_Macro()
 
 	Table_Entry->Token_Number = MACRO_ID_TOKEN;
 
-	New->Macro_Filename = UCS2_strdup(Input_File->In_File->name());
-	New->Macro_File_Pos = Input_File->In_File->tellg();
-
 	Check_Macro_Vers();
 
 	return (New);
@@ -3131,8 +3675,24 @@ void Parser::Invoke_Macro()
 	Inc_CS_Index();
 	Cond_Stack[CS_Index].Cond_Type = INVOKING_MACRO_COND;
 
-	Cond_Stack[CS_Index].File_Pos          = Input_File->In_File->tellg();
-	Cond_Stack[CS_Index].Macro_Return_Name = Input_File->In_File->name();
+	if (sceneData->parserProfile != NULL)
+	{
+		TOKEN_CACHE *Body = PMac->Macro_Start.Tokens;
+		POV_LONG Line = (PMac->Macro_Start.Index < Body->Number_Of_Tokens) ? Body->Tokens[PMac->Macro_Start.Index].File_Pos.lineno : 0;
+
+		Cond_Stack[CS_Index].Profile_Frame = Enter_Profile_Site(ParserProfile::kMacro, PMac->Macro_Name, Body->Name, Line);
+	}
+
+	if (Replaying())
+	{
+		Cond_Stack[CS_Index].Token_Pos.Tokens = Input_File->Replay;
+		Cond_Stack[CS_Index].Token_Pos.Index  = Input_File->Replay_Index;
+	}
+	else
+	{
+		Cond_Stack[CS_Index].Token_Pos.Tokens = NULL;
+		Cond_Stack[CS_Index].Token_Pos.Index  = 0;
+	}
 	Cond_Stack[CS_Index].PMac              = PMac;
 
 	/* Gotta have new symbol table in case #local is used */
@@ -3148,34 +3708,13 @@ void Parser::Invoke_Macro()
 		POV_FREE(Table_Entries);
 	}
 
-	if (UCS2_strcmp(PMac->Macro_Filename,Input_File->In_File->name()))
-	{
-		UCS2String ign;
-		/* Not in same file */
-		Cond_Stack[CS_Index].Macro_Same_Flag=false;
-		Cond_Stack[CS_Index].Macro_File = Input_File->In_File ;
-//  POV_DELETE(Input_File->In_File, IStream);
-		Got_EOF=false;
-		Input_File->R_Flag=false;
-		IStream *is = Locate_File (this, sceneData, PMac->Macro_Filename, POV_File_Text_Macro, ign, true);
-		if(is == NULL)
-		{
-			Input_File->In_File = NULL;  /* Keeps from closing failed file. */
-			Error ("Cannot open macro file '%s'.", UCS2toASCIIString(UCS2String(PMac->Macro_Filename)).c_str());
-		}
-		else
-			Input_File->In_File = new ITextStream(PMac->Macro_Filename, is);
-	}
-	else
-	{
-		Cond_Stack[CS_Index].Macro_Same_Flag=true;
-	}
+	/* The macro body was recorded when the macro was declared, so there is
+	   no need to seek in (or re-open) the file it was declared in. */
+	Cond_Stack[CS_Index].Macro_Tokens = PMac->Macro_Start.Tokens;
+	Cond_Stack[CS_Index].Macro_Tokens->References++;
 
-	Got_EOF=false;
-	if (!Input_File->In_File->seekg(PMac->Macro_File_Pos))
-	{
-		Error("Unable to file seek in macro.");
-	}
+	Input_File->Replay       = PMac->Macro_Start.Tokens;
+	Input_File->Replay_Index = PMac->Macro_Start.Index;
 
 	Token.Token_Id = END_OF_FILE_TOKEN;
 	Token.is_array_elem = false;
@@ -3188,26 +3727,18 @@ void Parser::Return_From_Macro()
 {
 	Check_Macro_Vers();
 
-	if (!Cond_Stack[CS_Index].Macro_Same_Flag)
-	{
-		if (Token.FileHandle == Input_File->In_File)
-			Token.FileHandle = NULL;
-		delete Input_File->In_File;
-		Input_File->R_Flag=false;
-		Input_File->In_File = Cond_Stack[CS_Index].Macro_File ;
-		if (Token.FileHandle == NULL)
-			Token.FileHandle = Input_File->In_File;
-	}
+	Input_File->Replay       = Cond_Stack[CS_Index].Token_Pos.Tokens;
+	Input_File->Replay_Index = Cond_Stack[CS_Index].Token_Pos.Index;
 
-	Got_EOF=false;
-
-	if (!Input_File->In_File->seekg(Cond_Stack[CS_Index].File_Pos))
-	{
-		Error("Unable to file seek in return from macro.");
-	}
+	Release_Token_Cache(Cond_Stack[CS_Index].Macro_Tokens);
+	Cond_Stack[CS_Index].Macro_Tokens = NULL;
+	if (Token.FileHandle == NULL)
+		Token.FileHandle = (Input_File->Replay != NULL) ? Input_File->Replay : Input_File->Tokens;
 
 	// Always destroy macro locals
 	Destroy_Table(Table_Index--);
+
+	Leave_Profile_Site(Cond_Stack[CS_Index].Profile_Frame);
 }
 
 void Parser::Destroy_Macro(POV_MACRO *PMac)
@@ -3219,10 +3750,7 @@ void Parser::Destroy_Macro(POV_MACRO *PMac)
 	}
 
 	POV_FREE(PMac->Macro_Name);
-	if (PMac->Macro_Filename!=NULL)
-	{
-		POV_FREE(PMac->Macro_Filename);
-	}
+	Release_Token_Cache(PMac->Macro_Start.Tokens);
 
 	for (i=0; i < PMac->Num_Of_Pars; i++)
 	{
@@ -3513,6 +4041,8 @@ int Parser::Parse_Read_Value(DATA_FILE *User_File,int Previous,int *NumberPtr,vo
 {
 	pov_base::ITextStream *Temp;
 	bool Temp_R_Flag;
+	TOKEN_CACHE *Temp_Tokens, *Temp_Replay;
+	int Temp_Replay_Index;
 	DBL Val;
 	int End_File=false;
 	int i;
@@ -3520,12 +4050,19 @@ int Parser::Parse_Read_Value(DATA_FILE *User_File,int Previous,int *NumberPtr,vo
 
 	Temp = Input_File->In_File;
 	Temp_R_Flag = Input_File->R_Flag;
+	Temp_Tokens = Input_File->Tokens;
+	Temp_Replay = Input_File->Replay;
+	Temp_Replay_Index = Input_File->Replay_Index;
 	Input_File->In_File = User_File->In_File;
 	Input_File->R_Flag = User_File->R_Flag;
 	if(User_File->In_File == NULL)
 		Error("Cannot read from file '%s' because the file is open for writing only.", UCS2toASCIIString(UCS2String(User_File->Out_File->name())).c_str());
 	User_File->In_File = NULL; // take control over pointer
 
+	// read the data file directly, neither replaying nor recording the scene file tokens
+	Input_File->Tokens = Open_Token_Cache(Input_File->In_File->name());
+	Input_File->Replay = NULL;
+
 	EXPECT
 		CASE3 (PLUS_TOKEN,DASH_TOKEN,FLOAT_FUNCT_TOKEN)
 			UNGET
@@ -3611,6 +4148,9 @@ int Parser::Parse_Read_Value(DATA_FILE *User_File,int Previous,int *NumberPtr,vo
 
 		OTHERWISE
 			Input_File->In_File = Temp;
+			Input_File->Tokens = Temp_Tokens;
+			Input_File->Replay = Temp_Replay;
+			Input_File->Replay_Index = Temp_Replay_Index;
 			Expectation_Error ("float, vector, or string literal");
 		END_CASE
 	END_EXPECT
@@ -3624,6 +4164,12 @@ int Parser::Parse_Read_Value(DATA_FILE *User_File,int Previous,int *NumberPtr,vo
 	User_File->In_File = Input_File->In_File; // return control over pointer
 	Input_File->In_File = Temp;
 	Input_File->R_Flag = Temp_R_Flag;
+	Release_Token_Cache(Input_File->Tokens);
+	Input_File->Tokens = Temp_Tokens;
+	Input_File->Replay = Temp_Replay;
+	Input_File->Replay_Index = Temp_Replay_Index;
+	if (Token.FileHandle == NULL)
+		Token.FileHandle = (Input_File->Replay != NULL) ? Input_File->Replay : Input_File->Tokens;
 
 	return End_File ;
 }
@@ -3793,10 +4339,12 @@ void Parser::Inc_CS_Index(void)
 	{
 		Error("Too many nested conditionals or macros.");
 	}
-	Cond_Stack[CS_Index].Macro_File = NULL;
-	Cond_Stack[CS_Index].Macro_Return_Name = NULL;
 	Cond_Stack[CS_Index].PMac = NULL;
-	Cond_Stack[CS_Index].Loop_File = NULL;
+	Cond_Stack[CS_Index].Token_Pos.Tokens = NULL;
+	Cond_Stack[CS_Index].Token_Pos.Index = 0;
+	Cond_Stack[CS_Index].Macro_Tokens = NULL;
+	Cond_Stack[CS_Index].Recording = NULL;
+	Cond_Stack[CS_Index].Profile_Frame = -1;
 	Cond_Stack[CS_Index].Loop_Identifier = NULL;
 }
 
@@ -3806,7 +4354,6 @@ int Parser::Parse_Ifdef_Param (void)
 	SYM_ENTRY *Entry;
 	int retval = false;
 	int i,j,k;
-	register int c;
 	DBL val;
 	POV_ARRAY *a;
 
@@ -3835,11 +4382,7 @@ int Parser::Parse_Ifdef_Param (void)
 
 			if (Token.NumberPtr && *(Token.NumberPtr)==ARRAY_ID_TOKEN)
 			{
-				Skip_Spaces();
-				c = Echo_getc();
-				Echo_ungetc(c);
-
-				if (c!='[')
+				if (!Subscript_Follows())
 				{
 					retval = true;
 					break;
@@ -4038,6 +4581,10 @@ void Parser::IncludeHeader(const UCS2String& temp)
 
 	Input_File = &Include_Files[Include_File_Index];
 	Input_File->In_File = NULL;
+	Input_File->Tokens = NULL;
+	Input_File->Replay = NULL;
+	Input_File->Replay_Index = 0;
+	Input_File->Profile_Frame = -1;
 	IStream *is = Locate_File (this, sceneData, temp.c_str(),POV_File_Text_INC,b,true);
 	if(is == NULL)
 	{
@@ -4048,6 +4595,12 @@ void Parser::IncludeHeader(const UCS2String& temp)
 		Input_File->In_File = new ITextStream(b.c_str(), is);
 
 	Input_File->R_Flag=false;
+	Input_File->Tokens = Open_Token_Cache(Input_File->In_File->name());
+
+	if (!sceneData->includeCachePath.empty())
+		Open_Include_Cache(b);
+
+	Input_File->Profile_Frame = Enter_Profile_Site(ParserProfile::kFile, UCS2toASCIIString(b).c_str(), NULL, 0);
 
 	Add_Sym_Table();
 
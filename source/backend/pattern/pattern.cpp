@@ -245,6 +245,58 @@ int GetNoiseGen (const TPATTERN *TPat, const TraceThreadData *Thread)
 	return noise_gen;
 }
 
+/*****************************************************************************
+*
+* FUNCTION
+*
+*   Invalidate_Pattern_Cache
+*
+* INPUT
+*
+*   Thread -- thread whose pattern cache is invalidated
+*
+* OUTPUT
+*
+* RETURNS
+*
+* AUTHOR
+*
+*   -
+*
+* DESCRIPTION
+*
+*   Called whenever the texture of a new intersection is computed, so that the
+*   cached pattern values are never used for a different intersection.
+*
+* CHANGES
+*
+*   -
+*
+******************************************************************************/
+
+void Invalidate_Pattern_Cache (TraceThreadData *Thread)
+{
+	if (++Thread->Pattern_Cache_Stamp == 0)
+	{
+		memset(Thread->Pattern_Cache, 0, sizeof(Thread->Pattern_Cache));
+		Thread->Pattern_Cache_Stamp = 1;
+	}
+}
+
+// Pattern cache slot of a pattern and point.
+static inline unsigned int Pattern_Cache_Slot (const TPATTERN *TPat, const VECTOR EPoint)
+{
+	POV_ULONG bits[3];
+	POV_ULONG h;
+
+	memcpy(bits, EPoint, sizeof(bits));
+	h = (POV_ULONG)(size_t)TPat ^ (bits[X] * 0x9E3779B97F4A7C15ULL) ^ (bits[Y] * 0xC2B2AE3D27D4EB4FULL) ^ (bits[Z] * 0x165667B19E3779F9ULL);
+	h ^= h >> 32;
+	h ^= h >> 15;
+
+	return (unsigned int)h & (PATTERN_CACHE_SIZE - 1);
+}
+
 /*****************************************************************************
 *
 * FUNCTION
@@ -277,9 +329,25 @@ int GetNoiseGen (const TPATTERN *TPat, const TraceThreadData *Thread)
 DBL Evaluate_TPat (const TPATTERN *TPat, const VECTOR EPoint, const Intersection *Isection, const Ray *ray, TraceThreadData *Thread)
 {
 	DBL value = 0.0;
+	Pattern_Cache_Entry *entry = NULL;
 
 	/* NK 19 Nov 1999 removed Warp_EPoint call */
 
+	/* These depend on the normal or the ray as well as the point. */
+	if ((Thread != NULL) &&
+	    (TPat->Type != SLOPE_PATTERN) && (TPat->Type != AOI_PATTERN) && (TPat->Type != PIGMENT_PATTERN))
+	{
+		Thread->Stats()[PatternCache_Tests]++;
+
+		entry = &Thread->Pattern_Cache[Pattern_Cache_Slot(TPat, EPoint)];
+		if ((entry->Stamp == Thread->Pattern_Cache_Stamp) && (entry->Pattern == TPat) &&
+		    (entry->Point[X] == EPoint[X]) && (entry->Point[Y] == EPoint[Y]) && (entry->Point[Z] == EPoint[Z]))
+		{
+			Thread->Stats()[PatternCache_Tests_Succeeded]++;
+			return entry->Value;
+		}
+	}
+
 	switch(TPat->Type)
 	{
 		case AGATE_PATTERN:       value = agate_pattern      (EPoint, TPat, GetNoiseGen(TPat, Thread)); break;
@@ -367,6 +435,14 @@ DBL Evaluate_TPat (const TPATTERN *TPat, const VECTOR EPoint, const Intersection
 			throw POV_EXCEPTION_STRING("Unknown Wave Type.");
 	}
 
+	if (entry != NULL)
+	{
+		entry->Pattern = TPat;
+		Assign_Vector(entry->Point, EPoint);
+		entry->Value = value;
+		entry->Stamp = Thread->Pattern_Cache_Stamp;
+	}
+
 	return value;
 }
 
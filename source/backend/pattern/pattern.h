@@ -257,6 +257,21 @@ struct Crackle_Cache_Entry
 
 typedef boost::unordered_map<Crackle_Cell_Coord, Crackle_Cache_Entry, boost::hash<Crackle_Cell_Coord> > Crackle_Cache_Type;
 
+/*
+ * Per-thread memo of recent Evaluate_TPat results, keyed by pattern and
+ * (warped) evaluation point. Entries are only valid while their stamp equals
+ * the thread's current one; Invalidate_Pattern_Cache starts a new stamp for
+ * each intersection.
+ */
+
+struct Pattern_Cache_Entry
+{
+	const TPATTERN *Pattern;
+	VECTOR Point;
+	DBL Value;
+	unsigned int Stamp;
+};
+
 /*****************************************************************************
 * Global variables
 ******************************************************************************/
@@ -266,6 +281,8 @@ typedef boost::unordered_map<Crackle_Cell_Coord, Crackle_Cache_Entry, boost::has
 * Global constants
 ******************************************************************************/
 
+// number of entries of the pattern cache, must be a power of 2
+const int PATTERN_CACHE_SIZE = 32;
 
 /*****************************************************************************
 * Global functions
@@ -283,6 +300,7 @@ DBL quilt_cubic (DBL t,DBL p1,DBL p2);
 void Search_Blend_Map (DBL value, const BLEND_MAP *Blend_Map,
                        BLEND_MAP_ENTRY **Prev, BLEND_MAP_ENTRY **Cur);
 int GetNoiseGen (const TPATTERN *TPat, const TraceThreadData *Thread);
+void Invalidate_Pattern_Cache (TraceThreadData *Thread);
 
 DENSITY_FILE *Create_Density_File ();
 DENSITY_FILE *Copy_Density_File (DENSITY_FILE *);
@@ -0,0 +1,546 @@
+/*******************************************************************************
+ * renderprocess.cpp
+ *
+ * This file contains the classes distributing the final trace over worker processes.
+ *
+ * from Persistence of Vision Ray Tracer ('POV-Ray') version 3.7.
+ * Copyright 1991-2003 Persistence of Vision Team
+ * Copyright 2003-2009 Persistence of Vision Raytracer Pty. Ltd.
+ * ---------------------------------------------------------------------------
+ * NOTICE: This source code file is provided so that users may experiment
+ * with enhancements to POV-Ray and to port the software to platforms other
+ * than those supported by the POV-Ray developers. There are strict rules
+ * regarding how you are permitted to use this file. These rules are contained
+ * in the distribution and derivative versions licenses which should have been
+ * provided with this file.
+ *
+ * These licences may be found online, linked from the end-user license
+ * agreement that is located at http://www.povray.org/povlegal.html
+ * ---------------------------------------------------------------------------
+ * POV-Ray is based on the popular DKB raytracer version 2.12.
+ * DKBTrace was originally written by David K. Buck.
+ * DKBTrace Ver 2.0-2.12 were written by David K. Buck & Aaron A. Collins.
+ * ---------------------------------------------------------------------------
+ * $File: //depot/povray/smp/source/backend/render/renderprocess.cpp $
+ * $Revision: #1 $
+ * $Change: 5401 $
+ * $DateTime: 2011/02/08 21:06:55 $
+ * $Author: clipka $
+ *******************************************************************************/
+
+/*********************************************************************************
+ * NOTICE
+ *
+ * This file is part of a BETA-TEST version of POV-Ray version 3.7. It is not
+ * final code. Use of this source file is governed by both the standard POV-Ray
+ * licences referred to in the copyright header block above this notice, and the
+ * following additional restrictions numbered 1 through 4 below:
+ *
+ *   1. This source file may not be re-distributed without the written permission
+ *      of Persistence of Vision Raytracer Pty. Ltd.
+ *
+ *   2. This notice may not be altered or removed.
+ *   
+ *   3. Binaries generated from this source file by individuals for their own
+ *      personal use may not be re-distributed without the written permission
+ *      of Persistence of Vision Raytracer Pty. Ltd. Such personal-use binaries
+ *      are not required to have a timeout, and thus permission is granted in
+ *      these circumstances only to disable the timeout code contained within
+ *      the beta software.
+ *   
+ *   4. Binaries generated from this source file for use within an organizational
+ *      unit (such as, but not limited to, a company or university) may not be
+ *      distributed beyond the local organizational unit in which they were made,
+ *      unless written permission is obtained from Persistence of Vision Raytracer
+ *      Pty. Ltd. Additionally, the timeout code implemented within the beta may
+ *      not be disabled or otherwise bypassed in any manner.
+ *
+ * The following text is not part of the above conditions and is provided for
+ * informational purposes only.
+ *
+ * The purpose of the no-redistribution clause is to attempt to keep the
+ * circulating copies of the beta source fresh. The only authorized distribution
+ * point for the source code is the POV-Ray website and Perforce server, where
+ * the code will be kept up to date with recent fixes. Additionally the beta
+ * timeout code mentioned above has been a standard part of POV-Ray betas since
+ * version 1.0, and is intended to reduce bug reports from old betas as well as
+ * keep any circulating beta binaries relatively fresh.
+ *
+ * All said, however, the POV-Ray developers are open to any reasonable request
+ * for variations to the above conditions and will consider them on a case-by-case
+ * basis.
+ *
+ * Additionally, the developers request your co-operation in fixing bugs and
+ * generally improving the program. If submitting a bug-fix, please ensure that
+ * you quote the revision number of the file shown above in the copyright header
+ * (see the '$Revision:' field). This ensures that it is possible to determine
+ * what specific copy of the file you are working with. The developers also would
+ * like to make it known that until POV-Ray 3.7 is out of beta, they would prefer
+ * to emphasize the provision of bug fixes over the addition of new features.
+ *
+ * Persons wishing to enhance this source are requested to take the above into
+ * account. It is also strongly suggested that such enhancements are started with
+ * a recent copy of the source.
+ *
+ * The source code page (see http://www.povray.org/beta/source/) sets out the
+ * conditions under which the developers are willing to accept contributions back
+ * into the primary source tree. Please refer to those conditions prior to making
+ * any changes to this source, if you wish to submit those changes for inclusion
+ * with POV-Ray.
+ *
+ *********************************************************************************/
+
+#include <vector>
+
+#include <boost/bind.hpp>
+
+// frame.h must always be the first POV file included (pulls in platform config)
+#include "backend/frame.h"
+
+#include "base/timer.h"
+
+#include "backend/render/renderprocess.h"
+#include "backend/scene/threaddata.h"
+#include "backend/scene/view.h"
+
+#if (SYS_RENDER_PROCESSES == 1)
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#endif
+
+// this must be the last file included
+#include "base/povdebug.h"
+
+namespace pov
+{
+
+using namespace pov_base;
+
+#if (SYS_RENDER_PROCESSES == 1)
+
+#ifdef MSG_NOSIGNAL
+const int RENDER_PROCESS_SEND_FLAGS = MSG_NOSIGNAL;
+#else
+const int RENDER_PROCESS_SEND_FLAGS = 0;
+#endif
+
+bool RenderProcessStream::read(void *ptr, size_t count)
+{
+	char *p = (char *)ptr;
+
+	while(count > 0)
+	{
+		ssize_t n = recv(fd, p, count, 0);
+
+		if(n < 0)
+		{
+			if(errno == EINTR)
+				continue;
+			return false;
+		}
+		if(n == 0)
+			return false;
+
+		p += n;
+		count -= n;
+	}
+
+	return true;
+}
+
+bool RenderProcessStream::write(const void *ptr, size_t count)
+{
+	const char *p = (const char *)ptr;
+
+	while(count > 0)
+	{
+		ssize_t n = send(fd, p, count, RENDER_PROCESS_SEND_FLAGS);
+
+		if(n < 0)
+		{
+			if(errno == EINTR)
+				continue;
+			return false;
+		}
+
+		p += n;
+		count -= n;
+	}
+
+	return true;
+}
+
+bool RenderProcessStream::Wait(unsigned int timeout)
+{
+	struct pollfd pfd;
+
+	pfd.fd = fd;
+	pfd.events = POLLIN;
+	pfd.revents = 0;
+
+	int n = poll(&pfd, 1, timeout);
+
+	// report errors as available data, so the following read fails
+	if(n < 0)
+		return (errno != EINTR);
+
+	return (n > 0);
+}
+
+#else
+
+bool RenderProcessStream::read(void *, size_t)
+{
+	return false;
+}
+
+bool RenderProcessStream::write(const void *, size_t)
+{
+	return false;
+}
+
+bool RenderProcessStream::Wait(unsigned int)
+{
+	return true;
+}
+
+#endif // SYS_RENDER_PROCESSES
+
+RenderProcessClient::RenderProcessClient(int fd) :
+	stream(fd)
+{
+}
+
+bool RenderProcessClient::GetNextRectangle(POVRect& rect, unsigned int& serial)
+{
+	POVMS_Object request(kPOVObjectClass_Rectangle);
+	POVMS_Object reply;
+
+	request.Write(stream);
+	reply.Read(stream);
+
+	// a reply without block id means there are no more blocks
+	if(reply.Exist(kPOVAttrib_PixelId) == false)
+		return false;
+
+	serial = reply.GetInt(kPOVAttrib_PixelId);
+	rect.left = reply.GetInt(kPOVAttrib_Left);
+	rect.top = reply.GetInt(kPOVAttrib_Top);
+	rect.right = reply.GetInt(kPOVAttrib_Right);
+	rect.bottom = reply.GetInt(kPOVAttrib_Bottom);
+
+	return true;
+}
+
+void RenderProcessClient::CompletedRectangle(const POVRect& rect, unsigned int serial, const vector<Colour>& pixels, unsigned int size, bool final)
+{
+	POVMS_Object pixelblock(kPOVObjectClass_PixelData);
+	vector<POVMSFloat> pixelvector;
+
+	pixelvector.reserve(pixels.size() * 5);
+
+	for(vector<Colour>::const_iterator i(pixels.begin()); i != pixels.end(); i++)
+	{
+		pixelvector.push_back(i->red());
+		pixelvector.push_back(i->green());
+		pixelvector.push_back(i->blue());
+		pixelvector.push_back(i->filter());
+		pixelvector.push_back(i->transm());
+	}
+
+	pixelblock.SetFloatVector(kPOVAttrib_PixelBlock, pixelvector);
+	if(final == true) // only final blocks get a block id, as in the pixel messages sent to the frontend
+		pixelblock.SetInt(kPOVAttrib_PixelId, serial);
+	pixelblock.SetInt(kPOVAttrib_PixelSize, size);
+	pixelblock.SetInt(kPOVAttrib_Left, rect.left);
+	pixelblock.SetInt(kPOVAttrib_Top, rect.top);
+	pixelblock.SetInt(kPOVAttrib_Right, rect.right);
+	pixelblock.SetInt(kPOVAttrib_Bottom, rect.bottom);
+
+	pixelblock.Write(stream);
+}
+
+void RenderProcessClient::SendStatistics(const RenderStatistics& stats, unsigned int htl, POV_LONG cpuTime)
+{
+	POVMS_Object statsobj(kPOVObjectClass_RenderStatistics);
+	vector<POVMSLong> intstats;
+	vector<POVMSFloat> fpstats;
+
+	intstats.reserve(MaxIntStat);
+	for(int i = 0; i < MaxIntStat; i++)
+		intstats.push_back((POVMSLong)(stats[IntStatsIndex(i)]));
+
+	fpstats.reserve(MaxFPStat);
+	for(int i = 0; i < MaxFPStat; i++)
+		fpstats.push_back((POVMSFloat)(stats[FPStatsIndex(i)]));
+
+	statsobj.SetLongVector(kPOVAttrib_IntStatistics, intstats);
+	statsobj.SetFloatVector(kPOVAttrib_FPStatistics, fpstats);
+	statsobj.SetInt(kPOVAttrib_TraceLevel, htl);
+	statsobj.SetLong(kPOVAttrib_CPUTime, cpuTime);
+
+	statsobj.Write(stream);
+}
+
+RenderProcessPool::RenderProcessPool(ViewData *vd, unsigned int count, const boost::function0<Task *>& tf) :
+	viewData(vd),
+	processes(count),
+	taskFactory(tf)
+{
+}
+
+RenderProcessPool::~RenderProcessPool()
+{
+	for(unsigned int i = 0; i < processes.size(); i++)
+		Finish(i, true);
+}
+
+bool RenderProcessPool::Supported()
+{
+	return (SYS_RENDER_PROCESSES == 1);
+}
+
+int RenderProcessPool::GetSocket(unsigned int index) const
+{
+	return processes[index].fd;
+}
+
+#if (SYS_RENDER_PROCESSES == 1)
+
+void RenderProcessPool::Start(TaskQueue&)
+{
+	for(unsigned int i = 0; i < processes.size(); i++)
+	{
+		int fds[2];
+
+		if(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0)
+			continue;
+
+#ifdef SO_NOSIGPIPE
+		int nosigpipe = 1;
+		(void)setsockopt(fds[0], SOL_SOCKET, SO_NOSIGPIPE, &nosigpipe, sizeof(nosigpipe));
+		(void)setsockopt(fds[1], SOL_SOCKET, SO_NOSIGPIPE, &nosigpipe, sizeof(nosigpipe));
+#endif
+
+		pid_t pid = fork();
+
+		if(pid == 0)
+		{
+			// the worker must not hold the coordinating ends of any socket, or
+			// the coordinating process would never see the others' sockets close
+			close(fds[0]);
+			for(unsigned int j = 0; j < i; j++)
+			{
+				if(processes[j].fd >= 0)
+					close(processes[j].fd);
+			}
+
+			RunWorker(fds[1]);
+		}
+
+		close(fds[1]);
+
+		if(pid < 0)
+		{
+			close(fds[0]);
+			continue;
+		}
+
+		processes[i].pid = pid;
+		processes[i].fd = fds[0];
+	}
+}
+
+void RenderProcessPool::Finish(unsigned int index, bool kill)
+{
+	Process& process = processes[index];
+
+	if(process.fd >= 0)
+	{
+		close(process.fd);
+		process.fd = -1;
+	}
+
+	if(process.pid > 0)
+	{
+		// signals other than SIGKILL may be blocked in all threads and
+		// only be received by a signal handling thread the worker lacks
+		if(kill == true)
+			(void)::kill(process.pid, SIGKILL);
+
+		while((waitpid(process.pid, NULL, 0) < 0) && (errno == EINTR)) { }
+		process.pid = -1;
+	}
+}
+
+static void RenderProcessTaskDone()
+{
+}
+
+void RenderProcessPool::RunWorker(int fd)
+{
+	int result = 1;
+
+	try
+	{
+		RenderProcessClient client(fd);
+		Task *task;
+
+		// this is the worker's private copy of the view data, so
+		// diverting the block dispatch does not affect the other processes
+		viewData->renderProcess = &client;
+
+		task = taskFactory();
+		task->Start(boost::bind(&RenderProcessTaskDone));
+
+		while(task->IsDone() == false)
+			Delay(10);
+
+		if(task->Failed() == false)
+		{
+			client.SendStatistics(((ViewThreadData *)(task->GetDataPtr()))->Stats(), viewData->highestTraceLevel, task->ConsumedCPUTime());
+			result = 0;
+		}
+	}
+	catch(...)
+	{
+	}
+
+	close(fd);
+
+	// leave without running any destructors or exit handlers inherited from the coordinating process
+	_exit(result);
+}
+
+#else
+
+void RenderProcessPool::Start(TaskQueue&)
+{
+}
+
+void RenderProcessPool::Finish(unsigned int, bool)
+{
+}
+
+void RenderProcessPool::RunWorker(int)
+{
+}
+
+#endif // SYS_RENDER_PROCESSES
+
+RenderProcessTask::RenderProcessTask(ViewData *vd, shared_ptr<RenderProcessPool> p, unsigned int i) :
+	RenderTask(vd),
+	pool(p),
+	index(i),
+	workerCPUTime(-1)
+{
+}
+
+RenderProcessTask::~RenderProcessTask()
+{
+}
+
+void RenderProcessTask::Run()
+{
+	int fd = pool->GetSocket(index);
+
+	if(fd < 0)
+		throw POV_EXCEPTION(kCannotHandleRequestErr, "Cannot start render process.");
+
+	RenderProcessStream stream(fd);
+	unsigned int renderThread = GetViewData()->AttachRenderThread();
+	POVRect rect;
+	unsigned int serial = 0;
+
+	while(true)
+	{
+		POVMS_Object msg;
+
+		while(stream.Wait(100) == false)
+			Cooperate();
+
+		Cooperate();
+
+		try
+		{
+			msg.Read(stream);
+		}
+		catch(pov_base::Exception&)
+		{
+			throw POV_EXCEPTION(kCannotHandleRequestErr, "Render process terminated unexpectedly.");
+		}
+
+		switch(msg.GetType(kPOVMSObjectClassID))
+		{
+			case kPOVObjectClass_Rectangle:
+			{
+				POVMS_Object reply(kPOVObjectClass_Rectangle);
+
+				if(GetViewData()->GetNextRectangle(rect, serial, renderThread) == true)
+				{
+					reply.SetInt(kPOVAttrib_PixelId, serial);
+					reply.SetInt(kPOVAttrib_Left, rect.left);
+					reply.SetInt(kPOVAttrib_Top, rect.top);
+					reply.SetInt(kPOVAttrib_Right, rect.right);
+					reply.SetInt(kPOVAttrib_Bottom, rect.bottom);
+				}
+
+				reply.Write(stream);
+				break;
+			}
+			case kPOVObjectClass_PixelData:
+			{
+				vector<POVMSFloat> pixelvector(msg.GetFloatVector(kPOVAttrib_PixelBlock));
+				vector<Colour> pixels;
+
+				pixels.reserve(pixelvector.size() / 5);
+				for(size_t i = 0; i + 4 < pixelvector.size(); i += 5)
+					pixels.push_back(Colour(pixelvector[i], pixelvector[i + 1], pixelvector[i + 2], pixelvector[i + 3], pixelvector[i + 4]));
+
+				GetViewData()->CompletedRectangle(rect, serial, pixels, msg.GetInt(kPOVAttrib_PixelSize), msg.Exist(kPOVAttrib_PixelId));
+				break;
+			}
+			case kPOVObjectClass_RenderStatistics:
+			{
+				vector<POVMSLong> intstats(msg.GetLongVector(kPOVAttrib_IntStatistics));
+				vector<POVMSFloat> fpstats(msg.GetFloatVector(kPOVAttrib_FPStatistics));
+				RenderStatistics& stats = GetViewDataPtr()->Stats();
+
+				for(size_t i = 0; (i < intstats.size()) && (i < MaxIntStat); i++)
+					stats[IntStatsIndex(i)] += (POV_ULONG)(intstats[i]);
+				for(size_t i = 0; (i < fpstats.size()) && (i < MaxFPStat); i++)
+					stats[FPStatsIndex(i)] += fpstats[i];
+
+				GetViewData()->SetHighestTraceLevel(msg.GetInt(kPOVAttrib_TraceLevel));
+				workerCPUTime = msg.GetLong(kPOVAttrib_CPUTime);
+
+				// the statistics are the last thing a worker sends
+				pool->Finish(index, false);
+				return;
+			}
+			default:
+				throw POV_EXCEPTION(kCannotHandleDataErr, "Unexpected data from render process.");
+		}
+	}
+}
+
+void RenderProcessTask::Stopped()
+{
+	pool->Finish(index, true);
+}
+
+void RenderProcessTask::Finish()
+{
+	pool->Finish(index, true);
+
+	GetViewDataPtr()->timeType = SceneThreadData::kRenderTime;
+	GetViewDataPtr()->realTime = ConsumedRealTime();
+	GetViewDataPtr()->cpuTime = workerCPUTime;
+}
+
+}
@@ -0,0 +1,281 @@
+/*******************************************************************************
+ * renderprocess.h
+ *
+ * This file contains the classes distributing the final trace over worker processes.
+ *
+ * from Persistence of Vision Ray Tracer ('POV-Ray') version 3.7.
+ * Copyright 1991-2003 Persistence of Vision Team
+ * Copyright 2003-2009 Persistence of Vision Raytracer Pty. Ltd.
+ * ---------------------------------------------------------------------------
+ * NOTICE: This source code file is provided so that users may experiment
+ * with enhancements to POV-Ray and to port the software to platforms other
+ * than those supported by the POV-Ray developers. There are strict rules
+ * regarding how you are permitted to use this file. These rules are contained
+ * in the distribution and derivative versions licenses which should have been
+ * provided with this file.
+ *
+ * These licences may be found online, linked from the end-user license
+ * agreement that is located at http://www.povray.org/povlegal.html
+ * ---------------------------------------------------------------------------
+ * POV-Ray is based on the popular DKB raytracer version 2.12.
+ * DKBTrace was originally written by David K. Buck.
+ * DKBTrace Ver 2.0-2.12 were written by David K. Buck & Aaron A. Collins.
+ * ---------------------------------------------------------------------------
+ * $File: //depot/povray/smp/source/backend/render/renderprocess.h $
+ * $Revision: #1 $
+ * $Change: 5401 $
+ * $DateTime: 2011/02/08 21:06:55 $
+ * $Author: clipka $
+ *******************************************************************************/
+
+/*********************************************************************************
+ * NOTICE
+ *
+ * This file is part of a BETA-TEST version of POV-Ray version 3.7. It is not
+ * final code. Use of this source file is governed by both the standard POV-Ray
+ * licences referred to in the copyright header block above this notice, and the
+ * following additional restrictions numbered 1 through 4 below:
+ *
+ *   1. This source file may not be re-distributed without the written permission
+ *      of Persistence of Vision Raytracer Pty. Ltd.
+ *
+ *   2. This notice may not be altered or removed.
+ *   
+ *   3. Binaries generated from this source file by individuals for their own
+ *      personal use may not be re-distributed without the written permission
+ *      of Persistence of Vision Raytracer Pty. Ltd. Such personal-use binaries
+ *      are not required to have a timeout, and thus permission is granted in
+ *      these circumstances only to disable the timeout code contained within
+ *      the beta software.
+ *   
+ *   4. Binaries generated from this source file for use within an organizational
+ *      unit (such as, but not limited to, a company or university) may not be
+ *      distributed beyond the local organizational unit in which they were made,
+ *      unless written permission is obtained from Persistence of Vision Raytracer
+ *      Pty. Ltd. Additionally, the timeout code implemented within the beta may
+ *      not be disabled or otherwise bypassed in any manner.
+ *
+ * The following text is not part of the above conditions and is provided for
+ * informational purposes only.
+ *
+ * The purpose of the no-redistribution clause is to attempt to keep the
+ * circulating copies of the beta source fresh. The only authorized distribution
+ * point for the source code is the POV-Ray website and Perforce server, where
+ * the code will be kept up to date with recent fixes. Additionally the beta
+ * timeout code mentioned above has been a standard part of POV-Ray betas since
+ * version 1.0, and is intended to reduce bug reports from old betas as well as
+ * keep any circulating beta binaries relatively fresh.
+ *
+ * All said, however, the POV-Ray developers are open to any reasonable request
+ * for variations to the above conditions and will consider them on a case-by-case
+ * basis.
+ *
+ * Additionally, the developers request your co-operation in fixing bugs and
+ * generally improving the program. If submitting a bug-fix, please ensure that
+ * you quote the revision number of the file shown above in the copyright header
+ * (see the '$Revision:' field). This ensures that it is possible to determine
+ * what specific copy of the file you are working with. The developers also would
+ * like to make it known that until POV-Ray 3.7 is out of beta, they would prefer
+ * to emphasize the provision of bug fixes over the addition of new features.
+ *
+ * Persons wishing to enhance this source are requested to take the above into
+ * account. It is also strongly suggested that such enhancements are started with
+ * a recent copy of the source.
+ *
+ * The source code page (see http://www.povray.org/beta/source/) sets out the
+ * conditions under which the developers are willing to accept contributions back
+ * into the primary source tree. Please refer to those conditions prior to making
+ * any changes to this source, if you wish to submit those changes for inclusion
+ * with POV-Ray.
+ *
+ *********************************************************************************/
+
+#ifndef POVRAY_BACKEND_RENDERPROCESS_H
+#define POVRAY_BACKEND_RENDERPROCESS_H
+
+#include <vector>
+
+#include <boost/function.hpp>
+
+#include "backend/frame.h"
+#include "backend/render/rendertask.h"
+#include "backend/scene/view.h"
+#include "backend/support/statistics.h"
+
+namespace pov
+{
+
+/**
+ *	Byte stream over one end of a connected socket, for use with the
+ *	POVMS_Object Read and Write templates. Each read and write transfers
+ *	the whole buffer or fails.
+ */
+class RenderProcessStream
+{
+	public:
+		RenderProcessStream(int f) : fd(f) { }
+
+		bool read(void *ptr, size_t count);
+		bool write(const void *ptr, size_t count);
+
+		/**
+		 *	Wait until data can be read.
+		 *	@param	timeout			Maximum time to wait in milliseconds.
+		 *	@return					True if data or the end of the stream is
+		 *							available, false if the time expired.
+		 */
+		bool Wait(unsigned int timeout);
+	private:
+		int fd;
+};
+
+/**
+ *	Worker process side of a view's final trace. The view data copy a
+ *	worker process inherits hands blocks out through this class instead of
+ *	its own block queue: each block is requested from the coordinating
+ *	process, and the finished pixels are sent back to it rather than to
+ *	the frontend.
+ *
+ *	A worker process runs a single trace task, so no locking is done.
+ */
+class RenderProcessClient
+{
+	public:
+		RenderProcessClient(int fd);
+
+		/**
+		 *	Request the next block from the coordinating process.
+		 *	@param	rect			Rectangle to render.
+		 *	@param	serial			Rectangle serial number.
+		 *	@return					True if a block was assigned, false if there are no more blocks.
+		 */
+		bool GetNextRectangle(POVRect& rect, unsigned int& serial);
+
+		/**
+		 *	Return the pixels of a block to the coordinating process.
+		 *	@param	rect			Rectangle just completed.
+		 *	@param	serial			Serial number of rectangle just completed.
+		 *	@param	pixels			Pixels of the rectangle, row by row.
+		 *	@param	size			Size of each pixel (width and height).
+		 *	@param	final			Mark the block as completely rendered for continue-trace.
+		 */
+		void CompletedRectangle(const POVRect& rect, unsigned int serial, const vector<Colour>& pixels, unsigned int size, bool final);
+
+		/**
+		 *	Send the statistics of the worker process once its trace task is done.
+		 *	@param	stats			Statistics of the trace task.
+		 *	@param	htl				Highest trace level reached.
+		 *	@param	cpuTime			CPU time used by the trace task in milliseconds.
+		 */
+		void SendStatistics(const RenderStatistics& stats, unsigned int htl, POV_LONG cpuTime);
+	private:
+		RenderProcessStream stream;
+};
+
+/**
+ *	Worker processes rendering the final trace of a view.
+ *
+ *	The processes are forked from the render control thread at a point
+ *	where no render task is running, so each inherits a copy-on-write
+ *	snapshot of the parsed scene, the photon maps and the radiosity
+ *	pretrace results and does not need to parse anything. Each process
+ *	runs one trace task and is connected to the coordinating process by a
+ *	socket carrying POVMS objects, where a RenderProcessTask stands in
+ *	for it.
+ */
+class RenderProcessPool
+{
+	public:
+		/**
+		 *	Create a pool. No processes are started until Start is called.
+		 *	@param	vd				View data of the view to render.
+		 *	@param	count			Number of worker processes.
+		 *	@param	tf				Creates the trace task a worker process runs.
+		 */
+		RenderProcessPool(ViewData *vd, unsigned int count, const boost::function0<Task *>& tf);
+		~RenderProcessPool();
+
+		/**
+		 *	Whether worker processes are supported on this platform.
+		 */
+		static bool Supported();
+
+		/**
+		 *	Get the number of worker processes.
+		 */
+		unsigned int GetCount() const { return processes.size(); }
+
+		/**
+		 *	Start the worker processes. To be queued with TaskQueue::AppendFunction
+		 *	after a sync, so no other render task is running while forking.
+		 */
+		void Start(TaskQueue&);
+
+		/**
+		 *	Get the socket connected to a worker process.
+		 *	@param	index			Worker process index.
+		 *	@return					Socket, or -1 if the process could not be started.
+		 */
+		int GetSocket(unsigned int index) const;
+
+		/**
+		 *	Close the connection to a worker process and wait for it to exit.
+		 *	@param	index			Worker process index.
+		 *	@param	kill			Terminate the process instead of waiting for it to finish.
+		 */
+		void Finish(unsigned int index, bool kill);
+	private:
+		struct Process
+		{
+			Process() : pid(-1), fd(-1) { }
+
+			int pid;
+			int fd;
+		};
+
+		/// view data
+		ViewData *viewData;
+		/// worker processes
+		vector<Process> processes;
+		/// creates the trace task of a worker process
+		boost::function0<Task *> taskFactory;
+
+		/**
+		 *	Body of a worker process. Does not return.
+		 */
+		void RunWorker(int fd);
+
+		/// not available
+		RenderProcessPool(const RenderProcessPool&);
+
+		/// not available
+		RenderProcessPool& operator=(const RenderProcessPool&);
+};
+
+/**
+ *	Stands in for one worker process in the coordinating process. It
+ *	answers the worker's block requests from the view's block dispatch,
+ *	forwards the returned pixels to the frontend like a trace task would,
+ *	and adds the worker's statistics to its own when the worker is done.
+ */
+class RenderProcessTask : public RenderTask
+{
+	public:
+		RenderProcessTask(ViewData *vd, shared_ptr<RenderProcessPool> p, unsigned int i);
+		virtual ~RenderProcessTask();
+
+		virtual void Run();
+		virtual void Stopped();
+		virtual void Finish();
+	private:
+		/// worker processes
+		shared_ptr<RenderProcessPool> pool;
+		/// index of the worker process
+		unsigned int index;
+		/// CPU time used by the worker process in milliseconds
+		POV_LONG workerCPUTime;
+};
+
+}
+
+#endif // POVRAY_BACKEND_RENDERPROCESS_H
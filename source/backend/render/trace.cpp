@@ -101,6 +101,7 @@
 #include "backend/scene/objects.h"
 #include "backend/pattern/pattern.h"
 #include "backend/pattern/warps.h"
+#include "backend/support/arena.h"
 #include "backend/support/imageutil.h"
 #include "backend/texture/normal.h"
 #include "backend/texture/pigment.h"
@@ -115,6 +116,7 @@
 #include "backend/shape/csg.h"
 #include "backend/shape/boxes.h"
 #include "backend/support/bsptree.h"
+#include "backend/support/bvhtree.h"
 
 // this must be the last file included
 #include "base/povdebug.h"
@@ -164,6 +166,11 @@ Trace::~Trace()
 }
 
 double Trace::TraceRay(const Ray& ray, Colour& colour, COLC weight, TraceTicket& ticket, bool continuedRay, DBL maxDepth)
+{
+	return TraceRay(ray, colour, weight, ticket, continuedRay, maxDepth, NULL);
+}
+
+double Trace::TraceRay(const Ray& ray, Colour& colour, COLC weight, TraceTicket& ticket, bool continuedRay, DBL maxDepth, const Intersection *isect)
 {
 	Intersection bestisect;
 	bool found;
@@ -184,10 +191,18 @@ double Trace::TraceRay(const Ray& ray, Colour& colour, COLC weight, TraceTicket&
 		return HUGE_VAL;
 	}
 
-	if (maxDepth >= EPSILON)
-		bestisect.Depth = maxDepth;
+	if(isect != NULL)
+	{
+		bestisect = *isect;
+		found = (bestisect.Object != NULL);
+	}
+	else
+	{
+		if (maxDepth >= EPSILON)
+			bestisect.Depth = maxDepth;
 
-	found = FindIntersection(bestisect, ray, precond, postcond);
+		found = FindIntersection(bestisect, ray, precond, postcond);
+	}
 
 	// Check if we're busy shooting too many radiosity sample rays at an unimportant object
 	if (ticket.radiosityImportanceQueried >= 0.0)
@@ -259,10 +274,43 @@ double Trace::TraceRay(const Ray& ray, Colour& colour, COLC weight, TraceTicket&
 		return bestisect.Depth;
 }
 
+void Trace::FindIntersectionPacket(const Ray * const *rays, Intersection * const *isects, unsigned int count)
+{
+	NoSomethingFlagRayObjectCondition precond;
+	TrueRayObjectCondition postcond;
+
+	if((sceneData->boundingMethod == 1) && (sceneData->boundingSlabs != NULL))
+		Intersect_BBox_Tree_Packet(packetStack, sceneData->boundingSlabs, rays, isects, count, precond, postcond, threadData);
+	else
+	{
+		for(unsigned int i = 0; i < count; i++)
+			FindIntersection(*isects[i], *rays[i], precond, postcond);
+	}
+}
+
 bool Trace::FindIntersection(Intersection& bestisect, const Ray& ray)
 {
 	switch(sceneData->boundingMethod)
 	{
+		case 3:
+		{
+			BSPIntersectFunctor ifn(bestisect, ray, sceneData->objects, threadData);
+			bool found = (*(sceneData->bvh))(ray, ifn, bestisect.Depth);
+
+			// test infinite objects
+			for(vector<ObjectPtr>::iterator it = sceneData->objects.begin() + sceneData->numberOfFiniteObjects; it != sceneData->objects.end(); it++)
+			{
+				Intersection isect;
+
+				if(FindIntersection(*it, isect, ray) && (isect.Depth < bestisect.Depth))
+				{
+					bestisect = isect;
+					found = true;
+				}
+			}
+
+			return found;
+		}
 		case 2:
 		{
 			BSPIntersectFunctor ifn(bestisect, ray, sceneData->objects, threadData);
@@ -318,6 +366,28 @@ bool Trace::FindIntersection(Intersection& bestisect, const Ray& ray, const RayO
 {
 	switch(sceneData->boundingMethod)
 	{
+		case 3:
+		{
+			BSPIntersectCondFunctor ifn(bestisect, ray, sceneData->objects, threadData, precondition, postcondition);
+			bool found = (*(sceneData->bvh))(ray, ifn, bestisect.Depth);
+
+			// test infinite objects
+			for(vector<ObjectPtr>::iterator it = sceneData->objects.begin() + sceneData->numberOfFiniteObjects; it != sceneData->objects.end(); it++)
+			{
+				if(precondition(ray, *it, 0.0) == true)
+				{
+					Intersection isect;
+
+					if(FindIntersection(*it, isect, ray, postcondition) && (isect.Depth < bestisect.Depth))
+					{
+						bestisect = isect;
+						found = true;
+					}
+				}
+			}
+
+			return found;
+		}
 		case 2:
 		{
 			BSPIntersectCondFunctor ifn(bestisect, ray, sceneData->objects, threadData, precondition, postcondition);
@@ -507,6 +577,9 @@ void Trace::ComputeTextureColour(Intersection& isect, Colour& colour, const Ray&
 	for (LightColorCacheList::iterator it = lightColorCache[lightColorCacheIndex].begin(); it != lightColorCache[lightColorCacheIndex].end(); it++)
 		it->tested = false;
 
+	// pattern values cached for a previous intersection must not be reused
+	Invalidate_Pattern_Cache(threadData);
+
 	// compute the surface normal
 	isect.Object->Normal(*rawnormal, &isect, threadData);
 
@@ -777,7 +850,8 @@ void Trace::ComputeLightedTexture(Colour& resultcolour, TEXTURE *texture, vector
 	RGBColour ambBackCol;
 	bool one_colour_found, colour_found;
 	bool tir_occured;
-	auto_ptr<PhotonGatherer> surfacePhotonGatherer(NULL); // TODO FIXME - auto_ptr why?  [CLi] why, to auto-destruct it of course! (e.g. in case of exception)
+	ArenaScope arenaScope(threadData->traceArena); // gives back the photon gatherer's memory, even in case of exception
+	ArenaPtr<PhotonGatherer> surfacePhotonGatherer; // must come after arenaScope so it is destructed first
 
 	WNRXVector listWNRX(wnrxPool); // "Weight, Normal, Reflectivity, eXponent"
 	assert(listWNRX->empty()); // verify that the WNRXVector pulled from the pool is in a cleaned-up condition
@@ -818,7 +892,7 @@ void Trace::ComputeLightedTexture(Colour& resultcolour, TEXTURE *texture, vector
 	one_colour_found = false;
 
 	if(sceneData->photonSettings.photonsEnabled && sceneData->surfacePhotonMap.numPhotons > 0)
-		surfacePhotonGatherer.reset(new PhotonGatherer(&sceneData->surfacePhotonMap, sceneData->photonSettings));
+		surfacePhotonGatherer.reset(new (ArenaPtr<PhotonGatherer>::Storage(threadData->traceArena)) PhotonGatherer(&sceneData->surfacePhotonMap, sceneData->photonSettings, &threadData->traceArena));
 
 	for(layer_number = 0, layer = texture; (layer != NULL) && (trans > ticket.adcBailout); layer_number++, layer = (TEXTURE *)layer->Next)
 	{
@@ -2309,6 +2383,8 @@ void Trace::ComputeShadowColour(const LightSource &lightsource, Intersection& is
 		return;
 	}
 
+	Invalidate_Pattern_Cache(threadData);
+
 	// Get the normal to the surface
 	isect.Object->Normal(*raw_Normal, &isect, threadData);
 
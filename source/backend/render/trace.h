@@ -103,6 +103,7 @@
 #include "backend/scene/threaddata.h"
 #include "backend/scene/objects.h"
 #include "backend/support/bsptree.h"
+#include "backend/support/bvhtree.h"
 #include "backend/support/randomsequences.h"
 #include "povrayold.h"
 
@@ -279,6 +280,16 @@ class Trace
 		 */
 		virtual double TraceRay(const Ray& ray, Colour& colour, COLC weight, TraceTicket& ticket, bool continuedRay, DBL maxDepth = 0.0);
 
+		/**
+		 *  Find the closest intersections of a packet of rays, as TraceRay() would for each of them.
+		 *
+		 *  @param[in]      rays                up to RAY_PACKET_SIZE rays
+		 *  @param[in,out]  isects              closest intersection of each ray, with the depth initialised
+		 *                                      to the maximum distance to look for an intersection
+		 *  @param[in]      count               number of rays
+		 */
+		void FindIntersectionPacket(const Ray * const *rays, Intersection * const *isects, unsigned int count);
+
 		bool FindIntersection(Intersection& isect, const Ray& ray);
 		bool FindIntersection(Intersection& isect, const Ray& ray, const RayObjectCondition& precondition, const RayObjectCondition& postcondition);
 		bool FindIntersection(ObjectPtr object, Intersection& isect, const Ray& ray, double closest = HUGE_VAL);
@@ -290,6 +301,14 @@ class Trace
 
 	protected: // TODO FIXME - should be private
 
+		/**
+		 *  Trace a ray whose closest intersection has already been determined by FindIntersectionPacket().
+		 *
+		 *  @param[in]      isect               closest intersection, or NULL to find it; an intersection
+		 *                                      without object means the ray doesn't hit anything
+		 */
+		double TraceRay(const Ray& ray, Colour& colour, COLC weight, TraceTicket& ticket, bool continuedRay, DBL maxDepth, const Intersection *isect);
+
 		/// structure used to cache reflection information for multi-layered textures
 		struct WNRX
 		{
@@ -338,6 +357,8 @@ class Trace
 
 		/// bounding slabs priority queue
 		PriorityQueue priorityQueue;
+		/// bounding slabs ray packet stack
+		BBoxPacketStack packetStack;
 		/// BSP tree mailbox
 		BSPTree::Mailbox mailbox;
 		/// area light grid buffer
@@ -239,6 +239,8 @@ TracePixel::TracePixel(ViewData *vd, TraceThreadData *td, unsigned int mtl, DBL
                        sceneData(vd->GetSceneData()),
                        threadData(td),
                        focalBlurData(NULL),
+                       usePackets(false),
+                       packetSize(0),
                        maxTraceLevel(mtl),
                        adcBailout(adcb),
                        pretrace(pt)
@@ -312,10 +314,94 @@ void TracePixel::SetupCamera(const Camera& cam)
 	useFocalBlur = ((camera.Aperture != 0.0) && (camera.Blur_Samples > 0));
 	if(useFocalBlur == true)
 		focalBlurData = new FocalBlurData(camera, threadData);
+
+	// packets are only worthwhile with the bounding slabs, and only give the same
+	// result if creating the primary ray does not depend on the tracing order
+	usePackets = (useFocalBlur == false) && (camera.Rays_Per_Pixel == 1) && (camera.Tnormal == NULL) &&
+	             (sceneData->boundingMethod == 1) && (sceneData->boundingSlabs != NULL);
+	packetSize = 0;
+}
+
+void TracePixel::PrepareRayPacket(DBL x, DBL y, unsigned int count, DBL width, DBL height)
+{
+	const Ray *rays[RAY_PACKET_SIZE];
+	Intersection *isects[RAY_PACKET_SIZE];
+	unsigned int n = 0;
+
+	packetSize = 0;
+
+	if(usePackets == false)
+		return;
+
+	packetSize = min(count, RAY_PACKET_SIZE);
+	packetWidth = width;
+	packetHeight = height;
+
+	for(unsigned int i = 0; i < packetSize; i++)
+	{
+		packetX[i] = x + DBL(i);
+		packetY[i] = y;
+		packetPending[i] = true;
+
+		packetRays[i] = Ray();
+		packetRayValid[i] = CreateCameraRay(packetRays[i], packetX[i], packetY[i], width, height, 0);
+
+		packetIntersections[i] = Intersection();
+		if(camera.Max_Ray_Distance >= EPSILON)
+			packetIntersections[i].Depth = camera.Max_Ray_Distance;
+
+		if(packetRayValid[i] == true)
+		{
+			rays[n] = &packetRays[i];
+			isects[n] = &packetIntersections[i];
+			n++;
+		}
+	}
+
+	if(n > 0)
+		FindIntersectionPacket(rays, isects, n);
+}
+
+bool TracePixel::TracePacketRay(DBL x, DBL y, DBL width, DBL height, Colour& colour)
+{
+	if((width != packetWidth) || (height != packetHeight))
+		return false;
+
+	for(unsigned int i = 0; i < packetSize; i++)
+	{
+		if((packetPending[i] == true) && (packetX[i] == x) && (packetY[i] == y))
+		{
+			packetPending[i] = false;
+
+			colour.clear();
+
+			if(packetRayValid[i] == true)
+			{
+				Colour col;
+
+				Trace::TraceTicket ticket(maxTraceLevel, adcBailout, sceneData->outputAlpha && (sceneData->EffectiveLanguageVersion() < 370));
+				TraceRay(packetRays[i], col, 1.0, ticket, false, camera.Max_Ray_Distance, &packetIntersections[i]);
+				colour += col;
+			}
+			else
+				colour.transm() = 1.0;
+
+			return true;
+		}
+	}
+
+	return false;
 }
 
 void TracePixel::operator()(DBL x, DBL y, DBL width, DBL height, Colour& colour)
 {
+	// trace data of the previous pixel is no longer referenced; this also
+	// recovers the memory should some trace code have left its scope unbalanced
+	threadData->traceArena.Reset();
+
+	if((packetSize > 0) && (TracePacketRay(x, y, width, height, colour) == true))
+		return;
+
 	if(useFocalBlur == false)
 	{
 		colour.clear();
@@ -851,12 +937,14 @@ bool TracePixel::CreateCameraRay(Ray& ray, DBL x, DBL y, DBL width, DBL height,
 							if ((intersection & mask) != 0)
 							{
 								const Mesh_Triangle_Struct *tr(mesh->Data->Triangles + idx * 32 + bit);
-								const double& P1u(mesh->Data->UVCoords[tr->UV1][U]);
-								const double& P2u(mesh->Data->UVCoords[tr->UV2][U]);
-								const double& P3u(mesh->Data->UVCoords[tr->UV3][U]);
-								const double& P1v(mesh->Data->UVCoords[tr->UV1][V]);
-								const double& P2v(mesh->Data->UVCoords[tr->UV2][V]);
-								const double& P3v(mesh->Data->UVCoords[tr->UV3][V]);
+								UV_VECT UV1, UV2, UV3;
+								mesh->get_triangle_uvcoords(tr, UV1, UV2, UV3);
+								const double& P1u(UV1[U]);
+								const double& P2u(UV2[U]);
+								const double& P3u(UV3[U]);
+								const double& P1v(UV1[V]);
+								const double& P2v(UV2[V]);
+								const double& P3v(UV3[V]);
 
 								// derive the barycentric co-ordinates from the UV co-ords
 								double scale = (P2u - P1u) * (P3v - P1v) - (P3u - P1u) * (P2v - P1v);
@@ -935,6 +1023,19 @@ void TracePixel::InitRayContainerState(Ray& ray, bool compute)
 				if(((*object)->interior != NULL) && Inside_BBox(ray.Origin, (*object)->BBox) && (*object)->Inside(ray.Origin, threadData))
 					containingInteriors.push_back((*object)->interior);
 		}
+		else if(sceneData->boundingMethod == 3)
+		{
+			HasInteriorPointObjectCondition precond;
+			ContainingInteriorsPointObjectCondition postcond(containingInteriors);
+			BSPInsideCondFunctor ifn(Vector3d(ray.Origin), sceneData->objects, threadData, precond, postcond);
+
+			(*sceneData->bvh)(Vector3d(ray.Origin), ifn);
+
+			// test infinite objects
+			for(vector<ObjectPtr>::iterator object = sceneData->objects.begin() + sceneData->numberOfFiniteObjects; object != sceneData->objects.end(); object++)
+				if(((*object)->interior != NULL) && Inside_BBox(ray.Origin, (*object)->BBox) && (*object)->Inside(ray.Origin, threadData))
+					containingInteriors.push_back((*object)->interior);
+		}
 		else if((sceneData->boundingMethod == 0) || (sceneData->boundingSlabs == NULL))
 		{
 			for(vector<ObjectPtr>::iterator object = sceneData->objects.begin(); object != sceneData->objects.end(); object++)
@@ -269,6 +269,10 @@ class TracePixel : public Trace
 		void SetupCamera(const Camera& cam);
 
 		void operator()(DBL x, DBL y, DBL width, DBL height, Colour& colour);
+
+		/// Create the primary rays for a row of up to RAY_PACKET_SIZE pixels starting at x and
+		/// find their intersections together; the pixels are then traced as usual by operator().
+		void PrepareRayPacket(DBL x, DBL y, unsigned int count, DBL width, DBL height);
 	private:
 		// Focal blur data
 		class FocalBlurData
@@ -298,6 +302,23 @@ class TracePixel : public Trace
 		bool precomputeContainingInteriors;
 		RayInteriorVector containingInteriors;
 
+		/// whether primary rays are traced in packets
+		bool usePackets;
+		/// number of pixels in the current ray packet
+		unsigned int packetSize;
+		/// position of each pixel of the current ray packet
+		DBL packetX[RAY_PACKET_SIZE], packetY[RAY_PACKET_SIZE];
+		/// image size used for the current ray packet
+		DBL packetWidth, packetHeight;
+		/// primary ray of each pixel of the current ray packet
+		Ray packetRays[RAY_PACKET_SIZE];
+		/// closest intersection of each pixel of the current ray packet
+		Intersection packetIntersections[RAY_PACKET_SIZE];
+		/// whether the primary ray could be created for each pixel of the current ray packet
+		bool packetRayValid[RAY_PACKET_SIZE];
+		/// whether each pixel of the current ray packet is still to be traced
+		bool packetPending[RAY_PACKET_SIZE];
+
 		Vector3d cameraDirection;
 		Vector3d cameraRight;
 		Vector3d cameraUp;
@@ -324,6 +345,8 @@ class TracePixel : public Trace
 
 		bool CreateCameraRay(Ray& ray, DBL x, DBL y, DBL width, DBL height, size_t ray_number);
 
+		bool TracePacketRay(DBL x, DBL y, DBL width, DBL height, Colour& colour);
+
 		void InitRayContainerState(Ray& ray, bool compute = false);
 		void InitRayContainerStateTree(Ray& ray, BBOX_TREE *node);
 
@@ -100,6 +100,7 @@
 #include "backend/render/trace.h"
 #include "backend/render/tracetask.h"
 #include "backend/support/jitter.h"
+#include "backend/support/randomsequences.h"
 #include "backend/texture/normal.h"
 #include "backend/math/chi2.h"
 
@@ -113,6 +114,9 @@
 namespace pov
 {
 
+/// number of samples per pixel taken by the first pass of progressive sampling; each further pass doubles it
+const unsigned int PROGRESSIVE_FIRST_PASS_SAMPLES = 4;
+
 #ifdef PROFILE_INTERSECTIONS
 	bool gDoneBSP;
 	bool gDoneBVH;
@@ -271,7 +275,7 @@ void TraceTask::SubdivisionBuffer::Clear()
 		*i = false;
 }
 
-TraceTask::TraceTask(ViewData *vd, unsigned int tm, DBL js, DBL aat, unsigned int aad, GammaCurvePtr& aag, unsigned int ps, bool psc, bool final, bool hr) :
+TraceTask::TraceTask(ViewData *vd, unsigned int tm, DBL js, DBL aat, unsigned int aad, DBL aatl, GammaCurvePtr& aag, unsigned int ps, bool psc, bool final, bool hr) :
 	RenderTask(vd),
 	trace(vd, GetViewDataPtr(), vd->GetSceneData()->parsedMaxTraceLevel, vd->GetSceneData()->parsedAdcBailout,
 	      vd->GetQualityFeatureFlags(), cooperate, media, radiosity),
@@ -280,11 +284,13 @@ TraceTask::TraceTask(ViewData *vd, unsigned int tm, DBL js, DBL aat, unsigned in
 	jitterScale(js),
 	aaThreshold(aat),
 	aaDepth(aad),
+	aaTimeLimit((POV_LONG)(aatl * 1000.0)),
 	aaGamma(aag),
 	previewSize(ps),
 	previewSkipCorner(psc),
 	finalTrace(final),
 	highReproducibility(hr),
+	renderThread(0),
 	media(GetViewDataPtr(), &trace, &photonGatherer),
 	radiosity(vd->GetSceneData(), GetViewDataPtr(),
 	          vd->GetSceneData()->radiositySettings, vd->GetRadiosityCache(), cooperate, RadiosityFunction::FINAL_TRACE, Vector3d(vd->GetCamera().Location)),
@@ -321,6 +327,8 @@ TraceTask::~TraceTask()
 
 void TraceTask::Run()
 {
+	renderThread = GetViewData()->AttachRenderThread();
+
 #ifdef RTR_HACK
 	bool forever = GetViewData()->GetRealTimeRaytracing();
 	do
@@ -340,6 +348,9 @@ void TraceTask::Run()
 			case 2:
 				AdaptiveSupersamplingM2();
 				break;
+			case 3:
+				ProgressiveSamplingM3();
+				break;
 		}
 
 #ifdef RTR_HACK
@@ -438,7 +449,7 @@ void TraceTask::SimpleSamplingM0()
 	vector<Colour> pixels;
 	unsigned int serial;
 
-	while(GetViewData()->GetNextRectangle(rect, serial) == true)
+	while(GetViewData()->GetNextRectangle(rect, serial, renderThread) == true)
 	{
 		radiosity.BeforeTile(highReproducibility? serial : 0);
 
@@ -449,6 +460,10 @@ void TraceTask::SimpleSamplingM0()
 		{
 			for(DBL x = DBL(rect.left); x <= DBL(rect.right); x++)
 			{
+				// find intersections of the next few pixels together
+				if((int(x) - rect.left) % RAY_PACKET_SIZE == 0)
+					trace.PrepareRayPacket(x, y, rect.right - int(x) + 1, GetViewData()->GetWidth(), GetViewData()->GetHeight());
+
 #ifdef PROFILE_INTERSECTIONS
 				POV_LONG it = ULLONG_MAX;
 				for (int i = 0 ; i < 3 ; i++)
@@ -493,7 +508,7 @@ void TraceTask::SimpleSamplingM0P()
 	vector<Colour> pixelcolors;
 	unsigned int serial;
 
-	while(GetViewData()->GetNextRectangle(rect, serial) == true)
+	while(GetViewData()->GetNextRectangle(rect, serial, renderThread) == true)
 	{
 		radiosity.BeforeTile(highReproducibility? serial : 0);
 
@@ -557,7 +572,7 @@ void TraceTask::NonAdaptiveSupersamplingM1()
 
 	jitterScale = jitterScale / DBL(aaDepth);
 
-	while(GetViewData()->GetNextRectangle(rect, serial) == true)
+	while(GetViewData()->GetNextRectangle(rect, serial, renderThread) == true)
 	{
 		radiosity.BeforeTile(highReproducibility? serial : 0);
 
@@ -566,6 +581,10 @@ void TraceTask::NonAdaptiveSupersamplingM1()
 		// sample line above current block
 		for(int x = rect.left; x <= rect.right; x++)
 		{
+			// find intersections of the next few pixels together
+			if((x - rect.left) % RAY_PACKET_SIZE == 0)
+				trace.PrepareRayPacket(DBL(x), DBL(rect.top) - 1.0, rect.right - x + 1, GetViewData()->GetWidth(), GetViewData()->GetHeight());
+
 			trace(DBL(x), DBL(rect.top) - 1.0, GetViewData()->GetWidth(), GetViewData()->GetHeight(), pixels(x, rect.top - 1));
 			GetViewDataPtr()->Stats()[Number_Of_Pixels]++;
 
@@ -601,6 +620,11 @@ void TraceTask::NonAdaptiveSupersamplingM1()
 
 			for(int x = rect.left; x <= rect.right; x++)
 			{
+				// find intersections of the next few pixels together;
+				// they are still traced in order, interleaved with antialiasing
+				if((x - rect.left) % RAY_PACKET_SIZE == 0)
+					trace.PrepareRayPacket(DBL(x), DBL(y), rect.right - x + 1, GetViewData()->GetWidth(), GetViewData()->GetHeight());
+
 				// trace current pixel
 				trace(DBL(x), DBL(y), GetViewData()->GetWidth(), GetViewData()->GetHeight(), pixels(x, y));
 				GetViewDataPtr()->Stats()[Number_Of_Pixels]++;
@@ -642,7 +666,7 @@ void TraceTask::AdaptiveSupersamplingM2()
 
 	jitterScale = jitterScale / DBL((1 << aaDepth) + 1);
 
-	while(GetViewData()->GetNextRectangle(rect, serial) == true)
+	while(GetViewData()->GetNextRectangle(rect, serial, renderThread) == true)
 	{
 		radiosity.BeforeTile(highReproducibility? serial : 0);
 
@@ -688,6 +712,108 @@ void TraceTask::AdaptiveSupersamplingM2()
 	}
 }
 
+void TraceTask::ProgressiveSamplingM3()
+{
+	POVRect rect;
+	unsigned int serial;
+	ViewData::BlockInfo *info;
+	vector<Colour> pixels;
+	vector<Vector2d> offsets;
+	unsigned int maxSamples = ((1 << aaDepth) + 1) * ((1 << aaDepth) + 1); // same as for method 2
+	unsigned int maxPasses = 1;
+
+	for(unsigned int n = PROGRESSIVE_FIRST_PASS_SAMPLES; n < maxSamples; n <<= 1)
+		maxPasses++;
+
+	// all pixels use the same low-discrepancy sub-pixel positions, so that any number
+	// of samples taken so far is well distributed; jitter shifts them per pixel
+	SequentialVector2dGeneratorPtr vgen(GetSubRandom2dGenerator(0, -0.5, 0.5, -0.5, 0.5, maxSamples));
+	offsets.reserve(maxSamples);
+	for(unsigned int i = 0; i < maxSamples; i++)
+		offsets.push_back((*vgen)());
+
+	// Blocks are dispatched once each for the first pass; after that, blocks that still
+	// contain unconverged pixels are dispatched again, until every pixel has converged,
+	// has reached the maximum number of samples, or the time limit has been exceeded.
+	while(GetViewData()->GetNextRectangle(rect, serial, info, 0) == true)
+	{
+		ProgressiveBlockInfo *blockInfo = dynamic_cast<ProgressiveBlockInfo *>(info);
+		if(blockInfo == NULL)
+		{
+			if(info != NULL)
+				delete info;
+			blockInfo = new ProgressiveBlockInfo(rect.GetArea());
+		}
+
+		radiosity.BeforeTile(highReproducibility? serial : 0);
+
+		unsigned int samples = min(maxSamples, PROGRESSIVE_FIRST_PASS_SAMPLES << blockInfo->pass);
+		bool again = false;
+		size_t i = 0;
+
+		pixels.clear();
+		pixels.reserve(rect.GetArea());
+
+		for(int y = rect.top; y <= rect.bottom; y++)
+		{
+			for(int x = rect.left; x <= rect.right; x++, i++)
+			{
+				ProgressivePixel& pixel = blockInfo->pixels[i];
+
+				if(pixel.converged == false)
+				{
+					DBL jx = 0.0, jy = 0.0;
+
+					if(jitterScale > 0.0)
+					{
+						Jitter2d(x, y, jx, jy);
+						jx *= jitterScale;
+						jy *= jitterScale;
+					}
+
+					if(blockInfo->pass == 1)
+						GetViewDataPtr()->Stats()[Number_Of_Pixels_Supersampled]++;
+
+					ProgressiveSampleOnePixel(DBL(x), DBL(y), jx, jy, offsets, samples, pixel);
+
+					// the pixel has converged once the 95% confidence interval of its mean
+					// gamma-adjusted intensity is narrower than the anti-aliasing threshold
+					if(pixel.samples >= maxSamples)
+						pixel.converged = true;
+					else
+						pixel.converged = (4.0 * pixel.m2 / DBL((pixel.samples - 1) * pixel.samples) < Sqr(aaThreshold));
+
+					if(pixel.converged == false)
+						again = true;
+				}
+
+				pixels.push_back(pixel.sum / DBL(pixel.samples));
+			}
+		}
+
+		radiosity.AfterTile();
+
+		float completion = 1.0f / float(maxPasses);
+
+		blockInfo->pass++;
+
+		if((again == true) && ((aaTimeLimit == 0) || (ElapsedRealTime() < aaTimeLimit)))
+			blockInfo->completion += completion;
+		else
+		{
+			// no more passes for this block
+			completion = 1.0f - blockInfo->completion;
+			delete blockInfo;
+			blockInfo = NULL;
+		}
+
+		GetViewDataPtr()->AfterTile();
+		GetViewData()->CompletedRectangle(rect, serial, pixels, 1, (blockInfo == NULL), completion, blockInfo);
+
+		Cooperate();
+	}
+}
+
 void TraceTask::NonAdaptiveSupersamplingForOnePixel(DBL x, DBL y, Colour& leftcol, Colour& topcol, Colour& curcol, bool& sampleleft, bool& sampletop, bool& samplecurrent)
 {
 	Colour gcLeft = GammaCurve::Encode(aaGamma, leftcol);
@@ -742,6 +868,46 @@ void TraceTask::SupersampleOnePixel(DBL x, DBL y, Colour& col)
 	col /= (aaDepth * aaDepth + 1);
 }
 
+void TraceTask::ProgressiveSampleOnePixel(DBL x, DBL y, DBL jx, DBL jy, const vector<Vector2d>& offsets, unsigned int count, ProgressivePixel& pixel)
+{
+	Colour col;
+
+	while(pixel.samples < count)
+	{
+		DBL dx = offsets[pixel.samples].x() + jx;
+		DBL dy = offsets[pixel.samples].y() + jy;
+
+		// keep jittered positions within the pixel
+		if(dx >= 0.5)
+			dx -= 1.0;
+		else if(dx < -0.5)
+			dx += 1.0;
+		if(dy >= 0.5)
+			dy -= 1.0;
+		else if(dy < -0.5)
+			dy += 1.0;
+
+		trace(x + dx, y + dy, GetViewData()->GetWidth(), GetViewData()->GetHeight(), col);
+
+		if(pixel.samples == 0)
+			GetViewDataPtr()->Stats()[Number_Of_Pixels]++;
+		else
+			GetViewDataPtr()->Stats()[Number_Of_Samples]++;
+
+		// update mean and squared deviations incrementally (Welford's method)
+		Colour gc = GammaCurve::Encode(aaGamma, col);
+		DBL intensity = gc[pRED] + gc[pGREEN] + gc[pBLUE] + gc[pTRANSM];
+		DBL delta = intensity - pixel.mean;
+
+		pixel.sum += col;
+		pixel.samples++;
+		pixel.mean += delta / DBL(pixel.samples);
+		pixel.m2 += delta * (intensity - pixel.mean);
+
+		Cooperate();
+	}
+}
+
 void TraceTask::SubdivideOnePixel(DBL x, DBL y, DBL d, size_t bx, size_t by, size_t bstep, SubdivisionBuffer& buffer, Colour& result, int level)
 {
 	Colour& cx0y0 = buffer(bx, by);
@@ -118,7 +118,7 @@ namespace pov
 class TraceTask : public RenderTask
 {
 	public:
-		TraceTask(ViewData *vd, unsigned int tm, DBL js, DBL aat, unsigned int aad, GammaCurvePtr& aag, unsigned int ps, bool psc, bool final, bool hr);
+		TraceTask(ViewData *vd, unsigned int tm, DBL js, DBL aat, unsigned int aad, DBL aatl, GammaCurvePtr& aag, unsigned int ps, bool psc, bool final, bool hr);
 		virtual ~TraceTask();
 
 		virtual void Run();
@@ -151,15 +151,50 @@ class TraceTask : public RenderTask
 				size_t size;
 		};
 
+		/// running sample statistics of one pixel for progressive sampling
+		struct ProgressivePixel
+		{
+			ProgressivePixel() : mean(0.0), m2(0.0), samples(0), converged(false) { }
+
+			/// sum of all samples
+			Colour sum;
+			/// mean of the gamma-adjusted sample intensities
+			DBL mean;
+			/// sum of squared deviations of the gamma-adjusted sample intensities from their mean
+			DBL m2;
+			/// number of samples taken so far
+			unsigned int samples;
+			/// whether the pixel needs no more samples
+			bool converged;
+		};
+
+		/// sample statistics of a block retained between progressive sampling passes
+		class ProgressiveBlockInfo : public ViewData::BlockInfo
+		{
+			public:
+				ProgressiveBlockInfo(size_t n) : pass(0), completion(0.0f), pixels(n) { }
+
+				/// number of passes completed
+				unsigned int pass;
+				/// contribution of the completed passes to the block's progress
+				float completion;
+				/// statistics of the block's pixels, row by row
+				vector<ProgressivePixel> pixels;
+		};
+
 		unsigned int tracingMethod;
 		DBL jitterScale;
 		DBL aaThreshold;
 		unsigned int aaDepth;
+		/// time after which progressive sampling stops refining, in milliseconds, or zero for no limit
+		POV_LONG aaTimeLimit;
 		unsigned int previewSize;
 		bool previewSkipCorner;
 		bool finalTrace;
 		bool highReproducibility;
 		GammaCurvePtr aaGamma;
+		/// render thread number to get blocks for
+		unsigned int renderThread;
 
 		/// tracing core
 		TracePixel trace;
@@ -173,10 +208,12 @@ class TraceTask : public RenderTask
 		void SimpleSamplingM0P();
 		void NonAdaptiveSupersamplingM1();
 		void AdaptiveSupersamplingM2();
+		void ProgressiveSamplingM3();
 
 		void NonAdaptiveSupersamplingForOnePixel(DBL x, DBL y, Colour& leftcol, Colour& topcol, Colour& curcol, bool& sampleleft, bool& sampletop, bool& samplecurrent);
 		void SupersampleOnePixel(DBL x, DBL y, Colour& col);
 		void SubdivideOnePixel(DBL x, DBL y, DBL d, size_t bx, size_t by, size_t bstep, SubdivisionBuffer& buffer, Colour& result, int level);
+		void ProgressiveSampleOnePixel(DBL x, DBL y, DBL jx, DBL jy, const vector<Vector2d>& offsets, unsigned int count, ProgressivePixel& pixel);
 };
 
 }
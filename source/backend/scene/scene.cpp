@@ -182,6 +182,12 @@ SceneData::SceneData() :
 	TTFonts = NULL;
 
 	tree = NULL;
+	bvh = NULL;
+
+	meshTriangles = 0;
+	meshMemory = 0;
+
+	parserProfile = NULL;
 
 	functionVM = new FunctionVM();
 }
@@ -214,6 +220,10 @@ SceneData::~SceneData()
 
 	if(tree != NULL)
 		delete tree;
+	if(bvh != NULL)
+		delete bvh;
+	if(parserProfile != NULL)
+		delete parserProfile;
 }
 
 UCS2String SceneData::FindFile(POVMSContext ctx, const UCS2String& filename, unsigned int stype)
@@ -474,6 +484,7 @@ Scene::Scene(POVMSAddress backendAddr, POVMSAddress frontendAddr, RenderBackend:
 	parserControlThread(NULL)
 {
 	sceneData->tree = NULL;
+	sceneData->bvh = NULL;
 	sceneData->sceneId = sid;
 	sceneData->backendAddress = backendAddr;
 	sceneData->frontendAddress = frontendAddr;
@@ -515,16 +526,23 @@ void Scene::StartParser(POVMS_Object& parseOptions)
 
 	sceneData->inputFile = parseOptions.TryGetUCS2String(kPOVAttrib_InputFile, "object.pov");
 	sceneData->headerFile = parseOptions.TryGetUCS2String(kPOVAttrib_IncludeHeader, "");
+	sceneData->includeCachePath = parseOptions.TryGetUCS2String(kPOVAttrib_IncludeCachePath, "");
 
 	sceneData->defaultFileType = parseOptions.TryGetInt(kPOVAttrib_OutputFileType, DEFAULT_OUTPUT_FORMAT); // TODO - should get DEFAULT_OUTPUT_FORMAT from the front-end
 	sceneData->clocklessAnimation = parseOptions.TryGetBool(kPOVAttrib_ClocklessAnimation, false); // TODO - experimental code
 
 	sceneData->splitUnions = parseOptions.TryGetBool(kPOVAttrib_SplitUnions, false);
 	sceneData->removeBounds = parseOptions.TryGetBool(kPOVAttrib_RemoveBounds, true);
-	sceneData->boundingMethod = clip<int>(parseOptions.TryGetInt(kPOVAttrib_BoundingMethod, 1), 1, 2);
+	sceneData->boundingMethod = clip<int>(parseOptions.TryGetInt(kPOVAttrib_BoundingMethod, 1), 1, 3);
 	if(parseOptions.TryGetBool(kPOVAttrib_Bounding, true) == false)
 		sceneData->boundingMethod = 0;
 
+	sceneData->functionVM->SetJIT(parseOptions.TryGetBool(kPOVAttrib_FunctionJIT, false));
+
+	sceneData->parserProfileFile = parseOptions.TryGetUCS2String(kPOVAttrib_ParseProfileFile, "");
+	if(parseOptions.TryGetBool(kPOVAttrib_ParseProfile, false) || (sceneData->parserProfileFile.empty() == false))
+		sceneData->parserProfile = new ParserProfile();
+
 	sceneData->outputAlpha = parseOptions.TryGetBool(kPOVAttrib_OutputAlpha, false);
 	if (!sceneData->outputAlpha)
 		// if we're not outputting an alpha channel, precompose the scene background against a black "background behind the background"
@@ -580,7 +598,20 @@ void Scene::StartParser(POVMS_Object& parseOptions)
 
 	// do bounding - we always call this even if the bounding is turned off
 	// because it also generates object statistics
-	sceneThreadData.push_back(dynamic_cast<SceneThreadData *>(parserTasks.AppendTask(new BoundingTask(sceneData, parseOptions.TryGetInt(kPOVAttrib_BoundingThreshold, 1)))));
+	shared_ptr<BoundingJobQueue> boundingJobQueue;
+	unsigned int boundingThreads = max(1, parseOptions.TryGetInt(kPOVAttrib_MaxRenderThreads, 1));
+
+	if((sceneData->boundingMethod == 1) && (boundingThreads > 1))
+		boundingJobQueue = shared_ptr<BoundingJobQueue>(new BoundingJobQueue(boundingThreads));
+
+	sceneThreadData.push_back(dynamic_cast<SceneThreadData *>(parserTasks.AppendTask(new BoundingTask(sceneData, parseOptions.TryGetInt(kPOVAttrib_BoundingThreshold, 1), boundingJobQueue))));
+
+	// helper tasks build parts of the bounding box tree in parallel
+	if(boundingJobQueue != NULL)
+	{
+		for(unsigned int i = 1; i < boundingThreads; i++)
+			sceneThreadData.push_back(dynamic_cast<SceneThreadData *>(parserTasks.AppendTask(new BoundingHelperTask(sceneData, boundingJobQueue))));
+	}
 
 	// wait for bounding
 	parserTasks.AppendSync();
@@ -685,6 +716,12 @@ void Scene::GetStatistics(POVMS_Object& parserStats)
 	parserStats.SetInt(kPOVAttrib_LightSources, POVMSInt(sceneData->lightSources.size()));
 	parserStats.SetInt(kPOVAttrib_Cameras, POVMSInt(sceneData->cameras.size()));
 
+	if(sceneData->meshTriangles > 0)
+	{
+		parserStats.SetLong(kPOVAttrib_MeshTriangles, sceneData->meshTriangles);
+		parserStats.SetLong(kPOVAttrib_MeshMemory, sceneData->meshMemory);
+	}
+
 	if(sceneData->boundingMethod == 2)
 	{
 		parserStats.SetInt(kPOVAttrib_BSPNodes, sceneData->nodes);
@@ -699,6 +736,62 @@ void Scene::GetStatistics(POVMS_Object& parserStats)
 		parserStats.SetFloat(kPOVAttrib_BSPAverageAborts, sceneData->averageAborts);
 		parserStats.SetFloat(kPOVAttrib_BSPAverageAbortObjects, sceneData->averageAbortObjects);
 	}
+	else if(sceneData->boundingMethod == 3)
+	{
+		parserStats.SetInt(kPOVAttrib_BVHNodes, sceneData->bvhNodes);
+		parserStats.SetInt(kPOVAttrib_BVHLeafNodes, sceneData->bvhLeafNodes);
+		parserStats.SetInt(kPOVAttrib_BVHMaxObjects, sceneData->maxObjects);
+		parserStats.SetFloat(kPOVAttrib_BVHAverageObjects, sceneData->averageObjects);
+		parserStats.SetInt(kPOVAttrib_BVHMaxDepth, sceneData->maxDepth);
+		parserStats.SetFloat(kPOVAttrib_BVHAverageDepth, sceneData->averageDepth);
+	}
+
+	if(sceneData->functionVM->GetJIT() == true)
+	{
+		const vector<FunctionVM::JITStatistics>& jitStats(sceneData->functionVM->GetJITStatistics());
+		POVMS_List functionStats;
+
+		for(vector<FunctionVM::JITStatistics>::const_iterator i(jitStats.begin()); i != jitStats.end(); i++)
+		{
+			POVMS_Object functionStat(kPOVObjectClass_FunctionJITStat);
+
+			functionStat.SetString(kPOVAttrib_FunctionName, i->name.c_str());
+			functionStat.SetInt(kPOVAttrib_FunctionInstructions, POVMSInt(i->instructions));
+			functionStat.SetInt(kPOVAttrib_FunctionCodeSize, POVMSInt(i->codesize));
+			functionStat.SetLong(kPOVAttrib_FunctionCompileTime, i->compiletime);
+
+			functionStats.Append(functionStat);
+		}
+
+		parserStats.Set(kPOVAttrib_FunctionJITStats, functionStats);
+	}
+
+	if(sceneData->parserProfile != NULL)
+	{
+		const vector<ParserProfile::Site>& sites(sceneData->parserProfile->GetSites());
+		POVMS_List profileSites;
+
+		for(vector<ParserProfile::Site>::const_iterator i(sites.begin()); i != sites.end(); i++)
+		{
+			POVMS_Object profileSite(kPOVObjectClass_ParseProfileSite);
+
+			profileSite.SetInt(kPOVAttrib_ProfileKind, POVMSInt(i->kind));
+			profileSite.SetString(kPOVAttrib_ProfileName, i->name.c_str());
+			profileSite.SetString(kPOVAttrib_ProfileFile, i->file.c_str());
+			profileSite.SetLong(kPOVAttrib_ProfileLine, i->line);
+			profileSite.SetLong(kPOVAttrib_ProfileCalls, i->calls);
+			profileSite.SetLong(kPOVAttrib_ProfileIterations, i->iterations);
+			profileSite.SetLong(kPOVAttrib_ProfileTotalTime, i->totalTime);
+			profileSite.SetLong(kPOVAttrib_ProfileSelfTime, i->selfTime);
+			profileSite.SetLong(kPOVAttrib_ProfileTokens, i->self.tokens);
+			profileSite.SetLong(kPOVAttrib_ProfileLookups, i->self.lookups);
+			profileSite.SetLong(kPOVAttrib_ProfileAllocations, i->self.allocations);
+
+			profileSites.Append(profileSite);
+		}
+
+		parserStats.Set(kPOVAttrib_ParseProfileSites, profileSites);
+	}
 }
 
 void Scene::SendStatistics(TaskQueue&)
@@ -109,6 +109,7 @@
 #include "backend/lighting/photons.h"
 #include "backend/lighting/radiosity.h"
 #include "backend/control/renderbackend.h"
+#include "backend/parser/parseprofile.h"
 //#include "backend/support/bsptree.h"
 
 #include "povrayold.h" // TODO
@@ -124,6 +125,7 @@ class FunctionVM;
 struct FontFileInfo;
 
 class BSPTree;
+class BVHTree;
 
 /**
  *	SceneData class representing holding scene specific data.
@@ -266,6 +268,8 @@ class SceneData
 		// name of the parsed file
 		UCS2String inputFile; // TODO - handle differently
 		UCS2String headerFile;
+		// directory holding pre-tokenized include files, or empty
+		UCS2String includeCachePath;
 
 		int defaultFileType;
 
@@ -290,6 +294,7 @@ class SceneData
 
 		// experimental
 		BSPTree *tree;
+		BVHTree *bvh;
 		unsigned int numberOfFiniteObjects;
 		unsigned int numberOfInfiniteObjects;
 
@@ -297,6 +302,17 @@ class SceneData
 		unsigned int nodes, splitNodes, objectNodes, emptyNodes, maxObjects, maxDepth, aborts;
 		float averageObjects, averageDepth, averageAborts, averageAbortObjects;
 
+		// BVH statistics
+		unsigned int bvhNodes, bvhLeafNodes;
+
+		// mesh statistics
+		POV_LONG meshTriangles, meshMemory;
+
+		// parser profile, or NULL if not requested
+		ParserProfile *parserProfile;
+		// file to write the parser profile to, or empty
+		UCS2String parserProfileFile;
+
 		// ********************************************************************************
 		// ********************************************************************************
 
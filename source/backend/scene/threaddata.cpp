@@ -119,6 +119,10 @@ SceneThreadData::SceneThreadData(shared_ptr<SceneData> sd): sceneData(sd)
 	Blob_Queue = (void **)POV_MALLOC(sizeof(void **), "Blob Queue");
 	Blob_Coefficients = (DBL *)POV_MALLOC(sizeof(DBL) * Blob_Coefficient_Count, "Blob Coefficients");
 	Blob_Intervals = new Blob_Interval_Struct [Blob_Interval_Count];
+	Blob_Stamp = 0;
+	Blob_Stamp_Count = sceneData->Max_Blob_Components;
+	Blob_Stamps = (unsigned int *)POV_MALLOC(sizeof(unsigned int) * Blob_Stamp_Count, "Blob Stamps");
+	memset(Blob_Stamps, 0, sizeof(unsigned int) * Blob_Stamp_Count);
 	isosurfaceData = (ISO_ThreadData *)POV_MALLOC(sizeof(ISO_ThreadData), "Isosurface Data");
 	isosurfaceData->ctx = NULL;
 	isosurfaceData->current = NULL;
@@ -171,6 +175,9 @@ SceneThreadData::SceneThreadData(shared_ptr<SceneData> sd): sceneData(sd)
 	// lock.
 	Crackle_Cache.max_load_factor(50.0);
 
+	Pattern_Cache_Stamp = 1;
+	memset(Pattern_Cache, 0, sizeof(Pattern_Cache));
+
 	numberOfWaves = sd->numberOfWaves;
 	Initialize_Waves(waveFrequencies, waveSources, numberOfWaves);
 }
@@ -183,6 +190,7 @@ SceneThreadData::~SceneThreadData()
 	POV_FREE(BCyl_RInt);
 	POV_FREE(BCyl_Intervals);
 	POV_FREE(Blob_Coefficients);
+	POV_FREE(Blob_Stamps);
 	POV_FREE(Blob_Queue);
 	POV_FREE(isosurfaceData);
 	Fractal::Free_Iteration_Stack(Fractal_IStack);
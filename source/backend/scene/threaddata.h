@@ -100,6 +100,7 @@
 #include "backend/frame.h"
 #include "backend/support/task.h"
 #include "backend/support/statistics.h"
+#include "backend/support/arena.h"
 #include "backend/shape/mesh.h"
 #include "backend/pattern/pattern.h"
 
@@ -146,11 +147,16 @@ class SceneThreadData : public Task::TaskData
 		Blob_Interval_Struct *Blob_Intervals;
 		int Blob_Coefficient_Count;
 		int Blob_Interval_Count;
+		unsigned int *Blob_Stamps;  ///< per-component mailbox for blob grid traversal
+		unsigned int Blob_Stamp;
+		int Blob_Stamp_Count;
 		ISO_ThreadData *isosurfaceData;
 		void *BCyl_Intervals;
 		void *BCyl_RInt;
 		void *BCyl_HInt;
 		IStackPool stackPool;
+		/// scratch memory for data that lives no longer than the trace of one primary ray
+		MemoryArena traceArena;
 		FPUContext *functionContext;
 		vector<FPUContext *> functionPatternContext;
 		int Facets_Last_Seed;
@@ -181,6 +187,10 @@ class SceneThreadData : public Task::TaskData
 
 		Crackle_Cache_Type Crackle_Cache;
 
+		/// results of Evaluate_TPat for the current intersection
+		Pattern_Cache_Entry Pattern_Cache[PATTERN_CACHE_SIZE];
+		unsigned int Pattern_Cache_Stamp;
+
 		// data for waves and ripples pattern
 		unsigned int numberOfWaves;
 		vector<double> waveFrequencies;
@@ -107,6 +107,7 @@
 #include "backend/scene/view.h"
 #include "backend/render/tracetask.h"
 #include "backend/render/radiositytask.h"
+#include "backend/render/renderprocess.h"
 #include "backend/lighting/photons.h"
 #include "backend/lighting/radiosity.h"
 
@@ -140,6 +141,12 @@ inline unsigned int MakePowerOfTwo(unsigned int i)
 	return 1 << ii;
 }
 
+/// Create the trace task of the final trace pass, run by each render worker process.
+static Task *NewFinalTraceTask(ViewData *vd, unsigned int tm, DBL js, DBL aat, unsigned int aad, DBL aatl, GammaCurvePtr aag, bool hr)
+{
+	return new TraceTask(vd, tm, js, aat, aad, aatl, aag, 0, false, true, hr);
+}
+
 ViewData::ViewData(shared_ptr<SceneData> sd) :
 	nextBlock(0),
 	completedFirstPass(false),
@@ -149,8 +156,10 @@ ViewData::ViewData(shared_ptr<SceneData> sd) :
 	blockWidth(10),
 	blockHeight(8),
 	blockSize(DEFAULT_BLOCK_SIZE),
+	renderThreads(1),
 	realTimeRaytracing(false),
 	rtrData(NULL),
+	renderProcess(NULL),
 	renderArea(0, 0, 159, 119),
 	radiosityCache(sd->radiositySettings),
 	sceneData(sd)
@@ -278,39 +287,29 @@ void ViewData::getBlockXY(const unsigned int nb, unsigned int &x, unsigned int &
 	 }/* all values are covered */
 }
 
-bool ViewData::GetNextRectangle(POVRect& rect, unsigned int& serial)
+unsigned int ViewData::AttachRenderThread()
 {
-	boost::mutex::scoped_lock lock(nextBlockMutex);
-
-	while(true)
-	{
-		if(nextBlock >= (blockWidth * blockHeight))
-			return false;
-
-		unsigned int tempNextBlock = nextBlock; // TODO FIXME - works around nasty gcc (found using 4.0.1) bug failing to honor casting away of volatile on pass by value on template argument lookup [trf]
+	return blockQueue.AttachWorker();
+}
 
-		if((blockSkipList.empty() == true) || (blockSkipList.find((unsigned int)tempNextBlock) == blockSkipList.end()))
-			break;
+bool ViewData::GetNextRectangle(POVRect& rect, unsigned int& serial, unsigned int thread)
+{
+	if(renderProcess != NULL)
+		return renderProcess->GetNextRectangle(rect, serial);
 
-		blockSkipList.erase((unsigned int)tempNextBlock);
-		nextBlock++;
-	}
+	if(blockQueue.Take(thread, serial) == false)
+		return false;
 
 	unsigned int blockX; 
 	unsigned int blockY;
-	getBlockXY(nextBlock,blockX,blockY);
+	getBlockXY(serial,blockX,blockY);
 
 	rect.left = renderArea.left + (blockX * blockSize);
 	rect.right = min(renderArea.left + ((blockX + 1) * blockSize) - 1, renderArea.right);
 	rect.top = renderArea.top + (blockY * blockSize);
 	rect.bottom = min(renderArea.top + ((blockY + 1) * blockSize) - 1, renderArea.bottom);
 
-	pixelsPending += rect.GetArea();
-
-	serial = nextBlock;
-	nextBlock++;
-
-	blockBusyList.insert(serial);
+	blockQueuePixelsPending[thread] += rect.GetArea();
 
 	return true;
 }
@@ -449,6 +448,13 @@ bool ViewData::GetNextRectangle(POVRect& rect, unsigned int& serial, BlockInfo*&
 
 void ViewData::CompletedRectangle(const POVRect& rect, unsigned int serial, const vector<Colour>& pixels, unsigned int size, bool final, float completion, BlockInfo* blockInfo)
 {
+	// the coordinating process sends the pixels on and keeps track of progress
+	if(renderProcess != NULL)
+	{
+		renderProcess->CompletedRectangle(rect, serial, pixels, size, final);
+		return;
+	}
+
 	if (realTimeRaytracing == true)
 	{
 		assert(pixels.size() == rect.GetArea());
@@ -588,7 +594,10 @@ void ViewData::CompletedRectangle(const POVRect& rect, unsigned int serial, floa
 			POVMS_Object obj(kPOVObjectClass_RenderProgress);
 			// TODO obj.SetLong(kPOVAttrib_RealTime, ElapsedRealTime());
 			obj.SetInt(kPOVAttrib_Pixels, renderArea.GetArea());
-			obj.SetInt(kPOVAttrib_PixelsPending, pixelsPending - pixelsCompleted + rect.GetArea());
+			unsigned int pending = pixelsPending;
+			for(vector<unsigned int>::const_iterator i(blockQueuePixelsPending.begin()); i != blockQueuePixelsPending.end(); i++)
+				pending += *i;
+			obj.SetInt(kPOVAttrib_PixelsPending, pending - pixelsCompleted + rect.GetArea());
 			obj.SetInt(kPOVAttrib_PixelsCompleted, pixelsCompleted);
 			RenderBackend::SendViewOutput(viewId, sceneData->frontendAddress, kPOVMsgIdent_Progress, obj);
 		}
@@ -609,6 +618,21 @@ void ViewData::SetNextRectangle(const set<unsigned int>& bsl, unsigned int fs)
 	nextBlock = fs;
 	completedFirstPass = false; // TODO
 	pixelsCompleted = 0; // TODO
+
+	// consecutive blocks go to different render threads, so the blocks
+	// are still rendered roughly in order as long as no thread runs out
+	blockQueue.Reset(renderThreads);
+	for(unsigned int i = fs; i < blockWidth * blockHeight; i++)
+	{
+		if(blockSkipList.find(i) == blockSkipList.end())
+			blockQueue.Append(i);
+	}
+	blockQueuePixelsPending.resize(renderThreads, 0);
+}
+
+void ViewData::GetRenderThreadStatistics(vector<WorkStealingQueue::WorkerStatistics>& stats)
+{
+	blockQueue.GetStatistics(stats);
 }
 
 void ViewData::SetHighestTraceLevel(unsigned int htl)
@@ -708,6 +732,21 @@ bool View::CheckCameraHollowObject(const VECTOR point)
 			if(((*object)->interior != NULL) && Inside_BBox(point, (*object)->BBox) && (*object)->Inside((double *) point, &threadData))
 				return true;
 	}
+	else if(sd->boundingMethod == 3)
+	{
+		HasInteriorPointObjectCondition precond;
+		TruePointObjectCondition postcond;
+		TraceThreadData threadData(sd); // TODO: avoid the need to construct threadData
+		BSPInsideCondFunctor ifn(Vector3d(point), sd->objects, &threadData, precond, postcond);
+
+		if ((*sd->bvh)(Vector3d(point), ifn, true))
+			return true;
+
+		// test infinite objects
+		for(vector<ObjectPtr>::iterator object = sd->objects.begin() + sd->numberOfFiniteObjects; object != sd->objects.end(); object++)
+			if(((*object)->interior != NULL) && Inside_BBox(point, (*object)->BBox) && (*object)->Inside((double *) point, &threadData))
+				return true;
+	}
 	else if((sd->boundingMethod == 0) || (sd->boundingSlabs == NULL))
 	{
 		TraceThreadData threadData(sd); // TODO: avoid the need to construct threadData
@@ -731,6 +770,7 @@ void View::StartRender(POVMS_Object& renderOptions)
 	bool jitter = false;
 	DBL aathreshold = 0.3;
 	unsigned int aadepth = 3;
+	DBL aatimelimit = 0.0;
 	DBL aaGammaValue = 1.0;
 	GammaCurvePtr aaGammaCurve;
 	unsigned int previewstartsize = 0;
@@ -750,10 +790,11 @@ void View::StartRender(POVMS_Object& renderOptions)
 	viewData.qualitySettings.Quality_Flags = QualityValues[viewData.qualitySettings.Quality];
 
 	if(renderOptions.TryGetBool(kPOVAttrib_Antialias, false) == true)
-		tracingmethod = clip(renderOptions.TryGetInt(kPOVAttrib_SamplingMethod, 1), 0, 2);
+		tracingmethod = clip(renderOptions.TryGetInt(kPOVAttrib_SamplingMethod, 1), 0, 3);
 
 	aadepth = clip((unsigned int)renderOptions.TryGetInt(kPOVAttrib_AntialiasDepth, 3), 1u, 9u);
 	aathreshold = clip(renderOptions.TryGetFloat(kPOVAttrib_AntialiasThreshold, 0.3f), 0.0f, 1.0f);
+	aatimelimit = max(renderOptions.TryGetFloat(kPOVAttrib_AntialiasTimeLimit, 0.0f), 0.0f);
 	if(renderOptions.TryGetBool(kPOVAttrib_Jitter, true) == true)
 		jitterscale = clip(renderOptions.TryGetFloat(kPOVAttrib_JitterAmount, 1.0f), 0.0f, 1.0f);
 	else
@@ -779,10 +820,11 @@ void View::StartRender(POVMS_Object& renderOptions)
 	{
 		// TODO FIXME - [CLi] I guess the radiosity file name needs more attention than this; probably a frontend job
 		Path radiosityFile = Path(renderOptions.TryGetUCS2String(kPOVAttrib_RadiosityFileName, "object.rca"));
+		unsigned int sceneHash = RadiosityCache::ComputeSceneHash(*viewData.GetSceneData());
 		if(loadRadiosityCache)
-			loadRadiosityCache = viewData.radiosityCache.Load(radiosityFile);
+			loadRadiosityCache = viewData.radiosityCache.Load(radiosityFile, sceneHash); // rejects files for a different scene
 		if(saveRadiosityCache)
-			viewData.radiosityCache.InitAutosave(radiosityFile, loadRadiosityCache); // if we loaded the file, add to existing data
+			viewData.radiosityCache.InitAutosave(radiosityFile, loadRadiosityCache, sceneHash); // if we loaded the file, add to existing data
 	}
 
 	viewData.GetSceneData()->radiositySettings.vainPretrace = renderOptions.TryGetBool(kPOVAttrib_RadiosityVainPretrace, true);
@@ -868,6 +910,7 @@ void View::StartRender(POVMS_Object& renderOptions)
 
 	viewData.pixelsPending = 0;
 	viewData.pixelsCompleted = 0;
+	viewData.blockQueuePixelsPending.clear();
 
 	// continue trace
 	nextblock = renderOptions.TryGetInt(kPOVAttrib_PixelId, 0);
@@ -880,11 +923,26 @@ void View::StartRender(POVMS_Object& renderOptions)
 			blockskiplist->insert(*i);
 	}
 
-	viewData.SetNextRectangle(*blockskiplist, nextblock);
-
 	// render thread count
 	int maxRenderThreads = renderOptions.TryGetInt(kPOVAttrib_MaxRenderThreads, 1);
 
+	viewData.renderThreads = max(1, maxRenderThreads);
+
+	// render worker process count; progressive sampling re-dispatches blocks with
+	// data retained in memory, so it always renders in this process
+	shared_ptr<RenderProcessPool> renderProcessPool;
+	int renderProcesses = renderOptions.TryGetInt(kPOVAttrib_RenderProcesses, 1);
+
+	if((renderProcesses > 1) && (tracingmethod < 3) && RenderProcessPool::Supported() &&
+	   (renderOptions.TryGetBool(kPOVAttrib_RealTimeRaytracing, false) == false))
+	{
+		renderProcessPool = shared_ptr<RenderProcessPool>(new RenderProcessPool(&viewData, renderProcesses,
+		                    boost::bind(&NewFinalTraceTask, &viewData, tracingmethod, jitterscale, aathreshold, aadepth, aatimelimit, aaGammaCurve, highReproducibility)));
+		viewData.renderThreads = max(viewData.renderThreads, (unsigned int)renderProcesses);
+	}
+
+	viewData.SetNextRectangle(*blockskiplist, nextblock);
+
 	viewData.realTimeRaytracing = renderOptions.TryGetBool(kPOVAttrib_RealTimeRaytracing, false); // TODO - experimental code
 	if (viewData.realTimeRaytracing)
 		viewData.rtrData = new RTRData(viewData, maxRenderThreads);
@@ -1032,6 +1090,12 @@ void View::StartRender(POVMS_Object& renderOptions)
 	*/
 	if(viewData.GetSceneData()->photonSettings.photonsEnabled)
 	{
+		// helper tasks build parts of the photon map kd-trees in parallel
+		shared_ptr<PhotonSortJobQueue> photonSortJobQueue;
+
+		if(maxRenderThreads > 1)
+			photonSortJobQueue = shared_ptr<PhotonSortJobQueue>(new PhotonSortJobQueue(maxRenderThreads));
+
 		if (viewData.GetSceneData()->photonSettings.fileName && viewData.GetSceneData()->photonSettings.loadFile)
 		{
 			vector<PhotonMap*> surfaceMaps;
@@ -1039,13 +1103,15 @@ void View::StartRender(POVMS_Object& renderOptions)
 
 			// when we pass a null parameter for the "strategy" (last parameter),
 			// then this will LOAD the photon map
-			viewThreadData.push_back(dynamic_cast<ViewThreadData *>(renderTasks.AppendTask(new PhotonSortingTask(&viewData, surfaceMaps, mediaMaps, NULL))));
+			viewThreadData.push_back(dynamic_cast<ViewThreadData *>(renderTasks.AppendTask(new PhotonSortingTask(&viewData, surfaceMaps, mediaMaps, NULL, photonSortJobQueue))));
+			for(int i = 1; (photonSortJobQueue != NULL) && (i < maxRenderThreads); i++)
+				viewThreadData.push_back(dynamic_cast<ViewThreadData *>(renderTasks.AppendTask(new PhotonSortingHelperTask(&viewData, photonSortJobQueue))));
 			// wait for photons to finish
 			renderTasks.AppendSync();
 		}
 		else
 		{
-			PhotonShootingStrategy* strategy = new PhotonShootingStrategy();
+			PhotonShootingStrategy* strategy = new PhotonShootingStrategy(maxRenderThreads);
 
 			viewThreadData.push_back(dynamic_cast<ViewThreadData *>(renderTasks.AppendTask(new PhotonEstimationTask(&viewData))));
 			// wait for photons to finish
@@ -1069,7 +1135,9 @@ void View::StartRender(POVMS_Object& renderOptions)
 			renderTasks.AppendSync();
 
 			// this merges the maps, sorts, computes gather options, and then cleans up memory
-			viewThreadData.push_back(dynamic_cast<ViewThreadData *>(renderTasks.AppendTask(new PhotonSortingTask(&viewData, surfaceMaps, mediaMaps, strategy))));
+			viewThreadData.push_back(dynamic_cast<ViewThreadData *>(renderTasks.AppendTask(new PhotonSortingTask(&viewData, surfaceMaps, mediaMaps, strategy, photonSortJobQueue))));
+			for(int i = 1; (photonSortJobQueue != NULL) && (i < maxRenderThreads); i++)
+				viewThreadData.push_back(dynamic_cast<ViewThreadData *>(renderTasks.AppendTask(new PhotonSortingHelperTask(&viewData, photonSortJobQueue))));
 			// wait for photons to finish
 			renderTasks.AppendSync();
 
@@ -1153,7 +1221,7 @@ void View::StartRender(POVMS_Object& renderOptions)
 	{
 		// do render with mosaic preview start size
 		for(int i = 0; i < maxRenderThreads; i++)
-			viewThreadData.push_back(dynamic_cast<ViewThreadData *>(renderTasks.AppendTask(new TraceTask(&viewData, 0, jitterscale, aathreshold, aadepth, aaGammaCurve, previewstartsize, false, false, highReproducibility))));
+			viewThreadData.push_back(dynamic_cast<ViewThreadData *>(renderTasks.AppendTask(new TraceTask(&viewData, 0, jitterscale, aathreshold, aadepth, aatimelimit, aaGammaCurve, previewstartsize, false, false, highReproducibility))));
 
 		for(unsigned int step = (previewstartsize >> 1); step >= previewendsize; step >>= 1)
 		{
@@ -1168,7 +1236,7 @@ void View::StartRender(POVMS_Object& renderOptions)
 
 			// do render with current mosaic preview size
 			for(int i = 0; i < maxRenderThreads; i++)
-				viewThreadData.push_back(dynamic_cast<ViewThreadData *>(renderTasks.AppendTask(new TraceTask(&viewData, 0, jitterscale, aathreshold, aadepth, aaGammaCurve, step, true, ((step == 1) && (tracingmethod == 0)), highReproducibility))));
+				viewThreadData.push_back(dynamic_cast<ViewThreadData *>(renderTasks.AppendTask(new TraceTask(&viewData, 0, jitterscale, aathreshold, aadepth, aatimelimit, aaGammaCurve, step, true, ((step == 1) && (tracingmethod == 0)), highReproducibility))));
 		}
 
 		// do render everything again if the final mosaic preview block size was not one or anti-aliasing is required
@@ -1183,15 +1251,25 @@ void View::StartRender(POVMS_Object& renderOptions)
 			// wait for block size counter and block skip list reset to finish
 			renderTasks.AppendSync();
 
-			for(int i = 0; i < maxRenderThreads; i++)
-				viewThreadData.push_back(dynamic_cast<ViewThreadData *>(renderTasks.AppendTask(new TraceTask(&viewData, tracingmethod, jitterscale, aathreshold, aadepth, aaGammaCurve, 0, false, true, highReproducibility))));
+			if(renderProcessPool != NULL)
+				AppendRenderProcessTasks(renderProcessPool);
+			else
+			{
+				for(int i = 0; i < maxRenderThreads; i++)
+					viewThreadData.push_back(dynamic_cast<ViewThreadData *>(renderTasks.AppendTask(new TraceTask(&viewData, tracingmethod, jitterscale, aathreshold, aadepth, aatimelimit, aaGammaCurve, 0, false, true, highReproducibility))));
+			}
 		}
 	}
 	// do render without mosaic preview
 	else
 	{
-		for(int i = 0; i < maxRenderThreads; i++)
-			viewThreadData.push_back(dynamic_cast<ViewThreadData *>(renderTasks.AppendTask(new TraceTask(&viewData, tracingmethod, jitterscale, aathreshold, aadepth, aaGammaCurve, 0, false, true, highReproducibility))));
+		if(renderProcessPool != NULL)
+			AppendRenderProcessTasks(renderProcessPool);
+		else
+		{
+			for(int i = 0; i < maxRenderThreads; i++)
+				viewThreadData.push_back(dynamic_cast<ViewThreadData *>(renderTasks.AppendTask(new TraceTask(&viewData, tracingmethod, jitterscale, aathreshold, aadepth, aatimelimit, aaGammaCurve, 0, false, true, highReproducibility))));
+		}
 	}
 
 	// wait for render to finish
@@ -1278,6 +1356,9 @@ void View::GetStatistics(POVMS_Object& renderStats)
 	renderStats.SetLong(kPOVAttrib_CrackleCacheTest, stats[CrackleCache_Tests]);
 	renderStats.SetLong(kPOVAttrib_CrackleCacheTestSuc, stats[CrackleCache_Tests_Succeeded]);
 
+	renderStats.SetLong(kPOVAttrib_PatternCacheTest, stats[PatternCache_Tests]);
+	renderStats.SetLong(kPOVAttrib_PatternCacheTestSuc, stats[PatternCache_Tests_Succeeded]);
+
 	POV_LONG current;
 	POV_ULONG allocs(0), frees(0), peak(0), smallest(0), largest(0);
 	POV_MEM_STATS_RENDER_END();
@@ -1310,6 +1391,7 @@ void View::GetStatistics(POVMS_Object& renderStats)
 	renderStats.SetLong(kPOVAttrib_RadFinalRayCount, stats[Radiosity_Final_RayCount]);
 	renderStats.SetLong(kPOVAttrib_RadOctreeNodes, stats[Radiosity_OctreeNodes]);
 	renderStats.SetLong(kPOVAttrib_RadOctreeLookups, stats[Radiosity_OctreeLookups]);
+	renderStats.SetLong(kPOVAttrib_RadOctreeContention, stats[Radiosity_OctreeContention]);
 	renderStats.SetLong(kPOVAttrib_RadOctreeAccepts0, stats[Radiosity_OctreeAccepts0]);
 	renderStats.SetLong(kPOVAttrib_RadOctreeAccepts1, stats[Radiosity_OctreeAccepts1]);
 	renderStats.SetLong(kPOVAttrib_RadOctreeAccepts2, stats[Radiosity_OctreeAccepts2]);
@@ -1381,8 +1463,26 @@ void View::GetStatistics(POVMS_Object& renderStats)
 					renderStats.Set(kPOVAttrib_RadiosityTime, elapsedTime);
 					break;
 				case SceneThreadData::kRenderTime:
+				{
+					vector<WorkStealingQueue::WorkerStatistics> threadStats;
+					vector<POVMSLong> blocks;
+					vector<POVMSLong> steals;
+					vector<POVMSLong> idleTime;
+
+					viewData.GetRenderThreadStatistics(threadStats);
+					for(vector<WorkStealingQueue::WorkerStatistics>::iterator ts(threadStats.begin()); ts != threadStats.end(); ts++)
+					{
+						blocks.push_back(ts->items);
+						steals.push_back(ts->steals);
+						idleTime.push_back(ts->idleTime);
+					}
+					elapsedTime.SetLongVector(kPOVAttrib_ThreadBlocks, blocks);
+					elapsedTime.SetLongVector(kPOVAttrib_ThreadSteals, steals);
+					elapsedTime.SetLongVector(kPOVAttrib_ThreadIdleTime, idleTime);
+
 					renderStats.Set(kPOVAttrib_TraceTime, elapsedTime);
 					break;
+				}
 			}
 		}
 	}
@@ -1443,6 +1543,18 @@ void View::SetNextRectangle(TaskQueue&, shared_ptr<set<unsigned int> > bsl, unsi
 	viewData.SetNextRectangle(*bsl, fs);
 }
 
+void View::AppendRenderProcessTasks(shared_ptr<RenderProcessPool> pool)
+{
+	// the worker processes are forked once no other task is running, so
+	// they start from a consistent copy of the scene and view data
+	renderTasks.AppendSync();
+	renderTasks.AppendFunction(boost::bind(&RenderProcessPool::Start, pool, _1));
+	renderTasks.AppendSync();
+
+	for(unsigned int i = 0; i < pool->GetCount(); i++)
+		viewThreadData.push_back(dynamic_cast<ViewThreadData *>(renderTasks.AppendTask(new RenderProcessTask(&viewData, pool, i))));
+}
+
 void View::RenderControlThread()
 {
 	bool sentFailedResult = false;
@@ -99,6 +99,7 @@
 #include "base/types.h"
 #include "backend/povray.h"
 #include "backend/support/taskqueue.h"
+#include "backend/support/workstealingqueue.h"
 #include "backend/scene/camera.h"
 #include "backend/scene/scene.h"
 #include "backend/control/renderbackend.h"
@@ -121,6 +122,9 @@ class ViewData;
 class SceneData;
 class ViewThreadData;
 
+class RenderProcessClient;
+class RenderProcessPool;
+
 class RTRData
 {
 	public:
@@ -161,6 +165,8 @@ class ViewData
 		// View needs access to the private view data constructor as well
 		// as some private data in order to initialise it properly!
 		friend class View;
+		// A worker process diverts the block dispatch of its copy of the view data.
+		friend class RenderProcessPool;
 	public:
 		/**
 		 *  Container for information about a rectangle to be retained between passes.
@@ -171,16 +177,27 @@ class ViewData
 			virtual void dummy() {} // dummy virtual function, allowing to use dynamic_cast
 		};
 
+		/**
+		 *  Assign one of the per-thread block queues to the calling render thread.
+		 *  This method is called once by each render thread before it calls
+		 *  GetNextRectangle for the first time.
+		 *  @return                 Render thread number to pass to GetNextRectangle.
+		 */
+		unsigned int AttachRenderThread();
+
 		/**
 		 *  Get the next sub-rectangle of the view to render (if any).
 		 *  This method is called by the render threads when they have
 		 *  completed rendering one block and are ready to start rendering
 		 *  the next block.
+		 *  Each render thread takes blocks from its own queue first, and
+		 *  steals blocks from the other threads' queues once it is empty.
 		 *  @param  rect            Rectangle to render.
 		 *  @param  serial          Rectangle serial number.
+		 *  @param  thread          Render thread number as returned by AttachRenderThread.
 		 *  @return                 True if there is another rectangle to be dispatched, false otherwise.
 		 */
-		bool GetNextRectangle(POVRect& rect, unsigned int& serial);
+		bool GetNextRectangle(POVRect& rect, unsigned int& serial, unsigned int thread);
 
 		/**
 		 *  Get the next sub-rectangle of the view to render (if any).
@@ -327,6 +344,12 @@ class ViewData
 		 */
 		 RTRData *GetRTRData() { return rtrData; }
 
+		/**
+		 *  Get block dispatch statistics for each render thread.
+		 *  @param  stats           Receives the statistics of each render thread.
+		 */
+		 void GetRenderThreadStatistics(vector<WorkStealingQueue::WorkerStatistics>& stats);
+
 	private:
 
 		struct BlockPostponedEntry {
@@ -349,6 +372,14 @@ class ViewData
 		volatile unsigned int nextBlock;
 		/// next block counter mutex
 		boost::mutex nextBlockMutex;
+		/// Blocks to be dispatched by the work-stealing version of @c GetNextRectangle,
+		/// filled by @c SetNextRectangle.
+		WorkStealingQueue blockQueue;
+		/// pixels dispatched from @c blockQueue, indexed by render thread
+		/// @note   Each entry is only changed by its render thread.
+		vector<unsigned int> blockQueuePixelsPending;
+		/// number of render threads
+		unsigned int renderThreads;
 		/// set data mutex
 		boost::mutex setDataMutex;
 		/// Whether all blocks have been dispatched at least once.
@@ -391,6 +422,9 @@ class ViewData
 		/// data specifically associated with the RTR feature
 		RTRData *rtrData;
 
+		/// connection to the coordinating process if this is the view data copy of a render worker process, or NULL
+		RenderProcessClient *renderProcess;
+
 		/// functions to compute the X & Y block
 		void getBlockXY(const unsigned int nb, unsigned int &x, unsigned int &y);
 
@@ -547,6 +581,12 @@ class View
 		 */
 		void SetNextRectangle(TaskQueue& taskq, shared_ptr<set<unsigned int> > bsl, unsigned int fs);
 
+		/**
+		 *  Append the tasks rendering the final trace pass in worker processes.
+		 *  @param  pool            Worker processes to render in.
+		 */
+		void AppendRenderProcessTasks(shared_ptr<RenderProcessPool> pool);
+
 		/**
 		 *  Thread controlling the render task queue.
 		 */
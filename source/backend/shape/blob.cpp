@@ -168,6 +168,10 @@
 
 #include <algorithm>
 
+#if SYS_SIMD_SSE2
+	#include <emmintrin.h>
+#endif
+
 // this must be the last file included
 #include "base/povdebug.h"
 
@@ -727,6 +731,73 @@ void Blob::insert_hit(const Blob_Element *Element, DBL t0, DBL t1, Blob_Interval
 
 
 
+/*****************************************************************************
+*
+* FUNCTION
+*
+*   sort_hits
+*
+* INPUT
+*
+*   intervals - Pointer to list of hits
+*   cnt       - Number of hits in intervals
+*
+* OUTPUT
+*
+*   intervals - Pointer to sorted list of hits
+*
+* RETURNS
+*
+* AUTHOR
+*
+*   -
+*
+* DESCRIPTION
+*
+*   Sort the hits found by grid_influences() by depth. Hits at the same
+*   depth keep their order, so a component's entry stays in front of
+*   its exit. Short lists are sorted by insertion, long ones with a merge
+*   sort instead of moving the list around for every single component
+*   like insert_hit() does.
+*
+* CHANGES
+*
+*   -
+*
+******************************************************************************/
+
+static bool compare_hits(const Blob_Interval_Struct& a, const Blob_Interval_Struct& b)
+{
+	return (a.bound < b.bound);
+}
+
+void Blob::sort_hits(Blob_Interval_Struct *intervals, unsigned int cnt)
+{
+	unsigned int i, j;
+	Blob_Interval_Struct temp;
+
+	if (cnt <= BLOB_MAX_INSERTION_SORT)
+	{
+		for (i = 1; i < cnt; i++)
+		{
+			temp = intervals[i];
+
+			for (j = i; (j > 0) && (intervals[j-1].bound > temp.bound); j--)
+			{
+				intervals[j] = intervals[j-1];
+			}
+
+			intervals[j] = temp;
+		}
+	}
+	else
+	{
+		std::stable_sort(intervals, intervals + cnt, compare_hits);
+	}
+}
+
+
+
 /*****************************************************************************
 *
 * FUNCTION
@@ -1323,7 +1394,13 @@ int Blob::determine_influences(const VECTOR P, const VECTOR  D, DBL mindist, Blo
 
 	cnt = 0;
 
-	if (Data->Tree == NULL)
+	if (Data->Grid != NULL)
+	{
+		/* Use blob's grid. */
+
+		cnt = grid_influences(P, D, mindist, intervals, Thread);
+	}
+	else if (Data->Tree == NULL)
 	{
 		/* There's no bounding hierarchy so just step through all elements. */
 
@@ -1391,6 +1468,223 @@ int Blob::determine_influences(const VECTOR P, const VECTOR  D, DBL mindist, Blo
 
 
 
+/*****************************************************************************
+*
+* FUNCTION
+*
+*   grid_influences
+*
+* INPUT
+*
+*   P, D       - Ray = P + t * D
+*   mindist    - Min. valid distance
+*
+* OUTPUT
+*
+*   intervals  - Sorted list of intersections found
+*
+* RETURNS
+*
+*   unsigned int - Number of intersection found
+*
+* AUTHOR
+*
+*   -
+*
+* DESCRIPTION
+*
+*   Step through the cells of the blob's grid pierced by the ray's line
+*   and intersect the components whose bounding spheres referenced by
+*   them are hit. Bounding spheres referenced by several cells are only
+*   tested once; the thread's stamps remember which ones were already
+*   tested for this ray.
+*
+*   The hits are collected first and sorted at the end. Hemispheres
+*   behind the ray's origin may report an exit in front of their entry;
+*   they are skipped.
+*
+* CHANGES
+*
+*   -
+*
+******************************************************************************/
+
+unsigned int Blob::grid_influences(const VECTOR P, const VECTOR D, DBL mindist, Blob_Interval_Struct *intervals, TraceThreadData *Thread) const
+{
+	int i, axis, cell[3], step[3];
+	unsigned int b, j, k, cnt, stamp;
+	unsigned int *Stamps;
+	DBL s, t, t0, t1, tnear, tfar, lo, hi, next[3], delta[3];
+	VECTOR V1;
+	const Blob_Grid *Grid = Data->Grid;
+	const Blob_Grid_Cell_Struct *Cell;
+	const Blob_Grid_Bound_Struct *Bound;
+	const Blob_Element *Element;
+
+	/* Clip the ray's line against the grid. */
+
+	tnear = -HUGE_VAL;
+	tfar  =  HUGE_VAL;
+
+	for (i = X; i <= Z; i++)
+	{
+		lo = Grid->Min[i];
+		hi = Grid->Min[i] + Grid->Size[i] * Grid->Cell_Size;
+
+		if (D[i] == 0.0)
+		{
+			if ((P[i] < lo) || (P[i] > hi))
+			{
+				return (0);
+			}
+		}
+		else
+		{
+			t0 = (lo - P[i]) / D[i];
+			t1 = (hi - P[i]) / D[i];
+
+			tnear = max(tnear, min(t0, t1));
+			tfar  = min(tfar,  max(t0, t1));
+		}
+	}
+
+	if (tnear > tfar)
+	{
+		return (0);
+	}
+
+	/* Set up the traversal at the point the line enters the grid. */
+
+	for (i = X; i <= Z; i++)
+	{
+		cell[i] = (int)floor((P[i] + tnear * D[i] - Grid->Min[i]) * Grid->Inv_Cell_Size);
+		cell[i] = max(0, min(cell[i], Grid->Size[i] - 1));
+
+		if (D[i] > 0.0)
+		{
+			step[i]  = 1;
+			next[i]  = (Grid->Min[i] + (cell[i] + 1) * Grid->Cell_Size - P[i]) / D[i];
+			delta[i] = Grid->Cell_Size / D[i];
+		}
+		else if (D[i] < 0.0)
+		{
+			step[i]  = -1;
+			next[i]  = (Grid->Min[i] + cell[i] * Grid->Cell_Size - P[i]) / D[i];
+			delta[i] = -Grid->Cell_Size / D[i];
+		}
+		else
+		{
+			step[i]  = 0;
+			next[i]  = HUGE_VAL;
+			delta[i] = 0.0;
+		}
+	}
+
+	/* Get a new stamp for this ray. */
+
+	if (++Thread->Blob_Stamp == 0)
+	{
+		memset(Thread->Blob_Stamps, 0, sizeof(unsigned int) * Thread->Blob_Stamp_Count);
+
+		Thread->Blob_Stamp = 1;
+	}
+
+	stamp  = Thread->Blob_Stamp;
+	Stamps = Thread->Blob_Stamps;
+
+	cnt = 0;
+
+	while (true)
+	{
+		Cell = &Grid->Cells[(cell[Z] * Grid->Size[Y] + cell[Y]) * Grid->Size[X] + cell[X]];
+
+#ifdef BLOB_EXTRA_STATS
+		Thread->Stats()[Blob_Grid_Cell_Tests]++;
+#endif
+
+		if (Cell->Count > 0)
+		{
+#ifdef BLOB_EXTRA_STATS
+			Thread->Stats()[Blob_Grid_Cell_Tests_Succeeded]++;
+#endif
+
+			for (j = Cell->First, k = Cell->First + Cell->Count; j < k; j++)
+			{
+				b = Grid->Reference[j];
+
+				if (Stamps[b] != stamp)
+				{
+					Stamps[b] = stamp;
+
+#ifdef BLOB_EXTRA_STATS
+					Thread->Stats()[Blob_Bound_Tests]++;
+#endif
+
+					Bound = &Grid->Bound[b];
+
+					VSub(V1, Bound->C, P);
+					VDot(s, V1, D);
+					VDot(t, V1, V1);
+
+					if ((t - Sqr(s)) > Bound->r2)
+					{
+						continue;
+					}
+
+#ifdef BLOB_EXTRA_STATS
+					Thread->Stats()[Blob_Bound_Tests_Succeeded]++;
+#endif
+
+					Element = &Data->Entry[Grid->Component[b]];
+
+					if (intersect_element(P, D, Element, mindist, &t0, &t1, Thread) && (t0 <= t1))
+					{
+						/* We are entering the component. */
+
+						intervals[cnt].type    = Element->Type | ENTERING;
+						intervals[cnt].bound   = t0;
+						intervals[cnt].Element = Element;
+
+						cnt++;
+
+						/* We are exiting the component. */
+
+						intervals[cnt].type    = Element->Type | EXITING;
+						intervals[cnt].bound   = t1;
+						intervals[cnt].Element = Element;
+
+						cnt++;
+					}
+				}
+			}
+		}
+
+		/* Step into the next cell. */
+
+		axis = (next[X] < next[Y]) ? ((next[X] < next[Z]) ? X : Z) : ((next[Y] < next[Z]) ? Y : Z);
+
+		if (next[axis] > tfar)
+		{
+			break;
+		}
+
+		cell[axis] += step[axis];
+
+		if ((cell[axis] < 0) || (cell[axis] >= Grid->Size[axis]))
+		{
+			break;
+		}
+
+		next[axis] += delta[axis];
+	}
+
+	sort_hits(intervals, cnt);
+
+	return (cnt);
+}
+
+
+
 /*****************************************************************************
 *
 * FUNCTION
@@ -1553,11 +1847,21 @@ DBL Blob::calculate_field_value(const VECTOR P, TraceThreadData *Thread) const
 	DBL density, rad2;
 	VECTOR V1;
 	BSPHERE_TREE *Tree;
+	const Blob_Grid_Cell_Struct *Cell;
 	BSPHERE_TREE **Queue = (BSPHERE_TREE **) Thread->Blob_Queue;
 
 	density = 0.0;
 
-	if (Data->Tree == NULL)
+	if (Data->Grid != NULL)
+	{
+		/* A grid exists --> use the components of the cell containing P. */
+
+		if ((Cell = grid_cell(P)) != NULL)
+		{
+			density = calculate_cell_field(Cell, P);
+		}
+	}
+	else if (Data->Tree == NULL)
 	{
 		/* There's no tree --> step through all elements. */
 
@@ -1609,6 +1913,243 @@ DBL Blob::calculate_field_value(const VECTOR P, TraceThreadData *Thread) const
 
 
 
+/*****************************************************************************
+*
+* FUNCTION
+*
+*   grid_cell
+*
+* INPUT
+*
+*   P       - Point in blob space
+*
+* OUTPUT
+*
+* RETURNS
+*
+*   const Blob_Grid_Cell_Struct * - Grid cell containing P, NULL if
+*                                   P is outside the grid
+*
+* AUTHOR
+*
+*   -
+*
+* DESCRIPTION
+*
+*   Find the cell of the blob's grid containing a point. Every component
+*   influencing the point is referenced by this cell.
+*
+* CHANGES
+*
+*   -
+*
+******************************************************************************/
+
+const Blob_Grid_Cell_Struct *Blob::grid_cell(const VECTOR P) const
+{
+	int i, cell[3];
+	DBL pos;
+	const Blob_Grid *Grid = Data->Grid;
+
+	for (i = X; i <= Z; i++)
+	{
+		pos = (P[i] - Grid->Min[i]) * Grid->Inv_Cell_Size;
+
+		/* Also rejects NaN. */
+
+		if (!((pos >= 0.0) && (pos < (DBL)Grid->Size[i])))
+		{
+			return (NULL);
+		}
+
+		cell[i] = min((int)pos, Grid->Size[i] - 1);
+	}
+
+	return (&Grid->Cells[(cell[Z] * Grid->Size[Y] + cell[Y]) * Grid->Size[X] + cell[X]]);
+}
+
+
+
+/*****************************************************************************
+*
+* FUNCTION
+*
+*   calculate_cell_field
+*
+* INPUT
+*
+*   Cell    - Grid cell containing P
+*   P       - Point whos field value is calculated
+*
+* OUTPUT
+*
+* RETURNS
+*
+*   DBL - Field value
+*
+* AUTHOR
+*
+*   -
+*
+* DESCRIPTION
+*
+*   Calculate the field value of a blob in a given point P from the
+*   components referenced by the grid cell containing P. The spheres
+*   and cylinders, which a cell references first, are evaluated two
+*   at a time; with SSE2 each pair shares the instructions.
+*
+*   The field values of a pair are summed up separately and only added
+*   at the end, without SSE2 as well, so the result doesn't depend on
+*   the instruction set used. Each single field value is computed exactly
+*   like calculate_element_field() does.
+*
+* CHANGES
+*
+*   -
+*
+******************************************************************************/
+
+DBL Blob::calculate_cell_field(const Blob_Grid_Cell_Struct *Cell, const VECTOR P) const
+{
+	unsigned int i, n;
+	const unsigned int *Reference = &Data->Grid->Reference[Cell->First];
+	const unsigned int *Component = &Data->Grid->Component[0];
+
+#if SYS_SIMD_SSE2
+	const Blob_Element *E0, *E1;
+	const MATRIX *M0, *M1;
+	__m128d px, py, pz, vx, vy, vz, r2, density, inside, sum;
+
+	px = _mm_set1_pd(P[X]);
+	py = _mm_set1_pd(P[Y]);
+	pz = _mm_set1_pd(P[Z]);
+
+	sum = _mm_setzero_pd();
+
+	/* Spheres. */
+
+	n = Cell->Spheres;
+
+	for (i = 0; i + 1 < n; i += 2)
+	{
+		E0 = &Data->Entry[Component[Reference[i]]];
+		E1 = &Data->Entry[Component[Reference[i+1]]];
+
+		vx = _mm_sub_pd(px, _mm_set_pd(E1->O[X], E0->O[X]));
+		vy = _mm_sub_pd(py, _mm_set_pd(E1->O[Y], E0->O[Y]));
+		vz = _mm_sub_pd(pz, _mm_set_pd(E1->O[Z], E0->O[Z]));
+
+		r2 = _mm_add_pd(_mm_add_pd(_mm_mul_pd(vx, vx), _mm_mul_pd(vy, vy)), _mm_mul_pd(vz, vz));
+
+		inside = _mm_cmplt_pd(r2, _mm_set_pd(E1->rad2, E0->rad2));
+
+		density = _mm_add_pd(_mm_mul_pd(r2, _mm_add_pd(_mm_mul_pd(r2, _mm_set_pd(E1->c[0], E0->c[0])), _mm_set_pd(E1->c[1], E0->c[1]))), _mm_set_pd(E1->c[2], E0->c[2]));
+
+		sum = _mm_add_pd(sum, _mm_and_pd(inside, density));
+	}
+
+	if (i < n)
+	{
+		sum = _mm_add_sd(sum, _mm_set_sd(calculate_element_field(&Data->Entry[Component[Reference[i]]], P)));
+	}
+
+	/* Cylinders. */
+
+	Reference += n;
+	n = Cell->Cylinders;
+
+	for (i = 0; i + 1 < n; i += 2)
+	{
+		E0 = &Data->Entry[Component[Reference[i]]];
+		E1 = &Data->Entry[Component[Reference[i+1]]];
+
+		M0 = (const MATRIX *)E0->Trans->inverse;
+		M1 = (const MATRIX *)E1->Trans->inverse;
+
+		/* Transform P into the cylinders' space like MInvTransPoint() does. */
+
+		vx = _mm_add_pd(_mm_add_pd(_mm_add_pd(_mm_mul_pd(px, _mm_set_pd((*M1)[0][X], (*M0)[0][X])), _mm_mul_pd(py, _mm_set_pd((*M1)[1][X], (*M0)[1][X]))), _mm_mul_pd(pz, _mm_set_pd((*M1)[2][X], (*M0)[2][X]))), _mm_set_pd((*M1)[3][X], (*M0)[3][X]));
+		vy = _mm_add_pd(_mm_add_pd(_mm_add_pd(_mm_mul_pd(px, _mm_set_pd((*M1)[0][Y], (*M0)[0][Y])), _mm_mul_pd(py, _mm_set_pd((*M1)[1][Y], (*M0)[1][Y]))), _mm_mul_pd(pz, _mm_set_pd((*M1)[2][Y], (*M0)[2][Y]))), _mm_set_pd((*M1)[3][Y], (*M0)[3][Y]));
+		vz = _mm_add_pd(_mm_add_pd(_mm_add_pd(_mm_mul_pd(px, _mm_set_pd((*M1)[0][Z], (*M0)[0][Z])), _mm_mul_pd(py, _mm_set_pd((*M1)[1][Z], (*M0)[1][Z]))), _mm_mul_pd(pz, _mm_set_pd((*M1)[2][Z], (*M0)[2][Z]))), _mm_set_pd((*M1)[3][Z], (*M0)[3][Z]));
+
+		r2 = _mm_add_pd(_mm_mul_pd(vx, vx), _mm_mul_pd(vy, vy));
+
+		inside = _mm_and_pd(_mm_and_pd(_mm_cmpge_pd(vz, _mm_setzero_pd()), _mm_cmple_pd(vz, _mm_set_pd(E1->len, E0->len))), _mm_cmple_pd(r2, _mm_set_pd(E1->rad2, E0->rad2)));
+
+		density = _mm_add_pd(_mm_mul_pd(r2, _mm_add_pd(_mm_mul_pd(r2, _mm_set_pd(E1->c[0], E0->c[0])), _mm_set_pd(E1->c[1], E0->c[1]))), _mm_set_pd(E1->c[2], E0->c[2]));
+
+		sum = _mm_add_pd(sum, _mm_and_pd(inside, density));
+	}
+
+	if (i < n)
+	{
+		sum = _mm_add_sd(sum, _mm_set_sd(calculate_element_field(&Data->Entry[Component[Reference[i]]], P)));
+	}
+
+	/* All other components. */
+
+	Reference += n;
+	n = Cell->Count - Cell->Spheres - Cell->Cylinders;
+
+	for (i = 0; i < n; i++)
+	{
+		sum = _mm_add_sd(sum, _mm_set_sd(calculate_element_field(&Data->Entry[Component[Reference[i]]], P)));
+	}
+
+	return (_mm_cvtsd_f64(sum) + _mm_cvtsd_f64(_mm_unpackhi_pd(sum, sum)));
+#else
+	DBL sum0, sum1;
+
+	sum0 = sum1 = 0.0;
+
+	/* Spheres. */
+
+	n = Cell->Spheres;
+
+	for (i = 0; i + 1 < n; i += 2)
+	{
+		sum0 += calculate_element_field(&Data->Entry[Component[Reference[i]]], P);
+		sum1 += calculate_element_field(&Data->Entry[Component[Reference[i+1]]], P);
+	}
+
+	if (i < n)
+	{
+		sum0 += calculate_element_field(&Data->Entry[Component[Reference[i]]], P);
+	}
+
+	/* Cylinders. */
+
+	Reference += n;
+	n = Cell->Cylinders;
+
+	for (i = 0; i + 1 < n; i += 2)
+	{
+		sum0 += calculate_element_field(&Data->Entry[Component[Reference[i]]], P);
+		sum1 += calculate_element_field(&Data->Entry[Component[Reference[i+1]]], P);
+	}
+
+	if (i < n)
+	{
+		sum0 += calculate_element_field(&Data->Entry[Component[Reference[i]]], P);
+	}
+
+	Reference += n;
+
+	/* All other components. */
+
+	n = Cell->Count - Cell->Spheres - Cell->Cylinders;
+
+	for (i = 0; i < n; i++)
+	{
+		sum0 += calculate_element_field(&Data->Entry[Component[Reference[i]]], P);
+	}
+
+	return (sum0 + sum1);
+#endif
+}
+
+
+
 /*****************************************************************************
 *
 * FUNCTION
@@ -1844,10 +2385,11 @@ void Blob::element_normal(VECTOR Result, const VECTOR P, const Blob_Element *Ele
 void Blob::Normal(VECTOR Result, Intersection *Inter, TraceThreadData *Thread) const
 {
 	int i;
-	unsigned int size;
+	unsigned int j, size;
 	DBL dist, val;
 	VECTOR New_Point, V1;
 	BSPHERE_TREE *Tree;
+	const Blob_Grid_Cell_Struct *Cell;
 	BSPHERE_TREE **Queue = (BSPHERE_TREE **) Thread->Blob_Queue;
 
 	/* Transform the point into the blob space. */
@@ -1857,7 +2399,19 @@ void Blob::Normal(VECTOR Result, Intersection *Inter, TraceThreadData *Thread) c
 
 	/* For each component that contributes to this point, add its bit to the normal */
 
-	if (Data->Tree == NULL)
+	if (Data->Grid != NULL)
+	{
+		/* A grid exists --> use the components of the cell containing the point. */
+
+		if ((Cell = grid_cell(New_Point)) != NULL)
+		{
+			for (j = Cell->First; j < Cell->First + Cell->Count; j++)
+			{
+				element_normal(Result, New_Point, &Data->Entry[Data->Grid->Component[Data->Grid->Reference[j]]]);
+			}
+		}
+	}
+	else if (Data->Tree == NULL)
 	{
 		/* There's no tree --> step through all elements. */
 
@@ -2506,6 +3060,7 @@ Blob_Data::Blob_Data (int Count)
 {
 	References = 1;
 	Tree = NULL;
+	Grid = NULL;
 	Number_Of_Components = Count;
 	Entry.resize (Count) ;
 }
@@ -2521,6 +3076,7 @@ void Blob_Data::ReleaseReference (void)
 	if (--References == 0)
 	{
 		Destroy_Bounding_Sphere_Hierarchy(Tree);
+		delete Grid;
 
 		/*
 		 * Make sure to destroy multiple references of a texture
@@ -2676,7 +3232,12 @@ int Blob::Make_Blob(DBL threshold, Blob_List_Struct *BlobList, int npoints, Trac
 	/* Create bounding sphere hierarchy. */
 
 	if (Test_Flag(this, HIERARCHY_FLAG))
-		build_bounding_hierarchy();
+	{
+		if (count >= BLOB_GRID_MIN_COMPONENTS)
+			build_grid();
+		else
+			build_bounding_hierarchy();
+	}
 
 	if (count * 5 >= Thread->Blob_Coefficient_Count)
 	{
@@ -2692,6 +3253,14 @@ int Blob::Make_Blob(DBL threshold, Blob_List_Struct *BlobList, int npoints, Trac
 		Thread->Blob_Intervals = new Blob_Interval_Struct [Thread->Blob_Interval_Count];
 	}
 
+	if (count > Thread->Blob_Stamp_Count)
+	{
+		POV_FREE(Thread->Blob_Stamps);
+		Thread->Blob_Stamp_Count = count;
+		Thread->Blob_Stamps = (unsigned int *)POV_MALLOC(sizeof(unsigned int) * Thread->Blob_Stamp_Count, "Blob Stamps");
+		memset(Thread->Blob_Stamps, 0, sizeof(unsigned int) * Thread->Blob_Stamp_Count);
+	}
+
 	return (count) ;
 }
 
@@ -2818,6 +3387,279 @@ void Blob::build_bounding_hierarchy()
 
 
 
+/*****************************************************************************
+*
+* FUNCTION
+*
+*   grid_cell_range
+*
+* INPUT
+*
+*   Grid         - Grid
+*   Lower, Upper - Bounding box
+*   margin       - Distance the box is enlarged by
+*
+* OUTPUT
+*
+*   lo, hi       - First and last cell overlapped along each axis
+*
+* RETURNS
+*
+* AUTHOR
+*
+*   -
+*
+* DESCRIPTION
+*
+*   Get the range of grid cells overlapped by a bounding box.
+*
+* CHANGES
+*
+*   -
+*
+******************************************************************************/
+
+static void grid_cell_range(const Blob_Grid *Grid, const DBL *Lower, const DBL *Upper, DBL margin, int *lo, int *hi)
+{
+	int i;
+
+	for (i = X; i <= Z; i++)
+	{
+		lo[i] = (int)floor((Lower[i] - margin - Grid->Min[i]) / Grid->Cell_Size);
+		hi[i] = (int)floor((Upper[i] + margin - Grid->Min[i]) / Grid->Cell_Size);
+
+		lo[i] = max(0, min(lo[i], Grid->Size[i] - 1));
+		hi[i] = max(0, min(hi[i], Grid->Size[i] - 1));
+	}
+}
+
+
+
+/*****************************************************************************
+*
+* FUNCTION
+*
+*   build_grid
+*
+* INPUT
+*
+* OUTPUT
+*
+* RETURNS
+*
+* AUTHOR
+*
+*   -
+*
+* DESCRIPTION
+*
+*   Create the uniform grid used instead of the bounding sphere hierarchy
+*   for blobs with many components. Each cell references the bounding
+*   spheres of all components whose bounding boxes overlap it: those of
+*   spheres first, cylinders next and all other components last.
+*
+*   The cells start out as large as the average bounding sphere's radius;
+*   they are enlarged until there are not too many cells and references.
+*
+* CHANGES
+*
+*   -
+*
+******************************************************************************/
+
+void Blob::build_grid()
+{
+	int i, j, n, x, y, z, pass, lo[3], hi[3];
+	unsigned int first;
+	DBL radius, size, margin, cells, refs;
+	VECTOR Min, Max, Extent;
+	Blob_Grid *Grid;
+	Blob_Element *Element;
+
+	n = Data->Number_Of_Components;
+
+	vector<Blob_Grid_Bound_Struct> Bound(n);
+	vector<DBL> Lower(3 * n);
+	vector<DBL> Upper(3 * n);
+
+	/* Get the bounding spheres of the components and their boxes. */
+
+	radius = 0.0;
+
+	Make_Vector(Min,  BOUND_HUGE,  BOUND_HUGE,  BOUND_HUGE);
+	Make_Vector(Max, -BOUND_HUGE, -BOUND_HUGE, -BOUND_HUGE);
+
+	for (i = 0; i < n; i++)
+	{
+		get_element_bounding_sphere(&Data->Entry[i], Bound[i].C, &Bound[i].r2);
+
+		radius += sqrt(Bound[i].r2);
+
+		for (j = X; j <= Z; j++)
+		{
+			Lower[3*i+j] = Bound[i].C[j] - sqrt(Bound[i].r2);
+			Upper[3*i+j] = Bound[i].C[j] + sqrt(Bound[i].r2);
+
+			Min[j] = min(Min[j], Lower[3*i+j]);
+			Max[j] = max(Max[j], Upper[3*i+j]);
+		}
+	}
+
+	VSub(Extent, Max, Min);
+
+	/* Start with cells as large as the average bounding sphere's radius. */
+
+	size = radius / n;
+
+	if (!(size > 0.0))
+	{
+		size = 1.0;
+	}
+
+	Grid = new Blob_Grid;
+
+	while (true)
+	{
+		margin = 0.001 * size;
+
+		Grid->Cell_Size = size;
+
+		for (j = X; j <= Z; j++)
+		{
+			Grid->Min[j]  = Min[j] - 2.0 * margin;
+			Grid->Size[j] = max(1, (int)ceil((Extent[j] + 4.0 * margin) / size));
+		}
+
+		cells = (DBL)Grid->Size[X] * (DBL)Grid->Size[Y] * (DBL)Grid->Size[Z];
+
+		if (cells <= (DBL)BLOB_GRID_MAX_CELLS * n)
+		{
+			refs = 0.0;
+
+			for (i = 0; i < n; i++)
+			{
+				grid_cell_range(Grid, &Lower[3*i], &Upper[3*i], margin, lo, hi);
+
+				refs += (DBL)(hi[X] - lo[X] + 1) * (DBL)(hi[Y] - lo[Y] + 1) * (DBL)(hi[Z] - lo[Z] + 1);
+			}
+
+			if (refs <= (DBL)BLOB_GRID_MAX_REFERENCES * n)
+			{
+				break;
+			}
+		}
+
+		size *= 1.25;
+	}
+
+	Grid->Inv_Cell_Size = 1.0 / Grid->Cell_Size;
+
+	Grid->Cells.resize(Grid->Size[X] * Grid->Size[Y] * Grid->Size[Z]);
+
+	/*
+	 * Order the bounding spheres by the cells containing their centers,
+	 * so the spheres referenced by nearby cells are close in memory.
+	 */
+
+	vector<unsigned int> Order(n);
+	vector<unsigned int> Next(Grid->Cells.size() + 1, 0);
+
+	for (i = 0; i < n; i++)
+	{
+		grid_cell_range(Grid, Bound[i].C, Bound[i].C, 0.0, lo, hi);
+
+		Order[i] = (lo[Z] * Grid->Size[Y] + lo[Y]) * Grid->Size[X] + lo[X];
+
+		Next[Order[i] + 1]++;
+	}
+
+	for (i = 1; i < (int)Next.size(); i++)
+	{
+		Next[i] += Next[i-1];
+	}
+
+	Grid->Bound.resize(n);
+	Grid->Component.resize(n);
+
+	for (i = 0; i < n; i++)
+	{
+		Order[i] = Next[Order[i]]++;
+
+		Grid->Bound[Order[i]]     = Bound[i];
+		Grid->Component[Order[i]] = i;
+	}
+
+	/* Count the references of each cell. */
+
+	for (i = 0; i < n; i++)
+	{
+		Element = &Data->Entry[i];
+
+		grid_cell_range(Grid, &Lower[3*i], &Upper[3*i], margin, lo, hi);
+
+		for (z = lo[Z]; z <= hi[Z]; z++)
+			for (y = lo[Y]; y <= hi[Y]; y++)
+				for (x = lo[X]; x <= hi[X]; x++)
+				{
+					Blob_Grid_Cell_Struct& Cell = Grid->Cells[(z * Grid->Size[Y] + y) * Grid->Size[X] + x];
+
+					Cell.Count++;
+
+					if (Element->Type == BLOB_SPHERE)
+						Cell.Spheres++;
+					else if (Element->Type == BLOB_CYLINDER)
+						Cell.Cylinders++;
+				}
+	}
+
+	first = 0;
+
+	for (i = 0; i < (int)Grid->Cells.size(); i++)
+	{
+		Grid->Cells[i].First = first;
+
+		first += Grid->Cells[i].Count;
+	}
+
+	/* Store the references: spheres, cylinders and all other components. */
+
+	Grid->Reference.resize(first);
+
+	for (i = 0; i < (int)Grid->Cells.size(); i++)
+	{
+		Next[i] = Grid->Cells[i].First;
+	}
+
+	for (pass = 0; pass < 3; pass++)
+	{
+		for (j = 0; j < n; j++)
+		{
+			i = Grid->Component[j];
+
+			Element = &Data->Entry[i];
+
+			if ((pass == 0) != (Element->Type == BLOB_SPHERE))
+				continue;
+
+			if ((pass == 1) != (Element->Type == BLOB_CYLINDER))
+				continue;
+
+			grid_cell_range(Grid, &Lower[3*i], &Upper[3*i], margin, lo, hi);
+
+			for (z = lo[Z]; z <= hi[Z]; z++)
+				for (y = lo[Y]; y <= hi[Y]; y++)
+					for (x = lo[X]; x <= hi[X]; x++)
+					{
+						Grid->Reference[Next[(z * Grid->Size[Y] + y) * Grid->Size[X] + x]++] = j;
+					}
+		}
+	}
+
+	Data->Grid = Grid;
+}
+
+
+
 /*****************************************************************************
 *
 * FUNCTION
@@ -2852,18 +3694,32 @@ void Blob::build_bounding_hierarchy()
 void Blob::Determine_Textures(Intersection *isect, bool hitinside, WeightedTextureVector& textures, TraceThreadData *Thread)
 {
 	int i;
-	unsigned int size;
+	unsigned int j, size;
 	DBL rad2;
 	VECTOR V1, P;
 	Blob_Element *Element;
 	BSPHERE_TREE *Tree;
+	const Blob_Grid_Cell_Struct *Cell;
 	size_t firstinserted = textures.size();
 	BSPHERE_TREE **Queue = (BSPHERE_TREE **) Thread->Blob_Queue;
 
 	/* Transform the point into the blob space. */
 	getLocalIPoint(P, isect);
 
-	if (Data->Tree == NULL)
+	if (Data->Grid != NULL)
+	{
+		/* A grid exists --> use the components of the cell containing P. */
+
+		if ((Cell = grid_cell(P)) != NULL)
+		{
+			for (j = Cell->First; j < Cell->First + Cell->Count; j++)
+			{
+				Element = &Data->Entry[Data->Grid->Component[Data->Grid->Reference[j]]];
+				determine_element_texture(Element, Element_Texture[Element->index], P, textures);
+			}
+		}
+	}
+	else if (Data->Tree == NULL)
 	{
 		/* There's no tree --> step through all elements. */
 
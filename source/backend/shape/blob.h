@@ -124,6 +124,22 @@ namespace pov
 
 #define BLOB_EXTRA_STATS 1
 
+/* Use a uniform grid instead of the bounding sphere hierarchy for blobs with many components. */
+
+#define BLOB_GRID_MIN_COMPONENTS 256
+
+/* Max. number of grid cells per component. */
+
+#define BLOB_GRID_MAX_CELLS 8
+
+/* Max. average number of grid cells referencing a component. */
+
+#define BLOB_GRID_MAX_REFERENCES 32
+
+/* Max. number of intervals sorted by insertion. */
+
+#define BLOB_MAX_INSERTION_SORT 32
+
 
 
 /*****************************************************************************
@@ -146,6 +162,33 @@ class Blob_Element
 		~Blob_Element();
 };
 
+struct Blob_Grid_Cell_Struct
+{
+	unsigned int First;     /* Index of the cell's first reference    */
+	unsigned int Spheres;   /* Number of spheres (referenced first)   */
+	unsigned int Cylinders; /* Number of cylinders (referenced next)  */
+	unsigned int Count;     /* Number of references                   */
+};
+
+struct Blob_Grid_Bound_Struct
+{
+	VECTOR C;               /* Center of the bounding sphere          */
+	DBL r2;                 /* Radius^2 of the bounding sphere        */
+};
+
+class Blob_Grid
+{
+	public:
+		VECTOR Min;                          /* Lower corner of the grid         */
+		DBL Cell_Size;                       /* Edge length of the cubic cells   */
+		DBL Inv_Cell_Size;
+		int Size[3];                         /* Number of cells along each axis  */
+		vector<Blob_Grid_Cell_Struct> Cells;
+		vector<unsigned int> Reference;      /* Bounding sphere indices by cell  */
+		vector<Blob_Grid_Bound_Struct> Bound; /* Components' bounding spheres   */
+		vector<unsigned int> Component;      /* Component index of each sphere   */
+};
+
 class Blob_Data
 {
 	public:
@@ -153,6 +196,7 @@ class Blob_Data
 		DBL Threshold;              /* Blob threshold           */
 		vector<Blob_Element> Entry; /* Array of blob components */
 		BSPHERE_TREE *Tree;         /* Bounding hierarchy       */
+		Blob_Grid *Grid;            /* Grid used instead of the hierarchy */
 
 		Blob_Data(int count = 0);
 		~Blob_Data();
@@ -215,9 +259,13 @@ class Blob : public ObjectBase
 		static void element_normal(VECTOR Result, const VECTOR P, const Blob_Element *Element);
 		static int intersect_element(const VECTOR P, const VECTOR D, const Blob_Element *Element, DBL mindist, DBL *t0, DBL *t1, TraceThreadData *Thread);
 		static void insert_hit(const Blob_Element *Element, DBL t0, DBL t1, Blob_Interval_Struct *intervals, unsigned int *cnt);
+		static void sort_hits(Blob_Interval_Struct *intervals, unsigned int cnt);
 		int determine_influences(const VECTOR P, const VECTOR D, DBL mindist, Blob_Interval_Struct *intervals, TraceThreadData *Thread) const;
+		unsigned int grid_influences(const VECTOR P, const VECTOR D, DBL mindist, Blob_Interval_Struct *intervals, TraceThreadData *Thread) const;
 		DBL calculate_field_value(const VECTOR P, TraceThreadData *Thread) const;
 		static DBL calculate_element_field(const Blob_Element *Element, const VECTOR P);
+		DBL calculate_cell_field(const Blob_Grid_Cell_Struct *Cell, const VECTOR P) const;
+		const Blob_Grid_Cell_Struct *grid_cell(const VECTOR P) const;
 
 		static int intersect_cylinder(const Blob_Element *Element, const VECTOR P, const VECTOR D, DBL mindist, DBL *tmin, DBL *tmax);
 		static int intersect_hemisphere(const Blob_Element *Element, const VECTOR P, const VECTOR D, DBL mindist, DBL *tmin, DBL *tmax);
@@ -226,6 +274,7 @@ class Blob : public ObjectBase
 
 		static void get_element_bounding_sphere(const Blob_Element *Element, VECTOR Center, DBL *Radius2);
 		void build_bounding_hierarchy();
+		void build_grid();
 
 		void determine_element_texture(const Blob_Element *Element, TEXTURE *Texture, const VECTOR P, WeightedTextureVector&);
 
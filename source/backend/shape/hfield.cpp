@@ -141,7 +141,7 @@ namespace pov
 
 #define sign(x) (((x) >= 0.0) ? 1.0 : -1.0)
 
-#define Get_Height(x, z) ((DBL)Data->Map[(z)][(x)])
+#define Get_Height(x, z) ((DBL)hfield_height(Data, (x), (z)))
 
 /* Small offest. */
 
@@ -151,6 +151,63 @@ const DBL HFIELD_TOLERANCE = 1.0e-6;
 
 
 
+/*****************************************************************************
+* Static functions
+******************************************************************************/
+
+/*
+ * Find the tile holding the sample at (x, z) and the index of the sample
+ * within it. The last tile in each direction also holds the samples on the
+ * far edge of the height field.
+ */
+
+static inline const HFIELD_TILE *hfield_tile(const HFIELD_DATA *Data, int x, int z, int *index)
+{
+	int tx, tz;
+	const HFIELD_TILE *Tile;
+
+	tx = min(x >> HFIELD_TILE_BITS, Data->tiles_x - 1);
+	tz = min(z >> HFIELD_TILE_BITS, Data->tiles_z - 1);
+
+	Tile = &Data->Tiles[tz * Data->tiles_x + tx];
+
+	*index = (z - (tz << HFIELD_TILE_BITS)) * Tile->width + (x - (tx << HFIELD_TILE_BITS));
+
+	return(Tile);
+}
+
+static inline HF_VAL hfield_sample(const HFIELD_TILE *Tile, int index)
+{
+	if (Tile->Small != NULL)
+	{
+		return(Tile->min_y + Tile->Small[index]);
+	}
+
+	if (Tile->Large != NULL)
+	{
+		return(Tile->Large[index]);
+	}
+
+	return(Tile->min_y);
+}
+
+static inline HF_VAL hfield_height(const HFIELD_DATA *Data, int x, int z)
+{
+	int index;
+	const HFIELD_TILE *Tile = hfield_tile(Data, x, z, &index);
+
+	return(hfield_sample(Tile, index));
+}
+
+/* Number of quadtree nodes along an axis of the given number of cells. */
+
+static inline int hfield_nodes(int cells, int level)
+{
+	return((cells + (1 << level) - 1) >> level);
+}
+
+
+
 /*****************************************************************************
 *
 * FUNCTION
@@ -374,18 +431,10 @@ void HField::Normal(VECTOR Result, Intersection *Inter, TraceThreadData *Thread)
 
 	if (Test_Flag(this, SMOOTHED_FLAG))
 	{
-		n[0][X] = Data->Normals[pz][px][0];
-		n[0][Y] = Data->Normals[pz][px][1];
-		n[0][Z] = Data->Normals[pz][px][2];
-		n[1][X] = Data->Normals[pz][px+1][0];
-		n[1][Y] = Data->Normals[pz][px+1][1];
-		n[1][Z] = Data->Normals[pz][px+1][2];
-		n[2][X] = Data->Normals[pz+1][px][0];
-		n[2][Y] = Data->Normals[pz+1][px][1];
-		n[2][Z] = Data->Normals[pz+1][px][2];
-		n[3][X] = Data->Normals[pz+1][px+1][0];
-		n[3][Y] = Data->Normals[pz+1][px+1][1];
-		n[3][Z] = Data->Normals[pz+1][px+1][2];
+		smooth_normal(px,   pz,   n[0]);
+		smooth_normal(px+1, pz,   n[1]);
+		smooth_normal(px,   pz+1, n[2]);
+		smooth_normal(px+1, pz+1, n[3]);
 
 		for (i = 0; i < 4; i++)
 		{
@@ -511,6 +560,8 @@ bool HField::intersect_pixel(int x, int z, const Ray &ray, DBL height1, DBL heig
 	DBL min_y2_y3, max_y2_y3;
 	DBL max_height, min_height;
 	VECTOR P, N, V1;
+	int index;
+	const HFIELD_TILE *Tile;
 
 #ifdef HFIELD_EXTRA_STATS
 	Thread->Stats()[Ray_HField_Cell_Tests]++;
@@ -519,10 +570,14 @@ bool HField::intersect_pixel(int x, int z, const Ray &ray, DBL height1, DBL heig
 	if (z>Data->max_z) z = Data->max_z;
 	if (x>Data->max_x) x = Data->max_x;
 
-	y1 = Get_Height(x,   z);
-	y2 = Get_Height(x+1, z);
-	y3 = Get_Height(x,   z+1);
-	y4 = Get_Height(x+1, z+1);
+	/* All corners of a cell are stored in the same tile. */
+
+	Tile = hfield_tile(Data, x, z, &index);
+
+	y1 = (DBL)hfield_sample(Tile, index);
+	y2 = (DBL)hfield_sample(Tile, index + 1);
+	y3 = (DBL)hfield_sample(Tile, index + Tile->width);
+	y4 = (DBL)hfield_sample(Tile, index + Tile->width + 1);
 
 	/* Do we hit this cell at all? */
 
@@ -718,7 +773,7 @@ bool HField::intersect_pixel(int x, int z, const Ray &ray, DBL height1, DBL heig
 *
 ******************************************************************************/
 
-int HField::add_single_normal(HF_VAL **data, int xsize, int zsize, int x0, int z0, int x1, int z1, int x2, int z2, VECTOR N)
+int HField::add_single_normal(int xsize, int zsize, int x0, int z0, int x1, int z1, int x2, int z2, VECTOR N) const
 {
 	VECTOR v0, v1, v2, t0, t1, Nt;
 
@@ -733,9 +788,9 @@ int HField::add_single_normal(HF_VAL **data, int xsize, int zsize, int x0, int z
 	}
 	else
 	{
-		Make_Vector(v0, x0, (DBL)data[z0][x0], z0);
-		Make_Vector(v1, x1, (DBL)data[z1][x1], z1);
-		Make_Vector(v2, x2, (DBL)data[z2][x2], z2);
+		Make_Vector(v0, x0, Get_Height(x0, z0), z0);
+		Make_Vector(v1, x1, Get_Height(x1, z1), z1);
+		Make_Vector(v2, x2, Get_Height(x2, z2), z2);
 
 		VSub(t0, v2, v0);
 		VSub(t1, v1, v0);
@@ -761,11 +816,15 @@ int HField::add_single_normal(HF_VAL **data, int xsize, int zsize, int x0, int z
 *
 * FUNCTION
 *
-*   smooth_height_field
+*   smooth_normal
 *
 * INPUT
+*
+*   x, z - Grid point
 *   
 * OUTPUT
+*
+*   N    - Averaged normal at the grid point
 *   
 * RETURNS
 *   
@@ -775,9 +834,10 @@ int HField::add_single_normal(HF_VAL **data, int xsize, int zsize, int x0, int z
 *   
 * DESCRIPTION
 *
-*   Given a height field that only contains an elevation grid, this
-*   routine will walk through the data and produce averaged normals
-*   for all points on the grid.
+*   Produce the averaged normal of a grid point of a smoothed height
+*   field from the surrounding triangles. The normal is rounded to the
+*   same 16 bit precision the normals of the whole grid used to be stored
+*   with; computing it when needed saves that storage.
 *
 * CHANGES
 *
@@ -785,53 +845,23 @@ int HField::add_single_normal(HF_VAL **data, int xsize, int zsize, int x0, int z
 *
 ******************************************************************************/
 
-void HField::smooth_height_field(int xsize, int zsize)
+void HField::smooth_normal(int x, int z, VECTOR N) const
 {
-	int i, j, k;
-	VECTOR N;
-	HF_VAL **map = Data->Map;
+	int xsize = Data->max_x + 1;
+	int zsize = Data->max_z + 1;
 
-	/* First off, allocate all the memory needed to store the normal information */
+	Make_Vector(N, 0.0, 0.0, 0.0);
 
-	Data->Normals_Height = zsize+1;
+	add_single_normal(xsize, zsize, x, z, x+1, z, x, z+1, N);
+	add_single_normal(xsize, zsize, x, z, x, z+1, x-1, z, N);
+	add_single_normal(xsize, zsize, x, z, x-1, z, x, z-1, N);
+	add_single_normal(xsize, zsize, x, z, x, z-1, x+1, z, N);
 
-	Data->Normals = (HF_Normals **)POV_MALLOC((zsize+1)*sizeof(HF_Normals *), "height field normals");
+	normalize(N, N);
 
-	for (i = 0; i <= zsize; i++)
-	{
-		Data->Normals[i] = (HF_Normals *)POV_MALLOC((xsize+1)*sizeof(HF_Normals), "height field normals");
-	}
-
-	/*
-	 * For now we will do it the hard way - by generating the normals
-	 * individually for each elevation point.
-	 */
-
-	for (i = 0; i <= zsize; i++)
-	{
-		for (j = 0; j <= xsize; j++)
-		{
-			Make_Vector(N, 0.0, 0.0, 0.0);
-
-			k = 0;
-
-			k += add_single_normal(map, xsize, zsize, j, i, j+1, i, j, i+1, N);
-			k += add_single_normal(map, xsize, zsize, j, i, j, i+1, j-1, i, N);
-			k += add_single_normal(map, xsize, zsize, j, i, j-1, i, j, i-1, N);
-			k += add_single_normal(map, xsize, zsize, j, i, j, i-1, j+1, i, N);
-
-			if (k == 0)
-			{
-				throw POV_EXCEPTION_STRING("Failed to find any normals at.");
-			}
-
-			normalize(N, N);
-
-			Data->Normals[i][j][0] = (short)(32767 * N[X]);
-			Data->Normals[i][j][1] = (short)(32767 * N[Y]);
-			Data->Normals[i][j][2] = (short)(32767 * N[Z]);
-		}
-	}
+	N[X] = (DBL)(short)(32767 * N[X]);
+	N[Y] = (DBL)(short)(32767 * N[Y]);
+	N[Z] = (DBL)(short)(32767 * N[Z]);
 }
 
 
@@ -854,8 +884,8 @@ void HField::smooth_height_field(int xsize, int zsize)
 *
 * DESCRIPTION
 *
-*   Copy image data into height field map. Create bounding blocks
-*   for the block traversal. Calculate normals for smoothed height fields.
+*   Copy image data into height field map. Create the quadtree
+*   for the traversal.
 *
 * CHANGES
 *
@@ -865,60 +895,26 @@ void HField::smooth_height_field(int xsize, int zsize)
 
 void HField::Compute_HField(ImageData *image)
 {
-	int x, z, max_x, max_z;
-	HF_VAL min_y, max_y, temp_y;
-
-	/* Get height field map size. */
-
-	max_x = image->iwidth;
-	max_z = image->iheight;
-
-	/* Allocate memory for map. */
-
-	Data->Map = (HF_VAL **)POV_MALLOC(max_z*sizeof(HF_VAL *), "height field");
-
-	for (z = 0; z < max_z; z++)
-	{
-		Data->Map[z] = (HF_VAL *)POV_MALLOC(max_x*sizeof(HF_VAL), "height field");
-	}
-
 	/* Copy map. */
 
-	min_y = 65535L;
-	max_y = 0;
-
-	for (z = 0; z < max_z; z++)
-	{
-		for (x = 0; x < max_x; x++)
-		{
-			temp_y = image_height_at(image, x, max_z - z - 1);
-
-			Data->Map[z][x] = temp_y;
-
-			min_y = min(min_y, temp_y);
-			max_y = max(max_y, temp_y);
-		}
-	}
+	build_hfield_tiles(image);
 
 	/* Resize bounding box. */
 
-	Data->min_y = min_y;
-	Data->max_y = max_y;
-
-	bounding_corner1[Y] = max((DBL)min_y, bounding_corner1[Y]) - HFIELD_OFFSET;
-	bounding_corner2[Y] = (DBL)max_y + HFIELD_OFFSET;
+	bounding_corner1[Y] = max((DBL)Data->min_y, bounding_corner1[Y]) - HFIELD_OFFSET;
+	bounding_corner2[Y] = (DBL)Data->max_y + HFIELD_OFFSET;
 
-	/* Compute smoothed height field. */
+	/* A smoothed height field needs at least one triangle at each grid point. */
 
-	if (Test_Flag(this, SMOOTHED_FLAG))
+	if (Test_Flag(this, SMOOTHED_FLAG) && ((image->iwidth < 2) || (image->iheight < 2)))
 	{
-		smooth_height_field(max_x-1, max_z-1);
+		throw POV_EXCEPTION_STRING("Failed to find any normals at.");
 	}
 
-	Data->max_x = max_x-2;
-	Data->max_z = max_z-2;
+	Data->max_x = image->iwidth-2;
+	Data->max_z = image->iheight-2;
 
-	build_hfield_blocks();
+	build_hfield_nodes();
 }
 
 
@@ -927,9 +923,11 @@ void HField::Compute_HField(ImageData *image)
 *
 * FUNCTION
 *
-*   build_hfield_blocks
+*   build_hfield_tiles
 *
 * INPUT
+*
+*   image - Image the heights are taken from
 *   
 * OUTPUT
 *   
@@ -937,129 +935,216 @@ void HField::Compute_HField(ImageData *image)
 *   
 * AUTHOR
 *
-*   Dieter Bayer
+*   -
 *   
 * DESCRIPTION
 *
-*   Create the bounding block hierarchy used by the block traversal.
+*   Copy the image data into the tiles of the height field map and find
+*   the min. and max. height. A tile keeps 8 bit offsets from its lowest
+*   height when possible, and no samples at all if it is flat, which
+*   roughly halves the memory needed by typical terrains.
 *
 * CHANGES
 *
-*   Feb 1995 : Creation.
+*   -
 *
 ******************************************************************************/
 
-void HField::build_hfield_blocks()
+void HField::build_hfield_tiles(ImageData *image)
 {
-	int x, z, nx, nz, wx, wz;
-	int i, j;
-	int xmin, xmax, zmin, zmax;
-	DBL y, ymin, ymax, water;
+	int x, z, tx, tz, width, height;
+	int x0, z0, xsize, zsize, i;
+	HF_VAL min_y, max_y, temp_y;
+	HF_VAL Samples[(HFIELD_TILE_SIZE+1) * (HFIELD_TILE_SIZE+1)];
+	HFIELD_TILE *Tile;
 
-	/* Get block size. */
+	/* Get height field map size. */
 
-	nx = max(1, (int)(sqrt((DBL)Data->max_x)));
-	nz = max(1, (int)(sqrt((DBL)Data->max_z)));
+	width = image->iwidth;
+	height = image->iheight;
 
-	/* Get dimensions of sub-block. */
+	Data->tiles_x = max(1, (width - 1 + HFIELD_TILE_SIZE - 1) >> HFIELD_TILE_BITS);
+	Data->tiles_z = max(1, (height - 1 + HFIELD_TILE_SIZE - 1) >> HFIELD_TILE_BITS);
 
-	wx = (int)ceil((DBL)(Data->max_x + 2) / (DBL)nx);
-	wz = (int)ceil((DBL)(Data->max_z + 2) / (DBL)nz);
+	/* Allocate memory for tiles. */
 
-	/* Increase number of sub-blocks if necessary. */
+	Data->Tiles = (HFIELD_TILE *)POV_MALLOC(Data->tiles_x*Data->tiles_z*sizeof(HFIELD_TILE), "height field");
 
-	if (nx * wx < Data->max_x + 2)
+	for (i = 0; i < Data->tiles_x*Data->tiles_z; i++)
 	{
-		nx++;
+		Data->Tiles[i].Small = NULL;
+		Data->Tiles[i].Large = NULL;
 	}
 
-	if (nz * wz < Data->max_z + 2)
-	{
-		nz++;
-	}
+	/* Copy map. */
+
+	Data->min_y = 65535L;
+	Data->max_y = 0;
 
-	if (!Test_Flag(this, HIERARCHY_FLAG) || ((nx == 1) && (nz == 1)))
+	for (tz = 0; tz < Data->tiles_z; tz++)
 	{
-		/* We don't want a bounding hierarchy. Just use one block. */
+		for (tx = 0; tx < Data->tiles_x; tx++)
+		{
+			Tile = &Data->Tiles[tz * Data->tiles_x + tx];
 
-		Data->Block = (HFIELD_BLOCK **)POV_MALLOC(sizeof(HFIELD_BLOCK *), "height field blocks");
+			/* Neighbouring tiles share their border samples. */
 
-		Data->Block[0] = (HFIELD_BLOCK *)POV_MALLOC(sizeof(HFIELD_BLOCK), "height field blocks");
+			x0 = tx << HFIELD_TILE_BITS;
+			z0 = tz << HFIELD_TILE_BITS;
 
-		Data->Block[0][0].xmin = 0;
-		Data->Block[0][0].xmax = Data->max_x;
-		Data->Block[0][0].zmin = 0;
-		Data->Block[0][0].zmax = Data->max_z;
+			xsize = min(HFIELD_TILE_SIZE, width - 1 - x0) + 1;
+			zsize = min(HFIELD_TILE_SIZE, height - 1 - z0) + 1;
 
-		Data->Block[0][0].ymin = bounding_corner1[Y];
-		Data->Block[0][0].ymax = bounding_corner2[Y];
+			min_y = 65535L;
+			max_y = 0;
 
-		Data->block_max_x = 1;
-		Data->block_max_z = 1;
+			for (z = 0; z < zsize; z++)
+			{
+				for (x = 0; x < xsize; x++)
+				{
+					temp_y = image_height_at(image, x0 + x, height - (z0 + z) - 1);
 
-		Data->block_width_x = Data->max_x + 2;
-		Data->block_width_z = Data->max_y + 2;
+					Samples[z * xsize + x] = temp_y;
 
-//		Debug_Info("Height field: %d x %d (1 x 1 blocks)\n", Data->max_x+2, Data->max_z+2);
+					min_y = min(min_y, temp_y);
+					max_y = max(max_y, temp_y);
+				}
+			}
 
-		return;
+			Tile->min_y = min_y;
+			Tile->max_y = max_y;
+			Tile->width = xsize;
+
+			if (max_y - min_y >= 256)
+			{
+				Tile->Large = (HF_VAL *)POV_MALLOC(xsize*zsize*sizeof(HF_VAL), "height field");
+
+				memcpy(Tile->Large, Samples, xsize*zsize*sizeof(HF_VAL));
+			}
+			else if (max_y > min_y)
+			{
+				Tile->Small = (unsigned char *)POV_MALLOC(xsize*zsize, "height field");
+
+				for (i = 0; i < xsize*zsize; i++)
+				{
+					Tile->Small[i] = (unsigned char)(Samples[i] - min_y);
+				}
+			}
+
+			Data->min_y = min(Data->min_y, min_y);
+			Data->max_y = max(Data->max_y, max_y);
+		}
 	}
+}
 
-//	Debug_Info("Height field: %d x %d (%d x %d blocks)\n", Data->max_x+2, Data->max_z+2, nx, nz);
 
-	/* Allocate memory for blocks. */
 
-	Data->Block = (HFIELD_BLOCK **)POV_MALLOC(nz*sizeof(HFIELD_BLOCK *), "height field blocks");
+/*****************************************************************************
+*
+* FUNCTION
+*
+*   build_hfield_nodes
+*
+* INPUT
+*   
+* OUTPUT
+*   
+* RETURNS
+*   
+* AUTHOR
+*
+*   -
+*   
+* DESCRIPTION
+*
+*   Create the quadtree of min. and max. heights used by the node
+*   traversal. The nodes of level HFIELD_NODE_LEVEL are taken from the
+*   height map, each higher level from the one below. The single node
+*   of the top level covers the whole height field.
+*
+* CHANGES
+*
+*   -
+*
+******************************************************************************/
+
+void HField::build_hfield_nodes()
+{
+	int x, z, i, j, nx, nz, cnx, cnz, level;
+	int xmin, xmax, zmin, zmax;
+	int cells_x, cells_z;
+	HF_VAL y, ymin, ymax;
+	HFIELD_NODE *Node, *Child;
 
-	/* Store block information. */
+	cells_x = max(1, Data->max_x + 1);
+	cells_z = max(1, Data->max_z + 1);
 
-	Data->block_max_x = nx;
-	Data->block_max_z = nz;
+	/* Get level of the root node. */
 
-	Data->block_width_x = wx;
-	Data->block_width_z = wz;
+	for (level = HFIELD_NODE_LEVEL; (hfield_nodes(cells_x, level) > 1) || (hfield_nodes(cells_z, level) > 1); level++)
+		;
 
-	water = bounding_corner1[Y];
+	Data->levels = level + 1;
 
-	for (z = 0; z < nz; z++)
+	Data->Nodes = (HFIELD_NODE **)POV_MALLOC((Data->levels-HFIELD_NODE_LEVEL)*sizeof(HFIELD_NODE *), "height field nodes");
+
+	for (level = HFIELD_NODE_LEVEL; level < Data->levels; level++)
 	{
-		Data->Block[z] = (HFIELD_BLOCK *)POV_MALLOC(nx*sizeof(HFIELD_BLOCK), "height field blocks");
+		nx = hfield_nodes(cells_x, level);
+		nz = hfield_nodes(cells_z, level);
+
+		Node = Data->Nodes[level-HFIELD_NODE_LEVEL] = (HFIELD_NODE *)POV_MALLOC(nx*nz*sizeof(HFIELD_NODE), "height field nodes");
 
-		for (x = 0; x < nx; x++)
+		for (z = 0; z < nz; z++)
 		{
-			/* Get block's borders. */
+			for (x = 0; x < nx; x++, Node++)
+			{
+				ymin = 65535L;
+				ymax = 0;
 
-			xmin = x * wx;
-			zmin = z * wz;
+				if (level == HFIELD_NODE_LEVEL)
+				{
+					/* Find min. and max. height of the cells in the node. */
 
-			xmax = min((x + 1) * wx - 1, Data->max_x);
-			zmax = min((z + 1) * wz - 1, Data->max_z);
+					xmin = x << level;
+					zmin = z << level;
 
-			/* Find min. and max. height in current block. */
+					xmax = min(xmin + (1 << level), Data->max_x + 1);
+					zmax = min(zmin + (1 << level), Data->max_z + 1);
 
-			ymin = BOUND_HUGE;
-			ymax = -BOUND_HUGE;
+					for (j = zmin; j <= zmax; j++)
+					{
+						for (i = xmin; i <= xmax; i++)
+						{
+							y = hfield_height(Data, i, j);
 
-			for (i = xmin; i <= xmax+1; i++)
-			{
-				for (j = zmin; j <= zmax+1; j++)
+							ymin = min(ymin, y);
+							ymax = max(ymax, y);
+						}
+					}
+				}
+				else
 				{
-					y = Get_Height(i, j);
+					/* Combine the child nodes. */
 
-					ymin = min(ymin, y);
-					ymax = max(ymax, y);
-				}
-			}
+					cnx = hfield_nodes(cells_x, level-1);
+					cnz = hfield_nodes(cells_z, level-1);
 
-			/* Store block's borders. */
+					for (j = 2*z; j < min(2*z+2, cnz); j++)
+					{
+						for (i = 2*x; i < min(2*x+2, cnx); i++)
+						{
+							Child = &Data->Nodes[level-1-HFIELD_NODE_LEVEL][j * cnx + i];
 
-			Data->Block[z][x].xmin = xmin;
-			Data->Block[z][x].xmax = xmax;
-			Data->Block[z][x].zmin = zmin;
-			Data->Block[z][x].zmax = zmax;
+							ymin = min(ymin, Child->min_y);
+							ymax = max(ymax, Child->max_y);
+						}
+					}
+				}
 
-			Data->Block[z][x].ymin = max(ymin, water) - HFIELD_OFFSET;
-			Data->Block[z][x].ymax = ymax + HFIELD_OFFSET;
+				Node->min_y = ymin;
+				Node->max_y = ymax;
+			}
 		}
 	}
 }
@@ -1272,19 +1357,16 @@ HField::HField() : ObjectBase(HFIELD_OBJECT)
 
 	Data->References = 1;
 
-	Data->Normals_Height = 0;
-
-	Data->Map     = NULL;
-	Data->Normals = NULL;
+	Data->Tiles = NULL;
+	Data->Nodes = NULL;
 
 	Data->max_x = 0;
 	Data->max_z = 0;
 
-	Data->block_max_x = 0;
-	Data->block_max_z = 0;
+	Data->tiles_x = 0;
+	Data->tiles_z = 0;
 
-	Data->block_width_x = 0;
-	Data->block_width_z = 0;
+	Data->levels = 0;
 
 	Set_Flag(this, HIERARCHY_FLAG);
 }
@@ -1376,37 +1458,32 @@ HField::~HField()
 
 	if (--(Data->References) == 0)
 	{
-		if (Data->Map != NULL)
+		if (Data->Tiles != NULL)
 		{
-			for (i = 0; i < Data->max_z+2; i++)
+			for (i = 0; i < Data->tiles_x*Data->tiles_z; i++)
 			{
-				if (Data->Map[i] != NULL)
+				if (Data->Tiles[i].Small != NULL)
 				{
-					POV_FREE (Data->Map[i]);
+					POV_FREE (Data->Tiles[i].Small);
 				}
-			}
-
-			POV_FREE (Data->Map);
-		}
 
-		if (Data->Normals != NULL)
-		{
-			for (i = 0; i < Data->Normals_Height; i++)
-			{
-				POV_FREE (Data->Normals[i]);
+				if (Data->Tiles[i].Large != NULL)
+				{
+					POV_FREE (Data->Tiles[i].Large);
+				}
 			}
 
-			POV_FREE (Data->Normals);
+			POV_FREE (Data->Tiles);
 		}
 
-		if (Data->Block != NULL)
+		if (Data->Nodes != NULL)
 		{
-			for (i = 0; i < Data->block_max_z; i++)
+			for (i = 0; i < Data->levels-HFIELD_NODE_LEVEL; i++)
 			{
-				POV_FREE(Data->Block[i]);
+				POV_FREE(Data->Nodes[i]);
 			}
 
-			POV_FREE(Data->Block);
+			POV_FREE(Data->Nodes);
 		}
 
 		POV_FREE (Data);
@@ -1902,7 +1979,8 @@ bool HField::dda_traversal(const Ray &ray, const VECTOR Start, const HFIELD_BLOC
 *
 * DESCRIPTION
 *
-*   Traverse the blocks of the height field.
+*   Traverse the height field, using the quadtree unless the
+*   hierarchy has been turned off.
 *
 * CHANGES
 *
@@ -1920,17 +1998,10 @@ bool HField::dda_traversal(const Ray &ray, const VECTOR Start, const HFIELD_BLOC
 
 bool HField::block_traversal(const Ray &ray, const VECTOR Start, IStack &HField_Stack, const Ray &RRay, DBL mindist, DBL maxdist, TraceThreadData *Thread)
 {
-	int xmax, zmax;
-	int x, z, nx, nz, signx, signz;
-	int found = false;
-	int dx_zero, dz_zero;
+	int x, z;
 	DBL px, pz, dx, dy, dz;
-	DBL maxdv;
-	DBL ymin, ymax, y1, y2;
 	DBL neary, fary;
-	DBL k1, k2, dist;
-	VECTOR nearP, farP;
-	HFIELD_BLOCK *Block;
+	HFIELD_BLOCK Block;
 
 	px = Start[X];
 	pz = Start[Z];
@@ -1939,8 +2010,6 @@ bool HField::block_traversal(const Ray &ray, const VECTOR Start, IStack &HField_
 	dy = ray.Direction[Y];
 	dz = ray.Direction[Z];
 
-	maxdv = (dx > dz) ? dx : dz;
-
 	/* First test for 'perpendicular' rays. */
 
 	if ((fabs(dx) < EPSILON) && (fabs(dz) < EPSILON))
@@ -1962,150 +2031,187 @@ bool HField::block_traversal(const Ray &ray, const VECTOR Start, IStack &HField_
 		return intersect_pixel(x, z, ray, min(neary, fary), max(neary, fary), HField_Stack, RRay, mindist, maxdist, Thread);
 	}
 
-	/* If we don't have blocks we just step through the grid. */
+	/* If we don't want a hierarchy we just step through the grid. */
 
-	if ((Data->block_max_x <= 1) && (Data->block_max_z <= 1))
+	if (!Test_Flag(this, HIERARCHY_FLAG))
 	{
-		return dda_traversal(ray, Start, &Data->Block[0][0], HField_Stack, RRay, mindist, maxdist, Thread);
+		Block.xmin = 0;
+		Block.xmax = Data->max_x;
+		Block.zmin = 0;
+		Block.zmax = Data->max_z;
+
+		Block.ymin = bounding_corner1[Y];
+		Block.ymax = bounding_corner2[Y];
+
+		return dda_traversal(ray, Start, &Block, HField_Stack, RRay, mindist, maxdist, Thread);
 	}
 
-	/* Get dimensions of grid. */
+	/* Walk down the quadtree, starting at its root. */
 
-	xmax = Data->block_max_x;
-	zmax = Data->block_max_z;
+	return node_traversal(ray, Data->levels - 1, 0, 0, mindist, maxdist, HField_Stack, RRay, mindist, maxdist, Thread);
+}
 
-	ymin = (DBL)Data->min_y - EPSILON;
-	ymax = (DBL)Data->max_y + EPSILON;
 
-	dx_zero = (fabs(dx) < EPSILON);
-	dz_zero = (fabs(dz) < EPSILON);
 
-	signx = sign(dx);
-	signz = sign(dz);
+/*****************************************************************************
+*
+* FUNCTION
+*
+*   node_traversal
+*
+* INPUT
+*
+*   Ray      - Current ray
+*   level    - Quadtree level of the node
+*   x, z     - Position of the node on its level
+*   mindepth - Depth where the ray enters the parent node
+*   maxdepth - Depth where the ray leaves the parent node
+*
+* OUTPUT
+*
+* RETURNS
+*
+*   bool - true if intersection was found
+*
+* AUTHOR
+*
+*   -
+*
+* DESCRIPTION
+*
+*   Traverse a node of the quadtree. The ray is clipped to the node and
+*   the node skipped if the ray passes above or below all of its heights.
+*   Otherwise its four children are traversed from front to back, down to
+*   the lowest stored level whose cells are stepped through by
+*   dda_traversal(). This lets rays at grazing angles skip large parts of
+*   the height field at once.
+*
+* CHANGES
+*
+*   -
+*
+******************************************************************************/
 
-	/* Walk on the block grid. */
+bool HField::node_traversal(const Ray &ray, int level, int x, int z, DBL mindepth, DBL maxdepth, IStack &HField_Stack, const Ray &RRay, DBL mindist, DBL maxdist, TraceThreadData *Thread)
+{
+	int i, cx, cz, nx, nz, signx, signz;
+	int xmin, xmax, zmin, zmax;
+	int found = false;
+	DBL k1, k2, y1, y2, ymin, ymax;
+	VECTOR Start;
+	HFIELD_BLOCK Block;
+	const HFIELD_NODE *Node;
 
-	px /= Data->block_width_x;
-	pz /= Data->block_width_z;
+	/* Get the cells covered by the node. */
 
-	x = (int)px;
-	z = (int)pz;
+	xmin = x << level;
+	zmin = z << level;
 
-	Assign_Vector(nearP, Start);
+	xmax = min(xmin + (1 << level), Data->max_x + 1);
+	zmax = min(zmin + (1 << level), Data->max_z + 1);
 
-	neary = Start[Y];
+	/* Clip the ray to the node. */
 
-	/*
-	 * Here comes the block walk algorithm.
-	 */
+	if (fabs(ray.Direction[X]) < EPSILON)
+	{
+		if ((ray.Origin[X] < (DBL)xmin - HFIELD_TOLERANCE) || (ray.Origin[X] > (DBL)xmax + HFIELD_TOLERANCE))
+		{
+			return(false);
+		}
+	}
+	else
+	{
+		k1 = ((DBL)xmin - HFIELD_TOLERANCE - ray.Origin[X]) / ray.Direction[X];
+		k2 = ((DBL)xmax + HFIELD_TOLERANCE - ray.Origin[X]) / ray.Direction[X];
+
+		mindepth = max(mindepth, min(k1, k2));
+		maxdepth = min(maxdepth, max(k1, k2));
+	}
 
-	do
+	if (fabs(ray.Direction[Z]) < EPSILON)
 	{
-#ifdef HFIELD_EXTRA_STATS
-		Thread->Stats()[Ray_HField_Block_Tests]++;
-#endif
+		if ((ray.Origin[Z] < (DBL)zmin - HFIELD_TOLERANCE) || (ray.Origin[Z] > (DBL)zmax + HFIELD_TOLERANCE))
+		{
+			return(false);
+		}
+	}
+	else
+	{
+		k1 = ((DBL)zmin - HFIELD_TOLERANCE - ray.Origin[Z]) / ray.Direction[Z];
+		k2 = ((DBL)zmax + HFIELD_TOLERANCE - ray.Origin[Z]) / ray.Direction[Z];
 
-		/* Get current block. */
+		mindepth = max(mindepth, min(k1, k2));
+		maxdepth = min(maxdepth, max(k1, k2));
+	}
 
-		Block = &Data->Block[z][x];
+	if (mindepth > maxdepth)
+	{
+		return(false);
+	}
 
-		/* Intersect ray with bounding planes. */
+	/* Get the heights of the ray inside the node. */
 
-		if (dx_zero)
-		{
-			k1 = BOUND_HUGE;
-		}
-		else
-		{
-			if (signx >= 0)
-			{
-				k1 = ((DBL)Block->xmax + 1.0 - ray.Origin[X]) / dx;
-			}
-			else
-			{
-				k1 = ((DBL)Block->xmin - ray.Origin[X]) / dx;
-			}
-		}
+	k1 = ray.Origin[Y] + mindepth * ray.Direction[Y];
+	k2 = ray.Origin[Y] + maxdepth * ray.Direction[Y];
 
-		if (dz_zero)
-		{
-			k2 = BOUND_HUGE;
-		}
-		else
-		{
-			if (signz >= 0)
-			{
-				k2 = ((DBL)Block->zmax + 1.0 - ray.Origin[Z]) / dz;
-			}
-			else
-			{
-				k2 = ((DBL)Block->zmin - ray.Origin[Z]) / dz;
-			}
-		}
+	y1 = min(k1, k2);
+	y2 = max(k1, k2);
 
-		/* Figure out the indices of the next block. */
+	/* Can we hit the node at all? */
 
-		if (dz_zero || ((!dx_zero) && (k1<k2 - EPSILON / maxdv) && (k1>0.0)))
-/*		if ((k1 < k2 - EPSILON / maxdv) && (k1 > 0.0)) */
-		{
-			/* Step along the x-axis. */
+#ifdef HFIELD_EXTRA_STATS
+	Thread->Stats()[Ray_HField_Block_Tests]++;
+#endif
 
-			dist = k1;
+	Node = &Data->Nodes[level-HFIELD_NODE_LEVEL][z * hfield_nodes(Data->max_x + 1, level) + x];
 
-			nx = x + signx;
-			nz = z;
-		}
-		else
-		{
-			if (dz_zero || ((!dx_zero) && (k1<k2 + EPSILON / maxdv) && (k1>0.0)))
-/*			if ((k1 < k2 + EPSILON / maxdv) && (k1 > 0.0))  */
-			{
-				/* Step along both axis (very rare case). */
+	ymin = max((DBL)Node->min_y, bounding_corner1[Y]) - HFIELD_OFFSET;
+	ymax = (DBL)Node->max_y + HFIELD_OFFSET;
 
-				dist = k1;
+	if ((y1 > ymax + EPSILON) || (y2 < ymin - EPSILON))
+	{
+		return(false);
+	}
 
-				nx = x + signx;
-				nz = z + signz;
-			}
-			else
-			{
-				/* Step along the z-axis. */
+#ifdef HFIELD_EXTRA_STATS
+	Thread->Stats()[Ray_HField_Block_Tests_Succeeded]++;
+#endif
 
-				dist = k2;
+	/* Step through the cells of the lowest nodes. */
 
-				nx = x;
-				nz = z + signz;
-			}
-		}
+	if (level == HFIELD_NODE_LEVEL)
+	{
+		Block.xmin = xmin;
+		Block.xmax = xmax - 1;
+		Block.zmin = zmin;
+		Block.zmax = zmax - 1;
 
-		/* Get point where ray leaves current block. */
+		Block.ymin = ymin;
+		Block.ymax = ymax;
 
-		VEvaluateRay(farP, ray.Origin, dist, ray.Direction);
+		VEvaluateRay(Start, ray.Origin, mindepth, ray.Direction);
 
-		fary = farP[Y];
+		return dda_traversal(ray, Start, &Block, HField_Stack, RRay, mindist, maxdist, Thread);
+	}
 
-		if (neary < fary)
-		{
-			y1 = neary;
-			y2 = fary;
-		}
-		else
-		{
-			y1 = fary;
-			y2 = neary;
-		}
+	/* Test the children from front to back. */
 
-		/* Can we hit current block at all? */
+	level--;
 
-		if ((y1 <= (DBL)Block->ymax + EPSILON) && (y2 >= (DBL)Block->ymin - EPSILON))
-		{
-			/* Test current block. */
+	nx = hfield_nodes(Data->max_x + 1, level);
+	nz = hfield_nodes(Data->max_z + 1, level);
 
-#ifdef HFIELD_EXTRA_STATS
-			Thread->Stats()[Ray_HField_Block_Tests_Succeeded]++;
-#endif
+	signx = (ray.Direction[X] < 0.0);
+	signz = (ray.Direction[Z] < 0.0);
+
+	for (i = 0; i < 4; i++)
+	{
+		cx = 2 * x + ((i & 1) ^ signx);
+		cz = 2 * z + ((i >> 1) ^ signz);
 
-			if (dda_traversal(ray, nearP, &Data->Block[z][x], HField_Stack, RRay, mindist, maxdist, Thread))
+		if ((cx < nx) && (cz < nz))
+		{
+			if (node_traversal(ray, level, cx, cz, mindepth, maxdepth, HField_Stack, RRay, mindist, maxdist, Thread))
 			{
 				if (Type & IS_CHILD_OBJECT)
 				{
@@ -2117,17 +2223,7 @@ bool HField::block_traversal(const Ray &ray, const VECTOR Start, IStack &HField_
 				}
 			}
 		}
-
-		/* Step to next block. */
-
-		x = nx;
-		z = nz;
-
-		Assign_Vector(nearP, farP);
-
-		neary = fary;
 	}
-	while ((x >= 0) && (x < xmax) && (z >= 0) && (z < zmax) && (neary >= ymin) && (neary <= ymax));
 
 	return(found);
 }
@@ -109,6 +109,15 @@ namespace pov
 
 #define HFIELD_EXTRA_STATS 1
 
+/* Cells per tile of the height map (must be a power of two). */
+
+#define HFIELD_TILE_BITS 5
+#define HFIELD_TILE_SIZE (1 << HFIELD_TILE_BITS)
+
+/* Lowest quadtree level; the cells of its nodes are stepped through. */
+
+#define HFIELD_NODE_LEVEL 3
+
 
 /*****************************************************************************
 * Global typedefs
@@ -117,6 +126,8 @@ namespace pov
 typedef struct HField_Data_Struct HFIELD_DATA;
 typedef struct HField_Block_Struct HFIELD_BLOCK;
 typedef struct HField_Normal_Struct HFIELD_NORMAL;
+typedef struct HField_Tile_Struct HFIELD_TILE;
+typedef struct HField_Node_Struct HFIELD_NODE;
 typedef short HF_Normals[3];
 
 struct HField_Normal_Struct
@@ -132,17 +143,41 @@ struct HField_Block_Struct
 	DBL ymin, ymax;
 };
 
+/*
+ * The height map is stored in square tiles of HFIELD_TILE_SIZE x
+ * HFIELD_TILE_SIZE cells. Neighbouring tiles share their border samples,
+ * so all four corners of a cell are found in the same tile. Tiles whose
+ * heights span less than 256 units only store the offset of each sample
+ * from min_y, and flat tiles store no samples at all.
+ */
+
+struct HField_Tile_Struct
+{
+	HF_VAL min_y, max_y;
+	int width;                /* Samples per row */
+	unsigned char *Small;     /* Heights minus min_y, if max_y - min_y < 256 */
+	HF_VAL *Large;            /* Heights, otherwise */
+};
+
+/*
+ * Min. and max. height of the cells covered by a node of the quadtree
+ * used to skip empty space. A node on level n covers 2^n x 2^n cells.
+ */
+
+struct HField_Node_Struct
+{
+	HF_VAL min_y, max_y;
+};
+
 struct HField_Data_Struct
 {
 	int References;
-	int Normals_Height;  /* Needed for Destructor */
 	int max_x, max_z;
 	HF_VAL min_y, max_y;
-	int block_max_x, block_max_z;
-	int block_width_x, block_width_z;
-	HF_VAL **Map;
-	HF_Normals **Normals;
-	HFIELD_BLOCK **Block;
+	int tiles_x, tiles_z;
+	int levels;
+	HFIELD_TILE *Tiles;
+	HFIELD_NODE **Nodes;      /* Quadtree levels from HFIELD_NODE_LEVEL up */
 };
 
 class HField : public ObjectBase
@@ -170,12 +205,14 @@ class HField : public ObjectBase
 		void Compute_HField(ImageData *image);
 	protected:
 		static DBL normalize(VECTOR A, const VECTOR B);
-		void smooth_height_field(int xsize, int zsize);
+		void smooth_normal(int x, int z, VECTOR N) const;
 		bool intersect_pixel(int x, int z, const Ray& ray, DBL height1, DBL height2, IStack &HField_Stack, const Ray &RRay, DBL mindist, DBL maxdist, TraceThreadData *Thread);
-		static int add_single_normal(HF_VAL **data, int xsize, int zsize, int x0, int z0,int x1, int z1,int x2, int z2, VECTOR N);
+		int add_single_normal(int xsize, int zsize, int x0, int z0,int x1, int z1,int x2, int z2, VECTOR N) const;
 		bool dda_traversal(const Ray &ray, const VECTOR Start, const HFIELD_BLOCK *Block, IStack &HField_Stack, const Ray &RRay, DBL mindist, DBL maxdist, TraceThreadData *Thread);
 		bool block_traversal(const Ray &ray, const VECTOR Start, IStack &HField_Stack, const Ray &RRay, DBL mindist, DBL maxdist, TraceThreadData *Thread);
-		void build_hfield_blocks();
+		bool node_traversal(const Ray &ray, int level, int x, int z, DBL mindepth, DBL maxdepth, IStack &HField_Stack, const Ray &RRay, DBL mindist, DBL maxdist, TraceThreadData *Thread);
+		void build_hfield_tiles(ImageData *image);
+		void build_hfield_nodes();
 };
 
 }
@@ -426,8 +426,8 @@ bool IsoSurface::Inside(const VECTOR IPoint, TraceThreadData *Thread) const
 
 void IsoSurface::Normal(VECTOR Result, Intersection *Inter, TraceThreadData *Thread) const
 {
-	VECTOR New_Point, TPoint;
-	DBL funct;
+	VECTOR New_Point, TPoints[4];
+	DBL funct, Values[4];
 
 	switch (Inter->i1)
 	{
@@ -469,17 +469,18 @@ void IsoSurface::Normal(VECTOR Result, Intersection *Inter, TraceThreadData *Thr
 				}
 			}
 
-			Assign_Vector(TPoint, New_Point);
-			funct = Evaluate_Function(Thread->functionContext, *Function, TPoint);
-			Assign_Vector(TPoint, New_Point);
-			TPoint[X] += accuracy;
-			Result[X] = Evaluate_Function(Thread->functionContext, *Function, TPoint) - funct;
-			Assign_Vector(TPoint, New_Point);
-			TPoint[Y] += accuracy;
-			Result[Y] = Evaluate_Function(Thread->functionContext, *Function, TPoint) - funct;
-			Assign_Vector(TPoint, New_Point);
-			TPoint[Z] += accuracy;
-			Result[Z] = Evaluate_Function(Thread->functionContext, *Function, TPoint) - funct;
+			Assign_Vector(TPoints[0], New_Point);
+			Assign_Vector(TPoints[1], New_Point);
+			TPoints[1][X] += accuracy;
+			Assign_Vector(TPoints[2], New_Point);
+			TPoints[2][Y] += accuracy;
+			Assign_Vector(TPoints[3], New_Point);
+			TPoints[3][Z] += accuracy;
+			POVFPU_RunBatch(Thread->functionContext, *Function, TPoints, Values, 4);
+			funct = Values[0];
+			Result[X] = Values[1] - funct;
+			Result[Y] = Values[2] - funct;
+			Result[Z] = Values[3] - funct;
 
 			if((Result[X] == 0) && (Result[Y] == 0) && (Result[Z] == 0))
 				Result[X] = 1.0;
@@ -987,6 +988,8 @@ bool IsoSurface::Function_Find_Root(ISO_ThreadData& itd, const VECTOR PP, const
 	DBL dt, t21, l_b, l_e, oldmg;
 	ISO_Pair EP1, EP2;
 	VECTOR VTmp;
+	VECTOR Points[2];
+	DBL Values[2];
 
 	itd.ctx->threaddata->Stats()[Ray_IsoSurface_Find_Root]++;
 
@@ -1013,7 +1016,12 @@ bool IsoSurface::Function_Find_Root(ISO_ThreadData& itd, const VECTOR PP, const
 
 	itd.cache = false;
 	EP1.t = *Depth1;
-	EP1.f = Float_Function(itd, Depth1);
+	EP2.t = *Depth2;
+	VEvaluateRay(Points[0], PP, EP1.t, DD);
+	VEvaluateRay(Points[1], PP, EP2.t, DD);
+	POVFPU_RunBatch(itd.ctx, *Function, Points, Values, 2);
+
+	EP1.f = (DBL)itd.Inv3 * (Values[0] - threshold);
 	itd.fmax = EP1.f;
 	if((closed == false) && (EP1.f < 0.0))
 	{
@@ -1021,8 +1029,7 @@ bool IsoSurface::Function_Find_Root(ISO_ThreadData& itd, const VECTOR PP, const
 		EP1.f *= -1;
 	}
 
-	EP2.t = *Depth2;
-	EP2.f = Float_Function(itd, Depth2);
+	EP2.f = (DBL)itd.Inv3 * (Values[1] - threshold);
 	itd.fmax = min(EP2.f, itd.fmax);
 
 	oldmg = maxg;
@@ -1030,7 +1037,7 @@ bool IsoSurface::Function_Find_Root(ISO_ThreadData& itd, const VECTOR PP, const
 	if((eval == true) && (oldmg > eval_param[0]))
 		maxg = oldmg * eval_param[2];
 	dt = maxg * itd.Vlength * t21;
-	if(Function_Find_Root_R(itd, &EP1, &EP2, dt, t21, 1.0 / (itd.Vlength * t21), maxg))
+	if(Function_Find_Root_R(itd, &EP1, &EP2, dt, t21, 1.0 / (itd.Vlength * t21), maxg, NULL, NULL))
 	{
 		if(eval == true)
 		{
@@ -1089,9 +1096,10 @@ bool IsoSurface::Function_Find_Root(ISO_ThreadData& itd, const VECTOR PP, const
 *
 ******************************************************************************/
 
-bool IsoSurface::Function_Find_Root_R(ISO_ThreadData& itd, const ISO_Pair* EP1, const ISO_Pair* EP2, DBL dt, DBL t21, DBL len, DBL& maxg)
+bool IsoSurface::Function_Find_Root_R(ISO_ThreadData& itd, const ISO_Pair* EP1, const ISO_Pair* EP2, DBL dt, DBL t21, DBL len, DBL& maxg, ISO_Pending *self, ISO_Pending *pending)
 {
 	ISO_Pair EPa;
+	ISO_Pending right;
 	DBL temp;
 
 	temp = fabs((EP2->f - EP1->f) * len);
@@ -1120,11 +1128,23 @@ bool IsoSurface::Function_Find_Root_R(ISO_ThreadData& itd, const ISO_Pair* EP1,
 		t21 *= 0.5;
 		dt *= 0.5;
 		EPa.t = EP1->t + t21;
-		EPa.f = Float_Function(itd, &EPa.t);
+
+		if((self != NULL) && (self->known == true))
+			EPa.f = self->f;
+		else
+			EPa.f = Float_Function_Batch(itd, EPa.t, pending);
 
 		itd.fmax = min(EPa.f, itd.fmax);
-		if(!Function_Find_Root_R(itd, EP1, &EPa, dt, t21, len * 2.0, maxg))
-			return (Function_Find_Root_R(itd, &EPa, EP2, dt, t21, len * 2.0,maxg));
+
+		right.EP1 = &EPa;
+		right.EP2 = EP2;
+		right.dt = dt;
+		right.t21 = t21;
+		right.known = false;
+		right.next = pending;
+
+		if(!Function_Find_Root_R(itd, EP1, &EPa, dt, t21, len * 2.0, maxg, NULL, &right))
+			return (Function_Find_Root_R(itd, &EPa, EP2, dt, t21, len * 2.0, maxg, &right, pending));
 		else
 			return true;
 	}
@@ -1169,21 +1189,30 @@ DBL IsoSurface::Vector_Function(FPUContext *ctx, const VECTOR VPos) const
 *
 * FUNCTION
 *
-*   Float_IsoSurface_Function
+*   Float_Function_Batch
 *
 * INPUT
 *
+*   t       - depth to evaluate the function at
+*   pending - intervals the root solver will subdivide later
+*
 * OUTPUT
 *
 * RETURNS
 *
-* AUTHOR
+*   DBL - function value at depth t
 *
-*   R. Suzuki
+* AUTHOR
 *
 * DESCRIPTION
 *
-*   -
+*   Evaluates the function at depth t together with the midpoints of
+*   pending intervals.  Unless a root is found first, the root solver
+*   subdivides every pending interval whose endpoints do not rule out a
+*   root, so their midpoint values are kept for when it gets there.  The
+*   midpoints are computed exactly like Function_Find_Root_R does.  With
+*   max_gradient evaluation turned on, the subdivision depends on values
+*   not known yet, so no pending intervals are evaluated.
 *
 * CHANGES
 *
@@ -1191,13 +1220,37 @@ DBL IsoSurface::Vector_Function(FPUContext *ctx, const VECTOR VPos) const
 *
 ******************************************************************************/
 
-DBL IsoSurface::Float_Function(ISO_ThreadData& itd, DBL* t) const
+DBL IsoSurface::Float_Function_Batch(ISO_ThreadData& itd, DBL t, ISO_Pending *pending) const
 {
-	VECTOR VTmp;
+	ISO_Pending *batch[ISO_BATCH_SIZE];
+	VECTOR points[ISO_BATCH_SIZE];
+	DBL values[ISO_BATCH_SIZE];
+	unsigned int n = 1;
+
+	VEvaluateRay(points[0], itd.Pglobal, t, itd.Dglobal);
+
+	if(eval == false)
+	{
+		for(ISO_Pending *p = pending; (p != NULL) && (n < ISO_BATCH_SIZE); p = p->next)
+		{
+			if((p->known == true) || (p->t21 < accuracy) || ((p->EP1->f + p->EP2->f - p->dt) >= 0))
+				continue;
 
-	VEvaluateRay(VTmp, itd.Pglobal, *t, itd.Dglobal);
+			VEvaluateRay(points[n], itd.Pglobal, p->EP1->t + p->t21 * 0.5, itd.Dglobal);
+			batch[n] = p;
+			n++;
+		}
+	}
+
+	POVFPU_RunBatch(itd.ctx, *Function, points, values, n);
+
+	for(unsigned int i = 1; i < n; i++)
+	{
+		batch[i]->f = (DBL)itd.Inv3 * (values[i] - threshold);
+		batch[i]->known = true;
+	}
 
-	return ((DBL)itd.Inv3 * (Evaluate_Function(itd.ctx, *Function, VTmp) - threshold));
+	return ((DBL)itd.Inv3 * (values[0] - threshold));
 }
 
 
@@ -119,6 +119,19 @@ struct FPUContext;
 
 struct ISO_Pair { DBL t,f; };
 
+// most midpoints the root solver evaluates at once
+#define ISO_BATCH_SIZE 8
+
+// interval the root solver will subdivide after the current one
+struct ISO_Pending
+{
+	const ISO_Pair *EP1, *EP2;
+	DBL dt, t21;
+	DBL f;                  // function value at the midpoint, if known
+	bool known;
+	ISO_Pending *next;
+};
+
 struct ISO_Max_Gradient
 {
 	unsigned int refcnt;
@@ -188,10 +201,10 @@ class IsoSurface : public ObjectBase
 
 	protected:
 		bool Function_Find_Root(ISO_ThreadData& itd, const VECTOR, const VECTOR, DBL*, DBL*, DBL& max_gradient, bool in_shadow_test);
-		bool Function_Find_Root_R(ISO_ThreadData& itd, const ISO_Pair*, const ISO_Pair*, DBL, DBL, DBL, DBL& max_gradient);
+		bool Function_Find_Root_R(ISO_ThreadData& itd, const ISO_Pair*, const ISO_Pair*, DBL, DBL, DBL, DBL& max_gradient, ISO_Pending *self, ISO_Pending *pending);
 
 		inline DBL Vector_Function(FPUContext *ctx, const VECTOR VPos) const;
-		inline DBL Float_Function(ISO_ThreadData& itd, DBL* t) const;
+		DBL Float_Function_Batch(ISO_ThreadData& itd, DBL t, ISO_Pending *pending) const;
 		static inline DBL Evaluate_Function(FPUContext *ctx, FUNCTION funct, const VECTOR fnvec);
 	private:
 		ISO_Max_Gradient *mginfo; // global, but just a statistic (read: not thread safe but we don't care) [trf]
@@ -121,6 +121,7 @@
 #include "backend/math/matrices.h"
 #include "backend/scene/objects.h"
 #include "backend/shape/mesh.h"
+#include "backend/shape/meshcache.h"
 #include "backend/texture/texture.h"
 #include "backend/shape/triangle.h"
 #include "backend/scene/threaddata.h"
@@ -128,6 +129,10 @@
 
 #include <algorithm>
 
+#if SYS_SIMD_SSE2
+	#include <emmintrin.h>
+#endif
+
 // this must be the last file included
 #include "base/povdebug.h"
 
@@ -140,6 +145,13 @@ namespace pov
 
 const DBL DEPTH_TOLERANCE = 1e-6;
 
+/* Relative tolerance of the triangle packet test; the packet test only
+   selects candidates for intersect_mesh_triangle, so it must never miss. */
+const DBL PACKET_TOLERANCE = 1e-6;
+
+/* Determinants below this fraction of |D|*|E1|*|E2| are treated as candidates. */
+const DBL PACKET_PARALLEL_TOLERANCE = 1e-9;
+
 #define max3_coordinate(x,y,z) ((x > y) ? ((x > z) ? X : Z) : ((y > z) ? Y : Z))
 
 const int HASH_SIZE = 1000;
@@ -831,6 +843,13 @@ Mesh::~Mesh()
 
 	if (--(Data->References) == 0)
 	{
+		/* Release a cache file first; this clears the pointers into it. */
+		if (Data->Cache != NULL)
+		{
+			Close_Mesh_Cache(Data);
+		}
+
+		destroy_mesh_packets((BBOX_TREE *) Data->Tree);
 		Destroy_BBox_Tree((BBOX_TREE *) Data->Tree);
 
 		if (Data->Normals != NULL)
@@ -855,6 +874,16 @@ Mesh::~Mesh()
 			POV_FREE(Data->Triangles);
 		}
 
+		if (Data->UV_Indices != NULL)
+		{
+			POV_FREE(Data->UV_Indices);
+		}
+
+		if (Data->Texture_Indices != NULL)
+		{
+			POV_FREE(Data->Texture_Indices);
+		}
+
 		POV_FREE(Data);
 	}
 }
@@ -944,9 +973,10 @@ void Mesh::Compute_BBox()
 *
 ******************************************************************************/
 
-bool Mesh::Compute_Mesh_Triangle(MESH_TRIANGLE *Triangle, int Smooth, VECTOR P1, VECTOR  P2, VECTOR  P3, VECTOR  S_Normal)
+bool Mesh::Compute_Mesh_Triangle(MESH_TRIANGLE *Triangle, int *UV, int *Tex, int Smooth, VECTOR P1, VECTOR  P2, VECTOR  P3, VECTOR  S_Normal)
 {
 	int temp, swap;
+	MESH_NORMAL ntemp;
 	DBL x, y, z;
 	VECTOR V1, V2, T1;
 	DBL Length;
@@ -1020,15 +1050,18 @@ bool Mesh::Compute_Mesh_Triangle(MESH_TRIANGLE *Triangle, int Smooth, VECTOR P1,
 		Triangle->P1 = temp;
 
 		/* NK 1998 */
-		temp = Triangle->UV2;
-		Triangle->UV2 = Triangle->UV1;
-		Triangle->UV1 = temp;
+		if (UV != NULL)
+		{
+			temp = UV[1];
+			UV[1] = UV[0];
+			UV[0] = temp;
+		}
 
-		if (Triangle->ThreeTex)
+		if ((Tex != NULL) && (Triangle->ThreeTex))
 		{
-			temp = Triangle->Texture2;
-			Triangle->Texture2 = Triangle->Texture;
-			Triangle->Texture = temp;
+			temp = Tex[1];
+			Tex[1] = Tex[0];
+			Tex[0] = temp;
 		}
 
 		Assign_Vector(T1, P1);
@@ -1037,9 +1070,9 @@ bool Mesh::Compute_Mesh_Triangle(MESH_TRIANGLE *Triangle, int Smooth, VECTOR P1,
 
 		if (Smooth)
 		{
-			temp = Triangle->N2;
+			ntemp = Triangle->N2;
 			Triangle->N2 = Triangle->N1;
-			Triangle->N1 = temp;
+			Triangle->N1 = ntemp;
 		}
 	}
 
@@ -1240,6 +1273,146 @@ bool Mesh::intersect_mesh_triangle(const Ray &ray, const MESH_TRIANGLE *Triangle
 	return(false);
 }
 
+
+
+/*****************************************************************************
+*
+* FUNCTION
+*
+*   intersect_mesh_packet
+*
+* INPUT
+*
+*   ray    - Ray in mesh space
+*   Packet - Triangle packet
+*   Count  - Number of triangles in the packet
+*
+* OUTPUT
+*
+* RETURNS
+*
+*   unsigned int - Bit mask of the triangles the ray may hit
+*
+* AUTHOR
+*
+* DESCRIPTION
+*
+*   Test a ray against all triangles of a packet at once using the
+*   Moller-Trumbore method, two triangles per SSE2 operation. The barycentric
+*   and depth bounds are widened by PACKET_TOLERANCE and nearly parallel
+*   triangles always pass, so the result is a superset of the triangles
+*   intersect_mesh_triangle() accepts. The caller runs that exact test on
+*   the candidates, which keeps the intersections identical to testing each
+*   triangle on its own.
+*
+* CHANGES
+*
+******************************************************************************/
+
+unsigned int Mesh::intersect_mesh_packet(const Ray &ray, const MESH_TRIANGLE_PACKET *Packet, int Count) const
+{
+	int i;
+	unsigned int mask;
+	DBL len;
+
+	VLength(len, ray.Direction);
+
+	mask = 0;
+
+#if SYS_SIMD_SSE2
+	const __m128d Dx = _mm_set1_pd(ray.Direction[X]);
+	const __m128d Dy = _mm_set1_pd(ray.Direction[Y]);
+	const __m128d Dz = _mm_set1_pd(ray.Direction[Z]);
+	const __m128d Ox = _mm_set1_pd(ray.Origin[X]);
+	const __m128d Oy = _mm_set1_pd(ray.Origin[Y]);
+	const __m128d Oz = _mm_set1_pd(ray.Origin[Z]);
+	const __m128d Tolerance = _mm_set1_pd(PACKET_TOLERANCE);
+	const __m128d Parallel = _mm_set1_pd(PACKET_PARALLEL_TOLERANCE * len);
+	const __m128d SignMask = _mm_set1_pd(-0.0);
+
+	for (i = 0; i < Count; i += 2)
+	{
+		__m128d e1x = _mm_loadu_pd(&Packet->E1[X][i]);
+		__m128d e1y = _mm_loadu_pd(&Packet->E1[Y][i]);
+		__m128d e1z = _mm_loadu_pd(&Packet->E1[Z][i]);
+		__m128d e2x = _mm_loadu_pd(&Packet->E2[X][i]);
+		__m128d e2y = _mm_loadu_pd(&Packet->E2[Y][i]);
+		__m128d e2z = _mm_loadu_pd(&Packet->E2[Z][i]);
+
+		/* P = D x E2, det = E1 . P */
+		__m128d px = _mm_sub_pd(_mm_mul_pd(Dy, e2z), _mm_mul_pd(Dz, e2y));
+		__m128d py = _mm_sub_pd(_mm_mul_pd(Dz, e2x), _mm_mul_pd(Dx, e2z));
+		__m128d pz = _mm_sub_pd(_mm_mul_pd(Dx, e2y), _mm_mul_pd(Dy, e2x));
+		__m128d det = _mm_add_pd(_mm_add_pd(_mm_mul_pd(e1x, px), _mm_mul_pd(e1y, py)), _mm_mul_pd(e1z, pz));
+
+		/* T = O - P1, u = T . P */
+		__m128d tx = _mm_sub_pd(Ox, _mm_loadu_pd(&Packet->P1[X][i]));
+		__m128d ty = _mm_sub_pd(Oy, _mm_loadu_pd(&Packet->P1[Y][i]));
+		__m128d tz = _mm_sub_pd(Oz, _mm_loadu_pd(&Packet->P1[Z][i]));
+		__m128d u = _mm_add_pd(_mm_add_pd(_mm_mul_pd(tx, px), _mm_mul_pd(ty, py)), _mm_mul_pd(tz, pz));
+
+		/* Q = T x E1, v = D . Q, t = E2 . Q */
+		__m128d qx = _mm_sub_pd(_mm_mul_pd(ty, e1z), _mm_mul_pd(tz, e1y));
+		__m128d qy = _mm_sub_pd(_mm_mul_pd(tz, e1x), _mm_mul_pd(tx, e1z));
+		__m128d qz = _mm_sub_pd(_mm_mul_pd(tx, e1y), _mm_mul_pd(ty, e1x));
+		__m128d v = _mm_add_pd(_mm_add_pd(_mm_mul_pd(Dx, qx), _mm_mul_pd(Dy, qy)), _mm_mul_pd(Dz, qz));
+		__m128d t = _mm_add_pd(_mm_add_pd(_mm_mul_pd(e2x, qx), _mm_mul_pd(e2y, qy)), _mm_mul_pd(e2z, qz));
+
+		/* Flip signs so the determinant is positive, which avoids the division. */
+		__m128d sign = _mm_and_pd(det, SignMask);
+		det = _mm_xor_pd(det, sign);
+		u = _mm_xor_pd(u, sign);
+		v = _mm_xor_pd(v, sign);
+		t = _mm_xor_pd(t, sign);
+
+		__m128d margin = _mm_mul_pd(det, Tolerance);
+		__m128d lower = _mm_xor_pd(margin, SignMask);
+
+		__m128d hit = _mm_and_pd(_mm_cmpge_pd(u, lower), _mm_cmpge_pd(v, lower));
+		hit = _mm_and_pd(hit, _mm_cmple_pd(_mm_add_pd(u, v), _mm_add_pd(det, margin)));
+		hit = _mm_and_pd(hit, _mm_cmpge_pd(t, lower));
+		hit = _mm_or_pd(hit, _mm_cmple_pd(det, _mm_mul_pd(Parallel, _mm_loadu_pd(&Packet->Scale[i]))));
+
+		mask |= (unsigned int)_mm_movemask_pd(hit) << i;
+	}
+#else
+	DBL det, u, v, t, margin;
+	VECTOR E1, E2, P, T, Q;
+
+	for (i = 0; i < Count; i++)
+	{
+		Make_Vector(E1, Packet->E1[X][i], Packet->E1[Y][i], Packet->E1[Z][i]);
+		Make_Vector(E2, Packet->E2[X][i], Packet->E2[Y][i], Packet->E2[Z][i]);
+		Make_Vector(T, ray.Origin[X] - Packet->P1[X][i], ray.Origin[Y] - Packet->P1[Y][i], ray.Origin[Z] - Packet->P1[Z][i]);
+
+		VCross(P, ray.Direction, E2);
+		VDot(det, E1, P);
+		VDot(u, T, P);
+		VCross(Q, T, E1);
+		VDot(v, ray.Direction, Q);
+		VDot(t, E2, Q);
+
+		if (det < 0.0)
+		{
+			det = -det;
+			u = -u;
+			v = -v;
+			t = -t;
+		}
+
+		margin = det * PACKET_TOLERANCE;
+
+		if (((u >= -margin) && (v >= -margin) && (u + v <= det + margin) && (t >= -margin)) ||
+		    (det <= PACKET_PARALLEL_TOLERANCE * len * Packet->Scale[i]))
+		{
+			mask |= 1 << i;
+		}
+	}
+#endif
+
+	return mask & ((1 << Count) - 1);
+}
+
 /*
  *  MeshUV - By Xander Enzmann
  *
@@ -1389,18 +1562,10 @@ void Mesh::Init_Mesh_Triangle(MESH_TRIANGLE *Triangle)
 	Triangle->P3 = -1;
 
 	Triangle->Normal_Ind = -1;
-	Triangle->Texture2 =
-	Triangle->Texture3 = -1;
-
-	Triangle->Texture = -1;
 
 	Triangle->N1 =
 	Triangle->N2 =
-	Triangle->N3 = -1;
-
-	Triangle->UV1 =
-	Triangle->UV2 =
-	Triangle->UV3 = -1;
+	Triangle->N3 = 0;
 
 	Make_Vector(Triangle->Perp, 0.0, 0.0, 0.0);
 
@@ -1522,6 +1687,248 @@ void Mesh::Build_Mesh_BBox_Tree()
 	/* Get rid of the Triangles array. */
 
 	POV_FREE(Triangles);
+
+	/* Combine neighbouring triangle leaves into packets. */
+
+	build_mesh_packets((BBOX_TREE *) Data->Tree);
+}
+
+
+
+/*****************************************************************************
+*
+* FUNCTION
+*
+*   build_mesh_packets
+*
+* INPUT
+*
+*   Node - Bounding box tree node
+*
+* OUTPUT
+*
+* RETURNS
+*
+* AUTHOR
+*
+* DESCRIPTION
+*
+*   Replace the triangle leaves below a node by packet leaves holding up to
+*   MESH_PACKET_SIZE triangles each. A node whose children are all triangle
+*   leaves becomes a packet leaf itself. Single triangles that are left
+*   over remain ordinary leaves.
+*
+* CHANGES
+*
+******************************************************************************/
+
+void Mesh::build_mesh_packets(BBOX_TREE *Node)
+{
+	int i, n, count;
+	BBOX_TREE *Packet;
+	vector<BBOX_TREE *> Leaves, Children;
+
+	if ((Node == NULL) || (Node->Entries <= 0))
+	{
+		return;
+	}
+
+	for (i = 0; i < Node->Entries; i++)
+	{
+		if (Node->Node[i]->Entries == 0)
+		{
+			Leaves.push_back(Node->Node[i]);
+		}
+		else
+		{
+			build_mesh_packets(Node->Node[i]);
+
+			Children.push_back(Node->Node[i]);
+		}
+	}
+
+	if (Leaves.size() < 2)
+	{
+		return;
+	}
+
+	if (Children.empty() && (Leaves.size() <= MESH_PACKET_SIZE))
+	{
+		/* Turn this node into a packet leaf; its bounding box stays the same. */
+
+		Packet = create_mesh_packet(&Leaves[0], (int)Leaves.size());
+
+		POV_FREE(Node->Node);
+
+		Node->Entries = Packet->Entries;
+		Node->Node    = Packet->Node;
+
+		POV_FREE(Packet);
+
+		return;
+	}
+
+	for (n = 0; n < (int)Leaves.size(); n += count)
+	{
+		count = min((int)Leaves.size() - n, MESH_PACKET_SIZE);
+
+		if (count == 1)
+		{
+			Children.push_back(Leaves[n]);
+		}
+		else
+		{
+			Children.push_back(create_mesh_packet(&Leaves[n], count));
+		}
+	}
+
+	POV_FREE(Node->Node);
+
+	Node->Entries = (short)Children.size();
+	Node->Node    = (BBOX_TREE **)POV_MALLOC(Children.size()*sizeof(BBOX_TREE *), "mesh bbox tree");
+
+	for (i = 0; i < Node->Entries; i++)
+	{
+		Node->Node[i] = Children[i];
+	}
+}
+
+
+
+/*****************************************************************************
+*
+* FUNCTION
+*
+*   create_mesh_packet
+*
+* INPUT
+*
+*   Leaves - Triangle leaves of the bounding box tree
+*   Count  - Number of leaves, at most MESH_PACKET_SIZE
+*
+* OUTPUT
+*
+* RETURNS
+*
+*   BBOX_TREE * - New packet leaf
+*
+* AUTHOR
+*
+* DESCRIPTION
+*
+*   Create a packet leaf for the given triangles and free their leaves.
+*
+* CHANGES
+*
+******************************************************************************/
+
+BBOX_TREE *Mesh::create_mesh_packet(BBOX_TREE **Leaves, int Count)
+{
+	int i, j;
+	DBL l1, l2;
+	VECTOR P1, P2, P3, E1, E2, Lower, Upper;
+	BBOX_TREE *Node;
+	MESH_TRIANGLE_PACKET *Packet;
+
+	Packet = (MESH_TRIANGLE_PACKET *)POV_MALLOC(sizeof(MESH_TRIANGLE_PACKET), "mesh bbox tree");
+
+	Make_Vector(Lower,  BOUND_HUGE,  BOUND_HUGE,  BOUND_HUGE);
+	Make_Vector(Upper, -BOUND_HUGE, -BOUND_HUGE, -BOUND_HUGE);
+
+	for (i = 0; i < MESH_PACKET_SIZE; i++)
+	{
+		Packet->Triangles[i] = (MESH_TRIANGLE *)Leaves[min(i, Count - 1)]->Node;
+
+		get_triangle_vertices(Packet->Triangles[i], P1, P2, P3);
+
+		VSub(E1, P2, P1);
+		VSub(E2, P3, P1);
+
+		for (j = X; j <= Z; j++)
+		{
+			Packet->P1[j][i] = P1[j];
+			Packet->E1[j][i] = E1[j];
+			Packet->E2[j][i] = E2[j];
+		}
+
+		VLength(l1, E1);
+		VLength(l2, E2);
+
+		Packet->Scale[i] = l1 * l2;
+	}
+
+	for (i = 0; i < Count; i++)
+	{
+		for (j = X; j <= Z; j++)
+		{
+			Lower[j] = min(Lower[j], (DBL)Leaves[i]->BBox.Lower_Left[j]);
+			Upper[j] = max(Upper[j], (DBL)Leaves[i]->BBox.Lower_Left[j] + (DBL)Leaves[i]->BBox.Lengths[j]);
+		}
+
+		POV_FREE(Leaves[i]);
+	}
+
+	Node = (BBOX_TREE *)POV_MALLOC(sizeof(BBOX_TREE), "mesh bbox tree");
+
+	Node->Infinite = false;
+	Node->Entries  = -Count;
+	Node->Node     = (BBOX_TREE **)Packet;
+
+	Make_BBox_from_min_max(Node->BBox, Lower, Upper);
+
+	return Node;
+}
+
+
+
+/*****************************************************************************
+*
+* FUNCTION
+*
+*   destroy_mesh_packets
+*
+* INPUT
+*
+*   Node - Bounding box tree node
+*
+* OUTPUT
+*
+* RETURNS
+*
+* AUTHOR
+*
+* DESCRIPTION
+*
+*   Free the packets of all packet leaves below a node and turn them into
+*   plain leaves, so Destroy_BBox_Tree() can free the tree itself.
+*
+* CHANGES
+*
+******************************************************************************/
+
+void Mesh::destroy_mesh_packets(BBOX_TREE *Node)
+{
+	int i;
+
+	if (Node == NULL)
+	{
+		return;
+	}
+
+	if (Node->Entries < 0)
+	{
+		POV_FREE(Node->Node);
+
+		Node->Entries = 0;
+		Node->Node    = NULL;
+	}
+	else
+	{
+		for (i = 0; i < Node->Entries; i++)
+		{
+			destroy_mesh_packets(Node->Node[i]);
+		}
+	}
 }
 
 
@@ -1565,8 +1972,10 @@ bool Mesh::intersect_bbox_tree(const Ray &ray, const Ray &Orig_Ray, DBL len, ISt
 {
 	bool found;
 	int i;
+	unsigned int mask;
 	DBL Best, Depth;
 	const BBOX_TREE *Node, *Root;
+	const MESH_TRIANGLE_PACKET *Packet;
 	short OldStyle= has_inside_vector;
 
 	/* Create the direction vectors for this ray. */
@@ -1613,13 +2022,32 @@ bool Mesh::intersect_bbox_tree(const Ray &ray, const Ray &Orig_Ray, DBL len, ISt
 
 		/* Check current node. */
 
-		if (Node->Entries)
+		if (Node->Entries > 0)
 		{
 			/* This is a node containing leaves to be checked. */
 
 			for (i = 0; i < Node->Entries; i++)
 				Check_And_Enqueue(Thread->Mesh_Queue, Node->Node[i], &Node->Node[i]->BBox, &rayinfo, Thread);
 		}
+		else if (Node->Entries < 0)
+		{
+			/* This is a leaf holding a packet of triangles. */
+
+			Packet = (const MESH_TRIANGLE_PACKET *)Node->Node;
+
+			for (i = 0, mask = intersect_mesh_packet(ray, Packet, -Node->Entries); mask != 0; i++, mask >>= 1)
+			{
+				if ((mask & 1) && intersect_mesh_triangle(ray, Packet->Triangles[i], &Depth))
+				{
+					if (test_hit(Packet->Triangles[i], Orig_Ray, Depth, len, Depth_Stack, Thread))
+					{
+						found = true;
+
+						Best = min(Best, Depth);
+					}
+				}
+			}
+		}
 		else
 		{
 			/* This is a leaf so test the contained triangle. */
@@ -2201,9 +2629,9 @@ void Mesh::get_triangle_vertices(const MESH_TRIANGLE *Triangle, VECTOR P1, VECTO
 
 void Mesh::get_triangle_normals(const MESH_TRIANGLE *Triangle, VECTOR N1, VECTOR N2, VECTOR N3) const
 {
-	Assign_Vector(N1, Data->Normals[Triangle->N1]);
-	Assign_Vector(N2, Data->Normals[Triangle->N2]);
-	Assign_Vector(N3, Data->Normals[Triangle->N3]);
+	Decode_Mesh_Normal(N1, Triangle->N1);
+	Decode_Mesh_Normal(N2, Triangle->N2);
+	Decode_Mesh_Normal(N3, Triangle->N3);
 }
 
 
@@ -2238,9 +2666,321 @@ void Mesh::get_triangle_normals(const MESH_TRIANGLE *Triangle, VECTOR N1, VECTOR
 
 void Mesh::get_triangle_uvcoords(const MESH_TRIANGLE *Triangle, UV_VECT UV1, UV_VECT UV2, UV_VECT UV3) const
 {
-	Assign_UV_Vect(UV1, Data->UVCoords[Triangle->UV1]);
-	Assign_UV_Vect(UV2, Data->UVCoords[Triangle->UV2]);
-	Assign_UV_Vect(UV3, Data->UVCoords[Triangle->UV3]);
+	const int *Ind;
+
+	if (Data->UV_Indices != NULL)
+	{
+		Ind = &Data->UV_Indices[3 * (Triangle - Data->Triangles)];
+
+		Assign_UV_Vect(UV1, Data->UVCoords[Ind[0]]);
+		Assign_UV_Vect(UV2, Data->UVCoords[Ind[1]]);
+		Assign_UV_Vect(UV3, Data->UVCoords[Ind[2]]);
+	}
+	else if (Data->Vertex_UVs)
+	{
+		Assign_UV_Vect(UV1, Data->UVCoords[Triangle->P1]);
+		Assign_UV_Vect(UV2, Data->UVCoords[Triangle->P2]);
+		Assign_UV_Vect(UV3, Data->UVCoords[Triangle->P3]);
+	}
+	else
+	{
+		Assign_UV_Vect(UV1, Data->UVCoords[0]);
+		Assign_UV_Vect(UV2, Data->UVCoords[0]);
+		Assign_UV_Vect(UV3, Data->UVCoords[0]);
+	}
+}
+
+
+
+/*****************************************************************************
+*
+* FUNCTION
+*
+*   get_triangle_texture
+*
+* INPUT
+*
+*   Triangle - Triangle
+*   Corner   - Corner of the triangle (0 unless the triangle has three textures)
+*
+* OUTPUT
+*
+* RETURNS
+*
+*   int - Index of the texture, or -1 if the triangle has none
+*
+* AUTHOR
+*
+* DESCRIPTION
+*
+*   Meshes using one texture for all triangles do not store an index per
+*   triangle, see Pack_Mesh_Indices().
+*
+* CHANGES
+*
+******************************************************************************/
+
+int Mesh::get_triangle_texture(const MESH_TRIANGLE *Triangle, int Corner) const
+{
+	if (Data->Texture_Indices == NULL)
+		return Data->Shared_Texture;
+
+	return Data->Texture_Indices[(Triangle - Data->Triangles) * Data->Texture_Stride + Corner];
+}
+
+
+
+/*****************************************************************************
+*
+* FUNCTION
+*
+*   Encode_Mesh_Normal
+*
+* INPUT
+*
+*   Normal - Unit normal vector
+*
+* OUTPUT
+*
+* RETURNS
+*
+*   MESH_NORMAL - Encoded normal
+*
+* AUTHOR
+*
+* DESCRIPTION
+*
+*   Project the normal onto the octahedron |x|+|y|+|z|=1, fold the lower
+*   half over the upper one and store the resulting x and y coordinates as
+*   16 bit signed fractions. The angular error is below 0.004 degrees.
+*
+* CHANGES
+*
+******************************************************************************/
+
+MESH_NORMAL Mesh::Encode_Mesh_Normal(const VECTOR Normal)
+{
+	DBL l, u, v, t;
+	int iu, iv;
+
+	l = fabs(Normal[X]) + fabs(Normal[Y]) + fabs(Normal[Z]);
+
+	if (l == 0.0)
+		return 0;
+
+	u = Normal[X] / l;
+	v = Normal[Y] / l;
+
+	if (Normal[Z] < 0.0)
+	{
+		t = u;
+		u = (1.0 - fabs(v)) * ((t >= 0.0) ? 1.0 : -1.0);
+		v = (1.0 - fabs(t)) * ((v >= 0.0) ? 1.0 : -1.0);
+	}
+
+	iu = (int)floor(u * 32767.0 + 0.5);
+	iv = (int)floor(v * 32767.0 + 0.5);
+
+	return ((MESH_NORMAL)(iu & 0xFFFF) << 16) | (MESH_NORMAL)(iv & 0xFFFF);
+}
+
+
+
+/*****************************************************************************
+*
+* FUNCTION
+*
+*   Decode_Mesh_Normal
+*
+* INPUT
+*
+*   Code - Encoded normal
+*
+* OUTPUT
+*
+*   Result - Unit normal vector
+*
+* RETURNS
+*
+* AUTHOR
+*
+* DESCRIPTION
+*
+*   Inverse of Encode_Mesh_Normal().
+*
+* CHANGES
+*
+******************************************************************************/
+
+void Mesh::Decode_Mesh_Normal(VECTOR Result, MESH_NORMAL Code)
+{
+	DBL u, v, t;
+
+	u = (DBL)(short)(Code >> 16) / 32767.0;
+	v = (DBL)(short)(Code & 0xFFFF) / 32767.0;
+
+	Result[Z] = 1.0 - fabs(u) - fabs(v);
+
+	if (Result[Z] < 0.0)
+	{
+		t = u;
+		u = (1.0 - fabs(v)) * ((t >= 0.0) ? 1.0 : -1.0);
+		v = (1.0 - fabs(t)) * ((v >= 0.0) ? 1.0 : -1.0);
+	}
+
+	Result[X] = u;
+	Result[Y] = v;
+
+	VNormalizeEq(Result);
+}
+
+
+
+/*****************************************************************************
+*
+* FUNCTION
+*
+*   Pack_Mesh_Indices
+*
+* INPUT
+*
+*   UV_Indices      - Three UV indices per triangle, or NULL
+*   Vertex_UVs      - Without UV indices: UVs follow the vertex indices
+*   Texture_Indices - Three texture indices per triangle
+*
+* OUTPUT
+*
+* RETURNS
+*
+* AUTHOR
+*
+* DESCRIPTION
+*
+*   Take over the temporary per-corner UV and texture index arrays built by
+*   the parser and only keep what cannot be derived otherwise: UV indices
+*   that match the vertex indices or are all zero, and a texture index that
+*   is the same for all triangles, are not stored per triangle. The mesh
+*   triangles must have been set up before calling this.
+*
+* CHANGES
+*
+******************************************************************************/
+
+void Mesh::Pack_Mesh_Indices(int *UV_Indices, bool Vertex_UVs, int *Texture_Indices)
+{
+	long i, n;
+	bool vertex_uvs, zero_uvs, three_tex, shared_tex;
+	const MESH_TRIANGLE *Triangle;
+
+	n = Data->Number_Of_Triangles;
+
+	Data->UV_Indices = NULL;
+	Data->Vertex_UVs = Vertex_UVs;
+
+	if (UV_Indices != NULL)
+	{
+		vertex_uvs = zero_uvs = true;
+
+		for (i = 0, Triangle = Data->Triangles; i < n; i++, Triangle++)
+		{
+			if ((UV_Indices[3*i] != Triangle->P1) || (UV_Indices[3*i+1] != Triangle->P2) || (UV_Indices[3*i+2] != Triangle->P3))
+				vertex_uvs = false;
+			if ((UV_Indices[3*i] != 0) || (UV_Indices[3*i+1] != 0) || (UV_Indices[3*i+2] != 0))
+				zero_uvs = false;
+		}
+
+		if (zero_uvs)
+		{
+			Data->Vertex_UVs = false;
+			POV_FREE(UV_Indices);
+		}
+		else if (vertex_uvs)
+		{
+			Data->Vertex_UVs = true;
+			POV_FREE(UV_Indices);
+		}
+		else
+			Data->UV_Indices = UV_Indices;
+	}
+
+	three_tex = false;
+	shared_tex = true;
+
+	for (i = 0, Triangle = Data->Triangles; i < n; i++, Triangle++)
+	{
+		if (Triangle->ThreeTex)
+			three_tex = true;
+		if (Texture_Indices[3*i] != Texture_Indices[0])
+			shared_tex = false;
+	}
+
+	Data->Shared_Texture = Texture_Indices[0];
+
+	if (three_tex)
+	{
+		Data->Texture_Indices = Texture_Indices;
+		Data->Texture_Stride = 3;
+	}
+	else if (shared_tex)
+	{
+		Data->Texture_Indices = NULL;
+		Data->Texture_Stride = 0;
+		POV_FREE(Texture_Indices);
+	}
+	else
+	{
+		for (i = 1; i < n; i++)
+			Texture_Indices[i] = Texture_Indices[3*i];
+
+		Data->Texture_Indices = (int *)POV_REALLOC(Texture_Indices, n*sizeof(int), "triangle mesh data");
+		Data->Texture_Stride = 1;
+	}
+}
+
+
+
+/*****************************************************************************
+*
+* FUNCTION
+*
+*   Mesh_Data_Size
+*
+* INPUT
+*
+* OUTPUT
+*
+* RETURNS
+*
+*   size_t - Number of bytes used by the mesh data
+*
+* AUTHOR
+*
+* DESCRIPTION
+*
+*   Sum up the memory used by the shared mesh data, excluding the bounding
+*   box tree. Used for the parser statistics.
+*
+* CHANGES
+*
+******************************************************************************/
+
+size_t Mesh::Mesh_Data_Size() const
+{
+	size_t size;
+
+	size = sizeof(MESH_DATA);
+	size += Data->Number_Of_Triangles * sizeof(MESH_TRIANGLE);
+	size += Data->Number_Of_Vertices * sizeof(SNGL_VECT);
+	size += Data->Number_Of_Normals * sizeof(SNGL_VECT);
+	size += Data->Number_Of_UVCoords * sizeof(UV_VECT);
+
+	if (Data->UV_Indices != NULL)
+		size += Data->Number_Of_Triangles * 3 * sizeof(int);
+
+	if (Data->Texture_Indices != NULL)
+		size += Data->Number_Of_Triangles * Data->Texture_Stride * sizeof(int);
+
+	return size;
 }
 
 
@@ -2378,6 +3118,7 @@ void Mesh::UVCoord(VECTOR Result, const Intersection *Inter, TraceThreadData *)
 	DBL w1, w2, w3, t1, t2;
 	VECTOR vA, vB;
 	VECTOR Side1, Side2;
+	UV_VECT UV1, UV2, UV3;
 	MESH_TRIANGLE *Triangle;
 	VECTOR P;
 
@@ -2449,12 +3190,14 @@ void Mesh::UVCoord(VECTOR Result, const Intersection *Inter, TraceThreadData *)
 	/* w3 = 1-fabs(t1/t2); */
 	w3 = 1+t1/t2;
 
-	Result[U] =  w1 * Data->UVCoords[Triangle->UV1][U] +
-	             w2 * Data->UVCoords[Triangle->UV2][U] +
-	             w3 * Data->UVCoords[Triangle->UV3][U];
-	Result[V] =  w1 * Data->UVCoords[Triangle->UV1][V] +
-	             w2 * Data->UVCoords[Triangle->UV2][V] +
-	             w3 * Data->UVCoords[Triangle->UV3][V];
+	get_triangle_uvcoords(Triangle, UV1, UV2, UV3);
+
+	Result[U] =  w1 * UV1[U] +
+	             w2 * UV2[U] +
+	             w3 * UV3[U];
+	Result[V] =  w1 * UV1[V] +
+	             w2 * UV2[V] +
+	             w3 * UV3[V];
 }
 
 
@@ -2492,8 +3235,10 @@ void Mesh::UVCoord(VECTOR Result, const Intersection *Inter, TraceThreadData *)
 bool Mesh::inside_bbox_tree(Ray &ray, TraceThreadData *Thread) const
 {
 	int i, found;
+	unsigned int mask;
 	DBL Best, Depth;
 	const BBOX_TREE *Node, *Root;
+	const MESH_TRIANGLE_PACKET *Packet;
 
 	/* Create the direction vectors for this ray. */
 	Rayinfo rayinfo(ray);
@@ -2520,12 +3265,23 @@ bool Mesh::inside_bbox_tree(Ray &ray, TraceThreadData *Thread) const
 		Priority_Queue_Delete(Thread->Mesh_Queue, &Depth, &Node);
 
 		/* Check current node. */
-		if (Node->Entries)
+		if (Node->Entries > 0)
 		{
 			/* This is a node containing leaves to be checked. */
 			for (i = 0; i < Node->Entries; i++)
 				Check_And_Enqueue(Thread->Mesh_Queue, Node->Node[i], &Node->Node[i]->BBox, &rayinfo, Thread);
 		}
+		else if (Node->Entries < 0)
+		{
+			/* This is a leaf holding a packet of triangles. */
+			Packet = (const MESH_TRIANGLE_PACKET *)Node->Node;
+
+			for (i = 0, mask = intersect_mesh_packet(ray, Packet, -Node->Entries); mask != 0; i++, mask >>= 1)
+			{
+				if ((mask & 1) && intersect_mesh_triangle(ray, Packet->Triangles[i], &Depth))
+					found++;
+			}
+		}
 		else
 		{
 			/* This is a leaf so test the contained triangle. */
@@ -2572,12 +3328,12 @@ void Mesh::Determine_Textures(Intersection *isect, bool hitinside, WeightedTextu
 
 		wsum = 1.0 / (w1 + w2 + w3);
 
-		textures.push_back(WeightedTexture(w1 * wsum, Textures[tri->Texture]));
-		textures.push_back(WeightedTexture(w2 * wsum, Textures[tri->Texture2]));
-		textures.push_back(WeightedTexture(w3 * wsum, Textures[tri->Texture3]));
+		textures.push_back(WeightedTexture(w1 * wsum, Textures[get_triangle_texture(tri, 0)]));
+		textures.push_back(WeightedTexture(w2 * wsum, Textures[get_triangle_texture(tri, 1)]));
+		textures.push_back(WeightedTexture(w3 * wsum, Textures[get_triangle_texture(tri, 2)]));
 	}
-	else if(tri->Texture >= 0) // TODO FIXME - make sure there always is some valid texture, also for code above! [trf]
-		textures.push_back(WeightedTexture(1.0, Textures[tri->Texture]));
+	else if(get_triangle_texture(tri, 0) >= 0) // TODO FIXME - make sure there always is some valid texture, also for code above! [trf]
+		textures.push_back(WeightedTexture(1.0, Textures[get_triangle_texture(tri, 0)]));
 	else if(Texture != NULL)
 		textures.push_back(WeightedTexture(1.0, Texture));
 }
@@ -105,6 +105,8 @@ namespace pov
 
 #define MESH_OBJECT (PATCH_OBJECT+HIERARCHY_OK_OBJECT) // NOTE: During parsing, the PATCH_OBJECT type flag may be cleared if an inside_vector is specified
 
+#define MESH_PACKET_SIZE 4 // Number of triangles tested together in a bounding box tree leaf
+
 
 /*****************************************************************************
 * Global typedefs
@@ -112,10 +114,15 @@ namespace pov
 
 typedef struct Mesh_Data_Struct MESH_DATA;
 typedef struct Mesh_Triangle_Struct MESH_TRIANGLE;
+typedef struct Mesh_Triangle_Packet_Struct MESH_TRIANGLE_PACKET;
+typedef struct Mesh_Cache_Struct MESH_CACHE;
 
 typedef struct Hash_Table_Struct HASH_TABLE;
 typedef struct UV_Hash_Table_Struct UV_HASH_TABLE;
 
+/* Octahedron-encoded unit normal, 16 bits per component. */
+typedef unsigned int MESH_NORMAL;
+
 struct Mesh_Data_Struct
 {
 	int References;                /* Number of references to the mesh. */
@@ -125,9 +132,15 @@ struct Mesh_Data_Struct
 	long Number_Of_Vertices;       /* Number of vertices in the mesh.   */
 	SNGL_VECT *Normals, *Vertices; /* Arrays of normals and vertices.   */
 	UV_VECT *UVCoords;             /* Array of UV coordinates           */
+	int *UV_Indices;               /* UV indices per corner, or NULL.   */
+	bool Vertex_UVs;               /* UV indices equal vertex indices.  */
+	int *Texture_Indices;          /* Texture indices, or NULL.         */
+	int Texture_Stride;            /* Texture indices per triangle.     */
+	int Shared_Texture;            /* Texture of all if no indices.     */
 	MESH_TRIANGLE *Triangles;      /* Array of triangles.               */
 	const BBOX_TREE *Tree;         /* Bounding box tree for mesh.       */
 	VECTOR Inside_Vect;            /* vector to use to test 'inside'    */
+	MESH_CACHE *Cache;             /* Cache file holding the arrays.    */
 };
 
 struct Mesh_Triangle_Struct
@@ -136,16 +149,26 @@ struct Mesh_Triangle_Struct
 	unsigned int Dominant_Axis:2;  /* Dominant axis.                        */
 	unsigned int vAxis:2;          /* Axis for smooth triangle.             */
 	unsigned int ThreeTex:1;       /* Color Triangle Patch.                 */
-	long Normal_Ind;               /* Index of unsmoothed triangle normal.  */
-	long P1, P2, P3;               /* Indices of triangle vertices.         */
-	long Texture;                  /* Index of triangle texture.            */
-	long Texture2, Texture3;       /* Color Triangle Patch.                 */
-	long N1, N2, N3;               /* Indices of smoothed triangle normals. */
-	long UV1, UV2, UV3;            /* Indicies of UV coordinate vectors     */
+	int Normal_Ind;                /* Index of unsmoothed triangle normal.  */
+	int P1, P2, P3;                /* Indices of triangle vertices.         */
+	MESH_NORMAL N1, N2, N3;        /* Encoded smoothed triangle normals.    */
 	SNGL Distance;                 /* Distance of triangle along normal.    */
 	SNGL_VECT Perp;                /* Vector used for smooth triangles.     */
 };
 
+/* Bounding box tree leaf holding up to MESH_PACKET_SIZE triangles in the
+   form used by the Moller-Trumbore test, one array per coordinate. Such
+   leaves are marked by a negative number of entries. Unused slots repeat
+   the last triangle. */
+struct Mesh_Triangle_Packet_Struct
+{
+	DBL P1[3][MESH_PACKET_SIZE];   /* First vertices.                       */
+	DBL E1[3][MESH_PACKET_SIZE];   /* Edges from first to second vertex.    */
+	DBL E2[3][MESH_PACKET_SIZE];   /* Edges from first to third vertex.     */
+	DBL Scale[MESH_PACKET_SIZE];   /* Product of the edge lengths.          */
+	MESH_TRIANGLE *Triangles[MESH_PACKET_SIZE];
+};
+
 struct Hash_Table_Struct
 {
 	int Index;
@@ -187,7 +210,9 @@ class Mesh : public ObjectBase
 		void Test_Mesh_Opacity();
 
 		void Create_Mesh_Hash_Tables();
-		bool Compute_Mesh_Triangle(MESH_TRIANGLE *Triangle, int Smooth, VECTOR P1, VECTOR P2, VECTOR P3, VECTOR S_Normal);
+		bool Compute_Mesh_Triangle(MESH_TRIANGLE *Triangle, int *UV, int *Tex, int Smooth, VECTOR P1, VECTOR P2, VECTOR P3, VECTOR S_Normal);
+		void Pack_Mesh_Indices(int *UV_Indices, bool Vertex_UVs, int *Texture_Indices);
+		size_t Mesh_Data_Size() const;
 		void Build_Mesh_BBox_Tree();
 		bool Degenerate(VECTOR P1, VECTOR P2, VECTOR P3);
 		void Init_Mesh_Triangle(MESH_TRIANGLE *Triangle);
@@ -197,6 +222,11 @@ class Mesh : public ObjectBase
 		int Mesh_Hash_Texture(int *Number_Of_Textures, int *Max_Textures, TEXTURE ***Textures, TEXTURE *Texture);
 		int Mesh_Hash_UV(int *Number, int *Max, UV_VECT **Elements, UV_VECT aPoint);
 		void Smooth_Mesh_Normal(VECTOR Result, const MESH_TRIANGLE *Triangle, const VECTOR IPoint) const;
+		void get_triangle_uvcoords(const MESH_TRIANGLE *Triangle, UV_VECT U1, UV_VECT U2, UV_VECT U3) const;
+		int get_triangle_texture(const MESH_TRIANGLE *Triangle, int Corner) const;
+
+		static MESH_NORMAL Encode_Mesh_Normal(const VECTOR Normal);
+		static void Decode_Mesh_Normal(VECTOR Result, MESH_NORMAL Code);
 
 		void Determine_Textures(Intersection *, bool, WeightedTextureVector&, TraceThreadData *);
 	protected:
@@ -205,13 +235,16 @@ class Mesh : public ObjectBase
 		void MeshUV(const VECTOR P, const MESH_TRIANGLE *Triangle, UV_VECT Result) const;
 		void compute_smooth_triangle(MESH_TRIANGLE *Triangle, const VECTOR P1, const VECTOR P2, const VECTOR P3);
 		bool intersect_mesh_triangle(const Ray& ray, const MESH_TRIANGLE *Triangle, DBL *Depth) const;
+		unsigned int intersect_mesh_packet(const Ray& ray, const MESH_TRIANGLE_PACKET *Packet, int Count) const;
+		void build_mesh_packets(BBOX_TREE *Node);
+		BBOX_TREE *create_mesh_packet(BBOX_TREE **Leaves, int Count);
+		static void destroy_mesh_packets(BBOX_TREE *Node);
 		bool test_hit(const MESH_TRIANGLE *Triangle, const Ray& OrigRay, DBL Depth, DBL len, IStack& Depth_Stack, TraceThreadData *Thread);
 		void get_triangle_bbox(const MESH_TRIANGLE *Triangle, BBOX *BBox) const;
 		bool intersect_bbox_tree(const Ray& ray, const Ray& Orig_Ray, DBL len, IStack& Depth_Stack, TraceThreadData *Thread);
 		bool inside_bbox_tree(Ray& ray, TraceThreadData *Thread) const;
 		void get_triangle_vertices(const MESH_TRIANGLE *Triangle, VECTOR P1, VECTOR P2, VECTOR P3) const;
 		void get_triangle_normals(const MESH_TRIANGLE *Triangle, VECTOR N1, VECTOR N2, VECTOR N3) const;
-		void get_triangle_uvcoords(const MESH_TRIANGLE *Triangle, UV_VECT U1, UV_VECT U2, UV_VECT U3) const;
 		static int mesh_hash(HASH_TABLE **Hash_Table, int *Number, int *Max, SNGL_VECT **Elements, VECTOR aPoint);
 
 private:
@@ -0,0 +1,1129 @@
+/*******************************************************************************
+ * meshcache.cpp
+ *
+ * This module implements binary cache files holding parsed mesh data.
+ *
+ * from Persistence of Vision Ray Tracer ('POV-Ray') version 3.7.
+ * Copyright 1991-2003 Persistence of Vision Team
+ * Copyright 2003-2009 Persistence of Vision Raytracer Pty. Ltd.
+ * ---------------------------------------------------------------------------
+ * NOTICE: This source code file is provided so that users may experiment
+ * with enhancements to POV-Ray and to port the software to platforms other
+ * than those supported by the POV-Ray developers. There are strict rules
+ * regarding how you are permitted to use this file. These rules are contained
+ * in the distribution and derivative versions licenses which should have been
+ * provided with this file.
+ *
+ * These licences may be found online, linked from the end-user license
+ * agreement that is located at http://www.povray.org/povlegal.html
+ * ---------------------------------------------------------------------------
+ * POV-Ray is based on the popular DKB raytracer version 2.12.
+ * DKBTrace was originally written by David K. Buck.
+ * DKBTrace Ver 2.0-2.12 were written by David K. Buck & Aaron A. Collins.
+ * ---------------------------------------------------------------------------
+ * $File: //depot/povray/smp/source/backend/shape/meshcache.cpp $
+ * $Revision: #1 $
+ * $Change: 5401 $
+ * $DateTime: 2011/02/08 21:06:55 $
+ * $Author: clipka $
+ *******************************************************************************/
+
+/*********************************************************************************
+ * NOTICE
+ *
+ * This file is part of a BETA-TEST version of POV-Ray version 3.7. It is not
+ * final code. Use of this source file is governed by both the standard POV-Ray
+ * licences referred to in the copyright header block above this notice, and the
+ * following additional restrictions numbered 1 through 4 below:
+ *
+ *   1. This source file may not be re-distributed without the written permission
+ *      of Persistence of Vision Raytracer Pty. Ltd.
+ *
+ *   2. This notice may not be altered or removed.
+ *   
+ *   3. Binaries generated from this source file by individuals for their own
+ *      personal use may not be re-distributed without the written permission
+ *      of Persistence of Vision Raytracer Pty. Ltd. Such personal-use binaries
+ *      are not required to have a timeout, and thus permission is granted in
+ *      these circumstances only to disable the timeout code contained within
+ *      the beta software.
+ *   
+ *   4. Binaries generated from this source file for use within an organizational
+ *      unit (such as, but not limited to, a company or university) may not be
+ *      distributed beyond the local organizational unit in which they were made,
+ *      unless written permission is obtained from Persistence of Vision Raytracer
+ *      Pty. Ltd. Additionally, the timeout code implemented within the beta may
+ *      not be disabled or otherwise bypassed in any manner.
+ *
+ * The following text is not part of the above conditions and is provided for
+ * informational purposes only.
+ *
+ * The purpose of the no-redistribution clause is to attempt to keep the
+ * circulating copies of the beta source fresh. The only authorized distribution
+ * point for the source code is the POV-Ray website and Perforce server, where
+ * the code will be kept up to date with recent fixes. Additionally the beta
+ * timeout code mentioned above has been a standard part of POV-Ray betas since
+ * version 1.0, and is intended to reduce bug reports from old betas as well as
+ * keep any circulating beta binaries relatively fresh.
+ *
+ * All said, however, the POV-Ray developers are open to any reasonable request
+ * for variations to the above conditions and will consider them on a case-by-case
+ * basis.
+ *
+ * Additionally, the developers request your co-operation in fixing bugs and
+ * generally improving the program. If submitting a bug-fix, please ensure that
+ * you quote the revision number of the file shown above in the copyright header
+ * (see the '$Revision:' field). This ensures that it is possible to determine
+ * what specific copy of the file you are working with. The developers also would
+ * like to make it known that until POV-Ray 3.7 is out of beta, they would prefer
+ * to emphasize the provision of bug fixes over the addition of new features.
+ *
+ * Persons wishing to enhance this source are requested to take the above into
+ * account. It is also strongly suggested that such enhancements are started with
+ * a recent copy of the source.
+ *
+ * The source code page (see http://www.povray.org/beta/source/) sets out the
+ * conditions under which the developers are willing to accept contributions back
+ * into the primary source tree. Please refer to those conditions prior to making
+ * any changes to this source, if you wish to submit those changes for inclusion
+ * with POV-Ray.
+ *
+ *********************************************************************************/
+
+/****************************************************************************
+*
+*  Explanation:
+*
+*    A mesh cache file holds the MESH_DATA arrays of a parsed mesh together
+*    with its bounding box tree, so that later renders can skip parsing the
+*    mesh. The arrays are stored exactly as they are kept in memory, each
+*    section aligned to MESH_CACHE_ALIGNMENT bytes. Pointers within the tree
+*    are stored as offsets from the start of the file.
+*
+*    Where possible the file is mapped copy-on-write. Only the tree sections
+*    are written to when the offsets are turned back into pointers; the
+*    vertex, normal and triangle pages remain shared with the page cache and
+*    with every other render that maps the same file.
+*
+*    The file is only meant to be read by the same build of POV-Ray on the
+*    same kind of machine; the header records the byte order and the sizes
+*    of all stored records, and any difference is rejected.
+*
+*****************************************************************************/
+
+// frame.h must always be the first POV file included (pulls in platform config)
+#include "backend/frame.h"
+#include "backend/bounding/bbox.h"
+#include "backend/scene/objects.h"
+#include "backend/shape/mesh.h"
+#include "backend/shape/meshcache.h"
+#include "base/pov_err.h"
+
+#include <vector>
+
+#if (SYS_MESH_CACHE_MMAP == 1)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+// this must be the last file included
+#include "base/povdebug.h"
+
+namespace pov
+{
+
+/*****************************************************************************
+* Local preprocessor defines
+******************************************************************************/
+
+const int MESH_CACHE_ALIGNMENT = 64;
+
+const unsigned int MESH_CACHE_BYTE_ORDER = 0x01020304;
+
+const char MESH_CACHE_MAGIC[8] = "POVMESH";
+
+/* Header flags. */
+const unsigned int MESH_CACHE_VERTEX_UVS    = 1;
+const unsigned int MESH_CACHE_INSIDE_VECTOR = 2;
+const unsigned int MESH_CACHE_TEXTURED      = 4;
+
+/* Records whose size is checked when a file is read. */
+enum
+{
+	MESH_CACHE_POINTER_RECORD = 0,
+	MESH_CACHE_VECTOR_RECORD,
+	MESH_CACHE_UV_RECORD,
+	MESH_CACHE_TRIANGLE_RECORD,
+	MESH_CACHE_NODE_RECORD,
+	MESH_CACHE_PACKET_RECORD,
+	MESH_CACHE_RECORDS
+};
+
+
+
+/*****************************************************************************
+* Local typedefs
+******************************************************************************/
+
+typedef struct Mesh_Cache_Header_Struct MESH_CACHE_HEADER;
+
+struct Mesh_Cache_Header_Struct
+{
+	char Magic[8];                 /* MESH_CACHE_MAGIC.                 */
+	unsigned int Version;          /* MESH_CACHE_VERSION.               */
+	unsigned int Byte_Order;       /* MESH_CACHE_BYTE_ORDER.            */
+	unsigned int Record_Sizes[MESH_CACHE_RECORDS];
+	unsigned int Flags;            /* MESH_CACHE_xxx flags.             */
+	int Number_Of_Textures;        /* Size of the texture list.         */
+	int Texture_Stride;            /* Texture indices per triangle.     */
+	int Shared_Texture;            /* Texture of all if no indices.     */
+	POV_LONG Number_Of_Vertices;
+	POV_LONG Number_Of_Normals;
+	POV_LONG Number_Of_UVCoords;
+	POV_LONG Number_Of_Triangles;
+	POV_LONG Number_Of_Nodes;      /* Bounding box tree nodes.          */
+	POV_LONG Number_Of_Children;   /* Child pointers of inner nodes.    */
+	POV_LONG Number_Of_Packets;    /* Triangle packets of leaves.       */
+	POV_LONG Vertices;             /* Section offsets, 0 if absent.     */
+	POV_LONG Normals;
+	POV_LONG UVCoords;
+	POV_LONG UV_Indices;
+	POV_LONG Texture_Indices;
+	POV_LONG Triangles;
+	POV_LONG Nodes;                /* The root is the first node.       */
+	POV_LONG Children;
+	POV_LONG Packets;
+	POV_LONG File_Size;
+	DBL Inside_Vect[3];
+};
+
+
+
+/*****************************************************************************
+* Static functions
+******************************************************************************/
+
+static void init_cache_header(MESH_CACHE_HEADER *Header);
+static POV_LONG place_cache_section(POV_LONG& Offset, POV_LONG Size);
+static void count_cache_tree(const BBOX_TREE *Node, MESH_CACHE_HEADER *Header);
+static POV_LONG flatten_cache_tree(const BBOX_TREE *Node, const MESH_DATA *Data, const MESH_CACHE_HEADER *Header, vector<BBOX_TREE>& Nodes, vector<BBOX_TREE *>& Children, vector<MESH_TRIANGLE_PACKET>& Packets);
+static void write_cache_section(OStream *file, POV_LONG& Position, POV_LONG Offset, const void *Buffer, size_t Size);
+static bool check_cache_section(const MESH_CACHE *Cache, POV_LONG Offset, POV_LONG Count, size_t Record_Size);
+static bool check_cache_record(const MESH_CACHE *Cache, POV_LONG Section, POV_LONG Count, size_t Record_Size, size_t Offset);
+static void release_cache_memory(MESH_CACHE *Cache);
+static void validate_cache(const MESH_CACHE *Cache, const MESH_CACHE_HEADER *Header);
+static void relocate_cache_tree(MESH_CACHE *Cache, const MESH_CACHE_HEADER *Header);
+
+
+
+/*****************************************************************************
+*
+* FUNCTION
+*
+*   Write_Mesh_Cache
+*
+* INPUT
+*
+*   file   - Output file
+*   Object - Parsed mesh, including its bounding box tree if any
+*
+* OUTPUT
+*
+* RETURNS
+*
+* AUTHOR
+*
+* DESCRIPTION
+*
+*   Write the mesh data of an object to a cache file. The textures are not
+*   stored; the mesh reading the file has to supply a texture list of the
+*   same size.
+*
+* CHANGES
+*
+******************************************************************************/
+
+void Write_Mesh_Cache(OStream *file, const Mesh *Object)
+{
+	POV_LONG Offset, Position;
+	const MESH_DATA *Data = Object->Data;
+	MESH_CACHE_HEADER Header;
+	vector<BBOX_TREE> Nodes;
+	vector<BBOX_TREE *> Children;
+	vector<MESH_TRIANGLE_PACKET> Packets;
+
+	init_cache_header(&Header);
+
+	if (Data->Vertex_UVs)
+		Header.Flags |= MESH_CACHE_VERTEX_UVS;
+	if (Object->has_inside_vector)
+		Header.Flags |= MESH_CACHE_INSIDE_VECTOR;
+	if (Object->Type & TEXTURED_OBJECT)
+		Header.Flags |= MESH_CACHE_TEXTURED;
+
+	Header.Number_Of_Textures  = (int)Object->Number_Of_Textures;
+	Header.Texture_Stride      = Data->Texture_Stride;
+	Header.Shared_Texture      = Data->Shared_Texture;
+	Header.Number_Of_Vertices  = Data->Number_Of_Vertices;
+	Header.Number_Of_Normals   = Data->Number_Of_Normals;
+	Header.Number_Of_UVCoords  = Data->Number_Of_UVCoords;
+	Header.Number_Of_Triangles = Data->Number_Of_Triangles;
+
+	Header.Inside_Vect[X] = Data->Inside_Vect[X];
+	Header.Inside_Vect[Y] = Data->Inside_Vect[Y];
+	Header.Inside_Vect[Z] = Data->Inside_Vect[Z];
+
+	count_cache_tree(Data->Tree, &Header);
+
+	/* Lay out the sections. */
+
+	Offset = sizeof(MESH_CACHE_HEADER);
+
+	Header.Vertices  = place_cache_section(Offset, Header.Number_Of_Vertices * sizeof(SNGL_VECT));
+	Header.Normals   = place_cache_section(Offset, Header.Number_Of_Normals * sizeof(SNGL_VECT));
+	Header.UVCoords  = place_cache_section(Offset, Header.Number_Of_UVCoords * sizeof(UV_VECT));
+	Header.Triangles = place_cache_section(Offset, Header.Number_Of_Triangles * sizeof(MESH_TRIANGLE));
+
+	if (Data->UV_Indices != NULL)
+		Header.UV_Indices = place_cache_section(Offset, Header.Number_Of_Triangles * 3 * sizeof(int));
+
+	if (Data->Texture_Indices != NULL)
+		Header.Texture_Indices = place_cache_section(Offset, Header.Number_Of_Triangles * Header.Texture_Stride * sizeof(int));
+
+	Header.Nodes    = place_cache_section(Offset, Header.Number_Of_Nodes * sizeof(BBOX_TREE));
+	Header.Children = place_cache_section(Offset, Header.Number_Of_Children * sizeof(BBOX_TREE *));
+	Header.Packets  = place_cache_section(Offset, Header.Number_Of_Packets * sizeof(MESH_TRIANGLE_PACKET));
+
+	Header.File_Size = Offset;
+
+	/* Replace the tree pointers by file offsets. */
+
+	if (Data->Tree != NULL)
+	{
+		Nodes.reserve((size_t)Header.Number_Of_Nodes);
+		Children.reserve((size_t)Header.Number_Of_Children);
+		Packets.reserve((size_t)Header.Number_Of_Packets);
+
+		flatten_cache_tree(Data->Tree, Data, &Header, Nodes, Children, Packets);
+	}
+
+	Position = 0;
+
+	write_cache_section(file, Position, 0, &Header, sizeof(MESH_CACHE_HEADER));
+	write_cache_section(file, Position, Header.Vertices, Data->Vertices, (size_t)Header.Number_Of_Vertices * sizeof(SNGL_VECT));
+	write_cache_section(file, Position, Header.Normals, Data->Normals, (size_t)Header.Number_Of_Normals * sizeof(SNGL_VECT));
+	write_cache_section(file, Position, Header.UVCoords, Data->UVCoords, (size_t)Header.Number_Of_UVCoords * sizeof(UV_VECT));
+	write_cache_section(file, Position, Header.Triangles, Data->Triangles, (size_t)Header.Number_Of_Triangles * sizeof(MESH_TRIANGLE));
+
+	if (Header.UV_Indices != 0)
+		write_cache_section(file, Position, Header.UV_Indices, Data->UV_Indices, (size_t)Header.Number_Of_Triangles * 3 * sizeof(int));
+
+	if (Header.Texture_Indices != 0)
+		write_cache_section(file, Position, Header.Texture_Indices, Data->Texture_Indices, (size_t)Header.Number_Of_Triangles * Header.Texture_Stride * sizeof(int));
+
+	if (Data->Tree != NULL)
+	{
+		write_cache_section(file, Position, Header.Nodes, &Nodes[0], Nodes.size() * sizeof(BBOX_TREE));
+
+		if (!Children.empty())
+			write_cache_section(file, Position, Header.Children, &Children[0], Children.size() * sizeof(BBOX_TREE *));
+
+		if (!Packets.empty())
+			write_cache_section(file, Position, Header.Packets, &Packets[0], Packets.size() * sizeof(MESH_TRIANGLE_PACKET));
+	}
+
+	if (!*file)
+		throw POV_EXCEPTION(kFileDataErr, "Cannot write mesh cache file.");
+}
+
+
+
+/*****************************************************************************
+*
+* FUNCTION
+*
+*   Read_Mesh_Cache
+*
+* INPUT
+*
+*   file     - Input file
+*   filename - Name of the file, used to map it into memory
+*   Object   - Mesh without data
+*
+* OUTPUT
+*
+*   Object
+*
+* RETURNS
+*
+* AUTHOR
+*
+* DESCRIPTION
+*
+*   Create the mesh data of an object from a cache file. The file is mapped
+*   copy-on-write if possible, otherwise it is read into memory. The arrays
+*   of the mesh data point into the file; the bounding box tree stored in
+*   it, if any, is left in Cache->Tree and set as the tree of the mesh.
+*
+*   The number of textures the file expects is left in the cache for the
+*   caller to check against the texture list of the mesh.
+*
+* CHANGES
+*
+******************************************************************************/
+
+void Read_Mesh_Cache(IStream *file, const UCS2String& filename, Mesh *Object)
+{
+	POV_LONG Size;
+	MESH_CACHE *Cache;
+	MESH_DATA *Data;
+	MESH_CACHE_HEADER *Header;
+
+	Cache = (MESH_CACHE *)POV_MALLOC(sizeof(MESH_CACHE), "mesh cache");
+
+	Cache->Base   = NULL;
+	Cache->Size   = 0;
+	Cache->Mapped = false;
+	Cache->Tree   = NULL;
+
+#if (SYS_MESH_CACHE_MMAP == 1)
+	int fd = open(UCS2toASCIIString(filename).c_str(), O_RDONLY);
+
+	if (fd >= 0)
+	{
+		struct stat info;
+
+		if ((fstat(fd, &info) == 0) && (info.st_size >= (off_t)sizeof(MESH_CACHE_HEADER)))
+		{
+			void *Base = mmap(NULL, (size_t)info.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+
+			if (Base != MAP_FAILED)
+			{
+				Cache->Base   = (char *)Base;
+				Cache->Size   = (size_t)info.st_size;
+				Cache->Mapped = true;
+			}
+		}
+
+		close(fd);
+	}
+#endif
+
+	if (Cache->Base == NULL)
+	{
+		file->seekg(0, IOBase::seek_end);
+		Size = file->tellg();
+		file->seekg(0, IOBase::seek_set);
+
+		if (Size < (POV_LONG)sizeof(MESH_CACHE_HEADER))
+		{
+			POV_FREE(Cache);
+
+			throw POV_EXCEPTION(kFileDataErr, "Mesh cache file is too short.");
+		}
+
+		Cache->Base = (char *)POV_MALLOC((size_t)Size, "mesh cache");
+		Cache->Size = (size_t)Size;
+
+		if (!file->read(Cache->Base, Cache->Size))
+		{
+			release_cache_memory(Cache);
+
+			throw POV_EXCEPTION(kFileDataErr, "Cannot read mesh cache file.");
+		}
+	}
+
+	Header = (MESH_CACHE_HEADER *)Cache->Base;
+
+	try
+	{
+		validate_cache(Cache, Header);
+		relocate_cache_tree(Cache, Header);
+	}
+	catch (...)
+	{
+		release_cache_memory(Cache);
+		throw;
+	}
+
+	Cache->Number_Of_Textures = Header->Number_Of_Textures;
+
+	Data = (MESH_DATA *)POV_MALLOC(sizeof(MESH_DATA), "triangle mesh data");
+
+	Data->References = 1;
+
+	Data->Number_Of_Vertices  = (long)Header->Number_Of_Vertices;
+	Data->Number_Of_Normals   = (long)Header->Number_Of_Normals;
+	Data->Number_Of_UVCoords  = (long)Header->Number_Of_UVCoords;
+	Data->Number_Of_Triangles = (long)Header->Number_Of_Triangles;
+
+	Data->Vertices  = (SNGL_VECT *)(Cache->Base + Header->Vertices);
+	Data->Normals   = (SNGL_VECT *)(Cache->Base + Header->Normals);
+	Data->UVCoords  = (UV_VECT *)(Cache->Base + Header->UVCoords);
+	Data->Triangles = (MESH_TRIANGLE *)(Cache->Base + Header->Triangles);
+
+	Data->UV_Indices      = (Header->UV_Indices != 0) ? (int *)(Cache->Base + Header->UV_Indices) : NULL;
+	Data->Vertex_UVs      = ((Header->Flags & MESH_CACHE_VERTEX_UVS) != 0);
+	Data->Texture_Indices = (Header->Texture_Indices != 0) ? (int *)(Cache->Base + Header->Texture_Indices) : NULL;
+	Data->Texture_Stride  = Header->Texture_Stride;
+	Data->Shared_Texture  = Header->Shared_Texture;
+
+	Data->Tree  = Cache->Tree;
+	Data->Cache = Cache;
+
+	Make_Vector(Data->Inside_Vect, Header->Inside_Vect[X], Header->Inside_Vect[Y], Header->Inside_Vect[Z]);
+
+	Object->Data = Data;
+
+	if (Header->Flags & MESH_CACHE_INSIDE_VECTOR)
+	{
+		Object->has_inside_vector = true;
+		Object->Type &= ~PATCH_OBJECT;
+	}
+	else
+	{
+		Object->has_inside_vector = false;
+		Object->Type |= PATCH_OBJECT;
+	}
+
+	if (Header->Flags & MESH_CACHE_TEXTURED)
+		Object->Type |= TEXTURED_OBJECT;
+}
+
+
+
+/*****************************************************************************
+*
+* FUNCTION
+*
+*   Close_Mesh_Cache
+*
+* INPUT
+*
+*   Data - Mesh data created from a cache file
+*
+* OUTPUT
+*
+*   Data
+*
+* RETURNS
+*
+* AUTHOR
+*
+* DESCRIPTION
+*
+*   Release the cache file of the mesh data and clear all pointers into it.
+*   A bounding box tree that was built after reading the file is kept.
+*
+* CHANGES
+*
+******************************************************************************/
+
+void Close_Mesh_Cache(MESH_DATA *Data)
+{
+	if (Data->Tree == Data->Cache->Tree)
+		Data->Tree = NULL;
+
+	Data->Vertices        = NULL;
+	Data->Normals         = NULL;
+	Data->UVCoords        = NULL;
+	Data->Triangles       = NULL;
+	Data->UV_Indices      = NULL;
+	Data->Texture_Indices = NULL;
+
+	release_cache_memory(Data->Cache);
+
+	Data->Cache = NULL;
+}
+
+
+
+/*****************************************************************************
+*
+* FUNCTION
+*
+*   init_cache_header
+*
+* INPUT
+*
+*   Header - Header to initialize
+*
+* OUTPUT
+*
+*   Header
+*
+* RETURNS
+*
+* AUTHOR
+*
+* DESCRIPTION
+*
+*   Clear a header and fill in the fields identifying the file format.
+*
+* CHANGES
+*
+******************************************************************************/
+
+static void init_cache_header(MESH_CACHE_HEADER *Header)
+{
+	memset(Header, 0, sizeof(MESH_CACHE_HEADER));
+
+	memcpy(Header->Magic, MESH_CACHE_MAGIC, sizeof(Header->Magic));
+
+	Header->Version    = MESH_CACHE_VERSION;
+	Header->Byte_Order = MESH_CACHE_BYTE_ORDER;
+
+	Header->Record_Sizes[MESH_CACHE_POINTER_RECORD]  = sizeof(void *);
+	Header->Record_Sizes[MESH_CACHE_VECTOR_RECORD]   = sizeof(SNGL_VECT);
+	Header->Record_Sizes[MESH_CACHE_UV_RECORD]       = sizeof(UV_VECT);
+	Header->Record_Sizes[MESH_CACHE_TRIANGLE_RECORD] = sizeof(MESH_TRIANGLE);
+	Header->Record_Sizes[MESH_CACHE_NODE_RECORD]     = sizeof(BBOX_TREE);
+	Header->Record_Sizes[MESH_CACHE_PACKET_RECORD]   = sizeof(MESH_TRIANGLE_PACKET);
+}
+
+
+
+/*****************************************************************************
+*
+* FUNCTION
+*
+*   place_cache_section
+*
+* INPUT
+*
+*   Offset - End of the previous section
+*   Size   - Size of the section in bytes
+*
+* OUTPUT
+*
+*   Offset - End of this section
+*
+* RETURNS
+*
+*   POV_LONG - Offset of the section, 0 for an empty section
+*
+* AUTHOR
+*
+* DESCRIPTION
+*
+*   -
+*
+* CHANGES
+*
+******************************************************************************/
+
+static POV_LONG place_cache_section(POV_LONG& Offset, POV_LONG Size)
+{
+	POV_LONG Start;
+
+	if (Size == 0)
+		return 0;
+
+	Start = (Offset + MESH_CACHE_ALIGNMENT - 1) / MESH_CACHE_ALIGNMENT * MESH_CACHE_ALIGNMENT;
+
+	Offset = Start + Size;
+
+	return Start;
+}
+
+
+
+/*****************************************************************************
+*
+* FUNCTION
+*
+*   count_cache_tree
+*
+* INPUT
+*
+*   Node   - Bounding box tree node
+*   Header - Header to update
+*
+* OUTPUT
+*
+*   Header
+*
+* RETURNS
+*
+* AUTHOR
+*
+* DESCRIPTION
+*
+*   Count the nodes, child pointers and packets of a bounding box tree.
+*
+* CHANGES
+*
+******************************************************************************/
+
+static void count_cache_tree(const BBOX_TREE *Node, MESH_CACHE_HEADER *Header)
+{
+	int i;
+
+	if (Node == NULL)
+		return;
+
+	Header->Number_Of_Nodes++;
+
+	if (Node->Entries > 0)
+	{
+		Header->Number_Of_Children += Node->Entries;
+
+		for (i = 0; i < Node->Entries; i++)
+			count_cache_tree(Node->Node[i], Header);
+	}
+	else if (Node->Entries < 0)
+	{
+		Header->Number_Of_Packets++;
+	}
+}
+
+
+
+/*****************************************************************************
+*
+* FUNCTION
+*
+*   flatten_cache_tree
+*
+* INPUT
+*
+*   Node     - Bounding box tree node
+*   Data     - Mesh data the tree refers to
+*   Header   - Header with the section offsets
+*   Nodes    - Nodes written so far
+*   Children - Child pointers written so far
+*   Packets  - Packets written so far
+*
+* OUTPUT
+*
+*   Nodes, Children, Packets
+*
+* RETURNS
+*
+*   POV_LONG - File offset of the node
+*
+* AUTHOR
+*
+* DESCRIPTION
+*
+*   Copy a bounding box tree into the node, child and packet sections,
+*   replacing every pointer by the file offset of its target.
+*
+* CHANGES
+*
+******************************************************************************/
+
+static POV_LONG flatten_cache_tree(const BBOX_TREE *Node, const MESH_DATA *Data, const MESH_CACHE_HEADER *Header, vector<BBOX_TREE>& Nodes, vector<BBOX_TREE *>& Children, vector<MESH_TRIANGLE_PACKET>& Packets)
+{
+	int i;
+	size_t Index, First;
+	POV_LONG Offset;
+	MESH_TRIANGLE_PACKET Packet;
+
+	Index = Nodes.size();
+
+	Nodes.push_back(*Node);
+
+	if (Node->Entries > 0)
+	{
+		First = Children.size();
+
+		Children.resize(First + Node->Entries);
+
+		for (i = 0; i < Node->Entries; i++)
+		{
+			Offset = flatten_cache_tree(Node->Node[i], Data, Header, Nodes, Children, Packets);
+
+			Children[First + i] = (BBOX_TREE *)(size_t)Offset;
+		}
+
+		Offset = Header->Children + First * sizeof(BBOX_TREE *);
+	}
+	else if (Node->Entries == 0)
+	{
+		Offset = Header->Triangles + ((const MESH_TRIANGLE *)Node->Node - Data->Triangles) * sizeof(MESH_TRIANGLE);
+	}
+	else
+	{
+		Packet = *(const MESH_TRIANGLE_PACKET *)Node->Node;
+
+		for (i = 0; i < MESH_PACKET_SIZE; i++)
+			Packet.Triangles[i] = (MESH_TRIANGLE *)(size_t)(Header->Triangles + (Packet.Triangles[i] - Data->Triangles) * sizeof(MESH_TRIANGLE));
+
+		Offset = Header->Packets + Packets.size() * sizeof(MESH_TRIANGLE_PACKET);
+
+		Packets.push_back(Packet);
+	}
+
+	Nodes[Index].Node = (BBOX_TREE **)(size_t)Offset;
+
+	return Header->Nodes + Index * sizeof(BBOX_TREE);
+}
+
+
+
+/*****************************************************************************
+*
+* FUNCTION
+*
+*   write_cache_section
+*
+* INPUT
+*
+*   file     - Output file
+*   Position - Current position in the file
+*   Offset   - Offset of the section
+*   Buffer   - Contents of the section
+*   Size     - Size of the section in bytes
+*
+* OUTPUT
+*
+*   Position
+*
+* RETURNS
+*
+* AUTHOR
+*
+* DESCRIPTION
+*
+*   Pad the file with zeros up to the section and write the section.
+*
+* CHANGES
+*
+******************************************************************************/
+
+static void write_cache_section(OStream *file, POV_LONG& Position, POV_LONG Offset, const void *Buffer, size_t Size)
+{
+	static const char Padding[MESH_CACHE_ALIGNMENT] = { 0 };
+
+	if (Offset > Position)
+	{
+		file->write((void *)Padding, (size_t)(Offset - Position));
+
+		Position = Offset;
+	}
+
+	file->write((void *)Buffer, Size);
+
+	Position += Size;
+}
+
+
+
+/*****************************************************************************
+*
+* FUNCTION
+*
+*   check_cache_section
+*
+* INPUT
+*
+*   Cache       - Cache file in memory
+*   Offset      - Offset of the section
+*   Count       - Number of records in the section
+*   Record_Size - Size of one record
+*
+* OUTPUT
+*
+* RETURNS
+*
+*   bool - true if the section is aligned and lies within the file
+*
+* AUTHOR
+*
+* DESCRIPTION
+*
+*   -
+*
+* CHANGES
+*
+******************************************************************************/
+
+static bool check_cache_section(const MESH_CACHE *Cache, POV_LONG Offset, POV_LONG Count, size_t Record_Size)
+{
+	if (Count == 0)
+		return (Offset == 0);
+
+	if ((Count < 0) || (Offset < (POV_LONG)sizeof(MESH_CACHE_HEADER)) || (Offset % MESH_CACHE_ALIGNMENT != 0))
+		return false;
+
+	return (Count <= ((POV_LONG)Cache->Size - Offset) / (POV_LONG)Record_Size);
+}
+
+
+
+/*****************************************************************************
+*
+* FUNCTION
+*
+*   check_cache_record
+*
+* INPUT
+*
+*   Cache       - Cache file in memory
+*   Section     - Offset of the section
+*   Count       - Number of records in the section
+*   Record_Size - Size of one record
+*   Offset      - Offset to check
+*
+* OUTPUT
+*
+* RETURNS
+*
+*   bool - true if the offset is the start of a record of the section
+*
+* AUTHOR
+*
+* DESCRIPTION
+*
+*   -
+*
+* CHANGES
+*
+******************************************************************************/
+
+static bool check_cache_record(const MESH_CACHE *Cache, POV_LONG Section, POV_LONG Count, size_t Record_Size, size_t Offset)
+{
+	if ((Count == 0) || ((POV_LONG)Offset < Section))
+		return false;
+
+	Offset -= (size_t)Section;
+
+	return ((Offset % Record_Size == 0) && ((POV_LONG)(Offset / Record_Size) < Count));
+}
+
+
+
+/*****************************************************************************
+*
+* FUNCTION
+*
+*   release_cache_memory
+*
+* INPUT
+*
+*   Cache - Cache file in memory
+*
+* OUTPUT
+*
+* RETURNS
+*
+* AUTHOR
+*
+* DESCRIPTION
+*
+*   Unmap or free the file contents and the cache itself.
+*
+* CHANGES
+*
+******************************************************************************/
+
+static void release_cache_memory(MESH_CACHE *Cache)
+{
+#if (SYS_MESH_CACHE_MMAP == 1)
+	if (Cache->Mapped)
+		munmap(Cache->Base, Cache->Size);
+	else
+#endif
+		POV_FREE(Cache->Base);
+
+	POV_FREE(Cache);
+}
+
+
+
+/*****************************************************************************
+*
+* FUNCTION
+*
+*   validate_cache
+*
+* INPUT
+*
+*   Cache  - Cache file in memory
+*   Header - Header of the file
+*
+* OUTPUT
+*
+* RETURNS
+*
+* AUTHOR
+*
+* DESCRIPTION
+*
+*   Make sure that the file was written by this build of POV-Ray, that all
+*   sections lie within the file and that every index stored in a triangle
+*   refers to an existing element.
+*
+* CHANGES
+*
+******************************************************************************/
+
+static void validate_cache(const MESH_CACHE *Cache, const MESH_CACHE_HEADER *Header)
+{
+	POV_LONG i, Count;
+	const int *Indices;
+	const MESH_TRIANGLE *Triangle;
+	MESH_CACHE_HEADER Expected;
+
+	init_cache_header(&Expected);
+
+	if (memcmp(Header->Magic, Expected.Magic, sizeof(Expected.Magic)) != 0)
+		throw POV_EXCEPTION(kFileDataErr, "Not a mesh cache file.");
+
+	if ((Header->Version != Expected.Version) || (Header->Byte_Order != Expected.Byte_Order) ||
+	    (memcmp(Header->Record_Sizes, Expected.Record_Sizes, sizeof(Expected.Record_Sizes)) != 0))
+		throw POV_EXCEPTION(kFileDataErr, "Mesh cache file was written by a different version or build of POV-Ray.");
+
+	if (Header->File_Size != (POV_LONG)Cache->Size)
+		throw POV_EXCEPTION(kFileDataErr, "Mesh cache file is truncated.");
+
+	if ((Header->Number_Of_Vertices <= 0) || (Header->Number_Of_Normals <= 0) ||
+	    (Header->Number_Of_UVCoords <= 0) || (Header->Number_Of_Triangles <= 0) ||
+	    (Header->Number_Of_Textures < 0) || (Header->Texture_Stride < 0) || (Header->Texture_Stride > 3) ||
+	    (Header->Shared_Texture < -1) || (Header->Shared_Texture >= max(Header->Number_Of_Textures, 1)) ||
+	    ((Header->Flags & MESH_CACHE_VERTEX_UVS) && (Header->Number_Of_UVCoords < Header->Number_Of_Vertices)))
+		throw POV_EXCEPTION(kFileDataErr, "Invalid mesh cache file header.");
+
+	if (!check_cache_section(Cache, Header->Vertices, Header->Number_Of_Vertices, sizeof(SNGL_VECT)) ||
+	    !check_cache_section(Cache, Header->Normals, Header->Number_Of_Normals, sizeof(SNGL_VECT)) ||
+	    !check_cache_section(Cache, Header->UVCoords, Header->Number_Of_UVCoords, sizeof(UV_VECT)) ||
+	    !check_cache_section(Cache, Header->Triangles, Header->Number_Of_Triangles, sizeof(MESH_TRIANGLE)) ||
+	    !check_cache_section(Cache, Header->UV_Indices, (Header->UV_Indices != 0) ? Header->Number_Of_Triangles * 3 : 0, sizeof(int)) ||
+	    !check_cache_section(Cache, Header->Texture_Indices, (Header->Texture_Indices != 0) ? Header->Number_Of_Triangles * Header->Texture_Stride : 0, sizeof(int)) ||
+	    !check_cache_section(Cache, Header->Nodes, Header->Number_Of_Nodes, sizeof(BBOX_TREE)) ||
+	    !check_cache_section(Cache, Header->Children, Header->Number_Of_Children, sizeof(BBOX_TREE *)) ||
+	    !check_cache_section(Cache, Header->Packets, Header->Number_Of_Packets, sizeof(MESH_TRIANGLE_PACKET)))
+		throw POV_EXCEPTION(kFileDataErr, "Invalid section in mesh cache file.");
+
+	Triangle = (const MESH_TRIANGLE *)(Cache->Base + Header->Triangles);
+
+	for (i = 0; i < Header->Number_Of_Triangles; i++, Triangle++)
+	{
+		if ((Triangle->P1 < 0) || (Triangle->P1 >= Header->Number_Of_Vertices) ||
+		    (Triangle->P2 < 0) || (Triangle->P2 >= Header->Number_Of_Vertices) ||
+		    (Triangle->P3 < 0) || (Triangle->P3 >= Header->Number_Of_Vertices) ||
+		    (Triangle->Normal_Ind < 0) || (Triangle->Normal_Ind >= Header->Number_Of_Normals))
+			throw POV_EXCEPTION(kFileDataErr, "Invalid triangle in mesh cache file.");
+	}
+
+	if (Header->UV_Indices != 0)
+	{
+		Indices = (const int *)(Cache->Base + Header->UV_Indices);
+		Count = Header->Number_Of_Triangles * 3;
+
+		for (i = 0; i < Count; i++)
+		{
+			if ((Indices[i] < 0) || (Indices[i] >= Header->Number_Of_UVCoords))
+				throw POV_EXCEPTION(kFileDataErr, "Invalid uv index in mesh cache file.");
+		}
+	}
+
+	if (Header->Texture_Indices != 0)
+	{
+		Indices = (const int *)(Cache->Base + Header->Texture_Indices);
+		Count = Header->Number_Of_Triangles * Header->Texture_Stride;
+
+		for (i = 0; i < Count; i++)
+		{
+			if ((Indices[i] < -1) || (Indices[i] >= Header->Number_Of_Textures))
+				throw POV_EXCEPTION(kFileDataErr, "Invalid texture index in mesh cache file.");
+		}
+	}
+}
+
+
+
+/*****************************************************************************
+*
+* FUNCTION
+*
+*   relocate_cache_tree
+*
+* INPUT
+*
+*   Cache  - Cache file in memory
+*   Header - Header of the file
+*
+* OUTPUT
+*
+*   Cache
+*
+* RETURNS
+*
+* AUTHOR
+*
+* DESCRIPTION
+*
+*   Turn the file offsets stored in the bounding box tree back into
+*   pointers, checking each of them first. This only writes to the node,
+*   child and packet sections of the file.
+*
+* CHANGES
+*
+******************************************************************************/
+
+static void relocate_cache_tree(MESH_CACHE *Cache, const MESH_CACHE_HEADER *Header)
+{
+	POV_LONG i;
+	int j;
+	size_t Offset;
+	BBOX_TREE *Node, **Child;
+	MESH_TRIANGLE_PACKET *Packet;
+
+	if (Header->Number_Of_Nodes == 0)
+		return;
+
+	Node = (BBOX_TREE *)(Cache->Base + Header->Nodes);
+
+	for (i = 0; i < Header->Number_Of_Nodes; i++, Node++)
+	{
+		Offset = (size_t)Node->Node;
+
+		if (Node->Entries > 0)
+		{
+			if (!check_cache_record(Cache, Header->Children, Header->Number_Of_Children, sizeof(BBOX_TREE *), Offset) ||
+			    !check_cache_record(Cache, Header->Children, Header->Number_Of_Children, sizeof(BBOX_TREE *), Offset + (Node->Entries - 1) * sizeof(BBOX_TREE *)))
+				throw POV_EXCEPTION(kFileDataErr, "Invalid bounding box tree in mesh cache file.");
+		}
+		else if (Node->Entries == 0)
+		{
+			if (!check_cache_record(Cache, Header->Triangles, Header->Number_Of_Triangles, sizeof(MESH_TRIANGLE), Offset))
+				throw POV_EXCEPTION(kFileDataErr, "Invalid bounding box tree in mesh cache file.");
+		}
+		else
+		{
+			if ((Node->Entries < -MESH_PACKET_SIZE) ||
+			    !check_cache_record(Cache, Header->Packets, Header->Number_Of_Packets, sizeof(MESH_TRIANGLE_PACKET), Offset))
+				throw POV_EXCEPTION(kFileDataErr, "Invalid bounding box tree in mesh cache file.");
+
+			Packet = (MESH_TRIANGLE_PACKET *)(Cache->Base + Offset);
+
+			for (j = 0; j < MESH_PACKET_SIZE; j++)
+			{
+				if (!check_cache_record(Cache, Header->Triangles, Header->Number_Of_Triangles, sizeof(MESH_TRIANGLE), (size_t)Packet->Triangles[j]))
+					throw POV_EXCEPTION(kFileDataErr, "Invalid bounding box tree in mesh cache file.");
+
+				Packet->Triangles[j] = (MESH_TRIANGLE *)(Cache->Base + (size_t)Packet->Triangles[j]);
+			}
+		}
+
+		Node->Node = (BBOX_TREE **)(Cache->Base + Offset);
+	}
+
+	Child = (BBOX_TREE **)(Cache->Base + Header->Children);
+
+	for (i = 0; i < Header->Number_Of_Children; i++, Child++)
+	{
+		if (!check_cache_record(Cache, Header->Nodes, Header->Number_Of_Nodes, sizeof(BBOX_TREE), (size_t)*Child))
+			throw POV_EXCEPTION(kFileDataErr, "Invalid bounding box tree in mesh cache file.");
+
+		*Child = (BBOX_TREE *)(Cache->Base + (size_t)*Child);
+	}
+
+	Cache->Tree = (const BBOX_TREE *)(Cache->Base + Header->Nodes);
+}
+
+}
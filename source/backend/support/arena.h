@@ -0,0 +1,268 @@
+/*******************************************************************************
+ * arena.h
+ *
+ * This file contains a per-thread bump allocator for short-lived trace data.
+ *
+ * from Persistence of Vision Ray Tracer ('POV-Ray') version 3.7.
+ * Copyright 1991-2003 Persistence of Vision Team
+ * Copyright 2003-2009 Persistence of Vision Raytracer Pty. Ltd.
+ * ---------------------------------------------------------------------------
+ * NOTICE: This source code file is provided so that users may experiment
+ * with enhancements to POV-Ray and to port the software to platforms other
+ * than those supported by the POV-Ray developers. There are strict rules
+ * regarding how you are permitted to use this file. These rules are contained
+ * in the distribution and derivative versions licenses which should have been
+ * provided with this file.
+ *
+ * These licences may be found online, linked from the end-user license
+ * agreement that is located at http://www.povray.org/povlegal.html
+ * ---------------------------------------------------------------------------
+ * POV-Ray is based on the popular DKB raytracer version 2.12.
+ * DKBTrace was originally written by David K. Buck.
+ * DKBTrace Ver 2.0-2.12 were written by David K. Buck & Aaron A. Collins.
+ * ---------------------------------------------------------------------------
+ * $File: //depot/povray/smp/source/backend/support/arena.h $
+ * $Revision: #1 $
+ * $Change: 5401 $
+ * $DateTime: 2011/02/08 21:06:55 $
+ * $Author: clipka $
+ *******************************************************************************/
+
+/*********************************************************************************
+ * NOTICE
+ *
+ * This file is part of a BETA-TEST version of POV-Ray version 3.7. It is not
+ * final code. Use of this source file is governed by both the standard POV-Ray
+ * licences referred to in the copyright header block above this notice, and the
+ * following additional restrictions numbered 1 through 4 below:
+ *
+ *   1. This source file may not be re-distributed without the written permission
+ *      of Persistence of Vision Raytracer Pty. Ltd.
+ *
+ *   2. This notice may not be altered or removed.
+ *   
+ *   3. Binaries generated from this source file by individuals for their own
+ *      personal use may not be re-distributed without the written permission
+ *      of Persistence of Vision Raytracer Pty. Ltd. Such personal-use binaries
+ *      are not required to have a timeout, and thus permission is granted in
+ *      these circumstances only to disable the timeout code contained within
+ *      the beta software.
+ *   
+ *   4. Binaries generated from this source file for use within an organizational
+ *      unit (such as, but not limited to, a company or university) may not be
+ *      distributed beyond the local organizational unit in which they were made,
+ *      unless written permission is obtained from Persistence of Vision Raytracer
+ *      Pty. Ltd. Additionally, the timeout code implemented within the beta may
+ *      not be disabled or otherwise bypassed in any manner.
+ *
+ * The following text is not part of the above conditions and is provided for
+ * informational purposes only.
+ *
+ * The purpose of the no-redistribution clause is to attempt to keep the
+ * circulating copies of the beta source fresh. The only authorized distribution
+ * point for the source code is the POV-Ray website and Perforce server, where
+ * the code will be kept up to date with recent fixes. Additionally the beta
+ * timeout code mentioned above has been a standard part of POV-Ray betas since
+ * version 1.0, and is intended to reduce bug reports from old betas as well as
+ * keep any circulating beta binaries relatively fresh.
+ *
+ * All said, however, the POV-Ray developers are open to any reasonable request
+ * for variations to the above conditions and will consider them on a case-by-case
+ * basis.
+ *
+ * Additionally, the developers request your co-operation in fixing bugs and
+ * generally improving the program. If submitting a bug-fix, please ensure that
+ * you quote the revision number of the file shown above in the copyright header
+ * (see the '$Revision:' field). This ensures that it is possible to determine
+ * what specific copy of the file you are working with. The developers also would
+ * like to make it known that until POV-Ray 3.7 is out of beta, they would prefer
+ * to emphasize the provision of bug fixes over the addition of new features.
+ *
+ * Persons wishing to enhance this source are requested to take the above into
+ * account. It is also strongly suggested that such enhancements are started with
+ * a recent copy of the source.
+ *
+ * The source code page (see http://www.povray.org/beta/source/) sets out the
+ * conditions under which the developers are willing to accept contributions back
+ * into the primary source tree. Please refer to those conditions prior to making
+ * any changes to this source, if you wish to submit those changes for inclusion
+ * with POV-Ray.
+ *
+ *********************************************************************************/
+
+#ifndef POVRAY_BACKEND_ARENA_H
+#define POVRAY_BACKEND_ARENA_H
+
+#include <vector>
+
+#include "backend/frame.h"
+
+namespace pov
+{
+
+/**
+ *	Bump allocator for data that lives no longer than the trace of one
+ *	primary ray. Memory is handed out from large blocks by advancing an
+ *	offset, and is given back all at once, either by releasing to a mark
+ *	taken earlier or by resetting the whole arena. Blocks are kept for
+ *	reuse, so once the arena has grown to the largest per-ray footprint no
+ *	further heap allocations take place.
+ *
+ *	Objects placed in the arena are never destructed by it; users either
+ *	place only objects with trivial destructors there, or destruct them
+ *	explicitly (see ArenaPtr).
+ *
+ *	An arena is owned by one thread and must not be shared.
+ */
+class MemoryArena
+{
+	public:
+		/// position in the arena to release to
+		struct Mark
+		{
+			size_t block;
+			size_t offset;
+		};
+
+		/**
+		 *	Create an empty arena. No memory is reserved until the first
+		 *	allocation.
+		 *	@param	bs				Default block size in bytes.
+		 */
+		MemoryArena(size_t bs = 64 * 1024);
+		~MemoryArena();
+
+		/**
+		 *	Allocate memory aligned to kAlignment bytes.
+		 *	@param	size			Number of bytes.
+		 *	@return					Pointer to uninitialised memory.
+		 */
+		inline void *Alloc(size_t size)
+		{
+			size = (size + kAlignment - 1) & ~(kAlignment - 1);
+			if(current < blocks.size())
+			{
+				Block& b = blocks[current];
+				if(b.used + size <= b.size)
+				{
+					void *p = b.data + b.used;
+					b.used += size;
+					return p;
+				}
+			}
+			return AllocSlow(size);
+		}
+
+		/// allocate uninitialised storage for count objects of type T
+		template<typename T> inline T *Alloc(size_t count) { return reinterpret_cast<T *>(Alloc(sizeof(T) * count)); }
+
+		/// get the current position, to release to later
+		inline Mark GetMark() const
+		{
+			Mark m;
+			m.block = current;
+			m.offset = (current < blocks.size()) ? blocks[current].used : 0;
+			return m;
+		}
+
+		/// give back everything allocated since the mark was taken
+		inline void Release(const Mark& m)
+		{
+			if(m.block < blocks.size())
+			{
+				current = m.block;
+				blocks[current].used = m.offset;
+			}
+		}
+
+		/// give back everything allocated so far, keeping the blocks
+		inline void Reset()
+		{
+			current = 0;
+			if(!blocks.empty())
+				blocks[0].used = 0;
+		}
+
+		/// number of bytes held in blocks
+		size_t GetReservedSize() const;
+
+		static const size_t kAlignment = 16;
+	private:
+		struct Block
+		{
+			unsigned char *data;
+			size_t size;
+			size_t used;
+		};
+
+		/// all blocks; those after the current one are free
+		vector<Block> blocks;
+		/// block allocations are taken from
+		size_t current;
+		/// default size of new blocks
+		size_t blockSize;
+
+		void *AllocSlow(size_t size);
+
+		/// not available
+		MemoryArena(const MemoryArena&);
+		/// not available
+		MemoryArena& operator=(const MemoryArena&);
+};
+
+/**
+ *	Releases everything allocated from an arena during the lifetime of the
+ *	scope object, including when the scope is left by an exception.
+ */
+class ArenaScope
+{
+	public:
+		explicit ArenaScope(MemoryArena& a) : arena(a), mark(a.GetMark()) { }
+		~ArenaScope() { arena.Release(mark); }
+	private:
+		MemoryArena& arena;
+		MemoryArena::Mark mark;
+
+		/// not available
+		ArenaScope(const ArenaScope&);
+		/// not available
+		ArenaScope& operator=(const ArenaScope&);
+};
+
+/**
+ *	Owns an object constructed in arena memory: destructs it but leaves the
+ *	memory to the arena. Declare it after the ArenaScope that releases the
+ *	memory, so the object is destructed first.
+ */
+template<typename T>
+class ArenaPtr
+{
+	public:
+		ArenaPtr() : object(NULL) { }
+		~ArenaPtr() { reset(); }
+
+		/// allocate storage for an object; construct it with placement new and pass it to reset
+		static void *Storage(MemoryArena& arena) { return arena.Alloc(sizeof(T)); }
+
+		void reset(T *p = NULL)
+		{
+			if(object != NULL)
+				object->~T();
+			object = p;
+		}
+
+		T *get() const { return object; }
+		T& operator*() const { return *object; }
+		T *operator->() const { return object; }
+	private:
+		T *object;
+
+		/// not available
+		ArenaPtr(const ArenaPtr&);
+		/// not available
+		ArenaPtr& operator=(const ArenaPtr&);
+};
+
+}
+
+#endif // POVRAY_BACKEND_ARENA_H
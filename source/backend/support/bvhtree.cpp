@@ -0,0 +1,522 @@
+/*******************************************************************************
+ * bvhtree.cpp
+ *
+ * from Persistence of Vision Ray Tracer ('POV-Ray') version 3.7.
+ * Copyright 1991-2003 Persistence of Vision Team
+ * Copyright 2003-2009 Persistence of Vision Raytracer Pty. Ltd.
+ * ---------------------------------------------------------------------------
+ * NOTICE: This source code file is provided so that users may experiment
+ * with enhancements to POV-Ray and to port the software to platforms other
+ * than those supported by the POV-Ray developers. There are strict rules
+ * regarding how you are permitted to use this file. These rules are contained
+ * in the distribution and derivative versions licenses which should have been
+ * provided with this file.
+ *
+ * These licences may be found online, linked from the end-user license
+ * agreement that is located at http://www.povray.org/povlegal.html
+ * ---------------------------------------------------------------------------
+ * POV-Ray is based on the popular DKB raytracer version 2.12.
+ * DKBTrace was originally written by David K. Buck.
+ * DKBTrace Ver 2.0-2.12 were written by David K. Buck & Aaron A. Collins.
+ * ---------------------------------------------------------------------------
+ * $File: //depot/povray/smp/source/backend/support/bvhtree.cpp $
+ * $Revision: #1 $
+ * $Change: 5401 $
+ * $DateTime: 2011/02/08 21:06:55 $
+ * $Author: clipka $
+ *******************************************************************************/
+
+/*********************************************************************************
+ * NOTICE
+ *
+ * This file is part of a BETA-TEST version of POV-Ray version 3.7. It is not
+ * final code. Use of this source file is governed by both the standard POV-Ray
+ * licences referred to in the copyright header block above this notice, and the
+ * following additional restrictions numbered 1 through 4 below:
+ *
+ *   1. This source file may not be re-distributed without the written permission
+ *      of Persistence of Vision Raytracer Pty. Ltd.
+ *
+ *   2. This notice may not be altered or removed.
+ *   
+ *   3. Binaries generated from this source file by individuals for their own
+ *      personal use may not be re-distributed without the written permission
+ *      of Persistence of Vision Raytracer Pty. Ltd. Such personal-use binaries
+ *      are not required to have a timeout, and thus permission is granted in
+ *      these circumstances only to disable the timeout code contained within
+ *      the beta software.
+ *   
+ *   4. Binaries generated from this source file for use within an organizational
+ *      unit (such as, but not limited to, a company or university) may not be
+ *      distributed beyond the local organizational unit in which they were made,
+ *      unless written permission is obtained from Persistence of Vision Raytracer
+ *      Pty. Ltd. Additionally, the timeout code implemented within the beta may
+ *      not be disabled or otherwise bypassed in any manner.
+ *
+ * The following text is not part of the above conditions and is provided for
+ * informational purposes only.
+ *
+ * The purpose of the no-redistribution clause is to attempt to keep the
+ * circulating copies of the beta source fresh. The only authorized distribution
+ * point for the source code is the POV-Ray website and Perforce server, where
+ * the code will be kept up to date with recent fixes. Additionally the beta
+ * timeout code mentioned above has been a standard part of POV-Ray betas since
+ * version 1.0, and is intended to reduce bug reports from old betas as well as
+ * keep any circulating beta binaries relatively fresh.
+ *
+ * All said, however, the POV-Ray developers are open to any reasonable request
+ * for variations to the above conditions and will consider them on a case-by-case
+ * basis.
+ *
+ * Additionally, the developers request your co-operation in fixing bugs and
+ * generally improving the program. If submitting a bug-fix, please ensure that
+ * you quote the revision number of the file shown above in the copyright header
+ * (see the '$Revision:' field). This ensures that it is possible to determine
+ * what specific copy of the file you are working with. The developers also would
+ * like to make it known that until POV-Ray 3.7 is out of beta, they would prefer
+ * to emphasize the provision of bug fixes over the addition of new features.
+ *
+ * Persons wishing to enhance this source are requested to take the above into
+ * account. It is also strongly suggested that such enhancements are started with
+ * a recent copy of the source.
+ *
+ * The source code page (see http://www.povray.org/beta/source/) sets out the
+ * conditions under which the developers are willing to accept contributions back
+ * into the primary source tree. Please refer to those conditions prior to making
+ * any changes to this source, if you wish to submit those changes for inclusion
+ * with POV-Ray.
+ *
+ *********************************************************************************/
+
+#include <algorithm>
+
+// frame.h must always be the first POV file included (pulls in platform config)
+#include "backend/frame.h"
+#include "backend/support/bvhtree.h"
+
+// this must be the last file included
+#include "base/povdebug.h"
+
+namespace pov
+{
+
+#define MAX_BVH_TREE_LEVEL    64
+#define MAX_BVH_LEAF_OBJECTS  16
+#define MIN_BVH_LEAF_OBJECTS  2
+#define BVH_SAH_LEVEL_LIMIT   32
+#define BVH_SAH_BINS          16
+#define OBJECT_ISECT_COST     4.0f
+#define NODE_ACCESS_COST      1.0f
+#define NODE_ALIGNMENT        64
+
+const unsigned int NODE_PROGRESS_INTERVAL = 1000;
+
+inline float HalfArea(const float *bmin, const float *bmax)
+{
+	float dx = bmax[X] - bmin[X];
+	float dy = bmax[Y] - bmin[Y];
+	float dz = bmax[Z] - bmin[Z];
+
+	return (dx * (dy + dz) + dy * dz);
+}
+
+inline void ClearBounds(float *bmin, float *bmax)
+{
+	bmin[X] = bmin[Y] = bmin[Z] = BOUND_HUGE;
+	bmax[X] = bmax[Y] = bmax[Z] = -BOUND_HUGE;
+}
+
+inline void ExtendBounds(float *bmin, float *bmax, const float *omin, const float *omax)
+{
+	bmin[X] = min(bmin[X], omin[X]);
+	bmin[Y] = min(bmin[Y], omin[Y]);
+	bmin[Z] = min(bmin[Z], omin[Z]);
+
+	bmax[X] = max(bmax[X], omax[X]);
+	bmax[Y] = max(bmax[Y], omax[Y]);
+	bmax[Z] = max(bmax[Z], omax[Z]);
+}
+
+struct CompareCentroid
+{
+	unsigned int axis;
+
+	CompareCentroid(unsigned int a) : axis(a) { }
+
+	template<class T>
+	inline bool operator()(const T& left, const T& right) const
+	{
+		if(left.centroid[axis] != right.centroid[axis])
+			return (left.centroid[axis] < right.centroid[axis]);
+		return (left.index < right.index);
+	}
+};
+
+BVHTree::BVHTree() :
+	nodes(NULL),
+	nodeMemory(NULL),
+	nodeCount(0)
+{
+}
+
+BVHTree::~BVHTree()
+{
+	clear();
+}
+
+void BVHTree::clear()
+{
+	if(nodeMemory != NULL)
+		POV_FREE(nodeMemory);
+
+	nodes = NULL;
+	nodeMemory = NULL;
+	nodeCount = 0;
+	indices.clear();
+}
+
+bool BVHTree::operator()(const Ray& ray, BSPTree::Intersect& isect, double maxdist) const
+{
+	unsigned int tstack[MAX_BVH_TREE_LEVEL];
+	unsigned int tstackpos = 0;
+	unsigned int inode = 0;
+	double origin[3];
+	double invdir[3];
+	bool nonzero[3];
+	bool negative[3];
+
+	if(nodeCount == 0)
+		return false;
+
+	for(int i = X; i <= Z; i++)
+	{
+		origin[i] = ray.Origin[i];
+		nonzero[i] = (ray.Direction[i] != 0.0);
+		negative[i] = (ray.Direction[i] < 0.0);
+		invdir[i] = (nonzero[i] ? 1.0 / ray.Direction[i] : 0.0);
+	}
+
+	while(true)
+	{
+		const Node& node = nodes[inode];
+		double tnear = -BOUND_HUGE;
+		double tfar = maxdist;
+		bool hit = true;
+
+		// slab test against node bounding box
+		for(int i = X; (i <= Z) && (hit == true); i++)
+		{
+			if(nonzero[i])
+			{
+				double t0 = (double(node.bmin[i]) - origin[i]) * invdir[i];
+				double t1 = (double(node.bmax[i]) - origin[i]) * invdir[i];
+
+				if(negative[i])
+					swap(t0, t1);
+
+				tnear = max(tnear, t0);
+				tfar = min(tfar, t1);
+
+				hit = (tnear <= tfar);
+			}
+			else
+				hit = ((origin[i] >= node.bmin[i]) && (origin[i] <= node.bmax[i]));
+		}
+
+		if((hit == true) && (tfar >= 0.0))
+		{
+			if(node.count == 0)
+			{
+				// descend into the child nearer to the ray origin first, remember the other one
+				if(negative[node.axis])
+				{
+					tstack[tstackpos++] = inode + 1;
+					inode = node.index;
+				}
+				else
+				{
+					tstack[tstackpos++] = node.index;
+					inode = inode + 1;
+				}
+
+				continue;
+			}
+
+			for(unsigned int i = node.index, e = i + node.count; i < e; i++)
+				isect(indices[i], maxdist);
+		}
+
+		// see if there is another node to process
+		if(tstackpos == 0)
+			break;
+
+		inode = tstack[--tstackpos];
+	}
+
+	return isect(); // see if any objects were hit
+}
+
+bool BVHTree::operator()(const Vector3d& origin, BSPTree::Inside& inside, bool earlyExit) const
+{
+	unsigned int tstack[MAX_BVH_TREE_LEVEL + 1];
+	unsigned int tstackpos = 0;
+
+	if(nodeCount == 0)
+		return false;
+
+	tstack[tstackpos++] = 0;
+	while(tstackpos > 0)
+	{
+		const Node& node = nodes[tstack[--tstackpos]];
+
+		// make sure the origin is within the node bounding box
+		if((origin[X] < node.bmin[X]) || (origin[Y] < node.bmin[Y]) || (origin[Z] < node.bmin[Z]) ||
+		   (origin[X] > node.bmax[X]) || (origin[Y] > node.bmax[Y]) || (origin[Z] > node.bmax[Z]))
+			continue;
+
+		if(node.count == 0)
+		{
+			tstack[tstackpos++] = node.index;
+			tstack[tstackpos++] = (unsigned int)(&node - nodes) + 1;
+		}
+		else
+		{
+			for(unsigned int i = node.index, e = i + node.count; i < e; i++)
+				inside(indices[i]);
+
+			if(earlyExit && inside())
+				return true;
+		}
+	}
+
+	return inside();
+}
+
+void BVHTree::build(const BSPTree::Progress& progress, const BSPTree::Objects& objects,
+                    unsigned int& totalnodes, unsigned int& leafnodes, unsigned int& maxobjects, float& averageobjects,
+                    unsigned int& maxdepth, float& averagedepth)
+{
+	vector<BuildObject> buildobjects(objects.size());
+	vector<Node> buildnodes;
+
+	clear();
+
+	maxTreeDepth = 0;
+	leafNodeCounter = 0;
+	maxObjectsInLeaf = 0;
+	objectsInTreeCounter = 0;
+	treeDepthCounter = 0;
+	lastProgressNodeCounter = 0;
+
+	progress(0);
+
+	for(unsigned int i = 0; i < objects.size(); i++)
+	{
+		for(int a = X; a <= Z; a++)
+		{
+			buildobjects[i].bmin[a] = objects.GetMin(a, i);
+			buildobjects[i].bmax[a] = objects.GetMax(a, i);
+			buildobjects[i].centroid[a] = 0.5f * (buildobjects[i].bmin[a] + buildobjects[i].bmax[a]);
+		}
+		buildobjects[i].index = i;
+	}
+
+	if(buildobjects.empty() == false)
+	{
+		// a binary tree never has more than twice as many nodes as objects
+		buildnodes.reserve(buildobjects.size() * 2);
+		indices.reserve(buildobjects.size());
+
+		BuildRecursive(progress, buildnodes, buildobjects, 0, buildobjects.size(), 0);
+
+		// copy nodes into their final, aligned location
+		nodeCount = buildnodes.size();
+		nodeMemory = POV_MALLOC(nodeCount * sizeof(Node) + NODE_ALIGNMENT, "BVH nodes");
+		nodes = reinterpret_cast<Node *>((reinterpret_cast<size_t>(nodeMemory) + NODE_ALIGNMENT - 1) & ~size_t(NODE_ALIGNMENT - 1));
+		std::copy(buildnodes.begin(), buildnodes.end(), nodes);
+	}
+
+	totalnodes = nodeCount;
+	leafnodes = leafNodeCounter;
+	maxobjects = maxObjectsInLeaf;
+	averageobjects = (leafNodeCounter > 0 ? float(double(objectsInTreeCounter) / double(leafNodeCounter)) : 0.0f);
+	maxdepth = maxTreeDepth;
+	averagedepth = (leafNodeCounter > 0 ? float(double(treeDepthCounter) / double(leafNodeCounter)) : 0.0f);
+
+	progress(nodeCount);
+}
+
+unsigned int BVHTree::BuildRecursive(const BSPTree::Progress& progress, vector<Node>& buildnodes, vector<BuildObject>& buildobjects,
+                                     unsigned int first, unsigned int last, unsigned int depth)
+{
+	unsigned int inode = buildnodes.size();
+	unsigned int count = last - first;
+	float cmin[3], cmax[3];
+	Node node;
+
+	buildnodes.push_back(node);
+
+	if((buildnodes.size() - lastProgressNodeCounter) > NODE_PROGRESS_INTERVAL)
+	{
+		progress(buildnodes.size());
+		lastProgressNodeCounter = buildnodes.size();
+	}
+
+	// compute node bounds as well as the bounds of the object centroids
+	ClearBounds(node.bmin, node.bmax);
+	ClearBounds(cmin, cmax);
+	for(unsigned int i = first; i < last; i++)
+	{
+		ExtendBounds(node.bmin, node.bmax, buildobjects[i].bmin, buildobjects[i].bmax);
+		ExtendBounds(cmin, cmax, buildobjects[i].centroid, buildobjects[i].centroid);
+	}
+
+	if((count <= MIN_BVH_LEAF_OBJECTS) || (depth >= MAX_BVH_TREE_LEVEL - 1))
+	{
+		SetLeafNode(node, buildobjects, first, last, depth);
+		buildnodes[inode] = node;
+		return inode;
+	}
+
+	unsigned int split = first + count / 2;
+	unsigned int bestaxis = X;
+	int bestbin = -1;
+	float bestcost = OBJECT_ISECT_COST * float(count);
+	float parentarea = HalfArea(node.bmin, node.bmax);
+
+	// find the best split plane in terms of the surface area heuristic
+	// by binning object centroids along all three axes; below a certain
+	// depth we stop trying, which guarantees the tree depth stays bounded
+	if((depth < BVH_SAH_LEVEL_LIMIT) && (parentarea > 0.0f))
+	{
+		for(unsigned int axis = X; axis <= Z; axis++)
+		{
+			Bin bins[BVH_SAH_BINS];
+			float rightarea[BVH_SAH_BINS];
+			unsigned int rightcount[BVH_SAH_BINS];
+			float extent = cmax[axis] - cmin[axis];
+
+			if(extent <= 0.0f)
+				continue;
+
+			float scale = float(BVH_SAH_BINS) / extent;
+
+			for(int b = 0; b < BVH_SAH_BINS; b++)
+			{
+				ClearBounds(bins[b].bmin, bins[b].bmax);
+				bins[b].count = 0;
+			}
+
+			for(unsigned int i = first; i < last; i++)
+			{
+				int b = min(int((buildobjects[i].centroid[axis] - cmin[axis]) * scale), BVH_SAH_BINS - 1);
+				ExtendBounds(bins[b].bmin, bins[b].bmax, buildobjects[i].bmin, buildobjects[i].bmax);
+				bins[b].count++;
+			}
+
+			float bmin[3], bmax[3];
+			unsigned int n = 0;
+
+			ClearBounds(bmin, bmax);
+			for(int b = BVH_SAH_BINS - 1; b > 0; b--)
+			{
+				ExtendBounds(bmin, bmax, bins[b].bmin, bins[b].bmax);
+				n += bins[b].count;
+				rightarea[b] = (n > 0 ? HalfArea(bmin, bmax) : 0.0f);
+				rightcount[b] = n;
+			}
+
+			n = 0;
+			ClearBounds(bmin, bmax);
+			for(int b = 0; b < BVH_SAH_BINS - 1; b++)
+			{
+				ExtendBounds(bmin, bmax, bins[b].bmin, bins[b].bmax);
+				n += bins[b].count;
+
+				if((n == 0) || (rightcount[b + 1] == 0))
+					continue;
+
+				float cost = NODE_ACCESS_COST + OBJECT_ISECT_COST *
+				             (HalfArea(bmin, bmax) * float(n) + rightarea[b + 1] * float(rightcount[b + 1])) / parentarea;
+
+				if(cost < bestcost)
+				{
+					bestcost = cost;
+					bestaxis = axis;
+					bestbin = b;
+				}
+			}
+		}
+
+		// stop splitting if it stops being effective
+		if((bestbin < 0) && (count <= MAX_BVH_LEAF_OBJECTS))
+		{
+			SetLeafNode(node, buildobjects, first, last, depth);
+			buildnodes[inode] = node;
+			return inode;
+		}
+	}
+
+	if(bestbin >= 0)
+	{
+		float scale = float(BVH_SAH_BINS) / (cmax[bestaxis] - cmin[bestaxis]);
+		unsigned int i = first;
+		unsigned int j = last;
+
+		// partition objects; the result only depends on the input order, so the
+		// same objects always produce the same tree
+		while(i < j)
+		{
+			if(min(int((buildobjects[i].centroid[bestaxis] - cmin[bestaxis]) * scale), BVH_SAH_BINS - 1) <= bestbin)
+				i++;
+			else
+				swap(buildobjects[i], buildobjects[--j]);
+		}
+
+		split = i;
+	}
+
+	// fall back to an object median split along the largest centroid extent
+	if((bestbin < 0) || (split == first) || (split == last))
+	{
+		bestaxis = X;
+		if((cmax[Y] - cmin[Y]) > (cmax[bestaxis] - cmin[bestaxis]))
+			bestaxis = Y;
+		if((cmax[Z] - cmin[Z]) > (cmax[bestaxis] - cmin[bestaxis]))
+			bestaxis = Z;
+
+		split = first + count / 2;
+		std::nth_element(buildobjects.begin() + first, buildobjects.begin() + split, buildobjects.begin() + last, CompareCentroid(bestaxis));
+	}
+
+	node.count = 0;
+	node.axis = bestaxis;
+
+	// first child directly follows its parent, only the second child needs to be stored
+	BuildRecursive(progress, buildnodes, buildobjects, first, split, depth + 1);
+	node.index = BuildRecursive(progress, buildnodes, buildobjects, split, last, depth + 1);
+
+	buildnodes[inode] = node;
+
+	return inode;
+}
+
+void BVHTree::SetLeafNode(Node& node, const vector<BuildObject>& buildobjects, unsigned int first, unsigned int last, unsigned int depth)
+{
+	unsigned int count = last - first;
+
+	node.index = indices.size();
+	node.count = count;
+	node.axis = 0;
+
+	for(unsigned int i = first; i < last; i++)
+		indices.push_back(buildobjects[i].index);
+
+	leafNodeCounter++;
+	maxObjectsInLeaf = max(maxObjectsInLeaf, count);
+	maxTreeDepth = max(maxTreeDepth, depth);
+	objectsInTreeCounter += count;
+	treeDepthCounter += depth;
+}
+
+}
@@ -0,0 +1,191 @@
+/*******************************************************************************
+ * bvhtree.h
+ *
+ * This file contains the surface area heuristic bounding volume hierarchy.
+ *
+ * from Persistence of Vision Ray Tracer ('POV-Ray') version 3.7.
+ * Copyright 1991-2003 Persistence of Vision Team
+ * Copyright 2003-2009 Persistence of Vision Raytracer Pty. Ltd.
+ * ---------------------------------------------------------------------------
+ * NOTICE: This source code file is provided so that users may experiment
+ * with enhancements to POV-Ray and to port the software to platforms other
+ * than those supported by the POV-Ray developers. There are strict rules
+ * regarding how you are permitted to use this file. These rules are contained
+ * in the distribution and derivative versions licenses which should have been
+ * provided with this file.
+ *
+ * These licences may be found online, linked from the end-user license
+ * agreement that is located at http://www.povray.org/povlegal.html
+ * ---------------------------------------------------------------------------
+ * POV-Ray is based on the popular DKB raytracer version 2.12.
+ * DKBTrace was originally written by David K. Buck.
+ * DKBTrace Ver 2.0-2.12 were written by David K. Buck & Aaron A. Collins.
+ * ---------------------------------------------------------------------------
+ * $File: //depot/povray/smp/source/backend/support/bvhtree.h $
+ * $Revision: #1 $
+ * $Change: 5401 $
+ * $DateTime: 2011/02/08 21:06:55 $
+ * $Author: clipka $
+ *******************************************************************************/
+
+/*********************************************************************************
+ * NOTICE
+ *
+ * This file is part of a BETA-TEST version of POV-Ray version 3.7. It is not
+ * final code. Use of this source file is governed by both the standard POV-Ray
+ * licences referred to in the copyright header block above this notice, and the
+ * following additional restrictions numbered 1 through 4 below:
+ *
+ *   1. This source file may not be re-distributed without the written permission
+ *      of Persistence of Vision Raytracer Pty. Ltd.
+ *
+ *   2. This notice may not be altered or removed.
+ *   
+ *   3. Binaries generated from this source file by individuals for their own
+ *      personal use may not be re-distributed without the written permission
+ *      of Persistence of Vision Raytracer Pty. Ltd. Such personal-use binaries
+ *      are not required to have a timeout, and thus permission is granted in
+ *      these circumstances only to disable the timeout code contained within
+ *      the beta software.
+ *   
+ *   4. Binaries generated from this source file for use within an organizational
+ *      unit (such as, but not limited to, a company or university) may not be
+ *      distributed beyond the local organizational unit in which they were made,
+ *      unless written permission is obtained from Persistence of Vision Raytracer
+ *      Pty. Ltd. Additionally, the timeout code implemented within the beta may
+ *      not be disabled or otherwise bypassed in any manner.
+ *
+ * The following text is not part of the above conditions and is provided for
+ * informational purposes only.
+ *
+ * The purpose of the no-redistribution clause is to attempt to keep the
+ * circulating copies of the beta source fresh. The only authorized distribution
+ * point for the source code is the POV-Ray website and Perforce server, where
+ * the code will be kept up to date with recent fixes. Additionally the beta
+ * timeout code mentioned above has been a standard part of POV-Ray betas since
+ * version 1.0, and is intended to reduce bug reports from old betas as well as
+ * keep any circulating beta binaries relatively fresh.
+ *
+ * All said, however, the POV-Ray developers are open to any reasonable request
+ * for variations to the above conditions and will consider them on a case-by-case
+ * basis.
+ *
+ * Additionally, the developers request your co-operation in fixing bugs and
+ * generally improving the program. If submitting a bug-fix, please ensure that
+ * you quote the revision number of the file shown above in the copyright header
+ * (see the '$Revision:' field). This ensures that it is possible to determine
+ * what specific copy of the file you are working with. The developers also would
+ * like to make it known that until POV-Ray 3.7 is out of beta, they would prefer
+ * to emphasize the provision of bug fixes over the addition of new features.
+ *
+ * Persons wishing to enhance this source are requested to take the above into
+ * account. It is also strongly suggested that such enhancements are started with
+ * a recent copy of the source.
+ *
+ * The source code page (see http://www.povray.org/beta/source/) sets out the
+ * conditions under which the developers are willing to accept contributions back
+ * into the primary source tree. Please refer to those conditions prior to making
+ * any changes to this source, if you wish to submit those changes for inclusion
+ * with POV-Ray.
+ *
+ *********************************************************************************/
+
+#ifndef POVRAY_BACKEND_BVHTREE_H
+#define POVRAY_BACKEND_BVHTREE_H
+
+#include <vector>
+
+#include "backend/frame.h"
+#include "backend/math/vector.h"
+#include "backend/support/bsptree.h"
+
+namespace pov
+{
+
+/**
+ *	Bounding volume hierarchy built using the surface area heuristic.
+ *	The tree is stored as a single depth-first array of 32 byte nodes, so
+ *	the first child of every inner node directly follows its parent and only
+ *	the second child needs to be referenced explicitly. The node array is
+ *	aligned to the node size so no node straddles a cache line.
+ *	The object, intersection, inside and progress callbacks are shared with
+ *	the BSP tree, thus the same functors can be used to traverse either one.
+ */
+class BVHTree
+{
+	public:
+		BVHTree();
+		virtual ~BVHTree();
+
+		bool operator()(const Ray& ray, BSPTree::Intersect& isect, double maxdist) const;
+		bool operator()(const Vector3d& origin, BSPTree::Inside& inside, bool earlyExit = false) const;
+
+		void build(const BSPTree::Progress& progress, const BSPTree::Objects& objects,
+		           unsigned int& nodes, unsigned int& leafNodes, unsigned int& maxObjects, float& averageObjects,
+		           unsigned int& maxDepth, float& averageDepth);
+
+		void clear();
+	private:
+		struct Node
+		{
+			/// lower left corner of node bounding box
+			float bmin[3];
+			/// inner node: index of second child; leaf node: first entry in object index list
+			unsigned int index;
+			/// upper right corner of node bounding box
+			float bmax[3];
+			/// number of objects in leaf node, zero for inner nodes
+			unsigned short count;
+			/// split axis of inner node, used to order traversal
+			unsigned short axis;
+		};
+
+		struct BuildObject
+		{
+			float bmin[3];
+			float bmax[3];
+			float centroid[3];
+			unsigned int index;
+		};
+
+		struct Bin
+		{
+			float bmin[3];
+			float bmax[3];
+			unsigned int count;
+		};
+
+		/// depth-first array of all nodes, aligned to node size
+		Node *nodes;
+		/// memory block holding node array
+		void *nodeMemory;
+		/// number of nodes in node array
+		unsigned int nodeCount;
+		/// object indices referenced by leaf nodes
+		vector<unsigned int> indices;
+		/// maximum tree depth
+		unsigned int maxTreeDepth;
+		/// leaf node counter
+		unsigned int leafNodeCounter;
+		/// maximum objects in leaf
+		unsigned int maxObjectsInLeaf;
+		/// objects in leaves counter
+		POV_LONG objectsInTreeCounter;
+		/// tree depth counter (sum over all leaves)
+		POV_LONG treeDepthCounter;
+		/// last node progress counter
+		unsigned int lastProgressNodeCounter;
+
+		unsigned int BuildRecursive(const BSPTree::Progress& progress, vector<Node>& buildnodes, vector<BuildObject>& buildobjects,
+		                            unsigned int first, unsigned int last, unsigned int depth);
+		void SetLeafNode(Node& node, const vector<BuildObject>& buildobjects, unsigned int first, unsigned int last, unsigned int depth);
+
+		/// not available
+		BVHTree(const BVHTree&);
+		/// not available
+		BVHTree& operator=(const BVHTree&);
+};
+
+}
+
+#endif // POVRAY_BACKEND_BVHTREE_H
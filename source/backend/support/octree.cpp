@@ -1204,6 +1204,76 @@ bool ot_write_block(OT_BLOCK *bl, void *fd) // must be passed as void * for comp
 	return true;
 }
 
+/*****************************************************************************
+*
+* FUNCTION
+*
+*   ot_write_file_header, ot_write_block_binary, ot_read_block_binary
+*
+* DESCRIPTION
+*
+*   Write the header of a binary cache file, write one block to a binary
+*   cache file, and convert one block read from a binary cache file.
+*   Unlike the text format, the binary format keeps the full precision
+*   of the position and the quality of each block.
+*
+******************************************************************************/
+
+bool ot_write_file_header(OStream *fd, unsigned int scene_hash)
+{
+	OT_FILE_HEADER header;
+
+	memset(&header, 0, sizeof(header));
+	memcpy(header.Magic, OT_FILE_MAGIC, sizeof(header.Magic));
+	header.Version = OT_FILE_VERSION;
+	header.BlockSize = sizeof(OT_FILE_BLOCK);
+	header.SceneHash = scene_hash;
+
+	if(!fd->write(&header, sizeof(header)))
+		return false;
+
+	return true;
+}
+
+bool ot_write_block_binary(OT_BLOCK *bl, void *fd) // must be passed as void * for compatibility
+{
+	OT_FILE_BLOCK fb;
+
+	memset(&fb, 0, sizeof(fb));
+	for(int i = X; i <= Z; i++)
+	{
+		fb.Point[i] = bl->Point[i];
+		fb.S_Normal[i] = bl->S_Normal[i];
+		fb.To_Nearest_Surface[i] = bl->To_Nearest_Surface[i];
+		fb.Illuminance[i] = bl->Illuminance[i];
+	}
+	fb.Harmonic_Mean_Distance = bl->Harmonic_Mean_Distance;
+	fb.Nearest_Distance = bl->Nearest_Distance;
+	fb.Quality = bl->Quality;
+	fb.Bounce_Depth = bl->Bounce_Depth;
+
+	if(!((OStream *)fd)->write(&fb, sizeof(fb)))
+		return false;
+
+	return true;
+}
+
+void ot_read_block_binary(const OT_FILE_BLOCK *fb, OT_BLOCK *bl)
+{
+	for(int i = X; i <= Z; i++)
+	{
+		bl->Point[i] = fb->Point[i];
+		bl->S_Normal[i] = fb->S_Normal[i];
+		bl->To_Nearest_Surface[i] = fb->To_Nearest_Surface[i];
+		bl->Illuminance[i] = fb->Illuminance[i];
+	}
+	bl->Harmonic_Mean_Distance = fb->Harmonic_Mean_Distance;
+	bl->Nearest_Distance = fb->Nearest_Distance;
+	bl->Quality = fb->Quality;
+	bl->Bounce_Depth = fb->Bounce_Depth;
+	bl->next = NULL;
+}
+
 
 /*****************************************************************************
 *
@@ -109,6 +109,11 @@ using namespace pov_base;
 
 #define OT_BIAS 10000000.
 
+// Binary cache file identification; the version must be changed whenever
+// the layout of OT_FILE_HEADER or OT_FILE_BLOCK changes.
+#define OT_FILE_MAGIC   "POVRCA\r\n"
+#define OT_FILE_VERSION 1
+
 
 /*****************************************************************************
 * Global typedefs
@@ -131,6 +136,8 @@ typedef struct ot_id_struct OT_ID;
 typedef struct ot_node_struct OT_NODE;
 typedef struct ot_read_param_struct OT_READ_PARAM;
 typedef struct ot_read_info_struct OT_READ_INFO;
+typedef struct ot_file_header_struct OT_FILE_HEADER;
+typedef struct ot_file_block_struct OT_FILE_BLOCK;
 
 // Each node in the oct-tree has a (possibly null) linked list of these data blocks off it.
 struct ot_block_struct
@@ -180,6 +187,32 @@ struct ot_read_info_struct
 	bool      FirstRadiosityPass;
 };
 
+// Header of a binary cache file, followed by any number of OT_FILE_BLOCKs.
+// The file is written in native byte order; files from other platforms are
+// rejected by the version and size checks.
+struct ot_file_header_struct
+{
+	char         Magic[8];     // OT_FILE_MAGIC
+	unsigned int Version;      // OT_FILE_VERSION
+	unsigned int BlockSize;    // sizeof(OT_FILE_BLOCK)
+	unsigned int SceneHash;    // hash of the scene the samples were taken in
+	unsigned int Reserved;
+};
+
+// One block as stored in a binary cache file.
+struct ot_file_block_struct
+{
+	double        Point[3];
+	float         S_Normal[3];
+	float         To_Nearest_Surface[3];
+	float         Illuminance[3];
+	float         Harmonic_Mean_Distance;
+	float         Nearest_Distance;
+	float         Quality;
+	unsigned char Bounce_Depth;
+	unsigned char Reserved[7];
+};
+
 /*****************************************************************************
 * Global functions
 ******************************************************************************/
@@ -190,6 +223,9 @@ void ot_index_sphere (const Vector3d& point, DBL radius, OT_ID *id);
 void ot_index_box (const Vector3d& min_point, const Vector3d& max_point, OT_ID *id);
 bool ot_save_tree (OT_NODE *root, OStream *fd);
 bool ot_write_block (OT_BLOCK *bl, void * handle);
+bool ot_write_file_header (OStream *fd, unsigned int scene_hash);
+bool ot_write_block_binary (OT_BLOCK *bl, void * handle);
+void ot_read_block_binary (const OT_FILE_BLOCK *fb, OT_BLOCK *bl);
 bool ot_free_tree (OT_NODE **root_ptr);
 bool ot_read_file (OT_NODE **root, IStream * fd, const OT_READ_PARAM* param, OT_READ_INFO* info);
 void ot_newroot (OT_NODE **root_ptr);
@@ -0,0 +1,227 @@
+/*******************************************************************************
+ * workstealingqueue.cpp
+ *
+ * This file contains a work-stealing distributor for work items.
+ *
+ * from Persistence of Vision Ray Tracer ('POV-Ray') version 3.7.
+ * Copyright 1991-2003 Persistence of Vision Team
+ * Copyright 2003-2009 Persistence of Vision Raytracer Pty. Ltd.
+ * ---------------------------------------------------------------------------
+ * NOTICE: This source code file is provided so that users may experiment
+ * with enhancements to POV-Ray and to port the software to platforms other
+ * than those supported by the POV-Ray developers. There are strict rules
+ * regarding how you are permitted to use this file. These rules are contained
+ * in the distribution and derivative versions licenses which should have been
+ * provided with this file.
+ *
+ * These licences may be found online, linked from the end-user license
+ * agreement that is located at http://www.povray.org/povlegal.html
+ * ---------------------------------------------------------------------------
+ * POV-Ray is based on the popular DKB raytracer version 2.12.
+ * DKBTrace was originally written by David K. Buck.
+ * DKBTrace Ver 2.0-2.12 were written by David K. Buck & Aaron A. Collins.
+ * ---------------------------------------------------------------------------
+ * $File: //depot/povray/smp/source/backend/support/workstealingqueue.cpp $
+ * $Revision: #1 $
+ * $Change: 5401 $
+ * $DateTime: 2011/02/08 21:06:55 $
+ * $Author: clipka $
+ *******************************************************************************/
+
+/*********************************************************************************
+ * NOTICE
+ *
+ * This file is part of a BETA-TEST version of POV-Ray version 3.7. It is not
+ * final code. Use of this source file is governed by both the standard POV-Ray
+ * licences referred to in the copyright header block above this notice, and the
+ * following additional restrictions numbered 1 through 4 below:
+ *
+ *   1. This source file may not be re-distributed without the written permission
+ *      of Persistence of Vision Raytracer Pty. Ltd.
+ *
+ *   2. This notice may not be altered or removed.
+ *   
+ *   3. Binaries generated from this source file by individuals for their own
+ *      personal use may not be re-distributed without the written permission
+ *      of Persistence of Vision Raytracer Pty. Ltd. Such personal-use binaries
+ *      are not required to have a timeout, and thus permission is granted in
+ *      these circumstances only to disable the timeout code contained within
+ *      the beta software.
+ *   
+ *   4. Binaries generated from this source file for use within an organizational
+ *      unit (such as, but not limited to, a company or university) may not be
+ *      distributed beyond the local organizational unit in which they were made,
+ *      unless written permission is obtained from Persistence of Vision Raytracer
+ *      Pty. Ltd. Additionally, the timeout code implemented within the beta may
+ *      not be disabled or otherwise bypassed in any manner.
+ *
+ * The following text is not part of the above conditions and is provided for
+ * informational purposes only.
+ *
+ * The purpose of the no-redistribution clause is to attempt to keep the
+ * circulating copies of the beta source fresh. The only authorized distribution
+ * point for the source code is the POV-Ray website and Perforce server, where
+ * the code will be kept up to date with recent fixes. Additionally the beta
+ * timeout code mentioned above has been a standard part of POV-Ray betas since
+ * version 1.0, and is intended to reduce bug reports from old betas as well as
+ * keep any circulating beta binaries relatively fresh.
+ *
+ * All said, however, the POV-Ray developers are open to any reasonable request
+ * for variations to the above conditions and will consider them on a case-by-case
+ * basis.
+ *
+ * Additionally, the developers request your co-operation in fixing bugs and
+ * generally improving the program. If submitting a bug-fix, please ensure that
+ * you quote the revision number of the file shown above in the copyright header
+ * (see the '$Revision:' field). This ensures that it is possible to determine
+ * what specific copy of the file you are working with. The developers also would
+ * like to make it known that until POV-Ray 3.7 is out of beta, they would prefer
+ * to emphasize the provision of bug fixes over the addition of new features.
+ *
+ * Persons wishing to enhance this source are requested to take the above into
+ * account. It is also strongly suggested that such enhancements are started with
+ * a recent copy of the source.
+ *
+ * The source code page (see http://www.povray.org/beta/source/) sets out the
+ * conditions under which the developers are willing to accept contributions back
+ * into the primary source tree. Please refer to those conditions prior to making
+ * any changes to this source, if you wish to submit those changes for inclusion
+ * with POV-Ray.
+ *
+ *********************************************************************************/
+
+#include <boost/thread.hpp>
+
+// frame.h must always be the first POV file included (pulls in platform config)
+#include "backend/frame.h"
+#include "backend/support/workstealingqueue.h"
+
+// this must be the last file included
+#include "base/povdebug.h"
+
+namespace pov
+{
+
+WorkStealingQueue::WorkStealingQueue() :
+	attachedWorkers(0),
+	appendedItems(0)
+{
+}
+
+WorkStealingQueue::~WorkStealingQueue()
+{
+	for(vector<Worker *>::iterator i(workers.begin()); i != workers.end(); i++)
+		delete *i;
+}
+
+void WorkStealingQueue::Reset(unsigned int count)
+{
+	ClosePass();
+
+	count = max(count, 1u);
+
+	while(workers.size() > count)
+	{
+		delete workers.back();
+		workers.pop_back();
+	}
+	while(workers.size() < count)
+		workers.push_back(new Worker());
+
+	if(statistics.size() < count)
+		statistics.resize(count);
+
+	for(vector<Worker *>::iterator i(workers.begin()); i != workers.end(); i++)
+	{
+		(*i)->items.clear();
+		(*i)->finishTime = -1;
+	}
+
+	attachedWorkers = 0;
+	appendedItems = 0;
+	timer.Reset();
+}
+
+void WorkStealingQueue::Append(unsigned int worker, unsigned int item)
+{
+	workers[worker]->items.push_back(item);
+	appendedItems++;
+}
+
+void WorkStealingQueue::Append(unsigned int item)
+{
+	Append(appendedItems % workers.size(), item);
+}
+
+unsigned int WorkStealingQueue::AttachWorker()
+{
+	boost::mutex::scoped_lock lock(attachMutex);
+
+	return (attachedWorkers++) % workers.size();
+}
+
+bool WorkStealingQueue::Take(unsigned int worker, unsigned int& item)
+{
+	Worker *self = workers[worker];
+
+	// statistics of a worker are only ever changed by the worker itself
+	{
+		boost::mutex::scoped_lock lock(self->dequeMutex);
+
+		if(self->items.empty() == false)
+		{
+			item = self->items.front();
+			self->items.pop_front();
+			statistics[worker].items++;
+			return true;
+		}
+	}
+
+	// steal from the back of the other deques, starting with the next worker
+	for(size_t n = 1; n < workers.size(); n++)
+	{
+		Worker *victim = workers[(worker + n) % workers.size()];
+		boost::mutex::scoped_lock lock(victim->dequeMutex);
+
+		if(victim->items.empty() == false)
+		{
+			item = victim->items.back();
+			victim->items.pop_back();
+			statistics[worker].items++;
+			statistics[worker].steals++;
+			return true;
+		}
+	}
+
+	if(self->finishTime < 0)
+		self->finishTime = timer.ElapsedRealTime();
+
+	return false;
+}
+
+void WorkStealingQueue::GetStatistics(vector<WorkerStatistics>& stats)
+{
+	ClosePass();
+
+	stats = statistics;
+}
+
+void WorkStealingQueue::ClosePass()
+{
+	POV_LONG passEnd = -1;
+
+	for(vector<Worker *>::iterator i(workers.begin()); i != workers.end(); i++)
+		passEnd = max(passEnd, (*i)->finishTime);
+
+	// workers that did not take part in the pass are not counted as idle
+	for(size_t i = 0; i < workers.size(); i++)
+	{
+		if(workers[i]->finishTime >= 0)
+		{
+			statistics[i].idleTime += passEnd - workers[i]->finishTime;
+			workers[i]->finishTime = -1;
+		}
+	}
+}
+
+}
@@ -0,0 +1,192 @@
+/*******************************************************************************
+ * workstealingqueue.h
+ *
+ * This file contains a work-stealing distributor for work items.
+ *
+ * from Persistence of Vision Ray Tracer ('POV-Ray') version 3.7.
+ * Copyright 1991-2003 Persistence of Vision Team
+ * Copyright 2003-2009 Persistence of Vision Raytracer Pty. Ltd.
+ * ---------------------------------------------------------------------------
+ * NOTICE: This source code file is provided so that users may experiment
+ * with enhancements to POV-Ray and to port the software to platforms other
+ * than those supported by the POV-Ray developers. There are strict rules
+ * regarding how you are permitted to use this file. These rules are contained
+ * in the distribution and derivative versions licenses which should have been
+ * provided with this file.
+ *
+ * These licences may be found online, linked from the end-user license
+ * agreement that is located at http://www.povray.org/povlegal.html
+ * ---------------------------------------------------------------------------
+ * POV-Ray is based on the popular DKB raytracer version 2.12.
+ * DKBTrace was originally written by David K. Buck.
+ * DKBTrace Ver 2.0-2.12 were written by David K. Buck & Aaron A. Collins.
+ * ---------------------------------------------------------------------------
+ * $File: //depot/povray/smp/source/backend/support/workstealingqueue.h $
+ * $Revision: #1 $
+ * $Change: 5401 $
+ * $DateTime: 2011/02/08 21:06:55 $
+ * $Author: clipka $
+ *******************************************************************************/
+
+/*********************************************************************************
+ * NOTICE
+ *
+ * This file is part of a BETA-TEST version of POV-Ray version 3.7. It is not
+ * final code. Use of this source file is governed by both the standard POV-Ray
+ * licences referred to in the copyright header block above this notice, and the
+ * following additional restrictions numbered 1 through 4 below:
+ *
+ *   1. This source file may not be re-distributed without the written permission
+ *      of Persistence of Vision Raytracer Pty. Ltd.
+ *
+ *   2. This notice may not be altered or removed.
+ *   
+ *   3. Binaries generated from this source file by individuals for their own
+ *      personal use may not be re-distributed without the written permission
+ *      of Persistence of Vision Raytracer Pty. Ltd. Such personal-use binaries
+ *      are not required to have a timeout, and thus permission is granted in
+ *      these circumstances only to disable the timeout code contained within
+ *      the beta software.
+ *   
+ *   4. Binaries generated from this source file for use within an organizational
+ *      unit (such as, but not limited to, a company or university) may not be
+ *      distributed beyond the local organizational unit in which they were made,
+ *      unless written permission is obtained from Persistence of Vision Raytracer
+ *      Pty. Ltd. Additionally, the timeout code implemented within the beta may
+ *      not be disabled or otherwise bypassed in any manner.
+ *
+ * The following text is not part of the above conditions and is provided for
+ * informational purposes only.
+ *
+ * The purpose of the no-redistribution clause is to attempt to keep the
+ * circulating copies of the beta source fresh. The only authorized distribution
+ * point for the source code is the POV-Ray website and Perforce server, where
+ * the code will be kept up to date with recent fixes. Additionally the beta
+ * timeout code mentioned above has been a standard part of POV-Ray betas since
+ * version 1.0, and is intended to reduce bug reports from old betas as well as
+ * keep any circulating beta binaries relatively fresh.
+ *
+ * All said, however, the POV-Ray developers are open to any reasonable request
+ * for variations to the above conditions and will consider them on a case-by-case
+ * basis.
+ *
+ * Additionally, the developers request your co-operation in fixing bugs and
+ * generally improving the program. If submitting a bug-fix, please ensure that
+ * you quote the revision number of the file shown above in the copyright header
+ * (see the '$Revision:' field). This ensures that it is possible to determine
+ * what specific copy of the file you are working with. The developers also would
+ * like to make it known that until POV-Ray 3.7 is out of beta, they would prefer
+ * to emphasize the provision of bug fixes over the addition of new features.
+ *
+ * Persons wishing to enhance this source are requested to take the above into
+ * account. It is also strongly suggested that such enhancements are started with
+ * a recent copy of the source.
+ *
+ * The source code page (see http://www.povray.org/beta/source/) sets out the
+ * conditions under which the developers are willing to accept contributions back
+ * into the primary source tree. Please refer to those conditions prior to making
+ * any changes to this source, if you wish to submit those changes for inclusion
+ * with POV-Ray.
+ *
+ *********************************************************************************/
+
+#ifndef POVRAY_BACKEND_WORKSTEALINGQUEUE_H
+#define POVRAY_BACKEND_WORKSTEALINGQUEUE_H
+
+#include <deque>
+#include <vector>
+
+#include <boost/thread.hpp>
+
+#include "base/timer.h"
+#include "backend/frame.h"
+
+namespace pov
+{
+
+/**
+ *	Distributes numbered work items to a fixed number of workers, such as
+ *	the render tasks of one pass. Every worker has its own deque of items
+ *	and takes items from its front. A worker that has run out of items
+ *	steals from the back of another worker's deque, so workers only
+ *	contend for a lock while stealing, and no worker goes idle while
+ *	another one still has items queued.
+ *
+ *	Items have to be appended before the first item of a pass is taken,
+ *	and Reset must not be called while items are being taken, which holds
+ *	when passes are separated by a task queue sync.
+ */
+class WorkStealingQueue
+{
+	public:
+		struct WorkerStatistics
+		{
+			/// items taken by the worker
+			POV_LONG items;
+			/// items the worker stole from other workers
+			POV_LONG steals;
+			/// milliseconds the worker had no items left while others were still busy
+			POV_LONG idleTime;
+
+			WorkerStatistics() : items(0), steals(0), idleTime(0) { }
+		};
+
+		WorkStealingQueue();
+		~WorkStealingQueue();
+
+		/// start a new pass with empty deques for the given number of workers
+		void Reset(unsigned int workers);
+		/// append an item to the back of a worker's deque
+		void Append(unsigned int worker, unsigned int item);
+		/// append an item, distributing consecutive items round-robin over the workers
+		void Append(unsigned int item);
+
+		/// assign a worker to the calling task for the current pass
+		unsigned int AttachWorker();
+
+		/// take the next item for a worker; returns false once no worker has items left
+		bool Take(unsigned int worker, unsigned int& item);
+
+		/// number of workers of the current pass
+		unsigned int GetWorkerCount() const { return workers.size(); }
+
+		/// get per-worker statistics accumulated over all passes so far
+		void GetStatistics(vector<WorkerStatistics>& stats);
+	private:
+		struct Worker
+		{
+			/// deque mutex
+			boost::mutex dequeMutex;
+			/// items not taken yet
+			std::deque<unsigned int> items;
+			/// time the worker ran out of items in the current pass, or -1
+			POV_LONG finishTime;
+
+			Worker() : finishTime(-1) { }
+		};
+
+		/// workers of the current pass
+		vector<Worker *> workers;
+		/// statistics of all workers, indexed by worker
+		vector<WorkerStatistics> statistics;
+		/// attach mutex
+		boost::mutex attachMutex;
+		/// number of workers attached in the current pass
+		unsigned int attachedWorkers;
+		/// number of items appended in the current pass
+		unsigned int appendedItems;
+		/// pass timer
+		Timer timer;
+
+		void ClosePass();
+
+		/// not available
+		WorkStealingQueue(const WorkStealingQueue&);
+
+		/// not available
+		WorkStealingQueue& operator=(const WorkStealingQueue&);
+};
+
+}
+
+#endif // POVRAY_BACKEND_WORKSTEALINGQUEUE_H
@@ -115,6 +115,10 @@
 
 #include <algorithm>
 
+#if SYS_SIMD_NOISE_DISPATCH && !USE_FASTER_NOISE
+	#include <immintrin.h>
+#endif
+
 // this must be the last file included
 #include "base/povdebug.h"
 
@@ -132,6 +136,9 @@ static void InitTextureTable (void);
 static TEXTURE *Copy_Materials (TEXTURE *Old);
 static void InitSolidNoise(void);
 static DBL SolidNoise(const VECTOR P);
+#if SYS_SIMD_NOISE_DISPATCH && !USE_FASTER_NOISE
+static void InitNoiseCornerTable(void);
+#endif
 
 /*****************************************************************************
 * Local preprocessor defines
@@ -174,6 +181,10 @@ const int SINTABSIZE = 1000;
 
 static DBL *sintab; // GLOBAL VARIABLE
 
+#if SYS_SIMD_NOISE_DISPATCH && !USE_FASTER_NOISE
+static DBL NoiseCornerTable[264][4]; // GLOBAL VARIABLE
+#endif
+
 #ifdef DYNAMIC_HASHTABLE
 unsigned short *hashTable; // GLOBAL VARIABLE
 #else
@@ -249,7 +260,7 @@ namespace pov
 		#define FASTER_NOISE_INIT()
 	#endif
 #else
-#if !defined(USE_AVX_FMA4_FOR_NOISE)
+#if !NOISE_DISPATCH
 	#define OriNoise Noise
 	#define OriDNoise DNoise
 #endif
@@ -257,6 +268,11 @@ namespace pov
 	#define FASTER_NOISE_INIT()
 #endif
 
+#if !NOISE_DISPATCH
+	#define OriTurbulence Turbulence
+	#define OriDTurbulence DTurbulence
+#endif
+
 /*****************************************************************************
 *
 * FUNCTION
@@ -281,9 +297,6 @@ namespace pov
 
 void Initialize_Noise()
 {
-#if defined(USE_AVX_FMA4_FOR_NOISE)
-	Initialise_NoiseDispatch();
-#endif
 	InitTextureTable();
 
 	/* are - initialize Perlin style noise function */
@@ -297,6 +310,14 @@ void Initialize_Noise()
 
 	for(int i = 0 ; i < SINTABSIZE ; i++)
 		sintab[i] = sin((DBL)i / SINTABSIZE * TWO_M_PI);
+
+#if SYS_SIMD_NOISE_DISPATCH && !USE_FASTER_NOISE
+	InitNoiseCornerTable();
+#endif
+#if NOISE_DISPATCH
+	// the variants are checked against the scalar code, so the tables must be ready
+	Initialise_NoiseDispatch();
+#endif
 }
 
 void Initialize_Waves(vector<double>& waveFrequencies, vector<Vector3d>& waveSources, unsigned int numberOfWaves)
@@ -944,7 +965,7 @@ SolidDNoise(const VECTOR P, VECTOR D)
 *
 ******************************************************************************/
 
-DBL Turbulence(const VECTOR EPoint, const TURB *Turb, int noise_generator)
+DBL OriTurbulence(const VECTOR EPoint, const TURB *Turb, int noise_generator)
 {
 	int i;
 	DBL Lambda, Omega, l, o, value;
@@ -1010,7 +1031,7 @@ DBL Turbulence(const VECTOR EPoint, const TURB *Turb, int noise_generator)
 ******************************************************************************/
 
 
-void DTurbulence(VECTOR result, const VECTOR EPoint, const TURB *Turb)
+void OriDTurbulence(VECTOR result, const VECTOR EPoint, const TURB *Turb)
 {
 	DBL Omega, Lambda;
 	int i;
@@ -1743,15 +1764,99 @@ int Test_Opacity(TEXTURE *Texture)
 }
 
 
-#if defined(USE_AVX_FMA4_FOR_NOISE)
+#if NOISE_DISPATCH
 
-/********************************************************************************************/
-/* AMD Specific optimizations: Its found that more than 50% of the time is spent in         */
-/* Noise and DNoise. These functions have been optimized using AVX and FMA4 instructions    */
-/*                                                                                          */
-/********************************************************************************************/
 DBL (*Noise) (const VECTOR EPoint, int noise_generator);
 void (*DNoise) (VECTOR result, const VECTOR EPoint);
+DBL (*Turbulence) (const VECTOR EPoint, const TURB *Turb, int noise_generator);
+void (*DTurbulence) (VECTOR result, const VECTOR EPoint, const TURB *Turb);
+
+static const char *Noise_Kernel_Name = "scalar";
+
+/*****************************************************************************
+*
+* FUNCTION
+*
+*   Noise_Kernel_Agrees
+*
+* INPUT
+*
+*   Kernel -- noise variant to check
+*
+* OUTPUT
+*
+* RETURNS
+*
+*   true if the variant matches OriNoise, OriDNoise, OriTurbulence and
+*   OriDTurbulence on a set of sample points
+*
+* AUTHOR
+*
+*   -
+*
+* DESCRIPTION
+*
+*   The sample points cover negative coordinates, lattice points and cells far
+*   from the origin, and the turbulence is checked for 1 to 10 octaves. A
+*   variant differing by more than NOISE_KERNEL_TOLERANCE anywhere is
+*   rejected. Must be called while Noise and DNoise are the scalar code, as
+*   OriTurbulence and OriDTurbulence use them.
+*
+* CHANGES
+*
+*   -
+*
+******************************************************************************/
+
+static bool Noise_Kernel_Agrees(const NOISE_KERNEL& Kernel)
+{
+	VECTOR P, D, DRef;
+	TURB Turb;
+
+	for(int i = 0; i < 1024; i++)
+	{
+		P[X] = (i - 512) * 0.6180339887;
+		P[Y] = ((i % 97) - 48) * 1.4142135624 + i * 0.001;
+		P[Z] = (((i * 37) % 1024) - 512) * 2.7182818285;
+		if((i & 7) == 0)
+		{
+			P[X] = floor(P[X]);
+			P[Y] = floor(P[Y]);
+		}
+
+		for(int generator = 1; generator <= 3; generator++)
+		{
+			if(fabs(Kernel.Noise(P, generator) - OriNoise(P, generator)) > NOISE_KERNEL_TOLERANCE)
+				return false;
+		}
+
+		Kernel.DNoise(D, P);
+		OriDNoise(DRef, P);
+		if((fabs(D[X] - DRef[X]) > NOISE_KERNEL_TOLERANCE) ||
+		   (fabs(D[Y] - DRef[Y]) > NOISE_KERNEL_TOLERANCE) ||
+		   (fabs(D[Z] - DRef[Z]) > NOISE_KERNEL_TOLERANCE))
+			return false;
+
+		Turb.Octaves = 1 + i % 10;
+		Turb.Lambda = ((i & 1) ? 2.0 : 2.7);
+		Turb.Omega = ((i & 2) ? 0.5 : 0.65);
+
+		for(int generator = 1; generator <= 3; generator++)
+		{
+			if(fabs(Kernel.Turbulence(P, &Turb, generator) - OriTurbulence(P, &Turb, generator)) > NOISE_KERNEL_TOLERANCE)
+				return false;
+		}
+
+		Kernel.DTurbulence(D, P, &Turb);
+		OriDTurbulence(DRef, P, &Turb);
+		if((fabs(D[X] - DRef[X]) > NOISE_KERNEL_TOLERANCE) ||
+		   (fabs(D[Y] - DRef[Y]) > NOISE_KERNEL_TOLERANCE) ||
+		   (fabs(D[Z] - DRef[Z]) > NOISE_KERNEL_TOLERANCE))
+			return false;
+	}
+
+	return true;
+}
 
 /*****************************************************************************
 *
@@ -1777,6 +1882,9 @@ void (*DNoise) (VECTOR result, const VECTOR EPoint);
 *
 * DESCRIPTION
 *
+*   Picks the first variant listed by Get_Noise_Kernels that agrees with the
+*   scalar code, falling back to OriNoise and OriDNoise.
+*
 * CHANGES
 *
 *
@@ -1788,22 +1896,41 @@ void Initialise_NoiseDispatch()
 
 	if(!cpu_detected)
 	{
-			if(CPU_FMA4_DETECT())
-			{
-				Noise = AVX_FMA4_Noise;
-				DNoise = AVX_FMA4_DNoise;
-			}
-			else
+		NOISE_KERNEL kernels[4];
+		unsigned int count = Get_Noise_Kernels(kernels, 4);
+
+		Noise = OriNoise;
+		DNoise = OriDNoise;
+		Turbulence = OriTurbulence;
+		DTurbulence = OriDTurbulence;
+		Noise_Kernel_Name = "scalar";
+
+		for(unsigned int i = 0; i < count; i++)
+		{
+			if((kernels[i].Noise == OriNoise) || Noise_Kernel_Agrees(kernels[i]))
 			{
-				Noise = OriNoise;
-				DNoise = OriDNoise;
+				Noise = kernels[i].Noise;
+				DNoise = kernels[i].DNoise;
+				Turbulence = kernels[i].Turbulence;
+				DTurbulence = kernels[i].DTurbulence;
+				Noise_Kernel_Name = kernels[i].Name;
+				break;
 			}
+		}
 
-			cpu_detected = true;
+		cpu_detected = true;
 	}
 }
 
+#endif
+
+#if defined(USE_AVX_FMA4_FOR_NOISE)
 
+/********************************************************************************************/
+/* AMD Specific optimizations: Its found that more than 50% of the time is spent in         */
+/* Noise and DNoise. These functions have been optimized using AVX and FMA4 instructions    */
+/*                                                                                          */
+/********************************************************************************************/
 
 /*****************************************************************************
 *
@@ -2432,5 +2559,922 @@ void AVX_FMA4_DNoise(VECTOR result, const VECTOR EPoint)
 
 #endif
 
+#if SYS_SIMD_NOISE_DISPATCH && !USE_FASTER_NOISE
+
+/*****************************************************************************/
+/* AVX2/FMA3 and AVX-512 variants of Noise and DNoise. The lattice setup is  */
+/* done for x, y and z at once; the hashing stays scalar. Each corner then   */
+/* contributes the dot product of its RTable entries with (1, x, y, z),      */
+/* read from NoiseCornerTable where the four entries are adjacent.           */
+/*****************************************************************************/
+
+#define NOISE_AVX2     __attribute__((target("avx2,fma")))
+#define NOISE_AVX512   __attribute__((target("avx512f,avx2,fma")))
+#define NOISE_INLINE   inline __attribute__((always_inline))
+
+/*
+ * Offsets subtracted from (1, x_ix, y_iy, z_iz) to get the lattice offsets of
+ * each corner, in the order ixiy, jxiy, ixjy, jxjy at iz followed by the same
+ * four at iz + 1.
+ */
+
+static const DBL NoiseCornerOffset[8][4] =
+{
+	{ 0.0, 0.0, 0.0, 0.0 }, { 0.0, 1.0, 0.0, 0.0 }, { 0.0, 0.0, 1.0, 0.0 }, { 0.0, 1.0, 1.0, 0.0 },
+	{ 0.0, 0.0, 0.0, 1.0 }, { 0.0, 1.0, 0.0, 1.0 }, { 0.0, 0.0, 1.0, 1.0 }, { 0.0, 1.0, 1.0, 1.0 }
+};
+
+/*****************************************************************************
+*
+* FUNCTION
+*
+*   InitNoiseCornerTable
+*
+* INPUT
+*
+* OUTPUT
+*
+* RETURNS
+*
+* AUTHOR
+*
+*   -
+*
+* DESCRIPTION
+*
+*   Copies the RTable entries 1, 2, 4 and 6 of every table index together.
+*   Entry i + 4 and i + 8 give the Y and Z components DNoise reads from mp + 8
+*   and mp + 16.
+*
+* CHANGES
+*
+*   -
+*
+******************************************************************************/
+
+static void InitNoiseCornerTable()
+{
+	for(int i = 0; i < 264; i++)
+	{
+		NoiseCornerTable[i][0] = RTable[i * 2 + 1];
+		NoiseCornerTable[i][1] = RTable[i * 2 + 2];
+		NoiseCornerTable[i][2] = RTable[i * 2 + 4];
+		NoiseCornerTable[i][3] = RTable[i * 2 + 6];
+	}
+}
+
+/*****************************************************************************
+*
+* FUNCTION
+*
+*   Noise_Range
+*
+* INPUT
+*
+*   sum             -- sum of the corner contributions
+*   noise_generator -- 1 or 2
+*
+* OUTPUT
+*
+* RETURNS
+*
+*   DBL noise value clamped to 0..1
+*
+* AUTHOR
+*
+*   -
+*
+* DESCRIPTION
+*
+*   Same mapping as at the end of OriNoise (see there for the range details).
+*
+* CHANGES
+*
+*   -
+*
+******************************************************************************/
+
+static inline DBL Noise_Range(DBL sum, int noise_generator)
+{
+	if(noise_generator==2)
+	{
+		sum += 1.05242;
+		sum *= 0.48985582;
+	}
+	else
+		sum = sum + 0.5;
+
+	if (sum < 0.0)
+		sum = 0.0;
+	if (sum > 1.0)
+		sum = 1.0;
+
+	return (sum);
+}
+
+/*****************************************************************************
+*
+* FUNCTION
+*
+*   AVX2_Noise_Cell
+*
+* INPUT
+*
+*   EPoint -- 3-D point at which noise is evaluated
+*
+* OUTPUT
+*
+*   index -- NoiseCornerTable index of each corner
+*   base  -- (1, x_ix, y_iy, z_iz)
+*   s_lo  -- weights txty*tz, sxty*tz, txsy*tz, sxsy*tz
+*   s_hi  -- weights txty*sz, sxty*sz, txsy*sz, sxsy*sz
+*
+* RETURNS
+*
+* AUTHOR
+*
+*   -
+*
+* DESCRIPTION
+*
+*   The lattice setup of OriNoise, including the JB range fix, for all three
+*   coordinates at once and without a branch on their sign.
+*
+* CHANGES
+*
+*   -
+*
+******************************************************************************/
+
+NOISE_AVX2
+static NOISE_INLINE void AVX2_Noise_Cell(const VECTOR EPoint, int *index, __m256d& base, __m256d& s_lo, __m256d& s_hi)
+{
+	int ix, iy, iz;
+	int ixiy_hash, ixjy_hash, jxiy_hash, jxjy_hash;
+
+	__m256d p = _mm256_insertf128_pd(_mm256_castpd128_pd256(_mm_loadu_pd(EPoint)), _mm_load_sd(EPoint + 2), 1);
+	__m256d pos = _mm256_cvtepi32_pd(_mm256_cvttpd_epi32(p));
+	__m256d neg = _mm256_cvtepi32_pd(_mm256_cvttpd_epi32(_mm256_sub_pd(p, _mm256_set1_pd(1-EPSILON))));
+	__m256d tmp = _mm256_blendv_pd(neg, pos, _mm256_cmp_pd(p, _mm256_setzero_pd(), _CMP_GE_OQ));
+	__m256d ixyz = _mm256_sub_pd(p, tmp);
+	__m128i i = _mm_and_si128(_mm_sub_epi32(_mm256_cvttpd_epi32(tmp), _mm_setr_epi32(MINX, MINY, MINZ, 0)), _mm_set1_epi32(0xFFF));
+
+	ix = _mm_cvtsi128_si32(i);
+	iy = _mm_extract_epi32(i, 1);
+	iz = _mm_extract_epi32(i, 2);
+
+	// SCURVE of x_ix, y_iy and z_iz and their complements
+	__m256d s = _mm256_mul_pd(_mm256_mul_pd(ixyz, ixyz), _mm256_fnmadd_pd(_mm256_set1_pd(2.0), ixyz, _mm256_set1_pd(3.0)));
+	__m256d t = _mm256_sub_pd(_mm256_set1_pd(1.0), s);
+	__m256d tsxz = _mm256_unpacklo_pd(t, s);  // tx sx tz sz
+	__m256d tsy = _mm256_unpackhi_pd(t, s);   // ty sy
+	__m256d w = _mm256_mul_pd(_mm256_permute4x64_pd(tsxz, 0x44), _mm256_permute4x64_pd(tsy, 0x50));
+
+	s_lo = _mm256_mul_pd(w, _mm256_permute4x64_pd(tsxz, 0xAA));
+	s_hi = _mm256_mul_pd(w, _mm256_permute4x64_pd(tsxz, 0xFF));
+	base = _mm256_blend_pd(_mm256_permute4x64_pd(ixyz, 0x90), _mm256_set1_pd(1.0), 1);
+
+	ixiy_hash = Hash2d(ix,     iy);
+	jxiy_hash = Hash2d(ix + 1, iy);
+	ixjy_hash = Hash2d(ix,     iy + 1);
+	jxjy_hash = Hash2d(ix + 1, iy + 1);
+
+	index[0] = Hash1dRTableIndex(ixiy_hash, iz) / 2;
+	index[1] = Hash1dRTableIndex(jxiy_hash, iz) / 2;
+	index[2] = Hash1dRTableIndex(ixjy_hash, iz) / 2;
+	index[3] = Hash1dRTableIndex(jxjy_hash, iz) / 2;
+	index[4] = Hash1dRTableIndex(ixiy_hash, iz + 1) / 2;
+	index[5] = Hash1dRTableIndex(jxiy_hash, iz + 1) / 2;
+	index[6] = Hash1dRTableIndex(ixjy_hash, iz + 1) / 2;
+	index[7] = Hash1dRTableIndex(jxjy_hash, iz + 1) / 2;
+}
+
+// Dot products of four corners starting at corner k with their lattice offsets.
+NOISE_AVX2
+static NOISE_INLINE __m256d AVX2_Noise_Dots(const int *index, int component, __m256d base, int k)
+{
+	__m256d d0 = _mm256_mul_pd(_mm256_loadu_pd(NoiseCornerTable[index[k]     + component]), _mm256_sub_pd(base, _mm256_loadu_pd(NoiseCornerOffset[k])));
+	__m256d d1 = _mm256_mul_pd(_mm256_loadu_pd(NoiseCornerTable[index[k + 1] + component]), _mm256_sub_pd(base, _mm256_loadu_pd(NoiseCornerOffset[k + 1])));
+	__m256d d2 = _mm256_mul_pd(_mm256_loadu_pd(NoiseCornerTable[index[k + 2] + component]), _mm256_sub_pd(base, _mm256_loadu_pd(NoiseCornerOffset[k + 2])));
+	__m256d d3 = _mm256_mul_pd(_mm256_loadu_pd(NoiseCornerTable[index[k + 3] + component]), _mm256_sub_pd(base, _mm256_loadu_pd(NoiseCornerOffset[k + 3])));
+	__m256d d01 = _mm256_hadd_pd(d0, d1);
+	__m256d d23 = _mm256_hadd_pd(d2, d3);
+
+	return _mm256_add_pd(_mm256_permute2f128_pd(d01, d23, 0x20), _mm256_permute2f128_pd(d01, d23, 0x31));
+}
+
+NOISE_AVX2
+static NOISE_INLINE DBL AVX2_Noise_Sum(__m256d v)
+{
+	__m128d sum = _mm_add_pd(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1));
+
+	return _mm_cvtsd_f64(_mm_add_sd(sum, _mm_unpackhi_pd(sum, sum)));
+}
+
+/*****************************************************************************
+*
+* FUNCTION
+*
+*   AVX2_FMA3_Noise
+*
+* INPUT
+*
+*   EPoint -- 3-D point at which noise is evaluated
+*
+* OUTPUT
+*
+* RETURNS
+*
+*   DBL noise value
+*
+* AUTHOR
+*
+*   -
+*
+* DESCRIPTION
+*
+*   OriNoise using AVX2 and FMA3.
+*
+* CHANGES
+*
+*   -
+*
+******************************************************************************/
+
+NOISE_AVX2
+DBL AVX2_FMA3_Noise(const VECTOR EPoint, int noise_generator)
+{
+	int index[8];
+	__m256d base, s_lo, s_hi, sum;
+
+	if (noise_generator==3)
+		return OriNoise(EPoint, noise_generator);
+
+	AVX2_Noise_Cell(EPoint, index, base, s_lo, s_hi);
+
+	sum = _mm256_mul_pd(s_lo, AVX2_Noise_Dots(index, 0, base, 0));
+	sum = _mm256_fmadd_pd(s_hi, AVX2_Noise_Dots(index, 0, base, 4), sum);
+
+	return Noise_Range(AVX2_Noise_Sum(sum), noise_generator);
+}
+
+/*****************************************************************************
+*
+* FUNCTION
+*
+*   AVX2_FMA3_DNoise
+*
+* INPUT
+*
+*   EPoint -- 3-D point at which noise is evaluated
+*
+* OUTPUT
+*
+*   VECTOR result
+*
+* RETURNS
+*
+* AUTHOR
+*
+*   -
+*
+* DESCRIPTION
+*
+*   OriDNoise using AVX2 and FMA3.
+*
+* CHANGES
+*
+*   -
+*
+******************************************************************************/
+
+NOISE_AVX2
+void AVX2_FMA3_DNoise(VECTOR result, const VECTOR EPoint)
+{
+	int index[8];
+	__m256d base, s_lo, s_hi, sum;
+
+	AVX2_Noise_Cell(EPoint, index, base, s_lo, s_hi);
+
+	for(int i = X; i <= Z; i++)
+	{
+		sum = _mm256_mul_pd(s_lo, AVX2_Noise_Dots(index, i * 4, base, 0));
+		sum = _mm256_fmadd_pd(s_hi, AVX2_Noise_Dots(index, i * 4, base, 4), sum);
+		result[i] = AVX2_Noise_Sum(sum);
+	}
+}
+
+NOISE_AVX512
+static NOISE_INLINE __m512d AVX512_Join(__m256d lo, __m256d hi)
+{
+	return _mm512_insertf64x4(_mm512_castpd256_pd512(lo), hi, 1);
+}
+
+NOISE_AVX512
+static NOISE_INLINE DBL AVX512_Noise_Sum(__m512d v)
+{
+	return AVX2_Noise_Sum(_mm256_add_pd(_mm512_castpd512_pd256(v), _mm512_extractf64x4_pd(v, 1)));
+}
+
+/*****************************************************************************
+*
+* FUNCTION
+*
+*   AVX512_Noise
+*
+* INPUT
+*
+*   EPoint -- 3-D point at which noise is evaluated
+*
+* OUTPUT
+*
+* RETURNS
+*
+*   DBL noise value
+*
+* AUTHOR
+*
+*   -
+*
+* DESCRIPTION
+*
+*   OriNoise using AVX-512, with the two corners that differ only in z
+*   sharing one vector.
+*
+* CHANGES
+*
+*   -
+*
+******************************************************************************/
+
+NOISE_AVX512
+DBL AVX512_Noise(const VECTOR EPoint, int noise_generator)
+{
+	int index[8];
+	__m256d base, s_lo, s_hi;
+
+	if (noise_generator==3)
+		return OriNoise(EPoint, noise_generator);
+
+	AVX2_Noise_Cell(EPoint, index, base, s_lo, s_hi);
+
+	__m512d base2 = AVX512_Join(base, base);
+	__m512d s = AVX512_Join(s_lo, s_hi);
+	__m512d sum = _mm512_setzero_pd();
+
+	for(int k = 0; k < 4; k++)
+	{
+		__m512d r = AVX512_Join(_mm256_loadu_pd(NoiseCornerTable[index[k]]), _mm256_loadu_pd(NoiseCornerTable[index[k + 4]]));
+		__m512d offset = AVX512_Join(_mm256_loadu_pd(NoiseCornerOffset[k]), _mm256_loadu_pd(NoiseCornerOffset[k + 4]));
+		__m512d w = _mm512_permutexvar_pd(_mm512_set_epi64(k + 4, k + 4, k + 4, k + 4, k, k, k, k), s);
+
+		sum = _mm512_fmadd_pd(_mm512_mul_pd(r, _mm512_sub_pd(base2, offset)), w, sum);
+	}
+
+	return Noise_Range(AVX512_Noise_Sum(sum), noise_generator);
+}
+
+/*****************************************************************************
+*
+* FUNCTION
+*
+*   AVX512_DNoise
+*
+* INPUT
+*
+*   EPoint -- 3-D point at which noise is evaluated
+*
+* OUTPUT
+*
+*   VECTOR result
+*
+* RETURNS
+*
+* AUTHOR
+*
+*   -
+*
+* DESCRIPTION
+*
+*   OriDNoise using AVX-512, with the X and Y components of each corner
+*   sharing one vector.
+*
+* CHANGES
+*
+*   -
+*
+******************************************************************************/
+
+NOISE_AVX512
+void AVX512_DNoise(VECTOR result, const VECTOR EPoint)
+{
+	int index[8];
+	__m256d base, s_lo, s_hi;
+
+	AVX2_Noise_Cell(EPoint, index, base, s_lo, s_hi);
+
+	__m512d s = AVX512_Join(s_lo, s_hi);
+	__m512d sum_xy = _mm512_setzero_pd();
+	__m256d sum_z = _mm256_setzero_pd();
+
+	for(int k = 0; k < 8; k++)
+	{
+		__m256d offset = _mm256_sub_pd(base, _mm256_loadu_pd(NoiseCornerOffset[k]));
+		__m512d w = _mm512_permutexvar_pd(_mm512_set1_epi64(k), s);
+		__m512d r = AVX512_Join(_mm256_loadu_pd(NoiseCornerTable[index[k]]), _mm256_loadu_pd(NoiseCornerTable[index[k] + 4]));
+
+		sum_xy = _mm512_fmadd_pd(_mm512_mul_pd(r, AVX512_Join(offset, offset)), w, sum_xy);
+		sum_z = _mm256_fmadd_pd(_mm256_mul_pd(_mm256_loadu_pd(NoiseCornerTable[index[k] + 8]), offset), _mm512_castpd512_pd256(w), sum_z);
+	}
+
+	// x01 y01 x23 y23
+	__m256d xy = _mm256_hadd_pd(_mm512_castpd512_pd256(sum_xy), _mm512_extractf64x4_pd(sum_xy, 1));
+
+	_mm_storeu_pd(result, _mm_add_pd(_mm256_castpd256_pd128(xy), _mm256_extractf128_pd(xy, 1)));
+	result[Z] = AVX2_Noise_Sum(sum_z);
+}
+
+/*****************************************************************************/
+/* Turbulence with four octaves per call of the noise code, one in each lane */
+/* of an AVX2 vector. The octaves are combined in the same order as in       */
+/* OriTurbulence and OriDTurbulence.                                         */
+/*****************************************************************************/
+
+// Lattice setup of OriNoise for one coordinate of four points.
+NOISE_AVX2
+static NOISE_INLINE __m256d AVX2_Noise_Lattice4(__m256d p, int min, int *i)
+{
+	__m256d pos = _mm256_cvtepi32_pd(_mm256_cvttpd_epi32(p));
+	__m256d neg = _mm256_cvtepi32_pd(_mm256_cvttpd_epi32(_mm256_sub_pd(p, _mm256_set1_pd(1-EPSILON))));
+	__m256d tmp = _mm256_blendv_pd(neg, pos, _mm256_cmp_pd(p, _mm256_setzero_pd(), _CMP_GE_OQ));
+
+	_mm_storeu_si128((__m128i *)i, _mm_and_si128(_mm_sub_epi32(_mm256_cvttpd_epi32(tmp), _mm_set1_epi32(min)), _mm_set1_epi32(0xFFF)));
+
+	return _mm256_sub_pd(p, tmp);
+}
+
+/*****************************************************************************
+*
+* FUNCTION
+*
+*   AVX2_Noise_Cell4
+*
+* INPUT
+*
+*   P -- x, y and z of four points at which noise is evaluated
+*
+* OUTPUT
+*
+*   index -- NoiseCornerTable index of each corner of each point
+*   d     -- x_ix, x_jx, y_iy, y_jy, z_iz and z_jz of the four points
+*   w     -- weight of each corner of the four points
+*
+* RETURNS
+*
+* AUTHOR
+*
+*   -
+*
+* DESCRIPTION
+*
+*   AVX2_Noise_Cell for four points at once, with the corners in the same
+*   order.
+*
+* CHANGES
+*
+*   -
+*
+******************************************************************************/
+
+NOISE_AVX2
+static NOISE_INLINE void AVX2_Noise_Cell4(const DBL P[3][4], int index[8][4], __m256d *d, __m256d *w)
+{
+	int ix[4], iy[4], iz[4];
+
+	d[0] = AVX2_Noise_Lattice4(_mm256_loadu_pd(P[X]), MINX, ix);
+	d[2] = AVX2_Noise_Lattice4(_mm256_loadu_pd(P[Y]), MINY, iy);
+	d[4] = AVX2_Noise_Lattice4(_mm256_loadu_pd(P[Z]), MINZ, iz);
+
+	__m256d one = _mm256_set1_pd(1.0);
+	__m256d three = _mm256_set1_pd(3.0);
+	__m256d two = _mm256_set1_pd(2.0);
+
+	d[1] = _mm256_sub_pd(d[0], one);
+	d[3] = _mm256_sub_pd(d[2], one);
+	d[5] = _mm256_sub_pd(d[4], one);
+
+	__m256d sx = _mm256_mul_pd(_mm256_mul_pd(d[0], d[0]), _mm256_fnmadd_pd(two, d[0], three));
+	__m256d sy = _mm256_mul_pd(_mm256_mul_pd(d[2], d[2]), _mm256_fnmadd_pd(two, d[2], three));
+	__m256d sz = _mm256_mul_pd(_mm256_mul_pd(d[4], d[4]), _mm256_fnmadd_pd(two, d[4], three));
+	__m256d tx = _mm256_sub_pd(one, sx);
+	__m256d ty = _mm256_sub_pd(one, sy);
+	__m256d tz = _mm256_sub_pd(one, sz);
+	__m256d txty = _mm256_mul_pd(tx, ty);
+	__m256d sxty = _mm256_mul_pd(sx, ty);
+	__m256d txsy = _mm256_mul_pd(tx, sy);
+	__m256d sxsy = _mm256_mul_pd(sx, sy);
+
+	w[0] = _mm256_mul_pd(txty, tz);
+	w[1] = _mm256_mul_pd(sxty, tz);
+	w[2] = _mm256_mul_pd(txsy, tz);
+	w[3] = _mm256_mul_pd(sxsy, tz);
+	w[4] = _mm256_mul_pd(txty, sz);
+	w[5] = _mm256_mul_pd(sxty, sz);
+	w[6] = _mm256_mul_pd(txsy, sz);
+	w[7] = _mm256_mul_pd(sxsy, sz);
+
+	for(int j = 0; j < 4; j++)
+	{
+		int ixiy_hash = Hash2d(ix[j],     iy[j]);
+		int jxiy_hash = Hash2d(ix[j] + 1, iy[j]);
+		int ixjy_hash = Hash2d(ix[j],     iy[j] + 1);
+		int jxjy_hash = Hash2d(ix[j] + 1, iy[j] + 1);
+
+		index[0][j] = Hash1dRTableIndex(ixiy_hash, iz[j]) / 2;
+		index[1][j] = Hash1dRTableIndex(jxiy_hash, iz[j]) / 2;
+		index[2][j] = Hash1dRTableIndex(ixjy_hash, iz[j]) / 2;
+		index[3][j] = Hash1dRTableIndex(jxjy_hash, iz[j]) / 2;
+		index[4][j] = Hash1dRTableIndex(ixiy_hash, iz[j] + 1) / 2;
+		index[5][j] = Hash1dRTableIndex(jxiy_hash, iz[j] + 1) / 2;
+		index[6][j] = Hash1dRTableIndex(ixjy_hash, iz[j] + 1) / 2;
+		index[7][j] = Hash1dRTableIndex(jxjy_hash, iz[j] + 1) / 2;
+	}
+}
+
+// Adds the contribution of one corner of four points to sum; the table rows of
+// the four points are transposed so that each lane holds one point.
+NOISE_AVX2
+static NOISE_INLINE __m256d AVX2_Noise_Corner4(const int *index, int component, __m256d dx, __m256d dy, __m256d dz, __m256d w, __m256d sum)
+{
+	__m256d r0 = _mm256_loadu_pd(NoiseCornerTable[index[0] + component]);
+	__m256d r1 = _mm256_loadu_pd(NoiseCornerTable[index[1] + component]);
+	__m256d r2 = _mm256_loadu_pd(NoiseCornerTable[index[2] + component]);
+	__m256d r3 = _mm256_loadu_pd(NoiseCornerTable[index[3] + component]);
+	__m256d t0 = _mm256_unpacklo_pd(r0, r1);
+	__m256d t1 = _mm256_unpackhi_pd(r0, r1);
+	__m256d t2 = _mm256_unpacklo_pd(r2, r3);
+	__m256d t3 = _mm256_unpackhi_pd(r2, r3);
+	__m256d v = _mm256_permute2f128_pd(t0, t2, 0x20);
+
+	v = _mm256_fmadd_pd(_mm256_permute2f128_pd(t1, t3, 0x20), dx, v);
+	v = _mm256_fmadd_pd(_mm256_permute2f128_pd(t0, t2, 0x31), dy, v);
+	v = _mm256_fmadd_pd(_mm256_permute2f128_pd(t1, t3, 0x31), dz, v);
+
+	return _mm256_fmadd_pd(w, v, sum);
+}
+
+// Sum over the eight corners of four points, for the X (0), Y (4) or Z (8)
+// component.
+NOISE_AVX2
+static NOISE_INLINE __m256d AVX2_Noise_Sum4(int index[8][4], int component, const __m256d *d, const __m256d *w)
+{
+	__m256d sum = _mm256_setzero_pd();
+
+	sum = AVX2_Noise_Corner4(index[0], component, d[0], d[2], d[4], w[0], sum);
+	sum = AVX2_Noise_Corner4(index[1], component, d[1], d[2], d[4], w[1], sum);
+	sum = AVX2_Noise_Corner4(index[2], component, d[0], d[3], d[4], w[2], sum);
+	sum = AVX2_Noise_Corner4(index[3], component, d[1], d[3], d[4], w[3], sum);
+	sum = AVX2_Noise_Corner4(index[4], component, d[0], d[2], d[5], w[4], sum);
+	sum = AVX2_Noise_Corner4(index[5], component, d[1], d[2], d[5], w[5], sum);
+	sum = AVX2_Noise_Corner4(index[6], component, d[0], d[3], d[5], w[6], sum);
+	sum = AVX2_Noise_Corner4(index[7], component, d[1], d[3], d[5], w[7], sum);
+
+	return sum;
+}
+
+/*****************************************************************************
+*
+* FUNCTION
+*
+*   Turbulence_Octaves4
+*
+* INPUT
+*
+*   EPoint -- point at which turb is evaluated
+*   first  -- first octave of the group, counting from 1
+*   count  -- number of octaves in the group, 1 to 4
+*   Lambda -- frequency ratio of successive octaves
+*   l      -- frequency of the first octave of the group, updated to the next
+*             group
+*
+* OUTPUT
+*
+*   P -- the point scaled for each octave; unused lanes are zero
+*
+* RETURNS
+*
+* AUTHOR
+*
+*   -
+*
+* DESCRIPTION
+*
+*   Scales the point as OriTurbulence does, the first octave not at all.
+*
+* CHANGES
+*
+*   -
+*
+******************************************************************************/
+
+static inline void Turbulence_Octaves4(const VECTOR EPoint, int first, int count, DBL Lambda, DBL& l, DBL P[3][4])
+{
+	for(int j = 0; j < 4; j++)
+	{
+		if(j >= count)
+			P[X][j] = P[Y][j] = P[Z][j] = 0.0;
+		else if(first + j == 1)
+			P[X][j] = EPoint[X], P[Y][j] = EPoint[Y], P[Z][j] = EPoint[Z];
+		else
+		{
+			P[X][j] = EPoint[X] * l;
+			P[Y][j] = EPoint[Y] * l;
+			P[Z][j] = EPoint[Z] * l;
+			l *= Lambda;
+		}
+	}
+}
+
+/*****************************************************************************
+*
+* FUNCTION
+*
+*   AVX2_FMA3_Turbulence
+*
+* INPUT
+*
+*   EPoint -- Point at which turb is evaluated.
+*   Turb   -- Parameters for fbm calculations.
+*
+* OUTPUT
+*
+* RETURNS
+*
+*   DBL result
+*
+* AUTHOR
+*
+*   -
+*
+* DESCRIPTION
+*
+*   OriTurbulence evaluating the noise of four octaves at once.
+*
+* CHANGES
+*
+*   -
+*
+******************************************************************************/
+
+NOISE_AVX2
+DBL AVX2_FMA3_Turbulence(const VECTOR EPoint, const TURB *Turb, int noise_generator)
+{
+	int index[8][4];
+	__m256d d[6], w[8];
+	DBL P[3][4], n[4];
+	DBL Lambda, Omega, l, o, value = 0.0;
+	int Octaves = max(Turb->Octaves, 1); // OriTurbulence always does the first one
+
+	if (noise_generator==3)
+		return OriTurbulence(EPoint, Turb, noise_generator);
+
+	l = Lambda = Turb->Lambda;
+	o = Omega  = Turb->Omega;
+
+	for(int first = 1; first <= Octaves; first += 4)
+	{
+		int count = min(Octaves - first + 1, 4);
+
+		Turbulence_Octaves4(EPoint, first, count, Lambda, l, P);
+		AVX2_Noise_Cell4(P, index, d, w);
+		_mm256_storeu_pd(n, AVX2_Noise_Sum4(index, 0, d, w));
+
+		for(int j = 0; j < count; j++)
+		{
+			n[j] = Noise_Range(n[j], noise_generator);
+
+			if(first + j == 1)
+			{
+				if (noise_generator>1)
+					value = min(max(2.0 * n[j] - 0.5, 0.0), 1.0);
+				else
+					value = n[j];
+			}
+			else
+			{
+				if (noise_generator>1)
+					value += o * (2.0 * n[j] - 0.5);
+				else
+					value += o * n[j];
+				o *= Omega;
+			}
+		}
+	}
+
+	return (value);
+}
+
+/*****************************************************************************
+*
+* FUNCTION
+*
+*   AVX2_FMA3_DTurbulence
+*
+* INPUT
+*
+*   EPoint -- Point at which turb is evaluated.
+*   Turb   -- Parameters for fmb calculations.
+*
+* OUTPUT
+*
+*   result -- Vector valued turbulence
+*
+* RETURNS
+*
+* AUTHOR
+*
+*   -
+*
+* DESCRIPTION
+*
+*   OriDTurbulence evaluating the noise of four octaves at once.
+*
+* CHANGES
+*
+*   -
+*
+******************************************************************************/
+
+NOISE_AVX2
+void AVX2_FMA3_DTurbulence(VECTOR result, const VECTOR EPoint, const TURB *Turb)
+{
+	int index[8][4];
+	__m256d d[6], w[8];
+	DBL P[3][4], n[3][4];
+	DBL Lambda, Omega, l, o;
+	int Octaves = max(Turb->Octaves, 1); // OriDTurbulence always does the first one
+
+	l = Lambda = Turb->Lambda;
+	o = Omega  = Turb->Omega;
+
+	for(int first = 1; first <= Octaves; first += 4)
+	{
+		int count = min(Octaves - first + 1, 4);
+
+		Turbulence_Octaves4(EPoint, first, count, Lambda, l, P);
+		AVX2_Noise_Cell4(P, index, d, w);
+		_mm256_storeu_pd(n[X], AVX2_Noise_Sum4(index, 0, d, w));
+		_mm256_storeu_pd(n[Y], AVX2_Noise_Sum4(index, 4, d, w));
+		_mm256_storeu_pd(n[Z], AVX2_Noise_Sum4(index, 8, d, w));
+
+		for(int j = 0; j < count; j++)
+		{
+			if(first + j == 1)
+			{
+				result[X] = n[X][j];
+				result[Y] = n[Y][j];
+				result[Z] = n[Z][j];
+			}
+			else
+			{
+				result[X] += o * n[X][j];
+				result[Y] += o * n[Y][j];
+				result[Z] += o * n[Z][j];
+				o *= Omega;
+			}
+		}
+	}
+}
+
+#endif
+
+/*****************************************************************************
+*
+* FUNCTION
+*
+*   Get_Noise_Kernels
+*
+* INPUT
+*
+*   Max_Kernels -- size of the Kernels array
+*
+* OUTPUT
+*
+*   Kernels -- noise variants the CPU supports
+*
+* RETURNS
+*
+*   unsigned int number of variants stored
+*
+* AUTHOR
+*
+*   -
+*
+* DESCRIPTION
+*
+*   Lists the variants in order of preference, the scalar code last.
+*   Initialise_NoiseDispatch uses the first one that agrees with the scalar
+*   code; the noise micro-benchmark times them all.
+*
+* CHANGES
+*
+*   -
+*
+******************************************************************************/
+
+unsigned int Get_Noise_Kernels(NOISE_KERNEL *Kernels, unsigned int Max_Kernels)
+{
+	unsigned int count = 0;
+
+#if SYS_SIMD_NOISE_DISPATCH && !USE_FASTER_NOISE
+	__builtin_cpu_init();
+
+	// With only eight corners per call the wider AVX-512 vectors measure no
+	// faster than AVX2 (see --benchmark-noise), so AVX2/FMA3 comes first.
+	if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma") && (count < Max_Kernels))
+	{
+		Kernels[count].Name = "AVX2/FMA3";
+		Kernels[count].Noise = AVX2_FMA3_Noise;
+		Kernels[count].DNoise = AVX2_FMA3_DNoise;
+		Kernels[count].Turbulence = AVX2_FMA3_Turbulence;
+		Kernels[count].DTurbulence = AVX2_FMA3_DTurbulence;
+		count++;
+	}
+	if(__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma") && (count < Max_Kernels))
+	{
+		Kernels[count].Name = "AVX-512";
+		Kernels[count].Noise = AVX512_Noise;
+		Kernels[count].DNoise = AVX512_DNoise;
+		// four octaves per call already fill an AVX2 vector
+		Kernels[count].Turbulence = AVX2_FMA3_Turbulence;
+		Kernels[count].DTurbulence = AVX2_FMA3_DTurbulence;
+		count++;
+	}
+#endif
+#if defined(USE_AVX_FMA4_FOR_NOISE)
+	if(CPU_FMA4_DETECT() && (count < Max_Kernels))
+	{
+		Kernels[count].Name = "AVX/FMA4";
+		Kernels[count].Noise = AVX_FMA4_Noise;
+		Kernels[count].DNoise = AVX_FMA4_DNoise;
+		Kernels[count].Turbulence = OriTurbulence;
+		Kernels[count].DTurbulence = OriDTurbulence;
+		count++;
+	}
+#endif
+	if(count < Max_Kernels)
+	{
+		Kernels[count].Name = "scalar";
+#if NOISE_DISPATCH
+		Kernels[count].Noise = OriNoise;
+		Kernels[count].DNoise = OriDNoise;
+		Kernels[count].Turbulence = OriTurbulence;
+		Kernels[count].DTurbulence = OriDTurbulence;
+#else
+		Kernels[count].Noise = Noise;
+		Kernels[count].DNoise = DNoise;
+		Kernels[count].Turbulence = Turbulence;
+		Kernels[count].DTurbulence = DTurbulence;
+#endif
+		count++;
+	}
+
+	return count;
+}
+
+/*****************************************************************************
+*
+* FUNCTION
+*
+*   Get_Noise_Kernel_Name
+*
+* INPUT
+*
+* OUTPUT
+*
+* RETURNS
+*
+*   const char * name of the noise variant in use
+*
+* AUTHOR
+*
+*   -
+*
+* DESCRIPTION
+*
+* CHANGES
+*
+*   -
+*
+******************************************************************************/
+
+const char *Get_Noise_Kernel_Name()
+{
+#if NOISE_DISPATCH
+	return Noise_Kernel_Name;
+#else
+	return "scalar";
+#endif
+}
 
 }
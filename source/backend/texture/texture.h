@@ -114,12 +114,44 @@ namespace pov
 #define Hash3d(a,b,c) \
 	hashTable[(int)(hashTable[(int)(hashTable[(int)((a) & 0xfff)] ^ ((b) & 0xfff))] ^ ((c) & 0xfff))]
 
+/*
+ * Noise, DNoise, Turbulence and DTurbulence are function pointers set by
+ * Initialise_NoiseDispatch if any SIMD variant of them may be available.
+ */
+
+#if defined(USE_AVX_FMA4_FOR_NOISE) || (SYS_SIMD_NOISE_DISPATCH && !USE_FASTER_NOISE)
+	#define NOISE_DISPATCH 1
+#else
+	#define NOISE_DISPATCH 0
+#endif
+
+/*
+ * Largest difference from OriNoise and OriDNoise accepted for a SIMD variant.
+ * The AVX2/FMA3 and AVX-512 variants add up the corner contributions in a
+ * different order and partly with fused multiply-adds, so they differ from the
+ * scalar code by a few units in the last place; each variant is checked
+ * against this at startup.
+ */
+
+#define NOISE_KERNEL_TOLERANCE 1.0e-12
+
 
 
 /*****************************************************************************
 * Global typedefs
 ******************************************************************************/
 
+typedef struct Noise_Kernel_Struct NOISE_KERNEL;
+
+struct Noise_Kernel_Struct
+{
+	const char *Name;
+	DBL (*Noise) (const VECTOR EPoint, int noise_generator);
+	void (*DNoise) (VECTOR result, const VECTOR EPoint);
+	DBL (*Turbulence) (const VECTOR EPoint, const TURB *Turb, int noise_generator);
+	void (*DTurbulence) (VECTOR result, const VECTOR EPoint, const TURB *Turb);
+};
+
 /*****************************************************************************
 * Global variables
 ******************************************************************************/
@@ -138,19 +170,37 @@ extern ALIGN16 unsigned short hashTable[8192];
 void Initialize_Noise (void);
 void Initialize_Waves(vector<double>& waveFrequencies, vector<Vector3d>& waveSources, unsigned int numberOfWaves);
 void Free_Noise_Tables (void);
-#if defined(USE_AVX_FMA4_FOR_NOISE)
+#if NOISE_DISPATCH
 extern DBL (*Noise) (const VECTOR EPoint, int noise_generator);
 extern void (*DNoise) (VECTOR result, const VECTOR EPoint);
+extern DBL (*Turbulence) (const VECTOR EPoint, const TURB *Turb, int noise_generator);
+extern void (*DTurbulence) (VECTOR result, const VECTOR EPoint, const TURB *Turb);
 void Initialise_NoiseDispatch();
+DBL OriNoise(const VECTOR EPoint, int noise_generator);
+void OriDNoise(VECTOR result, const VECTOR EPoint);
+DBL OriTurbulence(const VECTOR EPoint, const TURB *Turb, int noise_generator);
+void OriDTurbulence(VECTOR result, const VECTOR EPoint, const TURB *Turb);
+#if defined(USE_AVX_FMA4_FOR_NOISE)
 DBL AVX_FMA4_Noise(const VECTOR EPoint, int noise_generator);
 void AVX_FMA4_DNoise(VECTOR result, const VECTOR EPoint);
+#endif
+#if SYS_SIMD_NOISE_DISPATCH && !USE_FASTER_NOISE
+DBL AVX2_FMA3_Noise(const VECTOR EPoint, int noise_generator);
+void AVX2_FMA3_DNoise(VECTOR result, const VECTOR EPoint);
+DBL AVX2_FMA3_Turbulence(const VECTOR EPoint, const TURB *Turb, int noise_generator);
+void AVX2_FMA3_DTurbulence(VECTOR result, const VECTOR EPoint, const TURB *Turb);
+DBL AVX512_Noise(const VECTOR EPoint, int noise_generator);
+void AVX512_DNoise(VECTOR result, const VECTOR EPoint);
+#endif
 
 #else
 INLINE_NOISE DBL Noise (const VECTOR EPoint, int noise_generator);
 INLINE_NOISE void DNoise (VECTOR result, const VECTOR EPoint);
-#endif
 DBL Turbulence (const VECTOR EPoint, const TURB *Turb, int noise_generator);
 void DTurbulence (VECTOR result, const VECTOR EPoint, const TURB *Turb);
+#endif
+unsigned int Get_Noise_Kernels (NOISE_KERNEL *Kernels, unsigned int Max_Kernels);
+const char *Get_Noise_Kernel_Name (void);
 DBL cycloidal (DBL value);
 DBL Triangle_Wave (DBL value);
 void Transform_Textures (TEXTURE *Textures, const TRANSFORM *Trans);
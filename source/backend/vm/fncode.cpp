@@ -178,9 +178,9 @@ FNCode::FNCode(Parser *pa, FunctionCode *f, bool is_local, char *n)
 		function->name = POV_STRDUP(n);
 	else
 		function->name = POV_STRDUP("");
-	function->filename = pa->UCS2_strdup(parser->Token.FileHandle->name());
+	function->filename = pa->UCS2_strdup(parser->Token.FileHandle->Name);
 	if(parser->Token.FileHandle != NULL)
-		function->filepos = parser->Token.FileHandle->tellg();
+		function->filepos = parser->Token.Token_File_Pos;
 	else
 	{
 		function->filepos.lineno = 0;
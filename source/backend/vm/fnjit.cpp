@@ -0,0 +1,1329 @@
+/*******************************************************************************
+ * fnjit.cpp
+ *
+ * This module implements a native x86-64 code generator for the function VM.
+ *
+ * from Persistence of Vision Ray Tracer ('POV-Ray') version 3.7.
+ * Copyright 1991-2003 Persistence of Vision Team
+ * Copyright 2003-2009 Persistence of Vision Raytracer Pty. Ltd.
+ * ---------------------------------------------------------------------------
+ * NOTICE: This source code file is provided so that users may experiment
+ * with enhancements to POV-Ray and to port the software to platforms other
+ * than those supported by the POV-Ray developers. There are strict rules
+ * regarding how you are permitted to use this file. These rules are contained
+ * in the distribution and derivative versions licenses which should have been
+ * provided with this file.
+ *
+ * These licences may be found online, linked from the end-user license
+ * agreement that is located at http://www.povray.org/povlegal.html
+ * ---------------------------------------------------------------------------
+ * POV-Ray is based on the popular DKB raytracer version 2.12.
+ * DKBTrace was originally written by David K. Buck.
+ * DKBTrace Ver 2.0-2.12 were written by David K. Buck & Aaron A. Collins.
+ * ---------------------------------------------------------------------------
+ * $File: //depot/povray/smp/source/backend/vm/fnjit.cpp $
+ * $Revision: #1 $
+ * $Change: 5401 $
+ * $DateTime: 2011/02/08 21:06:55 $
+ * $Author: clipka $
+ *******************************************************************************/
+
+/*********************************************************************************
+ * NOTICE
+ *
+ * This file is part of a BETA-TEST version of POV-Ray version 3.7. It is not
+ * final code. Use of this source file is governed by both the standard POV-Ray
+ * licences referred to in the copyright header block above this notice, and the
+ * following additional restrictions numbered 1 through 4 below:
+ *
+ *   1. This source file may not be re-distributed without the written permission
+ *      of Persistence of Vision Raytracer Pty. Ltd.
+ *
+ *   2. This notice may not be altered or removed.
+ *   
+ *   3. Binaries generated from this source file by individuals for their own
+ *      personal use may not be re-distributed without the written permission
+ *      of Persistence of Vision Raytracer Pty. Ltd. Such personal-use binaries
+ *      are not required to have a timeout, and thus permission is granted in
+ *      these circumstances only to disable the timeout code contained within
+ *      the beta software.
+ *   
+ *   4. Binaries generated from this source file for use within an organizational
+ *      unit (such as, but not limited to, a company or university) may not be
+ *      distributed beyond the local organizational unit in which they were made,
+ *      unless written permission is obtained from Persistence of Vision Raytracer
+ *      Pty. Ltd. Additionally, the timeout code implemented within the beta may
+ *      not be disabled or otherwise bypassed in any manner.
+ *
+ * The following text is not part of the above conditions and is provided for
+ * informational purposes only.
+ *
+ * The purpose of the no-redistribution clause is to attempt to keep the
+ * circulating copies of the beta source fresh. The only authorized distribution
+ * point for the source code is the POV-Ray website and Perforce server, where
+ * the code will be kept up to date with recent fixes. Additionally the beta
+ * timeout code mentioned above has been a standard part of POV-Ray betas since
+ * version 1.0, and is intended to reduce bug reports from old betas as well as
+ * keep any circulating beta binaries relatively fresh.
+ *
+ * All said, however, the POV-Ray developers are open to any reasonable request
+ * for variations to the above conditions and will consider them on a case-by-case
+ * basis.
+ *
+ * Additionally, the developers request your co-operation in fixing bugs and
+ * generally improving the program. If submitting a bug-fix, please ensure that
+ * you quote the revision number of the file shown above in the copyright header
+ * (see the '$Revision:' field). This ensures that it is possible to determine
+ * what specific copy of the file you are working with. The developers also would
+ * like to make it known that until POV-Ray 3.7 is out of beta, they would prefer
+ * to emphasize the provision of bug fixes over the addition of new features.
+ *
+ * Persons wishing to enhance this source are requested to take the above into
+ * account. It is also strongly suggested that such enhancements are started with
+ * a recent copy of the source.
+ *
+ * The source code page (see http://www.povray.org/beta/source/) sets out the
+ * conditions under which the developers are willing to accept contributions back
+ * into the primary source tree. Please refer to those conditions prior to making
+ * any changes to this source, if you wish to submit those changes for inclusion
+ * with POV-Ray.
+ *
+ *********************************************************************************/
+
+/*
+
+The code generator translates the instruction stream of a function into
+x86-64 code that keeps the VM state in machine registers:
+
+  R0 - R7   xmm0 - xmm7
+  CC        r14d
+  context   rbx
+  SP        r12 (byte offset into the stack)
+  stack     r13 (context->dblstackbase)
+  SP(0)     r15 (r13 + r12)
+
+xmm8 is used as scratch register.  Calls to internal and external functions
+spill R0 - R7 to the native stack frame and reload them afterwards, so the
+VM registers keep the values the interpreter would have.  The stack base is
+reloaded after every call that may grow the stack.  On processors with AVX
+a vzeroupper follows the entry and every call, as the math library may leave
+dirty ymm state behind that makes the legacy SSE instructions stall.
+
+Instructions the generator does not know (global variable access, jsr, the
+integer instruction set) make it reject the whole function, which then keeps
+running in the interpreter.
+
+*/
+
+#include <stddef.h>
+#include <string.h>
+#include <algorithm>
+
+// frame.h must always be the first POV file included (pulls in platform config)
+#include "backend/frame.h"
+#include "backend/vm/fnjit.h"
+#include "backend/vm/fnpovfpu.h"
+#include "backend/vm/fnintern.h"
+
+#if (SYS_FUNCTION_JIT == 1)
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+// this must be the last file included
+#include "base/povdebug.h"
+
+namespace pov
+{
+
+#if (SYS_FUNCTION_JIT == 1)
+
+/*****************************************************************************
+* Local preprocessor defines
+******************************************************************************/
+
+#define REG_RAX 0
+#define REG_RCX 1
+#define REG_RDX 2
+#define REG_RBX 3
+#define REG_RSP 4
+#define REG_RSI 6
+#define REG_RDI 7
+#define REG_R12 12
+#define REG_R13 13
+#define REG_R14 14
+#define REG_R15 15
+
+#define REG_CONTEXT REG_RBX
+#define REG_SP      REG_R12
+#define REG_STACK   REG_R13
+#define REG_CCR     REG_R14
+#define REG_FRAME   REG_R15
+
+#define XMM_TEMP 8
+
+// condition codes as used by jcc and setcc
+#define CC_B  0x2
+#define CC_AE 0x3
+#define CC_E  0x4
+#define CC_NE 0x5
+#define CC_BE 0x6
+#define CC_A  0x7
+#define CC_P  0xa
+#define CC_NP 0xb
+
+// prefixes of scalar double and packed double SSE2 instructions
+#define SSE_SD 0xf2
+#define SSE_PD 0x66
+
+#define SSE_MOVSD_LOAD  0x10
+#define SSE_MOVSD_STORE 0x11
+#define SSE_MOVAPD      0x28
+#define SSE_CVTSI2SD    0x2a
+#define SSE_UCOMISD     0x2e
+#define SSE_ANDPD       0x54
+#define SSE_XORPD       0x57
+#define SSE_ADDSD       0x58
+#define SSE_MULSD       0x59
+#define SSE_SUBSD       0x5c
+#define SSE_DIVSD       0x5e
+
+#define ALU_ADD 0
+#define ALU_SUB 5
+#define ALU_CMP 7
+
+#define SPILL_AREA_SIZE (8 * 8)
+
+#define MAPPING_SIZE(codesize, pagesize) ((((codesize) + (pagesize) - 1) / (pagesize)) * (pagesize))
+
+
+/*****************************************************************************
+* Local typedefs
+******************************************************************************/
+
+enum
+{
+	PRED_EQ = 0,
+	PRED_NE,
+	PRED_LT,
+	PRED_LE,
+	PRED_GT,
+	PRED_GE
+};
+
+/*****************************************************************************
+* Static functions
+******************************************************************************/
+
+static bool CPUHasAVX()
+{
+	unsigned int eax, ebx, ecx, edx;
+
+	__asm__ __volatile__("cpuid" : "=a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx) : "a" (1), "c" (0));
+
+	// AVX and OSXSAVE must be set, and the OS must save the ymm state
+	if((ecx & ((1 << 27) | (1 << 28))) != ((1 << 27) | (1 << 28)))
+		return false;
+
+	__asm__ __volatile__("xgetbv" : "=a" (eax), "=d" (edx) : "c" (0));
+
+	return ((eax & 6) == 6);
+}
+
+class NativeCodeGenerator
+{
+	public:
+		NativeCodeGenerator(const FunctionCode *f, FUNCTION fn, const vector<DBL>& consts);
+
+		/// Translates the function, returns false if it uses unsupported instructions.
+		bool Translate();
+
+		const vector<unsigned char>& GetCode() const { return code; }
+	private:
+		struct Fixup
+		{
+			size_t pos;
+			unsigned int target;
+		};
+
+		const FunctionCode *function;
+		FUNCTION fn;
+		const vector<DBL>& consts;
+
+		vector<unsigned char> code;
+		vector<size_t> labels;
+		vector<Fixup> fixups;
+
+		/// True if the processor supports AVX and vzeroupper may be emitted.
+		bool avx;
+
+		NativeCodeGenerator();
+		NativeCodeGenerator(NativeCodeGenerator&);
+
+		bool TranslateInstruction(unsigned int op, unsigned int k);
+
+		void Byte(unsigned int b) { code.push_back((unsigned char)b); }
+		void Dword(unsigned int d);
+		void Qword(POV_ULONG q);
+		void Rex(bool w, int reg, int base, bool force = false);
+		void ModRMReg(int reg, int rm) { Byte(0xc0 | ((reg & 7) << 3) | (rm & 7)); }
+		void ModRMMem(int reg, int base, int disp);
+
+		void Push(int r);
+		void Pop(int r);
+		void MovRR(int dst, int src);
+		void MovRR32(int dst, int src);
+		void MovRI(int dst, POV_ULONG imm);
+		void MovRI32(int dst, unsigned int imm);
+		void MovRM(int dst, int base, int disp);
+		void MovRM32(int dst, int base, int disp);
+		void AluRR(int op, int dst, int src);
+		void AluRI(int ext, int dst, unsigned int imm);
+		void ShiftRI(int ext, int dst, unsigned int imm);
+		void Setcc(int cc, int r);
+		void Jcc(int cc, unsigned int target);
+		void Vzeroupper();
+		void Jmp(unsigned int target);
+		size_t JccForward(int cc);
+		void Bind(size_t pos);
+		void Call(const void *fnptr);
+
+		void SseRR(int prefix, int op, int reg, int rm);
+		void SseRM(int prefix, int op, int reg, int base, int disp);
+		void MovqXR(int xmm, int gpr);
+
+		void Prologue();
+		void Epilogue();
+		void SaveRegisters();
+		void RestoreRegisters();
+		void ReloadStack();
+		void LoadConstant(int xmm, DBL v);
+		void LoadBits(int xmm, POV_ULONG bits);
+		void FloatPredicate(int pred, int a, int b);
+		void PredicateToRegister(int xmm);
+		void SetCCR(int c, int d);
+		int TestCCR(unsigned int cond);
+		void CallException(const char *msg);
+		void CallMod(int d, int s, DBL v);
+		void StackOffset(int dst);
+};
+
+
+/*****************************************************************************
+* Local functions
+******************************************************************************/
+
+void POVFPU_JITGrow(FPUContext *context, FUNCTION fn, unsigned int sp, unsigned int k);
+
+
+/*****************************************************************************
+* Local variables
+******************************************************************************/
+
+const char *JITStackFull      = "Stack full. Possible infinite recursive function call.";
+const char *JITStackOverflow  = "Function evaluation stack overflow.";
+const char *JITStackUnderflow = "Function evaluation stack underflow.";
+
+
+/*****************************************************************************
+*
+* FUNCTION
+*
+*   POVFPU_JITGrow
+*
+* INPUT
+*
+*   fn - function reference number
+*   sp - current stack offset
+*   k  - number of stack elements required
+*   
+* OUTPUT
+*   
+* RETURNS
+*   
+* DESCRIPTION
+*
+*   Slow path of the grow instruction, identical to the interpreter's.
+*
+* CHANGES
+*
+*   -
+*
+******************************************************************************/
+
+void POVFPU_JITGrow(FPUContext *context, FUNCTION fn, unsigned int sp, unsigned int k)
+{
+	if((unsigned int)((unsigned int)sp + (unsigned int)k) >= (unsigned int)MAX_K)
+	{
+		POVFPU_Exception(context, fn, JITStackFull);
+	}
+	else if(sp + k >= context->maxdblstacksize)
+	{
+		context->maxdblstacksize = context->maxdblstacksize + max(k + 1, (unsigned int)256);
+		context->dblstackbase = (DBL *)POV_REALLOC(context->dblstackbase, sizeof(DBL) * context->maxdblstacksize, "fn: stack");
+	}
+}
+
+
+/*****************************************************************************
+*
+* FUNCTION
+*
+*   NativeCodeGenerator::NativeCodeGenerator
+*
+* INPUT
+*
+*   f      - function to translate
+*   fn     - function reference number
+*   consts - constant table of the function VM
+*   
+* OUTPUT
+*   
+* RETURNS
+*   
+* DESCRIPTION
+*
+*   -
+*
+* CHANGES
+*
+*   -
+*
+******************************************************************************/
+
+NativeCodeGenerator::NativeCodeGenerator(const FunctionCode *f, FUNCTION fn, const vector<DBL>& consts) :
+	function(f),
+	fn(fn),
+	consts(consts),
+	avx(CPUHasAVX())
+{
+}
+
+
+/*****************************************************************************
+*
+* FUNCTION
+*
+*   NativeCodeGenerator::Translate
+*
+* INPUT
+*   
+* OUTPUT
+*   
+* RETURNS
+*
+*   bool - true if the function could be translated
+*   
+* DESCRIPTION
+*
+*   Translates all instructions and resolves the branch targets.
+*
+* CHANGES
+*
+*   -
+*
+******************************************************************************/
+
+bool NativeCodeGenerator::Translate()
+{
+	if((function->program == NULL) || (function->program_size == 0))
+		return false;
+
+	code.clear();
+	code.reserve(function->program_size * 32);
+	labels.resize(function->program_size);
+	fixups.clear();
+
+	Prologue();
+
+	for(unsigned int pc = 0; pc < function->program_size; pc++)
+	{
+		labels[pc] = code.size();
+
+		if(TranslateInstruction(GET_OP(function->program[pc]), GET_K(function->program[pc])) == false)
+			return false;
+	}
+
+	// the compiler always ends a function with rts, but do not rely on it
+	Epilogue();
+
+	for(vector<Fixup>::iterator i(fixups.begin()); i != fixups.end(); i++)
+	{
+		if(i->target >= function->program_size)
+			return false;
+
+		unsigned int rel = (unsigned int)(labels[i->target] - (i->pos + 4));
+
+		for(int b = 0; b < 4; b++)
+			code[i->pos + b] = (unsigned char)(rel >> (b * 8));
+	}
+
+	return true;
+}
+
+
+/*****************************************************************************
+*
+* FUNCTION
+*
+*   NativeCodeGenerator::TranslateInstruction
+*
+* INPUT
+*
+*   op - instruction opcode
+*   k  - instruction k-data
+*   
+* OUTPUT
+*   
+* RETURNS
+*
+*   bool - false if the instruction is not supported
+*   
+* DESCRIPTION
+*
+*   Emits the native code of one instruction.  See fnpovfpu.cpp for the
+*   instruction set.
+*
+* CHANGES
+*
+*   -
+*
+******************************************************************************/
+
+bool NativeCodeGenerator::TranslateInstruction(unsigned int op, unsigned int k)
+{
+	int s = (op >> 3) & 7; // source register or extended opcode
+	int d = op & 7;        // destination register
+	size_t skip = 0;
+
+	switch(op >> 6)
+	{
+		case 0:                                     // add   Rs, Rd
+			SseRR(SSE_SD, SSE_ADDSD, d, s);
+			break;
+		case 1:                                     // sub   Rs, Rd
+			SseRR(SSE_SD, SSE_SUBSD, d, s);
+			break;
+		case 2:                                     // mul   Rs, Rd
+			SseRR(SSE_SD, SSE_MULSD, d, s);
+			break;
+		case 3:                                     // div   Rs, Rd
+			SseRR(SSE_SD, SSE_DIVSD, d, s);
+			break;
+		case 4:                                     // mod   Rs, Rd
+			CallMod(d, s, 0.0);
+			break;
+		case 5:                                     // move  Rs, Rd
+			if(s != d)
+				SseRR(SSE_PD, SSE_MOVAPD, d, s);
+			break;
+		case 6:                                     // cmp   Rs, Rd
+			SetCCR(s, d);
+			break;
+		case 7:                                     // neg   Rs, Rd
+			if(s != d)
+				SseRR(SSE_PD, SSE_MOVAPD, d, s);
+			LoadBits(XMM_TEMP, (POV_ULONG)(1) << 63);
+			SseRR(SSE_PD, SSE_XORPD, d, XMM_TEMP);
+			break;
+		case 8:                                     // abs   Rs, Rd
+			if(s != d)
+				SseRR(SSE_PD, SSE_MOVAPD, d, s);
+			LoadBits(XMM_TEMP, ~((POV_ULONG)(1) << 63));
+			SseRR(SSE_PD, SSE_ANDPD, d, XMM_TEMP);
+			break;
+		case 9:
+			if(k >= consts.size())
+				return false;
+			switch(s)
+			{
+				case 0:                             // addi  k, Rd
+					LoadConstant(XMM_TEMP, consts[k]);
+					SseRR(SSE_SD, SSE_ADDSD, d, XMM_TEMP);
+					break;
+				case 1:                             // subi  k, Rd
+					LoadConstant(XMM_TEMP, consts[k]);
+					SseRR(SSE_SD, SSE_SUBSD, d, XMM_TEMP);
+					break;
+				case 2:                             // muli  k, Rd
+					LoadConstant(XMM_TEMP, consts[k]);
+					SseRR(SSE_SD, SSE_MULSD, d, XMM_TEMP);
+					break;
+				case 3:                             // divi  k, Rd
+					LoadConstant(XMM_TEMP, consts[k]);
+					SseRR(SSE_SD, SSE_DIVSD, d, XMM_TEMP);
+					break;
+				case 4:                             // modi  k, Rd
+					CallMod(d, -1, consts[k]);
+					break;
+				case 5:                             // loadi k, Rd
+					LoadConstant(d, consts[k]);
+					break;
+				case 6:                             // cmpi  k, Rd
+					LoadConstant(XMM_TEMP, consts[k]);
+					SetCCR(XMM_TEMP, d);
+					break;
+				default:
+					return false;
+			}
+			break;
+		case 10:
+			switch(s)
+			{
+				case 6:                             // teq   Rd
+				case 7:                             // tne   Rd
+					SseRR(SSE_PD, SSE_XORPD, XMM_TEMP, XMM_TEMP);
+					FloatPredicate((s == 6) ? PRED_EQ : PRED_NE, d, XMM_TEMP);
+					break;
+				default:                            // seq, sne, slt, sle, sgt, sge   Rd
+					Setcc(TestCCR(s), REG_RAX);
+					break;
+			}
+			PredicateToRegister(d);
+			break;
+		case 11:
+			if(s != 1)                              // only load SP(k), Rd
+				return false;
+			SseRM(SSE_SD, SSE_MOVSD_LOAD, d, REG_FRAME, int(k * sizeof(DBL)));
+			break;
+		case 12:
+			if(s != 1)                              // only store Rs, SP(k)
+				return false;
+			SseRM(SSE_SD, SSE_MOVSD_STORE, d, REG_FRAME, int(k * sizeof(DBL)));
+			break;
+		case 13:
+			if((s > 5) || (d != 0))
+				return false;
+			Jcc(TestCCR(s), k);                     // beq, bne, blt, ble, bgt, bge   k
+			break;
+		case 14:
+			SseRR(SSE_PD, SSE_XORPD, XMM_TEMP, XMM_TEMP);
+			switch(s)
+			{
+				case 0:                             // xeq   Rs
+					FloatPredicate(PRED_EQ, d, XMM_TEMP);
+					break;
+				case 1:                             // xne   Rs
+					FloatPredicate(PRED_NE, d, XMM_TEMP);
+					break;
+				case 2:                             // xlt   Rs
+					FloatPredicate(PRED_LT, d, XMM_TEMP);
+					break;
+				case 3:                             // xle   Rs
+					FloatPredicate(PRED_LE, d, XMM_TEMP);
+					break;
+				case 4:                             // xgt   Rs
+					FloatPredicate(PRED_GT, d, XMM_TEMP);
+					break;
+				case 5:                             // xge   Rs
+					FloatPredicate(PRED_GE, d, XMM_TEMP);
+					break;
+				case 6:                             // xdz   R0, Rs
+					FloatPredicate(PRED_EQ, 0, XMM_TEMP);
+					AluRR(0x84, REG_RAX, REG_RAX);  // test al, al
+					skip = JccForward(CC_E);
+					FloatPredicate(PRED_EQ, d, XMM_TEMP);
+					break;
+				default:
+					return false;
+			}
+			AluRR(0x84, REG_RAX, REG_RAX);          // test al, al
+			{
+				size_t noexception = JccForward(CC_E);
+				CallException(NULL);
+				Bind(noexception);
+			}
+			if(skip != 0)
+				Bind(skip);
+			break;
+		case 15:
+			switch(op)
+			{
+				case OPCODE_JMP:                    // jmp   k
+					Jmp(k);
+					break;
+				case OPCODE_RTS:                    // rts
+					Epilogue();
+					break;
+				case OPCODE_CALL:                   // call  k
+					SaveRegisters();
+					MovRR(REG_RDI, REG_CONTEXT);
+					MovRI32(REG_RSI, k);
+					StackOffset(REG_RDX);
+					Call((const void *)(&POVFPU_JITCall));
+					SseRM(SSE_SD, SSE_MOVSD_STORE, 0, REG_RSP, 0);
+					ReloadStack();
+					RestoreRegisters();
+					break;
+				case OPCODE_SYS1:                   // sys1  k
+					if(k >= POVFPU_Sys1TableSize)
+						return false;
+					SaveRegisters();
+					Call((const void *)(POVFPU_Sys1Table[k]));
+					SseRM(SSE_SD, SSE_MOVSD_STORE, 0, REG_RSP, 0);
+					RestoreRegisters();
+					break;
+				case OPCODE_SYS2:                   // sys2  k
+					if(k >= POVFPU_Sys2TableSize)
+						return false;
+					SaveRegisters();
+					Call((const void *)(POVFPU_Sys2Table[k]));
+					SseRM(SSE_SD, SSE_MOVSD_STORE, 0, REG_RSP, 0);
+					RestoreRegisters();
+					break;
+				case OPCODE_TRAP:                   // trap  k
+					if(k >= POVFPU_TrapTableSize)
+						return false;
+					SaveRegisters();
+					MovRR(REG_RDI, REG_CONTEXT);
+					MovRR(REG_RSI, REG_FRAME);
+					MovRI32(REG_RDX, fn);
+					Call((const void *)(POVFPU_TrapTable[k].fn));
+					SseRM(SSE_SD, SSE_MOVSD_STORE, 0, REG_RSP, 0);
+					ReloadStack();
+					RestoreRegisters();
+					break;
+				case OPCODE_TRAPS:                  // traps k
+					if(k >= POVFPU_TrapSTableSize)
+						return false;
+					SaveRegisters();
+					MovRR(REG_RDI, REG_CONTEXT);
+					MovRR(REG_RSI, REG_FRAME);
+					MovRI32(REG_RDX, fn);
+					StackOffset(REG_RCX);
+					Call((const void *)(POVFPU_TrapSTable[k].fn));
+					ReloadStack();
+					RestoreRegisters();
+					break;
+				case OPCODE_GROW:                   // grow  k
+					{
+						size_t slow, done;
+
+						// fast path: the stack is already large enough
+						StackOffset(REG_RAX);
+						AluRI(ALU_ADD, REG_RAX, k);
+						AluRI(ALU_CMP, REG_RAX, MAX_K);
+						slow = JccForward(CC_AE);
+						MovRM32(REG_RCX, REG_CONTEXT, offsetof(FPUContext, maxdblstacksize));
+						AluRR(0x39, REG_RAX, REG_RCX); // cmp rax, rcx
+						done = JccForward(CC_B);
+						Bind(slow);
+						SaveRegisters();
+						MovRR(REG_RDI, REG_CONTEXT);
+						MovRI32(REG_RSI, fn);
+						StackOffset(REG_RDX);
+						MovRI32(REG_RCX, k);
+						Call((const void *)(&POVFPU_JITGrow));
+						ReloadStack();
+						RestoreRegisters();
+						Bind(done);
+					}
+					break;
+				case OPCODE_PUSH:                   // push  k
+					StackOffset(REG_RAX);
+					AluRI(ALU_ADD, REG_RAX, k);
+					MovRM32(REG_RCX, REG_CONTEXT, offsetof(FPUContext, maxdblstacksize));
+					AluRR(0x39, REG_RAX, REG_RCX);  // cmp rax, rcx
+					skip = JccForward(CC_B);
+					CallException(JITStackOverflow);
+					Bind(skip);
+					AluRI(ALU_ADD, REG_SP, k * sizeof(DBL));
+					MovRR(REG_FRAME, REG_STACK);
+					AluRR(0x01, REG_FRAME, REG_SP); // add r15, r12
+					break;
+				case OPCODE_POP:                    // pop   k
+					StackOffset(REG_RAX);
+					AluRI(ALU_CMP, REG_RAX, k);
+					skip = JccForward(CC_AE);
+					CallException(JITStackUnderflow);
+					Bind(skip);
+					AluRI(ALU_SUB, REG_SP, k * sizeof(DBL));
+					MovRR(REG_FRAME, REG_STACK);
+					AluRR(0x01, REG_FRAME, REG_SP); // add r15, r12
+					break;
+				case OPCODE_NOP:                    // nop
+					break;
+				default:                            // jsr and integer instructions
+					return false;
+			}
+			break;
+		default:
+			return false;
+	}
+
+	return true;
+}
+
+
+/*****************************************************************************
+*
+* FUNCTION
+*
+*   NativeCodeGenerator instruction encoding
+*
+* DESCRIPTION
+*
+*   Minimal x86-64 encoder for the instructions used above.  Register
+*   numbers 0 - 15 refer to rax - r15 or xmm0 - xmm15 respectively.
+*
+* CHANGES
+*
+*   -
+*
+******************************************************************************/
+
+void NativeCodeGenerator::Dword(unsigned int d)
+{
+	for(int b = 0; b < 4; b++)
+		Byte(d >> (b * 8));
+}
+
+void NativeCodeGenerator::Qword(POV_ULONG q)
+{
+	for(int b = 0; b < 8; b++)
+		Byte((unsigned int)(q >> (b * 8)));
+}
+
+void NativeCodeGenerator::Rex(bool w, int reg, int base, bool force)
+{
+	unsigned int rex = 0x40 | (w ? 0x08 : 0) | ((reg & 8) >> 1) | ((base & 8) >> 3);
+
+	if((rex != 0x40) || (force == true))
+		Byte(rex);
+}
+
+void NativeCodeGenerator::ModRMMem(int reg, int base, int disp)
+{
+	Byte(0x80 | ((reg & 7) << 3) | (base & 7));
+	if((base & 7) == REG_RSP) // rsp and r12 need a SIB byte
+		Byte(0x24);
+	Dword((unsigned int)disp);
+}
+
+void NativeCodeGenerator::Push(int r)
+{
+	Rex(false, 0, r);
+	Byte(0x50 + (r & 7));
+}
+
+void NativeCodeGenerator::Pop(int r)
+{
+	Rex(false, 0, r);
+	Byte(0x58 + (r & 7));
+}
+
+void NativeCodeGenerator::MovRR(int dst, int src)
+{
+	Rex(true, src, dst);
+	Byte(0x89);
+	ModRMReg(src, dst);
+}
+
+void NativeCodeGenerator::MovRR32(int dst, int src)
+{
+	Rex(false, src, dst);
+	Byte(0x89);
+	ModRMReg(src, dst);
+}
+
+void NativeCodeGenerator::MovRI(int dst, POV_ULONG imm)
+{
+	Rex(true, 0, dst);
+	Byte(0xb8 + (dst & 7));
+	Qword(imm);
+}
+
+void NativeCodeGenerator::MovRI32(int dst, unsigned int imm)
+{
+	Rex(false, 0, dst);
+	Byte(0xb8 + (dst & 7));
+	Dword(imm);
+}
+
+void NativeCodeGenerator::MovRM(int dst, int base, int disp)
+{
+	Rex(true, dst, base);
+	Byte(0x8b);
+	ModRMMem(dst, base, disp);
+}
+
+void NativeCodeGenerator::MovRM32(int dst, int base, int disp)
+{
+	Rex(false, dst, base);
+	Byte(0x8b);
+	ModRMMem(dst, base, disp);
+}
+
+void NativeCodeGenerator::AluRR(int op, int dst, int src)
+{
+	// byte-sized operations (op with lowest bit clear) are only used for al, cl and dl
+	Rex((op & 1) != 0, src, dst);
+	Byte(op);
+	ModRMReg(src, dst);
+}
+
+void NativeCodeGenerator::AluRI(int ext, int dst, unsigned int imm)
+{
+	Rex(true, 0, dst);
+	Byte(0x81);
+	ModRMReg(ext, dst);
+	Dword(imm);
+}
+
+void NativeCodeGenerator::ShiftRI(int ext, int dst, unsigned int imm)
+{
+	Rex(true, 0, dst);
+	Byte(0xc1);
+	ModRMReg(ext, dst);
+	Byte(imm);
+}
+
+void NativeCodeGenerator::Setcc(int cc, int r)
+{
+	Byte(0x0f);
+	Byte(0x90 | cc);
+	ModRMReg(0, r);
+}
+
+void NativeCodeGenerator::Jcc(int cc, unsigned int target)
+{
+	Fixup f;
+
+	Byte(0x0f);
+	Byte(0x80 | cc);
+	f.pos = code.size();
+	f.target = target;
+	fixups.push_back(f);
+	Dword(0);
+}
+
+void NativeCodeGenerator::Jmp(unsigned int target)
+{
+	Fixup f;
+
+	Byte(0xe9);
+	f.pos = code.size();
+	f.target = target;
+	fixups.push_back(f);
+	Dword(0);
+}
+
+size_t NativeCodeGenerator::JccForward(int cc)
+{
+	Byte(0x0f);
+	Byte(0x80 | cc);
+	Dword(0);
+
+	return code.size() - 4;
+}
+
+void NativeCodeGenerator::Bind(size_t pos)
+{
+	unsigned int rel = (unsigned int)(code.size() - (pos + 4));
+
+	for(int b = 0; b < 4; b++)
+		code[pos + b] = (unsigned char)(rel >> (b * 8));
+}
+
+void NativeCodeGenerator::Call(const void *fnptr)
+{
+	MovRI(REG_RAX, (POV_ULONG)(size_t)fnptr);
+	Byte(0xff);                 // call rax
+	Byte(0xd0);
+	Vzeroupper();
+}
+
+void NativeCodeGenerator::Vzeroupper()
+{
+	if(avx == false)
+		return;
+
+	Byte(0xc5);                 // vzeroupper
+	Byte(0xf8);
+	Byte(0x77);
+}
+
+void NativeCodeGenerator::SseRR(int prefix, int op, int reg, int rm)
+{
+	Byte(prefix);
+	Rex(false, reg, rm);
+	Byte(0x0f);
+	Byte(op);
+	ModRMReg(reg, rm);
+}
+
+void NativeCodeGenerator::SseRM(int prefix, int op, int reg, int base, int disp)
+{
+	Byte(prefix);
+	Rex(false, reg, base);
+	Byte(0x0f);
+	Byte(op);
+	ModRMMem(reg, base, disp);
+}
+
+void NativeCodeGenerator::MovqXR(int xmm, int gpr)
+{
+	Byte(0x66);
+	Rex(true, xmm, gpr);
+	Byte(0x0f);
+	Byte(0x6e);
+	ModRMReg(xmm, gpr);
+}
+
+
+/*****************************************************************************
+*
+* FUNCTION
+*
+*   NativeCodeGenerator code sequences
+*
+* DESCRIPTION
+*
+*   Frame setup and the sequences shared by several instructions.
+*
+* CHANGES
+*
+*   -
+*
+******************************************************************************/
+
+void NativeCodeGenerator::Prologue()
+{
+	// the generated code uses legacy SSE encodings, so leave the upper halves
+	// of the ymm registers clean to avoid the SSE/AVX transition penalty
+	Vzeroupper();
+
+	// five pushes re-align the stack to 16 bytes, the spill area keeps it aligned
+	Push(REG_RBX);
+	Push(REG_R12);
+	Push(REG_R13);
+	Push(REG_R14);
+	Push(REG_R15);
+	AluRI(ALU_SUB, REG_RSP, SPILL_AREA_SIZE);
+
+	MovRR(REG_CONTEXT, REG_RDI);
+	MovRR32(REG_SP, REG_RSI);
+	ShiftRI(4, REG_SP, 3);      // shl r12, 3
+	ReloadStack();
+	AluRR(0x31, REG_CCR, REG_CCR); // xor r14, r14
+}
+
+void NativeCodeGenerator::Epilogue()
+{
+	AluRI(ALU_ADD, REG_RSP, SPILL_AREA_SIZE);
+	Pop(REG_R15);
+	Pop(REG_R14);
+	Pop(REG_R13);
+	Pop(REG_R12);
+	Pop(REG_RBX);
+	Byte(0xc3);                 // ret
+}
+
+void NativeCodeGenerator::SaveRegisters()
+{
+	for(int r = 0; r < 8; r++)
+		SseRM(SSE_SD, SSE_MOVSD_STORE, r, REG_RSP, r * sizeof(DBL));
+}
+
+void NativeCodeGenerator::RestoreRegisters()
+{
+	for(int r = 0; r < 8; r++)
+		SseRM(SSE_SD, SSE_MOVSD_LOAD, r, REG_RSP, r * sizeof(DBL));
+}
+
+void NativeCodeGenerator::ReloadStack()
+{
+	MovRM(REG_STACK, REG_CONTEXT, offsetof(FPUContext, dblstackbase));
+	MovRR(REG_FRAME, REG_STACK);
+	AluRR(0x01, REG_FRAME, REG_SP); // add r15, r12
+}
+
+void NativeCodeGenerator::StackOffset(int dst)
+{
+	MovRR(dst, REG_SP);
+	ShiftRI(5, dst, 3);         // shr dst, 3
+}
+
+void NativeCodeGenerator::LoadConstant(int xmm, DBL v)
+{
+	POV_ULONG bits;
+
+	memcpy(&bits, &v, sizeof(bits));
+	LoadBits(xmm, bits);
+}
+
+void NativeCodeGenerator::LoadBits(int xmm, POV_ULONG bits)
+{
+	MovRI(REG_RAX, bits);
+	MovqXR(xmm, REG_RAX);
+}
+
+// sets al to the result of comparing xmm registers a and b, false if unordered except for PRED_NE
+void NativeCodeGenerator::FloatPredicate(int pred, int a, int b)
+{
+	switch(pred)
+	{
+		case PRED_EQ:
+			SseRR(SSE_PD, SSE_UCOMISD, a, b);
+			Setcc(CC_E, REG_RAX);
+			Setcc(CC_NP, REG_RCX);
+			AluRR(0x20, REG_RAX, REG_RCX); // and al, cl
+			break;
+		case PRED_NE:
+			SseRR(SSE_PD, SSE_UCOMISD, a, b);
+			Setcc(CC_NE, REG_RAX);
+			Setcc(CC_P, REG_RCX);
+			AluRR(0x08, REG_RAX, REG_RCX); // or al, cl
+			break;
+		case PRED_LT:
+			SseRR(SSE_PD, SSE_UCOMISD, b, a);
+			Setcc(CC_A, REG_RAX);
+			break;
+		case PRED_LE:
+			SseRR(SSE_PD, SSE_UCOMISD, b, a);
+			Setcc(CC_AE, REG_RAX);
+			break;
+		case PRED_GT:
+			SseRR(SSE_PD, SSE_UCOMISD, a, b);
+			Setcc(CC_A, REG_RAX);
+			break;
+		case PRED_GE:
+			SseRR(SSE_PD, SSE_UCOMISD, a, b);
+			Setcc(CC_AE, REG_RAX);
+			break;
+	}
+}
+
+// converts the boolean in al to 0.0 or 1.0
+void NativeCodeGenerator::PredicateToRegister(int xmm)
+{
+	Byte(0x0f);                 // movzx eax, al
+	Byte(0xb6);
+	ModRMReg(REG_RAX, REG_RAX);
+	SseRR(SSE_SD, SSE_CVTSI2SD, xmm, REG_RAX);
+}
+
+// CC = ((c > d) << 1) | (c == d), exactly like the interpreter
+void NativeCodeGenerator::SetCCR(int c, int d)
+{
+	SseRR(SSE_PD, SSE_UCOMISD, c, d);
+	Setcc(CC_A, REG_RAX);
+	Setcc(CC_E, REG_RCX);
+	Setcc(CC_NP, REG_RDX);
+	AluRR(0x20, REG_RCX, REG_RDX);  // and cl, dl
+	AluRR(0x00, REG_RAX, REG_RAX);  // add al, al
+	AluRR(0x08, REG_RAX, REG_RCX);  // or al, cl
+	Rex(false, REG_CCR, REG_RAX);   // movzx r14d, al
+	Byte(0x0f);
+	Byte(0xb6);
+	ModRMReg(REG_CCR, REG_RAX);
+}
+
+// compares CC for the condition of seq ... sge and beq ... bge, returns the condition code to test
+int NativeCodeGenerator::TestCCR(unsigned int cond)
+{
+	static const unsigned int value[6] = { 1, 1, 2, 1, 0, 1 };
+	static const int cc[6] = { CC_E, CC_NE, CC_E, CC_AE, CC_E, CC_BE };
+
+	Rex(false, 0, REG_CCR);     // cmp r14d, value
+	Byte(0x83);
+	ModRMReg(ALU_CMP, REG_CCR);
+	Byte(value[cond]);
+
+	return cc[cond];
+}
+
+void NativeCodeGenerator::CallException(const char *msg)
+{
+	SaveRegisters();
+	MovRR(REG_RDI, REG_CONTEXT);
+	MovRI32(REG_RSI, fn);
+	MovRI(REG_RDX, (POV_ULONG)(size_t)msg);
+	Call((const void *)(&POVFPU_Exception));
+	RestoreRegisters();
+}
+
+// Rd = fmod(Rd, Rs), or fmod(Rd, v) if s is negative
+void NativeCodeGenerator::CallMod(int d, int s, DBL v)
+{
+	SaveRegisters();
+	SseRM(SSE_SD, SSE_MOVSD_LOAD, 0, REG_RSP, d * sizeof(DBL));
+	if(s >= 0)
+		SseRM(SSE_SD, SSE_MOVSD_LOAD, 1, REG_RSP, s * sizeof(DBL));
+	else
+		LoadConstant(1, v);
+	Call((const void *)(POVFPU_Sys2Table[TRAP_SYS2_MOD]));
+	SseRM(SSE_SD, SSE_MOVSD_STORE, 0, REG_RSP, d * sizeof(DBL));
+	RestoreRegisters();
+}
+
+#endif // SYS_FUNCTION_JIT
+
+
+/*****************************************************************************
+*
+* FUNCTION
+*
+*   POVFPU_JITAvailable
+*
+* INPUT
+*   
+* OUTPUT
+*   
+* RETURNS
+*
+*   bool - true if native code generation is supported on this platform
+*   
+* DESCRIPTION
+*
+*   -
+*
+* CHANGES
+*
+*   -
+*
+******************************************************************************/
+
+bool POVFPU_JITAvailable()
+{
+	return (SYS_FUNCTION_JIT == 1);
+}
+
+
+/*****************************************************************************
+*
+* FUNCTION
+*
+*   POVFPU_JITCompile
+*
+* INPUT
+*
+*   f      - function to translate
+*   fn     - function reference number
+*   consts - constant table of the function VM
+*   
+* OUTPUT
+*
+*   codesize - size of the generated code in bytes
+*   
+* RETURNS
+*
+*   JITFunction - native entry point or NULL if the function has to be
+*                 interpreted
+*   
+* DESCRIPTION
+*
+*   Translates a function to native code and places it in executable
+*   memory.
+*
+* CHANGES
+*
+*   -
+*
+******************************************************************************/
+
+JITFunction POVFPU_JITCompile(const FunctionCode *f, FUNCTION fn, const vector<DBL>& consts, size_t *codesize)
+{
+#if (SYS_FUNCTION_JIT == 1)
+	NativeCodeGenerator generator(f, fn, consts);
+
+	if(generator.Translate() == false)
+		return NULL;
+
+	const vector<unsigned char>& code(generator.GetCode());
+	size_t size = MAPPING_SIZE(code.size(), (size_t)sysconf(_SC_PAGESIZE));
+	void *mem = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, -1, 0);
+
+	if(mem == MAP_FAILED)
+		return NULL;
+
+	memcpy(mem, &code[0], code.size());
+
+	if(mprotect(mem, size, PROT_READ | PROT_EXEC) != 0)
+	{
+		munmap(mem, size);
+		return NULL;
+	}
+
+	*codesize = code.size();
+
+	return reinterpret_cast<JITFunction>(mem);
+#else
+	return NULL;
+#endif
+}
+
+
+/*****************************************************************************
+*
+* FUNCTION
+*
+*   POVFPU_JITRelease
+*
+* INPUT
+*
+*   code     - native entry point returned by POVFPU_JITCompile
+*   codesize - size returned by POVFPU_JITCompile
+*   
+* OUTPUT
+*   
+* RETURNS
+*   
+* DESCRIPTION
+*
+*   Frees the executable memory of a function.
+*
+* CHANGES
+*
+*   -
+*
+******************************************************************************/
+
+void POVFPU_JITRelease(JITFunction code, size_t codesize)
+{
+#if (SYS_FUNCTION_JIT == 1)
+	if(code != NULL)
+		munmap(reinterpret_cast<void *>(code), MAPPING_SIZE(codesize, (size_t)sysconf(_SC_PAGESIZE)));
+#endif
+}
+
+
+/*****************************************************************************
+*
+* FUNCTION
+*
+*   POVFPU_JITCall
+*
+* INPUT
+*
+*   fn - function reference number
+*   sp - stack offset of the first function parameter
+*   
+* OUTPUT
+*   
+* RETURNS
+*
+*   DBL - result found in R0
+*   
+* DESCRIPTION
+*
+*   Executes the call instruction of native code.  The called function
+*   runs natively if it has been translated, otherwise in the interpreter.
+*
+* CHANGES
+*
+*   -
+*
+******************************************************************************/
+
+DBL POVFPU_JITCall(FPUContext *context, FUNCTION fn, unsigned int sp)
+{
+	JITFunction native = context->functionvm->functions[fn].native;
+
+	if(native != NULL)
+		return native(context, sp);
+
+	return POVFPU_RunInterpreted(context, fn, sp);
+}
+
+}
@@ -289,6 +289,8 @@ Density of instruction set: 916 / 1024 = 0.8945
 #include <limits.h>
 #include <algorithm>
 
+#include <boost/date_time/posix_time/posix_time.hpp>
+
 #define DEBUG_DEFAULTCPU 0
 #define SUPPORT_INTEGER_INSTRUCTIONS 0
 
@@ -452,6 +454,10 @@ namespace pov
 * Local functions
 ******************************************************************************/
 
+bool POVFPU_RunLanes(FPUContext *context, FUNCTION fn, unsigned int n, DBL *results);
+static void POVFPU_ReserveBatchStack(FPUContext *context, unsigned int size);
+static bool POVFPU_TestCCR(unsigned int cc, unsigned int ccr);
+
 SYS_MATH_RETURN math_int(SYS_MATH_PARAM i);
 SYS_MATH_RETURN math_div(SYS_MATH_PARAM i1, SYS_MATH_PARAM i2);
 
@@ -643,7 +649,8 @@ SYS_MATH_RETURN math_div(SYS_MATH_PARAM i1, SYS_MATH_PARAM i2)
 *
 ******************************************************************************/
 
-FunctionVM::FunctionVM()
+FunctionVM::FunctionVM() :
+	jit(false)
 {
 	// default constants are 0 and 1
 	AddConstant(0.0);
@@ -727,6 +734,7 @@ void FunctionVM::Reset()
 		if(i->reference_count > 0) // ignore the reference count [trf]
 		{
 			SYS_DELETE_FUNCTION(&(*i));
+			ReleaseNative(*i);
 			FNCode_Delete(&(i->fn));
 			i->reference_count = 0;
 		}
@@ -734,6 +742,7 @@ void FunctionVM::Reset()
 
 	functions.clear();
 	nextUnreferenced = MAX_FN;
+	jitStats.clear();
 
 	boost::recursive_mutex::scoped_lock lock(contextMutex);
 
@@ -1092,8 +1101,14 @@ FUNCTION FunctionVM::AddFunction(FunctionCode *f)
 
 	functions[fn].fn = *f;
 	functions[fn].reference_count = 1;
+	functions[fn].native = NULL;
+	functions[fn].native_size = 0;
+	functions[fn].batch = IsBatchable(fn);
 	SYS_ADD_FUNCTION(fn);
 
+	if(jit == true)
+		CompileNative(fn);
+
 	return fn;
 }
 
@@ -1142,6 +1157,7 @@ void FunctionVM::RemoveFunction(FUNCTION fn)
 			unsigned int i = 0;
 
 			SYS_DELETE_FUNCTION(&f);
+			ReleaseNative(functions[fn]);
 			for(i = 0; i < f.fn.program_size; i++)
 			{
 				if(GET_OP(f.fn.program[i]) == OPCODE_CALL)
@@ -1157,6 +1173,192 @@ void FunctionVM::RemoveFunction(FUNCTION fn)
 }
 
 
+/*****************************************************************************
+*
+* FUNCTION
+*
+*   FunctionVM::SetJIT
+*
+* INPUT
+*
+*   enable - translate functions to native code when they are added
+*   
+* OUTPUT
+*   
+* RETURNS
+*   
+* DESCRIPTION
+*
+*   Enables or disables native code generation for functions added from
+*   now on.  Has no effect on platforms without a native code generator.
+*
+* CHANGES
+*
+*   -
+*
+******************************************************************************/
+
+void FunctionVM::SetJIT(bool enable)
+{
+	jit = enable && POVFPU_JITAvailable();
+}
+
+
+/*****************************************************************************
+*
+* FUNCTION
+*
+*   FunctionVM::CompileNative
+*
+* INPUT
+*
+*   fn - function reference number
+*   
+* OUTPUT
+*   
+* RETURNS
+*   
+* DESCRIPTION
+*
+*   Translates a function to native code and records the time it took.
+*   Functions the code generator does not support keep running in the
+*   interpreter.
+*
+* CHANGES
+*
+*   -
+*
+******************************************************************************/
+
+void FunctionVM::CompileNative(FUNCTION fn)
+{
+	FunctionEntry& f = functions[fn];
+	JITStatistics stat;
+	boost::posix_time::ptime start(boost::posix_time::microsec_clock::universal_time());
+
+	f.native = POVFPU_JITCompile(&f.fn, fn, consts, &f.native_size);
+
+	stat.compiletime = (boost::posix_time::microsec_clock::universal_time() - start).total_microseconds();
+	if(f.fn.name != NULL)
+		stat.name = f.fn.name;
+	stat.instructions = f.fn.program_size;
+	stat.codesize = ((f.native != NULL) ? f.native_size : 0);
+
+	jitStats.push_back(stat);
+}
+
+
+/*****************************************************************************
+*
+* FUNCTION
+*
+*   FunctionVM::ReleaseNative
+*
+* INPUT
+*
+*   f - function entry
+*   
+* OUTPUT
+*   
+* RETURNS
+*   
+* DESCRIPTION
+*
+*   Frees the native code of a function, if any.
+*
+* CHANGES
+*
+*   -
+*
+******************************************************************************/
+
+void FunctionVM::ReleaseNative(FunctionEntry& f)
+{
+	if(f.native != NULL)
+		POVFPU_JITRelease(f.native, f.native_size);
+
+	f.native = NULL;
+	f.native_size = 0;
+}
+
+
+/*****************************************************************************
+*
+* FUNCTION
+*
+*   FunctionVM::IsBatchable
+*
+* INPUT
+*
+*   fn - function reference number
+*   
+* OUTPUT
+*   
+* RETURNS
+*
+*   bool - true if POVFPU_RunBatch may evaluate the function lane by lane
+*   
+* DESCRIPTION
+*
+*   Functions qualify if they neither write global variables, use jsr or
+*   the integer instruction set, nor call traps that write to the stack.
+*   Called functions have to qualify as well.
+*
+* CHANGES
+*
+*   -
+*
+******************************************************************************/
+
+bool FunctionVM::IsBatchable(FUNCTION fn)
+{
+	const FunctionCode& f = functions[fn].fn;
+
+	for(unsigned int pc = 0; pc < f.program_size; pc++)
+	{
+		unsigned int op = GET_OP(f.program[pc]);
+		unsigned int k = GET_K(f.program[pc]);
+
+		if((op >> 6) < 15)
+		{
+			if(((op >> 3) == ((12 << 3) | 0)) || ((op >> 3) == ((9 << 3) | 7)))
+				return false; // store to global or undefined instruction
+			continue;
+		}
+
+		switch(op)
+		{
+			case OPCODE_JMP:
+			case OPCODE_RTS:
+			case OPCODE_GROW:
+			case OPCODE_PUSH:
+			case OPCODE_POP:
+				break;
+			case OPCODE_SYS1:
+				if(k >= POVFPU_Sys1TableSize)
+					return false;
+				break;
+			case OPCODE_SYS2:
+				if(k >= POVFPU_Sys2TableSize)
+					return false;
+				break;
+			case OPCODE_TRAP:
+				if(k >= POVFPU_TrapTableSize)
+					return false;
+				break;
+			case OPCODE_CALL:
+				if((k >= functions.size()) || (k == fn) || (functions[k].batch == false))
+					return false;
+				break;
+			default:
+				return false;
+		}
+	}
+
+	return true;
+}
+
+
 /*****************************************************************************
 *
 * FUNCTION
@@ -1196,6 +1398,8 @@ FPUContext *FunctionVM::NewContext(TraceThreadData *td)
 	context->pstackbase = (StackFrame *)POV_MALLOC(sizeof(StackFrame) * MAX_CALL_STACK_SIZE, "fn: pstack");
 	context->functionvm = this;
 	context->threaddata = td;
+	context->batchstackbase = NULL;
+	context->maxbatchstacksize = 0;
 
 	#if (SYS_FUNCTIONS == 1)
 	context->dblstack = context->dblstackbase;
@@ -1241,6 +1445,8 @@ void FunctionVM::DeleteContext(FPUContext *context)
 
 	contexts.erase(context);
 
+	if(context->batchstackbase != NULL)
+		POV_FREE(context->batchstackbase);
 	POV_FREE(context->dblstackbase);
 	POV_FREE(context->pstackbase);
 	POV_FREE(context);
@@ -1327,7 +1533,7 @@ void POVFPU_Exception(FPUContext *context, FUNCTION fn, const char *msg)
 *   
 * DESCRIPTION
 *
-*   Execute a compiled function.
+*   Execute a compiled function, using its native code if available.
 *
 * CHANGES
 *
@@ -1336,6 +1542,50 @@ void POVFPU_Exception(FPUContext *context, FUNCTION fn, const char *msg)
 ******************************************************************************/
 
 DBL POVFPU_RunDefault(FPUContext *context, FUNCTION fn)
+{
+	JITFunction native = context->functionvm->functions[fn].native;
+
+	context->threaddata->Stats()[Ray_Function_VM_Calls]++;
+
+	if(native != NULL)
+		return native(context, 0);
+
+	return POVFPU_RunInterpreted(context, fn, 0);
+}
+
+
+/*****************************************************************************
+*
+* FUNCTION
+*
+*   POVFPU_RunInterpreted
+*
+* INPUT
+*
+*   fn - function reference number
+*   sp - stack offset of the first function parameter
+*   
+* OUTPUT
+*   
+* RETURNS
+*
+*   DBL - result found in R0
+*
+* AUTHOR
+*
+*   Thorsten Froehlich
+*   
+* DESCRIPTION
+*
+*   Execute a compiled function in the interpreter.
+*
+* CHANGES
+*
+*   -
+*
+******************************************************************************/
+
+DBL POVFPU_RunInterpreted(FPUContext *context, FUNCTION fn, unsigned int sp)
 {
 	vector<FunctionEntry>& functions(context->functionvm->functions);
 	vector<DBL>& consts(context->functionvm->consts);
@@ -1348,7 +1598,6 @@ DBL POVFPU_RunDefault(FPUContext *context, FUNCTION fn)
 	unsigned int k = 0;
 	unsigned int pc = 0;
 	unsigned int ccr = 0;
-	unsigned int sp = 0;
 	unsigned int psp = 0;
 
 #if (SUPPORT_INTEGER_INSTRUCTIONS == 1)
@@ -1364,8 +1613,6 @@ DBL POVFPU_RunDefault(FPUContext *context, FUNCTION fn)
 #endif
 #endif
 
-	context->threaddata->Stats()[Ray_Function_VM_Calls]++;
-
 	program = functions[fn].fn.program;
 
 	while(true)
@@ -1613,4 +1860,466 @@ DBL POVFPU_RunDefault(FPUContext *context, FUNCTION fn)
 #endif
 }
 
+
+/*****************************************************************************
+*
+* FUNCTION
+*
+*   POVFPU_RunBatchDefault
+*
+* INPUT
+*
+*   fn     - function reference number
+*   points - points to evaluate the function at, passed as x, y and z
+*   count  - number of points
+*   
+* OUTPUT
+*
+*   results - function value at each point
+*   
+* RETURNS
+*   
+* DESCRIPTION
+*
+*   Execute a compiled function at several points.  Up to POVFPU_BATCH_SIZE
+*   points are evaluated side by side, decoding each instruction only once
+*   for all of them.  Functions translated to native code, functions that
+*   do not qualify and groups of points that take different branches are
+*   evaluated one point after another.
+*
+* CHANGES
+*
+*   -
+*
+******************************************************************************/
+
+void POVFPU_RunBatchDefault(FPUContext *context, FUNCTION fn, const VECTOR *points, DBL *results, unsigned int count)
+{
+	JITFunction native = context->functionvm->functions[fn].native;
+	bool batch = context->functionvm->functions[fn].batch;
+	unsigned int i;
+
+	context->threaddata->Stats()[Ray_Function_VM_Calls] += count;
+
+	for(unsigned int base = 0; base < count; base += POVFPU_BATCH_SIZE)
+	{
+		unsigned int n = min(count - base, (unsigned int)POVFPU_BATCH_SIZE);
+
+		// native code is faster than the interpreter even when the interpreter
+		// works on several points at once, so it is only used for the rest
+		if((native == NULL) && (batch == true) && (n > 1))
+		{
+			DBL *stack;
+
+			POVFPU_ReserveBatchStack(context, 3);
+			stack = context->batchstackbase;
+
+			for(i = 0; i < n; i++)
+			{
+				stack[X * POVFPU_BATCH_SIZE + i] = points[base + i][X];
+				stack[Y * POVFPU_BATCH_SIZE + i] = points[base + i][Y];
+				stack[Z * POVFPU_BATCH_SIZE + i] = points[base + i][Z];
+			}
+
+			if(POVFPU_RunLanes(context, fn, n, &results[base]) == true)
+				continue;
+		}
+
+		for(i = 0; i < n; i++)
+		{
+			context->SetLocal(X, points[base + i][X]);
+			context->SetLocal(Y, points[base + i][Y]);
+			context->SetLocal(Z, points[base + i][Z]);
+
+			if(native != NULL)
+				results[base + i] = native(context, 0);
+			else
+				results[base + i] = POVFPU_RunInterpreted(context, fn, 0);
+		}
+	}
+}
+
+
+/*****************************************************************************
+*
+* FUNCTION
+*
+*   POVFPU_RunLanes
+*
+* INPUT
+*
+*   fn - function reference number
+*   n  - number of lanes, at most POVFPU_BATCH_SIZE
+*   
+* OUTPUT
+*
+*   results - R0 of each lane
+*   
+* RETURNS
+*
+*   bool - false if the lanes took different branches
+*   
+* DESCRIPTION
+*
+*   Execute a compiled function for several sets of parameters at once.
+*   Every register holds one value per lane and the stack holds
+*   POVFPU_BATCH_SIZE values per position, so that the loops over the lanes
+*   can use SIMD instructions.  The parameters have to be in the batch
+*   stack already.  Only functions marked as batchable may be passed.
+*
+* CHANGES
+*
+*   -
+*
+******************************************************************************/
+
+bool POVFPU_RunLanes(FPUContext *context, FUNCTION fn, unsigned int n, DBL *results)
+{
+	vector<FunctionEntry>& functions(context->functionvm->functions);
+	vector<DBL>& consts(context->functionvm->consts);
+	vector<DBL>& globals(context->functionvm->globals);
+	StackFrame *pstack = context->pstackbase;
+	DBL *stack = context->batchstackbase;
+	DBL r[8][POVFPU_BATCH_SIZE];
+	unsigned int ccr[POVFPU_BATCH_SIZE];
+	Instruction *program = functions[fn].fn.program;
+	unsigned int pc = 0;
+	unsigned int psp = 0;
+	unsigned int sp = 0;
+	unsigned int i;
+
+	while(true)
+	{
+		unsigned int op = GET_OP(program[pc]);
+		unsigned int k = GET_K(program[pc]);
+		unsigned int b = (op >> 3) & 7;
+		DBL *rs = r[b];
+		DBL *rd = r[op & 7];
+
+		switch(op >> 6)
+		{
+			case 0:                                             // add   Rs, Rd
+				for(i = 0; i < n; i++)
+					rd[i] = rd[i] + rs[i];
+				break;
+			case 1:                                             // sub   Rs, Rd
+				for(i = 0; i < n; i++)
+					rd[i] = rd[i] - rs[i];
+				break;
+			case 2:                                             // mul   Rs, Rd
+				for(i = 0; i < n; i++)
+					rd[i] = rd[i] * rs[i];
+				break;
+			case 3:                                             // div   Rs, Rd
+				for(i = 0; i < n; i++)
+					rd[i] = rd[i] / rs[i];
+				break;
+			case 4:                                             // mod   Rs, Rd
+				for(i = 0; i < n; i++)
+					rd[i] = fmod(rd[i], rs[i]);
+				break;
+			case 5:                                             // move  Rs, Rd
+				for(i = 0; i < n; i++)
+					rd[i] = rs[i];
+				break;
+			case 6:                                             // cmp   Rs, Rd
+				for(i = 0; i < n; i++)
+					ccr[i] = (((rs[i] > rd[i]) & 1) << 1) | ((rs[i] == rd[i]) & 1);
+				break;
+			case 7:                                             // neg   Rs, Rd
+				for(i = 0; i < n; i++)
+					rd[i] = -rs[i];
+				break;
+			case 8:                                             // abs   Rs, Rd
+				for(i = 0; i < n; i++)
+					rd[i] = fabs(rs[i]);
+				break;
+			case 9:
+			{
+				DBL c = consts[k];
+
+				switch(b)
+				{
+					case 0:                                     // addi  k, Rd
+						for(i = 0; i < n; i++)
+							rd[i] = rd[i] + c;
+						break;
+					case 1:                                     // subi  k, Rd
+						for(i = 0; i < n; i++)
+							rd[i] = rd[i] - c;
+						break;
+					case 2:                                     // muli  k, Rd
+						for(i = 0; i < n; i++)
+							rd[i] = rd[i] * c;
+						break;
+					case 3:                                     // divi  k, Rd
+						for(i = 0; i < n; i++)
+							rd[i] = rd[i] / c;
+						break;
+					case 4:                                     // modi  k, Rd
+						for(i = 0; i < n; i++)
+							rd[i] = fmod(rd[i], c);
+						break;
+					case 5:                                     // loadi k, Rd
+						for(i = 0; i < n; i++)
+							rd[i] = c;
+						break;
+					case 6:                                     // cmpi  k, Rs
+						for(i = 0; i < n; i++)
+							ccr[i] = (((c > rd[i]) & 1) << 1) | ((c == rd[i]) & 1);
+						break;
+				}
+				break;
+			}
+			case 10:
+				switch(b)
+				{
+					case 0:                                     // seq   Rd
+						for(i = 0; i < n; i++)
+							rd[i] = (ccr[i] == 1);
+						break;
+					case 1:                                     // sne   Rd
+						for(i = 0; i < n; i++)
+							rd[i] = (ccr[i] != 1);
+						break;
+					case 2:                                     // slt   Rd
+						for(i = 0; i < n; i++)
+							rd[i] = (ccr[i] == 2);
+						break;
+					case 3:                                     // sle   Rd
+						for(i = 0; i < n; i++)
+							rd[i] = (ccr[i] >= 1);
+						break;
+					case 4:                                     // sgt   Rd
+						for(i = 0; i < n; i++)
+							rd[i] = (ccr[i] == 0);
+						break;
+					case 5:                                     // sge   Rd
+						for(i = 0; i < n; i++)
+							rd[i] = (ccr[i] <= 1);
+						break;
+					case 6:                                     // teq   Rd
+						for(i = 0; i < n; i++)
+							rd[i] = (rd[i] == 0.0);
+						break;
+					case 7:                                     // tne   Rd
+						for(i = 0; i < n; i++)
+							rd[i] = (rd[i] != 0.0);
+						break;
+				}
+				break;
+			case 11:
+				if(b == 0)                                      // load  0(k), Rd
+				{
+					DBL c = globals[k];
+
+					for(i = 0; i < n; i++)
+						rd[i] = c;
+				}
+				else if(b == 1)                                 // load  SP(k), Rd
+				{
+					const DBL *lane = &stack[(sp + k) * POVFPU_BATCH_SIZE];
+
+					for(i = 0; i < n; i++)
+						rd[i] = lane[i];
+				}
+				break;
+			case 12:
+				if(b == 1)                                      // store Rs, SP(k)
+				{
+					DBL *lane = &stack[(sp + k) * POVFPU_BATCH_SIZE];
+
+					for(i = 0; i < n; i++)
+						lane[i] = rd[i];
+				}
+				break;
+			case 13:                                            // bxx   k
+				if(b <= 5)
+				{
+					bool taken = POVFPU_TestCCR(b, ccr[0]);
+
+					for(i = 1; i < n; i++)
+					{
+						if(POVFPU_TestCCR(b, ccr[i]) != taken)
+							return false;
+					}
+
+					if(taken == true)
+						pc = k - 1;
+				}
+				break;
+			case 14:
+				for(i = 0; i < n; i++)
+				{
+					bool exception = false;
+
+					switch(b)
+					{
+						case 0: exception = (rd[i] == 0.0); break;  // xeq   Rd
+						case 1: exception = (rd[i] != 0.0); break;  // xne   Rd
+						case 2: exception = (rd[i] < 0.0); break;   // xlt   Rd
+						case 3: exception = (rd[i] <= 0.0); break;  // xle   Rd
+						case 4: exception = (rd[i] > 0.0); break;   // xgt   Rd
+						case 5: exception = (rd[i] >= 0.0); break;  // xge   Rd
+						case 6: exception = ((r[0][i] == 0.0) && (rd[i] == 0.0)); break; // xdz   R0, Rd
+					}
+
+					if(exception == true)
+					{
+						POVFPU_Exception(context, fn);
+						break;
+					}
+				}
+				break;
+			case 15:
+				switch(op)
+				{
+					case OPCODE_JMP:                            // jmp   k
+						pc = k;
+						continue; // prevent increment of pc
+					case OPCODE_RTS:                            // rts
+						if(psp == 0)
+						{
+							for(i = 0; i < n; i++)
+								results[i] = r[0][i];
+							return true;
+						}
+						psp--;
+						pc = pstack[psp].pc; // old position, will be incremented
+						fn = pstack[psp].fn;
+						program = functions[fn].fn.program;
+						break;
+					case OPCODE_CALL:                           // call  k
+						pstack[psp].pc = pc;
+						pstack[psp].fn = fn;
+						psp++;
+						if(psp >= MAX_CALL_STACK_SIZE)
+							POVFPU_Exception(context, fn, "Maximum function evaluation recursion level reached.");
+						fn = k;
+						program = functions[fn].fn.program;
+						pc = 0;
+						continue; // prevent increment of pc
+					case OPCODE_SYS1:                           // sys1  k
+						for(i = 0; i < n; i++)
+							r[0][i] = POVFPU_Sys1Table[k](r[0][i]);
+						break;
+					case OPCODE_SYS2:                           // sys2  k
+						for(i = 0; i < n; i++)
+							r[0][i] = POVFPU_Sys2Table[k](r[0][i], r[1][i]);
+						break;
+					case OPCODE_TRAP:                           // trap  k
+						// traps only know about the scalar stack, so call them once per lane
+						for(i = 0; i < n; i++)
+						{
+							for(unsigned int j = 0; j < POVFPU_TrapTable[k].parameter_cnt; j++)
+								context->SetLocal(sp + j, stack[(sp + j) * POVFPU_BATCH_SIZE + i]);
+
+							r[0][i] = POVFPU_TrapTable[k].fn(context, &context->dblstackbase[sp], fn);
+						}
+						stack = context->batchstackbase;
+						break;
+					case OPCODE_GROW:                           // grow  k
+						if((unsigned int)((unsigned int)sp + (unsigned int)k) >= (unsigned int)MAX_K)
+							POVFPU_Exception(context, fn, "Stack full. Possible infinite recursive function call.");
+						else if(sp + k >= context->maxbatchstacksize)
+						{
+							POVFPU_ReserveBatchStack(context, sp + k + 1);
+							stack = context->batchstackbase;
+						}
+						break;
+					case OPCODE_PUSH:                           // push  k
+						if(sp + k >= context->maxbatchstacksize)
+							POVFPU_Exception(context, fn, "Function evaluation stack overflow.");
+						sp += k;
+						break;
+					case OPCODE_POP:                            // pop   k
+						if(k > sp)
+							POVFPU_Exception(context, fn, "Function evaluation stack underflow.");
+						sp -= k;
+						break;
+				}
+				break;
+		}
+
+		pc++;
+	}
+}
+
+
+/*****************************************************************************
+*
+* FUNCTION
+*
+*   POVFPU_ReserveBatchStack
+*
+* INPUT
+*
+*   size - number of stack positions needed
+*   
+* OUTPUT
+*   
+* RETURNS
+*   
+* DESCRIPTION
+*
+*   Grows the batch stack of a context to hold at least size positions.
+*
+* CHANGES
+*
+*   -
+*
+******************************************************************************/
+
+static void POVFPU_ReserveBatchStack(FPUContext *context, unsigned int size)
+{
+	if(size <= context->maxbatchstacksize)
+		return;
+
+	context->maxbatchstacksize = max(size, context->maxbatchstacksize + (unsigned int)256);
+	context->batchstackbase = (DBL *)POV_REALLOC(context->batchstackbase, sizeof(DBL) * POVFPU_BATCH_SIZE * context->maxbatchstacksize, "fn: batch stack");
+}
+
+
+/*****************************************************************************
+*
+* FUNCTION
+*
+*   POVFPU_TestCCR
+*
+* INPUT
+*
+*   cc  - condition of the branch instruction, 0 (beq) to 5 (bge)
+*   ccr - condition code register
+*   
+* OUTPUT
+*   
+* RETURNS
+*
+*   bool - true if the branch is taken
+*   
+* DESCRIPTION
+*
+*   -
+*
+* CHANGES
+*
+*   -
+*
+******************************************************************************/
+
+static bool POVFPU_TestCCR(unsigned int cc, unsigned int ccr)
+{
+	switch(cc)
+	{
+		case 0: return (ccr == 1);  // beq
+		case 1: return (ccr != 1);  // bne
+		case 2: return (ccr == 2);  // blt
+		case 3: return (ccr >= 1);  // ble
+		case 4: return (ccr == 0);  // bgt
+		case 5: return (ccr <= 1);  // bge
+	}
+
+	return false;
+}
+
 }
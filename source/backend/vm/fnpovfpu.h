@@ -111,12 +111,16 @@ struct FPUContext;
 
 #include "backend/frame.h"
 #include "backend/vm/fncode.h"
+#include "backend/vm/fnjit.h"
 
 namespace pov
 {
 
 #define MAX_CALL_STACK_SIZE 1024
 
+// number of points evaluated side by side by POVFPU_RunBatch
+#define POVFPU_BATCH_SIZE 16
+
 enum
 {
 	ITYPE_R = 0,
@@ -179,6 +183,9 @@ struct FunctionEntry
 		FUNCTION next_unreferenced; // valid if reference_count == 0
 	};
 	unsigned int reference_count;
+	JITFunction native;         // valid if reference_count != 0, NULL if not compiled to native code
+	size_t native_size;
+	bool batch;                 // valid if reference_count != 0, true if the function can be evaluated at several points at once
 	SYS_FUNCTION_ENTRY
 };
 
@@ -202,6 +209,8 @@ struct FPUContext
 	#if (SYS_FUNCTIONS == 1)
 	DBL *dblstack;
 	#endif
+	DBL *batchstackbase;            // POVFPU_BATCH_SIZE values per stack position, NULL until first used
+	unsigned int maxbatchstacksize; // in stack positions
 
 	void SetLocal(unsigned int k, DBL v);
 	DBL GetLocal(unsigned int k);
@@ -274,17 +283,40 @@ extern const unsigned int POVFPU_Sys2TableSize;
 
 void POVFPU_Exception(FPUContext *context, FUNCTION fn, const char *msg = NULL);
 DBL POVFPU_RunDefault(FPUContext *context, FUNCTION k);
+DBL POVFPU_RunInterpreted(FPUContext *context, FUNCTION k, unsigned int sp);
+void POVFPU_RunBatchDefault(FPUContext *context, FUNCTION k, const VECTOR *points, DBL *results, unsigned int count);
 
 class FunctionVM
 {
 		friend void POVFPU_Exception(FPUContext *, FUNCTION, const char *);
 		friend DBL POVFPU_RunDefault(FPUContext *, FUNCTION);
+		friend DBL POVFPU_RunInterpreted(FPUContext *, FUNCTION, unsigned int);
+		friend DBL POVFPU_JITCall(FPUContext *, FUNCTION, unsigned int);
+		friend void POVFPU_RunBatchDefault(FPUContext *, FUNCTION, const VECTOR *, DBL *, unsigned int);
+		friend bool POVFPU_RunLanes(FPUContext *, FUNCTION, unsigned int, DBL *);
 	public:
+		/// Native code generation result for one function.
+		struct JITStatistics
+		{
+			/// Function name, or empty for anonymous functions.
+			string name;
+			/// Number of VM instructions.
+			unsigned int instructions;
+			/// Size of the generated code in bytes, 0 if the function stays interpreted.
+			size_t codesize;
+			/// Time spent in the code generator in microseconds.
+			POV_LONG compiletime;
+		};
+
 		FunctionVM();
 		~FunctionVM();
 
 		void Reset();
 
+		void SetJIT(bool enable);
+		bool GetJIT() const { return jit; }
+		const vector<JITStatistics>& GetJITStatistics() const { return jitStats; }
+
 		void SetGlobal(unsigned int k, DBL v);
 		DBL GetGlobal(unsigned int k);
 
@@ -305,6 +337,12 @@ class FunctionVM
 		vector<DBL> globals;
 		vector<DBL> consts;
 		boost::recursive_mutex contextMutex;
+		bool jit;
+		vector<JITStatistics> jitStats;
+
+		bool IsBatchable(FUNCTION fn);
+		void CompileNative(FUNCTION fn);
+		void ReleaseNative(FunctionEntry& f);
 };
 
 }
@@ -205,6 +205,8 @@ enum
 	kPOVObjectClass_ElapsedTime         = 'ETim',
 
 	kPOVObjectClass_IsectStat           = 'ISta',
+	kPOVObjectClass_FunctionJITStat     = 'FJSt',
+	kPOVObjectClass_ParseProfileSite    = 'PfSt',
 	kPOVObjectClass_SceneCamera         = 'SCam',
 
 	kPOVObjectClass_ShellCommand        = 'SCmd',
@@ -320,6 +322,7 @@ enum
 
 	kPOVAttrib_PlatformData          = 'PlaD',
 	kPOVAttrib_MaxRenderThreads      = 'MRTh',
+	kPOVAttrib_RenderProcesses       = 'RPrc',
 	kPOVAttrib_SceneCamera           = 'SCam',
 
 	// universal use
@@ -417,6 +420,7 @@ enum
 	// options handled by scene/parser
 	kPOVAttrib_InputFile             = 'IFNa',
 	kPOVAttrib_IncludeHeader         = 'IncH',
+	kPOVAttrib_IncludeCachePath      = 'IncC',
 
 	kPOVAttrib_WarningLevel          = 'WLev',
 	kPOVAttrib_Declare               = 'Decl',
@@ -442,6 +446,7 @@ enum
 	kPOVAttrib_JitterAmount          = 'AAJA',
 	kPOVAttrib_AntialiasGamma        = 'AAGa',
 	kPOVAttrib_AntialiasGammaType    = 'AAGT', // currently not supported by code
+	kPOVAttrib_AntialiasTimeLimit    = 'AATL',
 	kPOVAttrib_Quality               = 'Qual',
 	kPOVAttrib_HighReproducibility   = 'HRep',
 
@@ -457,6 +462,9 @@ enum
 	kPOVAttrib_VistaBuffer           = 'VBuf', // currently not supported by code
 	kPOVAttrib_RemoveBounds          = 'RmBd',
 	kPOVAttrib_SplitUnions           = 'SplU',
+	kPOVAttrib_FunctionJIT           = 'FJIT',
+	kPOVAttrib_ParseProfile          = 'PPro',
+	kPOVAttrib_ParseProfileFile      = 'PPFi',
 
 	kPOVAttrib_CreateHistogram       = 'CHis', // currently not supported by code
 	kPOVAttrib_DrawVistas            = 'DrVi', // currently not supported by code
@@ -513,6 +521,31 @@ enum
 	kPOVAttrib_BSPAborts             = 'BAbo',
 	kPOVAttrib_BSPAverageAborts      = 'BAAb',
 	kPOVAttrib_BSPAverageAbortObjects = 'BAAO',
+	kPOVAttrib_BVHNodes              = 'VNod',
+	kPOVAttrib_BVHLeafNodes          = 'VLNo',
+	kPOVAttrib_BVHMaxObjects         = 'VMOb',
+	kPOVAttrib_BVHAverageObjects     = 'VAOb',
+	kPOVAttrib_BVHMaxDepth           = 'VMDe',
+	kPOVAttrib_BVHAverageDepth       = 'VADe',
+	kPOVAttrib_MeshTriangles         = 'MTri',
+	kPOVAttrib_MeshMemory            = 'MMem',
+	kPOVAttrib_FunctionJITStats      = 'FJSs',
+	kPOVAttrib_FunctionName          = 'FnNm',
+	kPOVAttrib_FunctionInstructions  = 'FnIn',
+	kPOVAttrib_FunctionCodeSize      = 'FnCS',
+	kPOVAttrib_FunctionCompileTime   = 'FnCT',
+	kPOVAttrib_ParseProfileSites     = 'PfSs',
+	kPOVAttrib_ProfileKind           = 'PfKd',
+	kPOVAttrib_ProfileName           = 'PfNm',
+	kPOVAttrib_ProfileFile           = 'PfFi',
+	kPOVAttrib_ProfileLine           = 'PfLn',
+	kPOVAttrib_ProfileCalls          = 'PfCl',
+	kPOVAttrib_ProfileIterations     = 'PfIt',
+	kPOVAttrib_ProfileTotalTime      = 'PfTT',
+	kPOVAttrib_ProfileSelfTime       = 'PfST',
+	kPOVAttrib_ProfileTokens         = 'PfTk',
+	kPOVAttrib_ProfileLookups        = 'PfLk',
+	kPOVAttrib_ProfileAllocations    = 'PfAl',
 
 	// statistics generated by view/render (radiosity)
 	kPOVAttrib_RadGatherCount        = 'RGCt',
@@ -527,6 +560,7 @@ enum
 	kPOVAttrib_RadFinalRayCount      = 'RYCF',
 	kPOVAttrib_RadOctreeNodes        = 'ROcN',
 	kPOVAttrib_RadOctreeLookups      = 'ROcL',
+	kPOVAttrib_RadOctreeContention   = 'ROcC',
 	kPOVAttrib_RadOctreeAccepts0     = 'ROc0',
 	kPOVAttrib_RadOctreeAccepts1     = 'ROc1',
 	kPOVAttrib_RadOctreeAccepts2     = 'ROc2',
@@ -628,6 +662,9 @@ enum
 	kPOVAttrib_CrackleCacheTest      = 'CrCT',
 	kPOVAttrib_CrackleCacheTestSuc   = 'CrCS',
 
+	kPOVAttrib_PatternCacheTest      = 'PaCT',
+	kPOVAttrib_PatternCacheTestSuc   = 'PaCS',
+
 	kPOVAttrib_ObjectIStats          = 'OISt',
 	kPOVAttrib_ISectsTests           = 'ITst',
 	kPOVAttrib_ISectsSucceeded       = 'ISuc',
@@ -650,6 +687,13 @@ enum
 	kPOVAttrib_RealTime              = 'ReaT',
 	kPOVAttrib_CPUTime               = 'CPUT',
 	kPOVAttrib_TimeSamples           = 'TSam',
+	kPOVAttrib_ThreadBlocks          = 'ThBl',
+	kPOVAttrib_ThreadSteals          = 'ThSt',
+	kPOVAttrib_ThreadIdleTime        = 'ThId',
+
+	// render process statistics
+	kPOVAttrib_IntStatistics         = 'ISts',
+	kPOVAttrib_FPStatistics          = 'FSts',
 
 	// parser progress
 	kPOVAttrib_CurrentTokenCount     = 'CTCo',
@@ -751,6 +795,7 @@ enum
 	kPOVList_Stat_VistaBufferTest,
 	kPOVList_Stat_RBezierTest,
 	kPOVList_Stat_OvusTest,
+	kPOVList_Stat_BlobGridTest,
 	kPOVList_Stat_Last
 };
 
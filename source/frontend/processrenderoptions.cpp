@@ -210,6 +210,7 @@ struct ProcessOptions::INI_Parser_Table RenderOptions_INI_Table[] =
 	{ "Antialias",           kPOVAttrib_Antialias,          kPOVMSType_Bool },
 	{ "Antialias_Threshold", kPOVAttrib_AntialiasThreshold, kPOVMSType_Float },
 	{ "Antialias_Gamma",     kPOVAttrib_AntialiasGamma,     kPOVMSType_Float },
+	{ "Antialias_Time_Limit",kPOVAttrib_AntialiasTimeLimit, kPOVMSType_Float },
 
 	{ "Bits_Per_Color",      kPOVAttrib_BitsPerColor,       kPOVMSType_Int },
 	{ "Bits_Per_Colour",     kPOVAttrib_BitsPerColor,       kPOVMSType_Int },
@@ -253,6 +254,7 @@ struct ProcessOptions::INI_Parser_Table RenderOptions_INI_Table[] =
 	{ "Final_Clock",         kPOVAttrib_FinalClock,         kPOVMSType_Float },
 	{ "Final_Frame",         kPOVAttrib_FinalFrame,         kPOVMSType_Int },
 	{ "Frame_Step",          kPOVAttrib_FrameStep,          kPOVMSType_Int },
+	{ "Function_JIT",        kPOVAttrib_FunctionJIT,        kPOVMSType_Bool },
 
 	{ "Grayscale_Output",    kPOVAttrib_GrayscaleOutput,    kPOVMSType_Bool },
 
@@ -265,6 +267,7 @@ struct ProcessOptions::INI_Parser_Table RenderOptions_INI_Table[] =
 	{ "Initial_Clock",       kPOVAttrib_InitialClock,       kPOVMSType_Float },
 	{ "Initial_Frame",       kPOVAttrib_InitialFrame,       kPOVMSType_Int },
 	{ "Input_File_Name",     kPOVAttrib_InputFile,          kPOVMSType_UCS2String },
+	{ "Include_Cache_Path",  kPOVAttrib_IncludeCachePath,   kPOVMSType_UCS2String },
 	{ "Include_Header",      kPOVAttrib_IncludeHeader,      kPOVMSType_UCS2String },
 	{ "Include_Ini",         kPOVAttrib_IncludeIni,         kUseSpecialHandler },
 
@@ -283,6 +286,8 @@ struct ProcessOptions::INI_Parser_Table RenderOptions_INI_Table[] =
 	{ "Output_To_File",      kPOVAttrib_OutputToFile,       kPOVMSType_Bool },
 
 	{ "Palette",             kPOVAttrib_Palette,            kUseSpecialHandler },
+	{ "Parse_Profile",       kPOVAttrib_ParseProfile,       kPOVMSType_Bool },
+	{ "Parse_Profile_File",  kPOVAttrib_ParseProfileFile,   kPOVMSType_UCS2String },
 	{ "Pause_When_Done",     kPOVAttrib_PauseWhenDone,      kPOVMSType_Bool },
 	{ "Post_Frame_Command",  kPOVAttrib_PostFrameCommand,   kUseSpecialHandler },
 	{ "Post_Frame_Return",   kPOVAttrib_PostFrameCommand,   kUseSpecialHandler },
@@ -308,6 +313,7 @@ struct ProcessOptions::INI_Parser_Table RenderOptions_INI_Table[] =
 	{ "Render_Console",      kPOVAttrib_RenderConsole,      kPOVMSType_Bool },
 	{ "Render_File",         kPOVAttrib_RenderFile,         kPOVMSType_UCS2String },
 	{ "Render_Pattern",      kPOVAttrib_RenderPattern,      kPOVMSType_Int },
+	{ "Render_Processes",    kPOVAttrib_RenderProcesses,    kPOVMSType_Int },
 
 	{ "Sampling_Method",     kPOVAttrib_SamplingMethod,     kPOVMSType_Int },
 	{ "Split_Unions",        kPOVAttrib_SplitUnions,        kPOVMSType_Bool },
@@ -392,6 +398,7 @@ struct ProcessOptions::Cmd_Parser_Table RenderOptions_Cmd_Table[] =
 
 	{ "I",   kPOVAttrib_InputFile,          kPOVMSType_UCS2String,  kNoParameter },
 
+	{ "JIT", kNoParameter,                  kNoParameter,           kPOVAttrib_FunctionJIT },
 	{ "J",   kPOVAttrib_JitterAmount,       kPOVMSType_Float,       kPOVAttrib_Jitter },
 	{ "J",   kNoParameter,                  kNoParameter,           kPOVAttrib_Jitter },
 
@@ -950,9 +950,22 @@ void ParserOptions(POVMS_Object& cppmsg, TextStreamBuffer *tsb)
 		tsb->printf("  Input file: %s\n", UCS2toASCIIString(ucs2buf).c_str());
 	else
 		tsb->printf("  Input file: %s (compatible to version %1.2f)\n", UCS2toASCIIString(ucs2buf).c_str(), (double)f);
-	tsb->printf("  Remove bounds.......%s\n  Split unions........%s\n",
+	tsb->printf("  Remove bounds.......%s\n  Split unions........%s\n  Function JIT........%s\n",
 	              GetOptionSwitchString(msg, kPOVAttrib_RemoveBounds, true),
-	              GetOptionSwitchString(msg, kPOVAttrib_SplitUnions, false));
+	              GetOptionSwitchString(msg, kPOVAttrib_SplitUnions, false),
+	              GetOptionSwitchString(msg, kPOVAttrib_FunctionJIT, false));
+
+	l = sizeof(ucs2buf);
+	ucs2buf[0] = 0;
+	if((POVMSUtil_GetUCS2String(msg, kPOVAttrib_IncludeCachePath, ucs2buf, &l) == kNoErr) && (ucs2buf[0] != 0))
+		tsb->printf("  Include cache: %s\n", UCS2toASCIIString(ucs2buf).c_str());
+
+	l = sizeof(ucs2buf);
+	ucs2buf[0] = 0;
+	if((POVMSUtil_GetUCS2String(msg, kPOVAttrib_ParseProfileFile, ucs2buf, &l) == kNoErr) && (ucs2buf[0] != 0))
+		tsb->printf("  Parse profile: %s\n", UCS2toASCIIString(ucs2buf).c_str());
+	else if(cppmsg.TryGetBool(kPOVAttrib_ParseProfile, false) == true)
+		tsb->printf("  Parse profile: On\n");
 
 	tsb->printf("  Library paths:\n");
 	if(POVMSObject_Get(msg, &attr, kPOVAttrib_LibraryPath) == kNoErr)
@@ -1011,7 +1024,7 @@ void RenderOptions(POVMS_Object& obj, TextStreamBuffer *tsb)
 	{
 		int method = 0;
 		if(obj.TryGetBool(kPOVAttrib_Antialias, false) == true)
-			method = clip(obj.TryGetInt(kPOVAttrib_SamplingMethod, 1), 0, 2);
+			method = clip(obj.TryGetInt(kPOVAttrib_SamplingMethod, 1), 0, 3);
 		int depth = clip(obj.TryGetInt(kPOVAttrib_AntialiasDepth, 3), 1, 9);
 		float threshold = clip(obj.TryGetFloat(kPOVAttrib_AntialiasThreshold, 0.3f), 0.0f, 1.0f);
 		float aagamma = obj.TryGetFloat(kPOVAttrib_AntialiasGamma, 2.5f);
@@ -1024,9 +1037,16 @@ void RenderOptions(POVMS_Object& obj, TextStreamBuffer *tsb)
 		else
 			tsb->printf("  Antialiasing.........On  (Method %d, Threshold %.3f, Depth %d, Jitter Off, Gamma %.2f)\n",
 			               method, threshold, depth, aagamma);
+		float timelimit = max(obj.TryGetFloat(kPOVAttrib_AntialiasTimeLimit, 0.0f), 0.0f);
+		if((method == 3) && (timelimit > 0.0f))
+			tsb->printf("  Antialias Time Limit.%.1f seconds\n", timelimit);
 	}
 	else
 		tsb->printf("  Antialiasing.........Off\n");
+
+	int processes = obj.TryGetInt(kPOVAttrib_RenderProcesses, 1);
+	if(processes > 1)
+		tsb->printf("  Render processes.....%d\n", processes);
 }
 
 void OutputOptions(POVMS_Object& cppmsg, TextStreamBuffer *tsb)
@@ -1311,6 +1331,17 @@ void ParserStatistics(POVMS_Object& cppmsg, TextStreamBuffer *tsb)
 	tsb->printf("Light Sources:    %10d\n", l);
 	tsb->printf("Total:            %10d\n", s + i + l);
 
+	if(cppmsg.Exist(kPOVAttrib_MeshTriangles) == true)
+	{
+		POV_LONG triangles = cppmsg.TryGetLong(kPOVAttrib_MeshTriangles, 0);
+		POV_LONG memory = cppmsg.TryGetLong(kPOVAttrib_MeshMemory, 0);
+
+		tsb->printf("----------------------------------------------------------------------------\n");
+		tsb->printf("Mesh Triangles:   %10ld\n", long(triangles));
+		tsb->printf("Mesh Data:        %10ld KBytes   %8.2f bytes/triangle\n",
+		            long(memory / 1024), triangles > 0 ? double(memory) / double(triangles) : 0.0);
+	}
+
 	if(cppmsg.Exist(kPOVAttrib_BSPNodes) == true)
 	{
 		tsb->printf("----------------------------------------------------------------------------\n");
@@ -1328,6 +1359,116 @@ void ParserStatistics(POVMS_Object& cppmsg, TextStreamBuffer *tsb)
 		            cppmsg.TryGetFloat(kPOVAttrib_BSPAverageAbortObjects, 0.0f));
 	}
 
+	if(cppmsg.Exist(kPOVAttrib_BVHNodes) == true)
+	{
+		tsb->printf("----------------------------------------------------------------------------\n");
+		tsb->printf("BVH Leaf Nodes:   %10d\n", cppmsg.TryGetInt(kPOVAttrib_BVHLeafNodes, 0));
+		tsb->printf("BVH Total Nodes:  %10d\n", cppmsg.TryGetInt(kPOVAttrib_BVHNodes, 0));
+		tsb->printf("----------------------------------------------------------------------------\n");
+		tsb->printf("BVH Objects/Leaf Average:       %8.2f          Maximum:      %10d\n",
+		            cppmsg.TryGetFloat(kPOVAttrib_BVHAverageObjects, 0.0f), cppmsg.TryGetInt(kPOVAttrib_BVHMaxObjects, 0));
+		tsb->printf("BVH Tree Depth Average:         %8.2f          Maximum:      %10d\n",
+		            cppmsg.TryGetFloat(kPOVAttrib_BVHAverageDepth, 0.0f), cppmsg.TryGetInt(kPOVAttrib_BVHMaxDepth, 0));
+	}
+
+	if(cppmsg.Exist(kPOVAttrib_FunctionJITStats) == true)
+	{
+		POVMS_List jitStats;
+		POV_LONG totalTime = 0;
+		int compiled = 0;
+		int interpreted = 0;
+
+		cppmsg.Get(kPOVAttrib_FunctionJITStats, jitStats);
+
+		tsb->printf("----------------------------------------------------------------------------\n");
+		tsb->printf("Function                   Instructions     Native Code       Compile Time\n");
+
+		for(int index = 1; index <= jitStats.GetListSize(); index++)
+		{
+			POVMS_Object jitStat;
+
+			jitStats.GetNth(index, jitStat);
+
+			std::string name(jitStat.TryGetString(kPOVAttrib_FunctionName, ""));
+			int instructions = jitStat.TryGetInt(kPOVAttrib_FunctionInstructions, 0);
+			int codesize = jitStat.TryGetInt(kPOVAttrib_FunctionCodeSize, 0);
+			POV_LONG compiletime = jitStat.TryGetLong(kPOVAttrib_FunctionCompileTime, 0);
+
+			if(codesize > 0)
+				compiled++;
+			else
+				interpreted++;
+			totalTime += compiletime;
+
+			// functions that merely wrap an internal function (such as those in functions.inc) are not listed
+			if(instructions > 2)
+			{
+				if(name.empty() == true)
+					name = "(anonymous)";
+				if(codesize > 0)
+					tsb->printf("%-24.24s  %13d  %8d bytes  %12d usec\n", name.c_str(), instructions, codesize, int(compiletime));
+				else
+					tsb->printf("%-24.24s  %13d     interpreted  %12d usec\n", name.c_str(), instructions, int(compiletime));
+			}
+		}
+
+		tsb->printf("Functions Compiled:     %10d   Interpreted:   %10d   Time: %d.%03d sec\n",
+		            compiled, interpreted, int(totalTime / 1000000), int((totalTime / 1000) % 1000));
+	}
+
+	if(cppmsg.Exist(kPOVAttrib_ParseProfileSites) == true)
+	{
+		const int maxSites = 20;
+		POVMS_List profileSites;
+
+		cppmsg.Get(kPOVAttrib_ParseProfileSites, profileSites);
+
+		// sites arrive sorted by decreasing self time; counts exclude nested sites, total time includes them
+		tsb->printf("----------------------------------------------------------------------------\n");
+		tsb->printf("Parser Profile         Calls  Total ms   Self ms    Tokens  Lookups   Allocs\n");
+
+		for(int index = 1; (index <= profileSites.GetListSize()) && (index <= maxSites); index++)
+		{
+			POVMS_Object profileSite;
+
+			profileSites.GetNth(index, profileSite);
+
+			std::string name(profileSite.TryGetString(kPOVAttrib_ProfileName, ""));
+			std::string file(profileSite.TryGetString(kPOVAttrib_ProfileFile, ""));
+			char label[256];
+
+			// show file names without their path
+			if(name.find_last_of("/\\") != std::string::npos)
+				name.erase(0, name.find_last_of("/\\") + 1);
+			if(file.find_last_of("/\\") != std::string::npos)
+				file.erase(0, file.find_last_of("/\\") + 1);
+
+			switch(profileSite.TryGetInt(kPOVAttrib_ProfileKind, 0))
+			{
+				case 0:
+					sprintf(label, "file %.240s", name.c_str());
+					break;
+				case 1:
+					sprintf(label, "macro %.240s", name.c_str());
+					break;
+				default:
+					sprintf(label, "%s %.200s:%ld", name.c_str(), file.c_str(), long(profileSite.TryGetLong(kPOVAttrib_ProfileLine, 0)));
+					break;
+			}
+
+			tsb->printf("%-20.20s %7ld %9.1f %9.1f %9ld %8ld %8ld\n", label,
+			            long(profileSite.TryGetLong(kPOVAttrib_ProfileCalls, 0)),
+			            double(profileSite.TryGetLong(kPOVAttrib_ProfileTotalTime, 0)) / 1000.0,
+			            double(profileSite.TryGetLong(kPOVAttrib_ProfileSelfTime, 0)) / 1000.0,
+			            long(profileSite.TryGetLong(kPOVAttrib_ProfileTokens, 0)),
+			            long(profileSite.TryGetLong(kPOVAttrib_ProfileLookups, 0)),
+			            long(profileSite.TryGetLong(kPOVAttrib_ProfileAllocations, 0)));
+		}
+
+		if(profileSites.GetListSize() > maxSites)
+			tsb->printf("(%d more sites not shown)\n", profileSites.GetListSize() - maxSites);
+	}
+
 	tsb->printf("----------------------------------------------------------------------------\n");
 }
 
@@ -1434,6 +1575,16 @@ void RenderStatistics(POVMS_Object& cppmsg, TextStreamBuffer *tsb)
 				            100.0 * POVMSLongToCDouble(l2) / POVMSLongToCDouble(l));
 	}
 
+	(void)POVMSUtil_GetLong(msg, kPOVAttrib_PatternCacheTest, &l);
+	(void)POVMSUtil_GetLong(msg, kPOVAttrib_PatternCacheTestSuc, &l2);
+	if(POVMSLongToCDouble(l) > 0.5)
+	{
+		tsb->printf("----------------------------------------------------------------------------\n");
+		tsb->printf("Pattern Cache Queries: %15.0f\n", POVMSLongToCDouble(l));
+		tsb->printf("Pattern Cache Hits:    %15.0f (%3.0f percent)\n", POVMSLongToCDouble(l2),
+		            100.0 * POVMSLongToCDouble(l2) / POVMSLongToCDouble(l));
+	}
+
 	tsb->printf("----------------------------------------------------------------------------\n");
 
 	(void)POVMSUtil_GetLong(msg, kPOVAttrib_PolynomTest, &l);
@@ -1530,6 +1681,10 @@ void RenderStatistics(POVMS_Object& cppmsg, TextStreamBuffer *tsb)
 			tsb->printf("Radiosity octree samples/node: %15.2f\n", POVMSLongToCDouble(l) / POVMSLongToCDouble(l2));
 		}
 
+		(void)POVMSUtil_GetLong(msg, kPOVAttrib_RadOctreeContention, &l2);
+		if(POVMSLongToCDouble(l2) > 0.5)
+			tsb->printf("Radiosity octree contention:   %15.0f\n", POVMSLongToCDouble(l2));
+
 		(void)POVMSUtil_GetLong(msg, kPOVAttrib_RadOctreeLookups, &l);
 		if(POVMSLongToCDouble(l) > 0.5)
 			tsb->printf("Radiosity blocks examined:     %15.0f\n", POVMSLongToCDouble(l));
@@ -1921,6 +2076,20 @@ void RenderTime(POVMS_Object& cppmsg, TextStreamBuffer *tsb)
 		}
 		else
 			tsb->printf("              using %d thread(s)\n", int(renderTime.TryGetInt(kPOVAttrib_TimeSamples, 1)));
+		if((renderTime.Exist(kPOVAttrib_ThreadBlocks) == true) && (renderTime.Exist(kPOVAttrib_ThreadSteals) == true) && (renderTime.Exist(kPOVAttrib_ThreadIdleTime) == true))
+		{
+			vector<POVMSLong> blocks(renderTime.GetLongVector(kPOVAttrib_ThreadBlocks));
+			vector<POVMSLong> steals(renderTime.GetLongVector(kPOVAttrib_ThreadSteals));
+			vector<POVMSLong> idleTime(renderTime.GetLongVector(kPOVAttrib_ThreadIdleTime));
+
+			// per-thread block distribution is only of interest with more than one thread
+			for(size_t t = 0; (blocks.size() > 1) && (t < blocks.size()) && (t < steals.size()) && (t < idleTime.size()); t++)
+			{
+				sec = int(idleTime[t] / (POV_LONG)(1000));
+				msec = int(idleTime[t] % (POV_LONG)(1000));
+				tsb->printf("              thread %3d: %8d blocks, %6d stolen, %d.%03d seconds idle\n", int(t + 1), int(blocks[t]), int(steals[t]), sec, msec);
+			}
+		}
 	}
 	else
 		tsb->printf("  Trace Time:       No trace\n");
@@ -145,6 +145,8 @@ const INTERSECTION_STATS_INFO intersection_stats[kPOVList_Stat_Last] =
 	  "Blob Component" },
 	{ kPOVList_Stat_BlobBdTest,         Blob_Bound_Tests, Blob_Bound_Tests_Succeeded,
 	  "Blob Bound" },
+	{ kPOVList_Stat_BlobGridTest,       Blob_Grid_Cell_Tests, Blob_Grid_Cell_Tests_Succeeded,
+	  "Blob Grid Cell" },
 	{ kPOVList_Stat_BoxTest,            Ray_Box_Tests, Ray_Box_Tests_Succeeded,
 	  "Box" },
 	{ kPOVList_Stat_ConeCylTest,        Ray_Cone_Tests, Ray_Cone_Tests_Succeeded,
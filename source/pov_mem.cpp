@@ -306,6 +306,9 @@ number of calls to malloc/free and some other statistics.
 
 static int leak_msg = false; // GLOBAL VARIABLE
 
+/* number of blocks allocated so far (see mem_allocations) */
+static POV_ULONG mem_allocation_count = 0; // GLOBAL VARIABLE
+
 
 #ifdef MEM_HEADER
 	const int NODESIZE = (((sizeof(MEMNODE) + (MEM_HEADER_ALIGNMENT - 1)) / MEM_HEADER_ALIGNMENT) * MEM_HEADER_ALIGNMENT);
@@ -430,6 +433,8 @@ void *pov_malloc(size_t size, const char *file, int line, const char *msg)
 	if (block == NULL)
 		throw std::bad_alloc();; // TODO FIXME !!! // Parser::MAError(msg, (int)size);
 
+	mem_allocation_count++;
+
 #if defined(MEM_HEADER)
 	node = (MEMNODE *) block;
 #endif
@@ -473,6 +478,16 @@ void *pov_malloc(size_t size, const char *file, int line, const char *msg)
 }
 
 
+/****************************************************************************/
+/* Number of blocks allocated so far by pov_malloc, pov_calloc and pov_realloc
+   (counting only new blocks), for profiling.  The count is not synchronized, so
+   blocks allocated by other threads may or may not be included. */
+POV_ULONG mem_allocations()
+{
+	return mem_allocation_count;
+}
+
+
 /****************************************************************************/
 void *pov_calloc(size_t nitems, size_t size, const char *file, int line, const char *msg)
 {
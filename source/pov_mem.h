@@ -129,6 +129,7 @@ void *pov_realloc (void *ptr, size_t size, const char *file, int line, const cha
 void pov_free (void *ptr, const char *file, int line);
 char *pov_strdup (const char *s);
 void *pov_memmove (void *dest, void *src, size_t length);
+POV_ULONG mem_allocations (void);
 
 #if defined(MEM_STATS)
 /* These are level 1 routines */
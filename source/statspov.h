@@ -124,6 +124,8 @@ typedef enum INTSTATS
 	Blob_Element_Tests_Succeeded,
 	Blob_Bound_Tests,
 	Blob_Bound_Tests_Succeeded,
+	Blob_Grid_Cell_Tests,
+	Blob_Grid_Cell_Tests_Succeeded,
 	Ray_Box_Tests,
 	Ray_Box_Tests_Succeeded,
 	Ray_Cone_Tests,
@@ -201,6 +203,10 @@ typedef enum INTSTATS
 	CrackleCache_Tests,
 	CrackleCache_Tests_Succeeded,
 
+	/* pattern cache */
+	PatternCache_Tests,
+	PatternCache_Tests_Succeeded,
+
 	/* bounding etc */
 	Bounding_Region_Tests,
 	Bounding_Region_Tests_Succeeded,
@@ -265,6 +271,7 @@ typedef enum INTSTATS
 	Radiosity_UnsavedCount,           // number of samples gathered but not stored in cache
 	Radiosity_RayCount,               // number of rays shot to gather samples
 	Radiosity_OctreeNodes,            // number of nodes in octree
+	Radiosity_OctreeContention,       // number of octree insertions that had to wait for or retry after another thread
 	Radiosity_OctreeLookups,          // number of blocks examined for sample lookup
 	Radiosity_OctreeAccepts0,         // number of blocks accepted by pass & tile id check
 	Radiosity_OctreeAccepts1,         // number of blocks accepted by quick out-of-range check
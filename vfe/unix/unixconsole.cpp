@@ -284,6 +284,19 @@ void PrintVersion(void)
 	);
 }
 
+void PrintNoiseBenchmark(void)
+{
+	pov::Noise_Benchmark_Result results[4];
+	unsigned int count = pov::Run_Noise_Benchmark(results, 4);
+
+	fprintf(stderr, "Noise function variants (million calls per second):\n");
+	fprintf(stderr, "  %-12s %10s %10s %14s\n", "Variant", "Noise", "DNoise", "Max deviation");
+	for (unsigned int i = 0; i < count; i++)
+		fprintf(stderr, "  %-12s %10.2f %10.2f %14.3g%s\n",
+			results[i].Name, results[i].Noise_Rate, results[i].DNoise_Rate, results[i].Max_Deviation,
+			results[i].Selected ? "  (selected)" : "");
+}
+
 void ErrorExit(vfeSession *session)
 {
 	fprintf(stderr, "%s\n", session->GetErrorString());
@@ -499,6 +512,14 @@ int main (int argc, char **argv)
 		delete session;
 		return RETURN_OK;
 	}
+	else if (session->GetUnixOptions()->isOptionSet("general", "benchmark_noise"))
+	{
+		PrintNoiseBenchmark();
+		session->Shutdown() ;
+		delete sigthread;
+		delete session;
+		return RETURN_OK;
+	}
 	else if (session->GetUnixOptions()->isOptionSet("general", "benchmark"))
 	{
 		retval = PrepareBenchmark(session, opts, bench_ini_name, bench_pov_name, argc, argv);
@@ -112,6 +112,7 @@ namespace vfePlatform
 		UnixOptionsProcessor::Option_Info("general", "temppath", "", true, "", "POV_TEMP_DIR", "directory for temporary files"),
 		UnixOptionsProcessor::Option_Info("general", "version", "off", false, "--version|-version|--V", "", "display program version"),
 		UnixOptionsProcessor::Option_Info("general", "benchmark", "off", false, "--benchmark|-benchmark", "", "run the standard POV-Ray benchmark"),
+		UnixOptionsProcessor::Option_Info("general", "benchmark_noise", "off", false, "--benchmark-noise", "", "compare the speed of the noise function variants"),
 		UnixOptionsProcessor::Option_Info("", "", "", false, "", "", "") // has to be last
 	};
 